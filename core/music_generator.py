@@ -86,6 +86,7 @@ class MusicGenerator:
         sample_type="custom",
         generation_duration=6,
         sample_rate=48000,
+        seed=None,
     ):
         try:
             print(f"🔮 Direct generation with prompt: '{musicgen_prompt}'")
@@ -97,7 +98,9 @@ class MusicGenerator:
                 num_inference_steps = 8
                 cfg_scale = 1.0
 
-            seed_value = random.randint(0, 2**31 - 1)
+            seed_value = (
+                seed if seed is not None and seed >= 0 else random.randint(0, 2**31 - 1)
+            )
             generator = torch.Generator(device=self.device).manual_seed(seed_value)
 
             print(
@@ -136,6 +139,7 @@ class MusicGenerator:
                 "type": sample_type,
                 "tempo": tempo,
                 "prompt": musicgen_prompt,
+                "seed": seed_value,
             }
 
             return sample_audio, sample_info
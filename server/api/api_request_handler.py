@@ -55,6 +55,7 @@ class APIRequestHandler:
             tempo=request.bpm,
             generation_duration=request.generation_duration or 6,
             sample_rate=int(request.sample_rate),
+            seed=request.seed,
         )
         self.dj_system.music_gen.destroy_model()
         return audio, sample_info
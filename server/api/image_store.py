@@ -0,0 +1,70 @@
+import hashlib
+import threading
+import time
+from collections import OrderedDict
+
+PNG_SIGNATURE = b"\x89PNG"
+
+# MiniCPM-V slices images into 448px tiles, so anything larger is resized
+# away before the vision model sees it.
+IMAGE_MAX_DIMENSION = 448
+IMAGE_QUANTIZE_BITS = 4
+IMAGE_MAX_UPLOAD_BYTES = 8 * 1024 * 1024
+
+
+class ImageStore:
+    def __init__(self, max_bytes=64 * 1024 * 1024, ttl_seconds=3600):
+        self.max_bytes = max_bytes
+        self.ttl_seconds = ttl_seconds
+        self._images = OrderedDict()
+        self._total_bytes = 0
+        self._lock = threading.Lock()
+
+    @staticmethod
+    def compute_hash(image_bytes):
+        return hashlib.sha256(image_bytes).hexdigest()
+
+    def put(self, image_bytes):
+        image_hash = self.compute_hash(image_bytes)
+        with self._lock:
+            if image_hash in self._images:
+                self._images.move_to_end(image_hash)
+                self._images[image_hash] = (image_bytes, time.time())
+                return image_hash
+
+            self._images[image_hash] = (image_bytes, time.time())
+            self._total_bytes += len(image_bytes)
+            self._evict_locked()
+        return image_hash
+
+    def get(self, image_hash):
+        with self._lock:
+            entry = self._images.get(image_hash)
+            if entry is None:
+                return None
+            image_bytes, stored_at = entry
+            if time.time() - stored_at > self.ttl_seconds:
+                self._remove_locked(image_hash)
+                return None
+            self._images.move_to_end(image_hash)
+            return image_bytes
+
+    def _remove_locked(self, image_hash):
+        image_bytes, _ = self._images.pop(image_hash)
+        self._total_bytes -= len(image_bytes)
+
+    def _evict_locked(self):
+        now = time.time()
+        expired = [
+            h for h, (_, stored_at) in self._images.items()
+            if now - stored_at > self.ttl_seconds
+        ]
+        for image_hash in expired:
+            self._remove_locked(image_hash)
+
+        while self._total_bytes > self.max_bytes and len(self._images) > 1:
+            oldest = next(iter(self._images))
+            self._remove_locked(oldest)
+
+
+image_store = ImageStore()
@@ -11,5 +11,7 @@ class GenerateRequest(BaseModel):
     sample_rate: Optional[float] = 48000.00
     use_image: Optional[bool] = False
     image_base64: Optional[str] = None
+    image_hash: Optional[str] = None
     image_temperature: Optional[float] = 0.7
     keywords: Optional[List[str]] = []
+    seed: Optional[int] = None
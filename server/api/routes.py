@@ -11,6 +11,13 @@ from fastapi import APIRouter, HTTPException, Depends, Request
 from fastapi.security import APIKeyHeader
 from fastapi.responses import Response
 from .models import GenerateRequest
+from .image_store import (
+    image_store,
+    PNG_SIGNATURE,
+    IMAGE_MAX_DIMENSION,
+    IMAGE_QUANTIZE_BITS,
+    IMAGE_MAX_UPLOAD_BYTES,
+)
 from core.dj_system import DJSystem
 from config.config import API_KEYS, ENVIRONMENT, lock, IS_TEST, BYPASS_LLM
 from server.api.api_request_handler import APIRequestHandler
@@ -94,6 +101,78 @@ async def verify_key(_: str = Depends(verify_api_key)):
     return {"status": "valid", "message": "API Key valid"}
 
 
+@router.get("/images/capabilities")
+async def image_capabilities(api_key: str = Depends(verify_api_key)):
+    return {
+        "max_dimension": IMAGE_MAX_DIMENSION,
+        "quantize_bits": IMAGE_QUANTIZE_BITS,
+        "max_upload_bytes": IMAGE_MAX_UPLOAD_BYTES,
+        "formats": ["png"],
+    }
+
+
+# Refuses the body as soon as it is known to exceed max_bytes, instead of
+# buffering all of it first.
+async def read_limited_body(request: Request, max_bytes: int) -> bytes:
+    content_length = request.headers.get("content-length")
+    if content_length is not None:
+        try:
+            declared_bytes = int(content_length)
+        except ValueError:
+            raise create_error_response("INVALID_REQUEST", "Invalid Content-Length")
+        if declared_bytes > max_bytes:
+            raise create_error_response("IMAGE_TOO_LARGE", "Image exceeds upload limit", 413)
+
+    body = bytearray()
+    async for chunk in request.stream():
+        body.extend(chunk)
+        if len(body) > max_bytes:
+            raise create_error_response("IMAGE_TOO_LARGE", "Image exceeds upload limit", 413)
+    return bytes(body)
+
+
+@router.post("/images")
+async def upload_image(request: Request, api_key: str = Depends(verify_api_key)):
+    image_bytes = await read_limited_body(request, IMAGE_MAX_UPLOAD_BYTES)
+    if not image_bytes.startswith(PNG_SIGNATURE):
+        raise create_error_response("INVALID_IMAGE", "Upload must be a PNG image")
+
+    # Only a verified upload is stored.
+    expected_hash = request.headers.get("X-Image-Hash")
+    image_hash = image_store.compute_hash(image_bytes)
+    if expected_hash and expected_hash.lower() != image_hash:
+        raise create_error_response("HASH_MISMATCH", "Image hash does not match upload")
+    image_store.put(image_bytes)
+
+    print(f"🖼️  Image stored: {image_hash[:12]} ({len(image_bytes)} bytes)")
+    return {"image_hash": image_hash, "size": len(image_bytes)}
+
+
+def decode_request_image(request: GenerateRequest) -> bytes:
+    if request.image_hash:
+        image_bytes = image_store.get(request.image_hash.lower())
+        if image_bytes is None:
+            raise create_error_response(
+                "IMAGE_NOT_FOUND", "Image hash unknown or expired, upload it again", 404
+            )
+        print(f"✅ Image resolved from hash: {len(image_bytes)} bytes")
+        return image_bytes
+
+    cleaned_base64 = clean_base64(request.image_base64)
+    print(f"✅ Cleaned base64 length: {len(cleaned_base64)} chars")
+    print(f"📊 Length % 4 = {len(cleaned_base64) % 4}")
+
+    try:
+        image_bytes = base64.b64decode(cleaned_base64, validate=True)
+    except Exception as e:
+        print(f"⚠️  Standard decode failed: {e}")
+        print(f"🔄 Retrying with validate=False...")
+        image_bytes = base64.b64decode(cleaned_base64, validate=False)
+
+    print(f"✅ Image decoded: {len(image_bytes)} bytes")
+    return image_bytes
+
+
 @router.post("/generate")
 async def generate_loop(
     request: GenerateRequest,
@@ -101,24 +180,14 @@ async def generate_loop(
     dj_system: DJSystem = Depends(get_dj_system),
 ):
     processed_path = None
+    used_seed = None
     try:
         request_id = int(time.time())
         temp_image_path = None
-        if request.use_image and request.image_base64:
-            cleaned_base64 = clean_base64(request.image_base64)
-            print(f"✅ Cleaned base64 length: {len(cleaned_base64)} chars")
-            print(f"📊 Length % 4 = {len(cleaned_base64) % 4}")
-
-            try:
-                image_bytes = base64.b64decode(cleaned_base64, validate=True)
-            except Exception as e:
-                print(f"⚠️  Standard decode failed: {e}")
-                print(f"🔄 Retrying with validate=False...")
-                image_bytes = base64.b64decode(cleaned_base64, validate=False)
-
-            print(f"✅ Image decoded: {len(image_bytes)} bytes")
+        if request.use_image and (request.image_hash or request.image_base64):
+            image_bytes = decode_request_image(request)
 
-            if not image_bytes.startswith(b"\x89PNG"):
+            if not image_bytes.startswith(PNG_SIGNATURE):
                 raise ValueError("Decoded data is not a valid PNG image")
 
             with tempfile.NamedTemporaryFile(delete=False, suffix=".png") as tmp:
@@ -153,9 +222,9 @@ async def generate_loop(
 
             request.prompt = generated_prompt
 
-        elif request.use_image and not request.image_base64:
+        elif request.use_image:
             raise create_error_response(
-                "INVALID_REQUEST", "use_image=true but no image_base64 provided"
+                "INVALID_REQUEST", "use_image=true but no image_hash or image_base64 provided"
             )
         if not request.prompt or len(request.prompt.strip()) < 3:
             raise create_error_response(
@@ -192,7 +261,8 @@ async def generate_loop(
                         llm_decision = (
                             f"{request.bpm} BPM {request.prompt} {request.key}"
                         )
-                audio, _ = handler.generate_simple(request, llm_decision)
+                audio, sample_info = handler.generate_simple(request, llm_decision)
+                used_seed = sample_info.get("seed")
                 processed_path = handler.process_audio_pipeline(
                     audio, request, request_id
                 )
@@ -262,6 +332,7 @@ async def generate_loop(
             "X-Detected-BPM": str(detected_bpm) if detected_bpm else "",
             "X-Key": str(request.key or ""),
             "X-Stems-Used": "",
+            "X-Seed": str(used_seed) if used_seed is not None else "",
             "X-Credits-Remaining": remaining_credits,
         }
         if key_info.get("is_limited") and key_info.get("date_of_expiration"):
@@ -1,108 +1,475 @@
 #pragma once
 #include "JuceHeader.h"
 #include "SoundTouch.h"
-#include "BPMDetect.h"
+#include <array>
+#include <vector>
 
 class AudioAnalyzer
 {
 public:
+	struct TempoEstimate
+	{
+		float bpm = 0.0f;
+		float confidence = 0.0f;
+		double beatOffsetSeconds = 0.0;
+		double downbeatOffsetSeconds = 0.0;
+
+		bool isValid() const { return bpm > 0.0f; }
+	};
+
+	static constexpr float minimumTempoConfidence = 0.35f;
+
 	static float detectBPM(const juce::AudioBuffer<float>& buffer, double sampleRate)
 	{
-		if (buffer.getNumSamples() == 0)
-			return 0.0f;
+		return analyzeTempo(buffer, sampleRate).bpm;
+	}
+
+	// Spectral-flux onset envelope, FFT autocorrelation and a comb over beat
+	// multiples. Confidence combines how periodic the envelope is at the chosen
+	// lag with how far that tempo stands out from the other candidates.
+	static TempoEstimate analyzeTempo(const juce::AudioBuffer<float>& buffer, double sampleRate)
+	{
+		TempoEstimate result;
+		if (buffer.getNumSamples() == 0 || buffer.getNumChannels() == 0 || sampleRate <= 0.0)
+			return result;
 
 		try
 		{
-			soundtouch::BPMDetect bpmDetect(1, (int)sampleRate);
-
-			int maxSamplesToAnalyze = (int)(sampleRate * 10.0);
-			int samplesToAnalyze = std::min(buffer.getNumSamples(), maxSamplesToAnalyze);
+			int numSamples = std::min(buffer.getNumSamples(), (int)(sampleRate * maxTempoAnalysisSeconds));
+			int hopSize = juce::nextPowerOfTwo((int)(sampleRate / 100.0));
+			int fftSize = hopSize * 2;
+			if (numSamples < fftSize * 4)
+				return result;
 
-			std::vector<float> monoData;
-			monoData.reserve(samplesToAnalyze);
+			auto mono = makeMono(buffer, numSamples);
 
-			bool retFlag;
-			float retVal = normalizeAudio(buffer, monoData, retFlag, samplesToAnalyze);
-			if (retFlag)
-				return retVal;
+			std::vector<float> onset, lowOnset;
+			computeOnsetEnvelopes(mono, sampleRate, fftSize, hopSize, onset, lowOnset);
 
-			chunkAnalysis(monoData, bpmDetect);
+			double frameRate = sampleRate / hopSize;
+			auto acf = computeAutocorrelation(onset);
+			if (acf.empty() || acf[0] <= 0.0f)
+				return result;
 
-			float detectedBPM = bpmDetect.getBpm();
+			float bestScore = 0.0f;
+			float bestBpm = 0.0f;
+			double scoreSum = 0.0;
+			int numCandidates = 0;
 
-			if (detectedBPM >= 30.0f && detectedBPM <= 300.0f)
+			for (float bpm = minTempoBpm; bpm <= maxTempoBpm; bpm += tempoStepBpm)
 			{
-				DBG("BPM detected: " << detectedBPM);
-				return detectedBPM;
+				float score = scoreTempo(acf, 60.0 * frameRate / bpm) * tempoPrior(bpm);
+				scoreSum += score;
+				++numCandidates;
+				if (score > bestScore)
+				{
+					bestScore = score;
+					bestBpm = bpm;
+				}
 			}
 
-			DBG("BPM detection failed, returning 0");
-			return 0.0f;
+			if (bestScore <= 0.0f || numCandidates == 0)
+				return result;
+
+			double beatLag = 60.0 * frameRate / bestBpm;
+			float meanScore = (float)(scoreSum / numCandidates);
+			float salience = (bestScore - meanScore) / bestScore;
+			float periodicity = juce::jlimit(0.0f, 1.0f, interpolate(acf, beatLag));
+
+			result.bpm = bestBpm;
+			result.confidence = juce::jlimit(0.0f, 1.0f, std::sqrt(juce::jmax(0.0f, salience) * periodicity) * 1.5f);
+
+			double beatPhase = findBeatPhase(onset, beatLag);
+			int downbeat = findDownbeat(lowOnset, beatPhase, beatLag);
+			double frameCentre = fftSize * 0.5 / sampleRate;
+			result.beatOffsetSeconds = beatPhase / frameRate + frameCentre;
+			result.downbeatOffsetSeconds = (beatPhase + downbeat * beatLag) / frameRate + frameCentre;
+
+			DBG("Tempo: " << bestBpm << " BPM, confidence " << result.confidence
+				<< ", downbeat at " << result.downbeatOffsetSeconds << " s");
+			return result;
 		}
 		catch (const std::exception& e)
 		{
-			DBG("BPM detection error: " << e.what());
-			return 0.0f;
+			DBG("Tempo analysis error: " << e.what());
+			return {};
 		}
 	}
-	static float returnDetectedBPMorFallback(float detectedBPM,
-		const juce::AudioSampleBuffer& /*buffer*/,
-		double /*sampleRate*/)
+
+	struct KeyEstimate
 	{
-		if (detectedBPM >= 30.0f && detectedBPM <= 300.0f)
+		juce::String key;
+		float confidence = 0.0f;
+		// Pitch class of the tonic, -1 when no key was found.
+		int tonic = -1;
+		bool minor = false;
+	};
+
+	// Chroma from FFT magnitudes correlated against Krumhansl-Kessler profiles.
+	static KeyEstimate estimateKey(const juce::AudioBuffer<float>& buffer, double sampleRate)
+	{
+		KeyEstimate result;
+		const int fftOrder = 12;
+		const int fftSize = 1 << fftOrder;
+		const int hopSize = fftSize / 2;
+
+		int numSamples = std::min(buffer.getNumSamples(), (int)(sampleRate * maxTempoAnalysisSeconds));
+		if (buffer.getNumChannels() == 0 || sampleRate <= 0.0 || numSamples < fftSize)
+			return result;
+
+		auto mono = makeMono(buffer, numSamples);
+		juce::dsp::FFT fft(fftOrder);
+		juce::dsp::WindowingFunction<float> window((size_t)fftSize, juce::dsp::WindowingFunction<float>::hann, false);
+
+		int numBins = fftSize / 2 + 1;
+		std::vector<int> binPitchClass((size_t)numBins, -1);
+		for (int b = 1; b < numBins; ++b)
+		{
+			double frequency = b * sampleRate / fftSize;
+			if (frequency < 55.0 || frequency > 5000.0)
+				continue;
+			int midi = juce::roundToInt(12.0 * std::log2(frequency / 440.0) + 69.0);
+			binPitchClass[(size_t)b] = ((midi % 12) + 12) % 12;
+		}
+
+		std::array<double, 12> chroma{};
+		std::vector<float> frame((size_t)fftSize * 2);
+		for (int start = 0; start + fftSize <= numSamples; start += hopSize)
+		{
+			std::fill(frame.begin(), frame.end(), 0.0f);
+			juce::FloatVectorOperations::copy(frame.data(), mono.data() + start, fftSize);
+			window.multiplyWithWindowingTable(frame.data(), (size_t)fftSize);
+			fft.performFrequencyOnlyForwardTransform(frame.data(), true);
+
+			for (int b = 1; b < numBins; ++b)
+				if (binPitchClass[(size_t)b] >= 0)
+					chroma[(size_t)binPitchClass[(size_t)b]] += frame[(size_t)b];
+		}
+
+		static const double majorProfile[12] = { 6.35, 2.23, 3.48, 2.33, 4.38, 4.09, 2.52, 5.19, 2.39, 3.66, 2.29, 2.88 };
+		static const double minorProfile[12] = { 6.33, 2.68, 3.52, 5.38, 2.60, 3.53, 2.54, 4.75, 3.98, 2.69, 3.34, 3.17 };
+		static const char* noteNames[12] = { "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B" };
+
+		double best = -2.0, secondBest = -2.0;
+		for (int tonic = 0; tonic < 12; ++tonic)
 		{
-			return detectedBPM;
+			for (int mode = 0; mode < 2; ++mode)
+			{
+				const double* profile = mode == 0 ? majorProfile : minorProfile;
+				std::array<double, 12> rotated{};
+				for (int i = 0; i < 12; ++i)
+					rotated[(size_t)i] = profile[(i - tonic + 12) % 12];
+
+				double r = correlation(chroma, rotated);
+				if (r > best)
+				{
+					secondBest = best;
+					best = r;
+					result.key = juce::String(noteNames[tonic]) + (mode == 0 ? " Major" : " Minor");
+					result.tonic = tonic;
+					result.minor = mode == 1;
+				}
+				else if (r > secondBest)
+				{
+					secondBest = r;
+				}
+			}
 		}
-		return 0.0f;
+
+		// A clear winner matters more than a high absolute correlation: relative
+		// major/minor pairs always score close to each other.
+		result.confidence = juce::jlimit(0.0f, 1.0f, (float)(juce::jmax(0.0, best) * 0.5 + (best - secondBest) * 5.0));
+		return result;
 	}
 
-	static void chunkAnalysis(std::vector<float>& monoData, soundtouch::BPMDetect& bpmDetect)
+	struct LoudnessMeasurement
 	{
-		const int chunkSize = 4096;
+		float integratedLufs = -70.0f;
+		float truePeakDb = -100.0f;
+	};
+
+	// ITU-R BS.1770-4 integrated loudness (K-weighting, 400 ms blocks with 75%
+	// overlap, absolute and relative gates) and 4x oversampled true peak.
+	static LoudnessMeasurement measureLoudness(const juce::AudioBuffer<float>& buffer, double sampleRate)
+	{
+		LoudnessMeasurement result;
+		int numChannels = juce::jmin(2, buffer.getNumChannels());
+		int numSamples = buffer.getNumSamples();
+		if (numChannels == 0 || numSamples == 0 || sampleRate <= 0.0)
+			return result;
+
+		int segmentSize = juce::jmax(1, (int)(sampleRate * 0.1));
+		int numSegments = numSamples / segmentSize;
+		std::vector<double> segmentEnergy((size_t)numSegments, 0.0);
+
+		juce::AudioBuffer<float> weighted;
+		weighted.makeCopyOf(buffer);
+		for (int ch = 0; ch < numChannels; ++ch)
+		{
+			juce::IIRFilter shelf, highPass;
+			shelf.setCoefficients(makeKWeightingShelf(sampleRate));
+			highPass.setCoefficients(makeKWeightingHighPass(sampleRate));
+			auto* data = weighted.getWritePointer(ch);
+			shelf.processSamples(data, numSamples);
+			highPass.processSamples(data, numSamples);
+
+			for (int seg = 0; seg < numSegments; ++seg)
+			{
+				const float* segment = data + (size_t)seg * segmentSize;
+				double sum = 0.0;
+				for (int i = 0; i < segmentSize; ++i)
+					sum += (double)segment[i] * segment[i];
+				segmentEnergy[(size_t)seg] += sum / segmentSize;
+			}
+		}
+
+		std::vector<double> blockEnergy;
+		for (int seg = 0; seg + 4 <= numSegments; ++seg)
+			blockEnergy.push_back((segmentEnergy[(size_t)seg] + segmentEnergy[(size_t)seg + 1]
+				+ segmentEnergy[(size_t)seg + 2] + segmentEnergy[(size_t)seg + 3]) * 0.25);
+
+		auto toLufs = [](double energy) { return energy > 0.0 ? -0.691 + 10.0 * std::log10(energy) : -100.0; };
+		auto gatedMean = [&blockEnergy, &toLufs](double gateLufs, double& mean)
+			{
+				double sum = 0.0;
+				int count = 0;
+				for (auto energy : blockEnergy)
+				{
+					if (toLufs(energy) > gateLufs)
+					{
+						sum += energy;
+						++count;
+					}
+				}
+				mean = count > 0 ? sum / count : 0.0;
+				return count;
+			};
 
-		for (size_t i = 0; i < monoData.size(); i += chunkSize)
+		double absoluteMean = 0.0;
+		if (gatedMean(-70.0, absoluteMean) > 0)
 		{
-			size_t remaining = std::min((size_t)chunkSize, monoData.size() - i);
-			bpmDetect.inputSamples(&monoData[i], (int)remaining);
+			double relativeMean = 0.0;
+			if (gatedMean(toLufs(absoluteMean) - 10.0, relativeMean) > 0)
+				result.integratedLufs = (float)toLufs(relativeMean);
 		}
+
+		result.truePeakDb = juce::Decibels::gainToDecibels(measureTruePeak(buffer, numChannels), -100.0f);
+		return result;
 	}
 
-	static float normalizeAudio(const juce::AudioSampleBuffer& buffer,
-		std::vector<float>& monoData,
-		bool& retFlag,
-		int maxSamples = -1)
+	struct OnsetStrength
+	{
+		std::vector<float> envelope;
+		int hopSize = 0;
+		double frameCentreOffset = 0.0;
+
+		// Strongest onset within a couple of frames of samplePosition, so
+		// callers scoring grid positions tolerate small misalignment.
+		float at(double samplePosition) const
+		{
+			if (envelope.empty() || hopSize <= 0)
+				return 0.0f;
+			int frame = juce::roundToInt((samplePosition - frameCentreOffset) / hopSize);
+			float best = 0.0f;
+			for (int f = frame - 2; f <= frame + 2; ++f)
+				if (f >= 0 && f < (int)envelope.size())
+					best = juce::jmax(best, envelope[(size_t)f]);
+			return best;
+		}
+	};
+
+	// Spectral-flux onset strength at roughly 100 frames per second,
+	// normalised so the strongest onset is 1.
+	static OnsetStrength computeOnsetStrength(const juce::AudioBuffer<float>& buffer, int numSamples, double sampleRate)
 	{
-		retFlag = true;
+		OnsetStrength result;
+		numSamples = juce::jmin(numSamples, buffer.getNumSamples());
+		if (numSamples == 0 || buffer.getNumChannels() == 0 || sampleRate <= 0.0)
+			return result;
+
+		int hopSize = juce::nextPowerOfTwo((int)(sampleRate / 100.0));
+		int fftSize = hopSize * 2;
+		if (numSamples < fftSize * 4)
+			return result;
+
+		auto mono = makeMono(buffer, numSamples);
+		std::vector<float> lowEnvelope;
+		computeOnsetEnvelopes(mono, sampleRate, fftSize, hopSize, result.envelope, lowEnvelope);
+
+		float peak = 0.0f;
+		for (auto& value : result.envelope)
+		{
+			value = juce::jmax(0.0f, value);
+			peak = juce::jmax(peak, value);
+		}
+		if (peak > 0.0f)
+			juce::FloatVectorOperations::multiply(result.envelope.data(), 1.0f / peak, (int)result.envelope.size());
 
-		int samplesToProcess = (maxSamples > 0) ? std::min(maxSamples, buffer.getNumSamples())
-			: buffer.getNumSamples();
+		result.hopSize = hopSize;
+		result.frameCentreOffset = fftSize * 0.5;
+		return result;
+	}
 
-		float maxLevel = 0.0f;
-		for (int i = 0; i < samplesToProcess; ++i)
+	// Onset times in seconds, peak-picked from the spectral-flux envelope.
+	static std::vector<float> detectOnsets(const juce::AudioBuffer<float>& buffer, double sampleRate, int maxOnsets = 1024)
+	{
+		std::vector<float> onsets;
+		if (buffer.getNumSamples() == 0 || buffer.getNumChannels() == 0 || sampleRate <= 0.0)
+			return onsets;
+
+		int hopSize = juce::nextPowerOfTwo((int)(sampleRate / 100.0));
+		int fftSize = hopSize * 2;
+		if (buffer.getNumSamples() < fftSize * 4)
+			return onsets;
+
+		auto mono = makeMono(buffer, buffer.getNumSamples());
+		std::vector<float> envelope, lowEnvelope;
+		computeOnsetEnvelopes(mono, sampleRate, fftSize, hopSize, envelope, lowEnvelope);
+
+		double mean = 0.0;
+		for (auto value : envelope)
+			mean += value;
+		mean /= (double)envelope.size();
+		float threshold = (float)(mean * 2.0);
+		int minSpacing = juce::jmax(1, (int)(0.05 * sampleRate / hopSize));
+		int lastOnset = -minSpacing;
+
+		for (int i = 1; i + 1 < (int)envelope.size(); ++i)
 		{
-			float mono = buffer.getSample(0, i);
-			if (buffer.getNumChannels() > 1)
+			float value = envelope[(size_t)i];
+			if (value > threshold && value > envelope[(size_t)i - 1] && value >= envelope[(size_t)i + 1]
+				&& i - lastOnset >= minSpacing)
 			{
-				mono = (buffer.getSample(0, i) + buffer.getSample(1, i)) * 0.5f;
+				onsets.push_back((float)(((double)i * hopSize + fftSize * 0.5) / sampleRate));
+				lastOnset = i;
+				if ((int)onsets.size() >= maxOnsets)
+					break;
 			}
+		}
+		return onsets;
+	}
+
+	static constexpr int numMfccs = 13;
+
+	struct TimbreSummary
+	{
+		// Mean and spread over the frames with sound in them.
+		std::array<float, numMfccs> mfccMean{};
+		std::array<float, numMfccs> mfccDeviation{};
+		// Sums to 1 unless the sample is silent.
+		std::array<float, 12> chroma{};
+		// In octaves above 50 Hz.
+		float centroidMean = 0.0f;
+		float centroidDeviation = 0.0f;
+	};
+
+	// MFCCs from a 26-band mel filterbank, pitch-class energy and spectral
+	// centroid, all from one STFT pass over the first 30 seconds.
+	static TimbreSummary analyzeTimbre(const juce::AudioBuffer<float>& buffer, double sampleRate)
+	{
+		TimbreSummary result;
+		const int fftOrder = 11;
+		const int fftSize = 1 << fftOrder;
+		const int hopSize = fftSize / 2;
+		const int numBands = 26;
+
+		int numSamples = std::min(buffer.getNumSamples(), (int)(sampleRate * maxTempoAnalysisSeconds));
+		if (buffer.getNumChannels() == 0 || sampleRate <= 0.0 || numSamples < fftSize)
+			return result;
 
-			maxLevel = std::max(maxLevel, std::abs(mono));
-			monoData.push_back(mono);
+		auto mono = makeMono(buffer, numSamples);
+		juce::dsp::FFT fft(fftOrder);
+		juce::dsp::WindowingFunction<float> window((size_t)fftSize, juce::dsp::WindowingFunction<float>::hann, false);
+
+		int numBins = fftSize / 2 + 1;
+		auto filterbank = makeMelFilterbank(numBands, fftSize, sampleRate, 30.0, juce::jmin(8000.0, sampleRate * 0.5));
+
+		std::vector<int> binPitchClass((size_t)numBins, -1);
+		for (int b = 1; b < numBins; ++b)
+		{
+			double frequency = b * sampleRate / fftSize;
+			if (frequency < 55.0 || frequency > 5000.0)
+				continue;
+			int midi = juce::roundToInt(12.0 * std::log2(frequency / 440.0) + 69.0);
+			binPitchClass[(size_t)b] = ((midi % 12) + 12) % 12;
 		}
 
-		if (maxLevel < 0.001f)
+		std::array<double, numMfccs> sum{}, sumOfSquares{};
+		std::array<double, 12> chroma{};
+		double centroidSum = 0.0, centroidSquares = 0.0;
+		int numFrames = 0;
+
+		std::vector<float> frame((size_t)fftSize * 2);
+		std::array<float, numBands> bandEnergy{};
+		for (int start = 0; start + fftSize <= numSamples; start += hopSize)
 		{
-			return 0.0f;
+			std::fill(frame.begin(), frame.end(), 0.0f);
+			juce::FloatVectorOperations::copy(frame.data(), mono.data() + start, fftSize);
+			window.multiplyWithWindowingTable(frame.data(), (size_t)fftSize);
+			fft.performFrequencyOnlyForwardTransform(frame.data(), true);
+
+			double power = 0.0, weightedFrequency = 0.0;
+			for (int b = 1; b < numBins; ++b)
+			{
+				double magnitude = frame[(size_t)b];
+				power += magnitude;
+				weightedFrequency += magnitude * b * sampleRate / fftSize;
+				if (binPitchClass[(size_t)b] >= 0)
+					chroma[(size_t)binPitchClass[(size_t)b]] += magnitude;
+			}
+			// Silence would pull every statistic towards the noise floor.
+			if (power < 1.0e-3)
+				continue;
+
+			for (int band = 0; band < numBands; ++band)
+			{
+				double energy = 0.0;
+				for (const auto& [bin, weight] : filterbank[(size_t)band])
+					energy += (double)frame[(size_t)bin] * frame[(size_t)bin] * weight;
+				bandEnergy[(size_t)band] = (float)std::log(energy + 1.0e-10);
+			}
+
+			// DCT-II of the log band energies.
+			for (int c = 0; c < numMfccs; ++c)
+			{
+				double coefficient = 0.0;
+				for (int band = 0; band < numBands; ++band)
+					coefficient += bandEnergy[(size_t)band] * std::cos(juce::MathConstants<double>::pi * c * (band + 0.5) / numBands);
+				sum[(size_t)c] += coefficient;
+				sumOfSquares[(size_t)c] += coefficient * coefficient;
+			}
+
+			double centroid = std::log2(juce::jmax(50.0, weightedFrequency / power) / 50.0);
+			centroidSum += centroid;
+			centroidSquares += centroid * centroid;
+			++numFrames;
 		}
 
-		float normalizeGain = 0.5f / maxLevel;
-		for (auto& sample : monoData)
+		if (numFrames == 0)
+			return result;
+
+		auto deviation = [numFrames](double total, double squares)
+			{
+				double mean = total / numFrames;
+				return (float)std::sqrt(juce::jmax(0.0, squares / numFrames - mean * mean));
+			};
+
+		for (int c = 0; c < numMfccs; ++c)
 		{
-			sample *= normalizeGain;
+			result.mfccMean[(size_t)c] = (float)(sum[(size_t)c] / numFrames);
+			result.mfccDeviation[(size_t)c] = deviation(sum[(size_t)c], sumOfSquares[(size_t)c]);
 		}
 
-		retFlag = false;
-		return 0.0f;
+		double chromaTotal = 0.0;
+		for (auto value : chroma)
+			chromaTotal += value;
+		if (chromaTotal > 0.0)
+			for (int i = 0; i < 12; ++i)
+				result.chroma[(size_t)i] = (float)(chroma[(size_t)i] / chromaTotal);
+
+		result.centroidMean = (float)(centroidSum / numFrames);
+		result.centroidDeviation = deviation(centroidSum, centroidSquares);
+		return result;
 	}
 
 	static void timeStretchBufferFast(juce::AudioBuffer<float>& buffer,
@@ -210,4 +577,324 @@ public:
 			DBG("Time stretch error: " << e.what());
 		}
 	}
-};
\ No newline at end of file
+
+	// K-weighting filters for an arbitrary rate, as derived in libebur128.
+	static juce::IIRCoefficients makeKWeightingShelf(double sampleRate)
+	{
+		double f0 = 1681.974450955533;
+		double gainDb = 3.999843853973347;
+		double q = 0.7071752369554196;
+		double k = std::tan(juce::MathConstants<double>::pi * f0 / sampleRate);
+		double vh = std::pow(10.0, gainDb / 20.0);
+		double vb = std::pow(vh, 0.4996667741545416);
+		double a0 = 1.0 + k / q + k * k;
+		return juce::IIRCoefficients((vh + vb * k / q + k * k) / a0,
+			2.0 * (k * k - vh) / a0,
+			(vh - vb * k / q + k * k) / a0,
+			1.0,
+			2.0 * (k * k - 1.0) / a0,
+			(1.0 - k / q + k * k) / a0);
+	}
+
+	static juce::IIRCoefficients makeKWeightingHighPass(double sampleRate)
+	{
+		double f0 = 38.13547087602444;
+		double q = 0.5003270373238773;
+		double k = std::tan(juce::MathConstants<double>::pi * f0 / sampleRate);
+		double a0 = 1.0 + k / q + k * k;
+		return juce::IIRCoefficients(1.0, -2.0, 1.0,
+			1.0,
+			2.0 * (k * k - 1.0) / a0,
+			(1.0 - k / q + k * k) / a0);
+	}
+
+private:
+	static constexpr double maxTempoAnalysisSeconds = 30.0;
+	static constexpr float minTempoBpm = 60.0f;
+	static constexpr float maxTempoBpm = 200.0f;
+	static constexpr float tempoStepBpm = 0.1f;
+	static constexpr int combHarmonics = 4;
+	static constexpr double lowBandHz = 150.0;
+
+	static std::vector<float> makeMono(const juce::AudioBuffer<float>& buffer, int numSamples)
+	{
+		std::vector<float> mono((size_t)numSamples);
+		juce::FloatVectorOperations::copy(mono.data(), buffer.getReadPointer(0), numSamples);
+		if (buffer.getNumChannels() > 1)
+		{
+			juce::FloatVectorOperations::add(mono.data(), buffer.getReadPointer(1), numSamples);
+			juce::FloatVectorOperations::multiply(mono.data(), 0.5f, numSamples);
+		}
+		return mono;
+	}
+
+	// Triangular filters evenly spaced on the mel scale, as (bin, weight) pairs.
+	static std::vector<std::vector<std::pair<int, float>>> makeMelFilterbank(int numBands,
+		int fftSize,
+		double sampleRate,
+		double lowHz,
+		double highHz)
+	{
+		auto toMel = [](double hz) { return 2595.0 * std::log10(1.0 + hz / 700.0); };
+		auto toBin = [fftSize, sampleRate](double mel)
+			{ return 700.0 * (std::pow(10.0, mel / 2595.0) - 1.0) * fftSize / sampleRate; };
+
+		double lowMel = toMel(lowHz), highMel = toMel(highHz);
+		std::vector<double> edges((size_t)numBands + 2);
+		for (int i = 0; i < numBands + 2; ++i)
+			edges[(size_t)i] = toBin(lowMel + (highMel - lowMel) * i / (numBands + 1));
+
+		std::vector<std::vector<std::pair<int, float>>> filterbank((size_t)numBands);
+		for (int band = 0; band < numBands; ++band)
+		{
+			double left = edges[(size_t)band], centre = edges[(size_t)band + 1], right = edges[(size_t)band + 2];
+			for (int bin = juce::jmax(1, (int)std::ceil(left)); bin <= (int)right && bin <= fftSize / 2; ++bin)
+			{
+				double weight = bin <= centre ? (bin - left) / juce::jmax(1.0e-9, centre - left)
+					: (right - bin) / juce::jmax(1.0e-9, right - centre);
+				if (weight > 0.0)
+					filterbank[(size_t)band].push_back({ bin, (float)weight });
+			}
+			// Narrow low bands can fall between two bins.
+			if (filterbank[(size_t)band].empty())
+				filterbank[(size_t)band].push_back({ juce::jlimit(1, fftSize / 2, juce::roundToInt(centre)), 1.0f });
+		}
+		return filterbank;
+	}
+
+	static double correlation(const std::array<double, 12>& a, const std::array<double, 12>& b)
+	{
+		double meanA = 0.0, meanB = 0.0;
+		for (int i = 0; i < 12; ++i)
+		{
+			meanA += a[(size_t)i];
+			meanB += b[(size_t)i];
+		}
+		meanA /= 12.0;
+		meanB /= 12.0;
+
+		double covariance = 0.0, varianceA = 0.0, varianceB = 0.0;
+		for (int i = 0; i < 12; ++i)
+		{
+			double da = a[(size_t)i] - meanA;
+			double db = b[(size_t)i] - meanB;
+			covariance += da * db;
+			varianceA += da * da;
+			varianceB += db * db;
+		}
+		return (varianceA > 0.0 && varianceB > 0.0) ? covariance / std::sqrt(varianceA * varianceB) : 0.0;
+	}
+
+	static float measureTruePeak(const juce::AudioBuffer<float>& buffer, int numChannels)
+	{
+		const int blockSize = 4096;
+		juce::dsp::Oversampling<float> oversampling((size_t)numChannels, 2,
+			juce::dsp::Oversampling<float>::filterHalfBandFIREquiripple, true, false);
+		oversampling.initProcessing((size_t)blockSize);
+
+		juce::AudioBuffer<float> chunk(numChannels, blockSize);
+		float peak = 0.0f;
+		for (int start = 0; start < buffer.getNumSamples(); start += blockSize)
+		{
+			int count = juce::jmin(blockSize, buffer.getNumSamples() - start);
+			for (int ch = 0; ch < numChannels; ++ch)
+				chunk.copyFrom(ch, 0, buffer, ch, start, count);
+
+			juce::dsp::AudioBlock<float> block(chunk.getArrayOfWritePointers(), (size_t)numChannels, (size_t)count);
+			auto upsampled = oversampling.processSamplesUp(block);
+			for (size_t ch = 0; ch < upsampled.getNumChannels(); ++ch)
+			{
+				auto range = juce::FloatVectorOperations::findMinAndMax(upsampled.getChannelPointer(ch), (int)upsampled.getNumSamples());
+				peak = juce::jmax(peak, std::abs(range.getStart()), std::abs(range.getEnd()));
+			}
+		}
+		return peak;
+	}
+
+	static void computeOnsetEnvelopes(const std::vector<float>& mono,
+		double sampleRate,
+		int fftSize,
+		int hopSize,
+		std::vector<float>& onset,
+		std::vector<float>& lowOnset)
+	{
+		int numFrames = ((int)mono.size() - fftSize) / hopSize + 1;
+		int numBins = fftSize / 2 + 1;
+		int lowBins = juce::jlimit(2, numBins, (int)(lowBandHz * fftSize / sampleRate) + 1);
+
+		juce::dsp::FFT fft(juce::roundToInt(std::log2(fftSize)));
+		juce::dsp::WindowingFunction<float> window((size_t)fftSize, juce::dsp::WindowingFunction<float>::hann, false);
+
+		std::vector<float> frame((size_t)fftSize * 2);
+		std::vector<float> previous((size_t)numBins, 0.0f);
+		std::vector<float> difference((size_t)numBins);
+		std::vector<float> flux((size_t)numFrames), lowFlux((size_t)numFrames);
+
+		for (int f = 0; f < numFrames; ++f)
+		{
+			std::fill(frame.begin(), frame.end(), 0.0f);
+			juce::FloatVectorOperations::copy(frame.data(), mono.data() + (size_t)f * hopSize, fftSize);
+			window.multiplyWithWindowingTable(frame.data(), (size_t)fftSize);
+			fft.performFrequencyOnlyForwardTransform(frame.data(), true);
+
+			for (int b = 0; b < numBins; ++b)
+				frame[(size_t)b] = std::log1p(100.0f * frame[(size_t)b]);
+
+			juce::FloatVectorOperations::subtract(difference.data(), frame.data(), previous.data(), numBins);
+			juce::FloatVectorOperations::clip(difference.data(), difference.data(), 0.0f, std::numeric_limits<float>::max(), numBins);
+			juce::FloatVectorOperations::copy(previous.data(), frame.data(), numBins);
+
+			float low = 0.0f, total = 0.0f;
+			for (int b = 0; b < numBins; ++b)
+			{
+				total += difference[(size_t)b];
+				if (b < lowBins)
+					low += difference[(size_t)b];
+			}
+			flux[(size_t)f] = f > 0 ? total : 0.0f;
+			lowFlux[(size_t)f] = f > 0 ? low : 0.0f;
+		}
+
+		onset = subtractLocalMean(flux, 8);
+		lowOnset = subtractLocalMean(lowFlux, 8);
+	}
+
+	static std::vector<float> subtractLocalMean(const std::vector<float>& input, int radius)
+	{
+		std::vector<float> output(input.size());
+		double runningSum = 0.0;
+		int count = 0;
+		int size = (int)input.size();
+
+		for (int i = 0; i < std::min(radius, size); ++i)
+		{
+			runningSum += input[(size_t)i];
+			++count;
+		}
+
+		for (int i = 0; i < size; ++i)
+		{
+			if (i + radius < size)
+			{
+				runningSum += input[(size_t)(i + radius)];
+				++count;
+			}
+			if (i - radius - 1 >= 0)
+			{
+				runningSum -= input[(size_t)(i - radius - 1)];
+				--count;
+			}
+			float mean = count > 0 ? (float)(runningSum / count) : 0.0f;
+			output[(size_t)i] = std::max(0.0f, input[(size_t)i] - mean);
+		}
+		return output;
+	}
+
+	static std::vector<float> computeAutocorrelation(const std::vector<float>& envelope)
+	{
+		int length = (int)envelope.size();
+		if (length < 2)
+			return {};
+
+		int order = juce::roundToInt(std::ceil(std::log2(length * 2)));
+		int size = 1 << order;
+		juce::dsp::FFT fft(order);
+		std::vector<float> data((size_t)size * 2, 0.0f);
+
+		float mean = 0.0f;
+		for (auto value : envelope)
+			mean += value;
+		mean /= (float)length;
+		for (int i = 0; i < length; ++i)
+			data[(size_t)i] = envelope[(size_t)i] - mean;
+
+		fft.performRealOnlyForwardTransform(data.data(), true);
+		for (int bin = 0; bin <= size / 2; ++bin)
+		{
+			float re = data[(size_t)bin * 2];
+			float im = data[(size_t)bin * 2 + 1];
+			data[(size_t)bin * 2] = re * re + im * im;
+			data[(size_t)bin * 2 + 1] = 0.0f;
+		}
+		fft.performRealOnlyInverseTransform(data.data());
+
+		std::vector<float> acf((size_t)length);
+		float zeroLag = data[0];
+		if (zeroLag <= 0.0f)
+			return {};
+
+		// Unbiased: longer lags overlap fewer frames, so scale them back up.
+		for (int lag = 0; lag < length; ++lag)
+			acf[(size_t)lag] = data[(size_t)lag] / zeroLag * (float)length / (float)(length - lag);
+		return acf;
+	}
+
+	static float interpolate(const std::vector<float>& values, double position)
+	{
+		if (position < 0.0 || position >= (double)values.size() - 1.0)
+			return 0.0f;
+
+		auto index = (size_t)position;
+		float fraction = (float)(position - (double)index);
+		return values[index] + fraction * (values[index + 1] - values[index]);
+	}
+
+	static float scoreTempo(const std::vector<float>& acf, double lag)
+	{
+		float score = 0.0f;
+		int used = 0;
+		for (int k = 1; k <= combHarmonics; ++k)
+		{
+			double position = lag * k;
+			// Needs at least a couple of periods of overlap to mean anything.
+			if (position * 2.0 >= (double)acf.size())
+				break;
+			score += interpolate(acf, position);
+			++used;
+		}
+		return used > 0 ? juce::jmax(0.0f, score / (float)used) : 0.0f;
+	}
+
+	// Gentle log-normal preference around 120 BPM to settle octave ambiguity.
+	static float tempoPrior(float bpm)
+	{
+		float octaves = std::log2(bpm / 120.0f);
+		return std::exp(-0.5f * octaves * octaves);
+	}
+
+	static double findBeatPhase(const std::vector<float>& onset, double beatLag)
+	{
+		double bestPhase = 0.0;
+		float bestSum = -1.0f;
+		for (double phase = 0.0; phase < beatLag; phase += 1.0)
+		{
+			float sum = 0.0f;
+			for (double position = phase; position < (double)onset.size() - 1.0; position += beatLag)
+				sum += interpolate(onset, position);
+			if (sum > bestSum)
+			{
+				bestSum = sum;
+				bestPhase = phase;
+			}
+		}
+		return bestPhase;
+	}
+
+	static int findDownbeat(const std::vector<float>& lowOnset, double beatPhase, double beatLag)
+	{
+		int bestBeat = 0;
+		float bestSum = -1.0f;
+		for (int beat = 0; beat < 4; ++beat)
+		{
+			float sum = 0.0f;
+			for (double position = beatPhase + beat * beatLag; position < (double)lowOnset.size() - 1.0; position += beatLag * 4.0)
+				sum += interpolate(lowOnset, position);
+			if (sum > bestSum)
+			{
+				bestSum = sum;
+				bestBeat = beat;
+			}
+		}
+		return bestBeat;
+	}
+};
@@ -0,0 +1,108 @@
+#pragma once
+#include "JuceHeader.h"
+#include <memory>
+
+// Encoded snapshot of a drawing canvas. Shared between the canvas, the track
+// state and the upload path so an unchanged canvas is never re-encoded.
+struct CanvasImage
+{
+	using Ptr = std::shared_ptr<const CanvasImage>;
+
+	juce::MemoryBlock png;
+	juce::String hash;
+	juce::String base64;
+	int width = 0;
+	int height = 0;
+
+	static Ptr encode(const juce::Image& image, bool withBase64 = true)
+	{
+		if (!image.isValid())
+		{
+			return nullptr;
+		}
+
+		juce::MemoryOutputStream stream;
+		juce::PNGImageFormat pngFormat;
+		if (!pngFormat.writeImageToStream(image, stream))
+		{
+			return nullptr;
+		}
+
+		auto result = std::make_shared<CanvasImage>();
+		result->png = stream.getMemoryBlock();
+		result->hash = juce::SHA256(result->png).toHexString();
+		result->width = image.getWidth();
+		result->height = image.getHeight();
+		if (withBase64)
+		{
+			result->base64 = juce::Base64::toBase64(result->png.getData(), result->png.getSize());
+		}
+		return result;
+	}
+
+	static Ptr fromPng(const juce::MemoryBlock& pngData, const juce::String& base64, const juce::Image& decoded)
+	{
+		auto result = std::make_shared<CanvasImage>();
+		result->png = pngData;
+		result->hash = juce::SHA256(pngData).toHexString();
+		result->base64 = base64;
+		result->width = decoded.getWidth();
+		result->height = decoded.getHeight();
+		return result;
+	}
+
+	// Builds the variant a server asked for: scaled down to fit maxDimension and
+	// each channel truncated to quantizeBits. Quantizing flattens airbrush noise,
+	// which shrinks the PNG a lot more than the slight colour loss costs the
+	// vision model. Returns the source itself when nothing would change.
+	static Ptr reduce(const Ptr& source, int maxDimension, int quantizeBits)
+	{
+		if (!source)
+		{
+			return nullptr;
+		}
+
+		bool needsScale = maxDimension > 0 && juce::jmax(source->width, source->height) > maxDimension;
+		bool needsQuantize = quantizeBits > 0 && quantizeBits < 8;
+		if (!needsScale && !needsQuantize)
+		{
+			return source;
+		}
+
+		juce::MemoryInputStream input(source->png, false);
+		juce::PNGImageFormat pngFormat;
+		auto image = juce::SoftwareImageType().convert(pngFormat.decodeImage(input));
+		if (!image.isValid())
+		{
+			return source;
+		}
+
+		if (needsScale)
+		{
+			float scale = (float)maxDimension / (float)juce::jmax(image.getWidth(), image.getHeight());
+			image = image.rescaled(juce::jmax(1, juce::roundToInt(image.getWidth() * scale)),
+				juce::jmax(1, juce::roundToInt(image.getHeight() * scale)),
+				juce::Graphics::highResamplingQuality);
+		}
+
+		if (needsQuantize)
+		{
+			auto mask = (juce::uint8)(0xff << (8 - quantizeBits));
+			juce::Image::BitmapData data(image, juce::Image::BitmapData::readWrite);
+			for (int y = 0; y < data.height; ++y)
+			{
+				for (int x = 0; x < data.width; ++x)
+				{
+					auto colour = data.getPixelColour(x, y);
+					data.setPixelColour(x, y, juce::Colour((juce::uint8)(colour.getRed() & mask),
+						(juce::uint8)(colour.getGreen() & mask),
+						(juce::uint8)(colour.getBlue() & mask),
+						colour.getAlpha()));
+				}
+			}
+		}
+
+		auto reduced = encode(image, false);
+		return reduced ? reduced : source;
+	}
+};
@@ -1,6 +1,9 @@
 ﻿#pragma once
 #include "./JuceHeader.h"
+#include "GenerationControl.h"
+#include "CanvasImage.h"
 #include <mutex>
+#include <set>
 
 class DjIaClient
 {
@@ -12,16 +15,16 @@ public:
 		float bpm;
 		juce::String key;
 		bool useImage = false;
-		juce::String imageBase64 = "";
+		CanvasImage::Ptr image;
 		juce::StringArray keywords;
+		int seed = -1;
 
 		LoopRequest()
 			: prompt(""),
 			generationDuration(6.0f),
 			bpm(120.0f),
 			key(""),
-			useImage(false),
-			imageBase64("")
+			useImage(false)
 		{
 		}
 	};
@@ -38,6 +41,9 @@ public:
 		bool isUnlimitedKey = false;
 		int totalCredits = -1;
 		int usedCredits = -1;
+		// Seed the server generated with; -1 if it did not say.
+		int seed = -1;
+		bool cancelled = false;
 
 		LoopResponse()
 			: duration(0.0f), bpm(120.0f), detectedBpm(-1.0f)
@@ -90,6 +96,7 @@ public:
 		{
 			baseUrl = newBaseUrl + "/api/v1";
 		}
+		resetImageUploadStateLocked();
 		DBG("DjIaClient: Base URL updated to: " + baseUrl);
 	}
 
@@ -169,8 +176,44 @@ public:
 		return result;
 	}
 
-	LoopResponse generateLoop(const LoopRequest& request, double sampleRate, int requestTimeoutMS)
+	LoopResponse generateLoop(const LoopRequest& request, double sampleRate, int requestTimeoutMS,
+		const GenerationControl::Ptr& control = nullptr)
 	{
+		bool imageExpired = false;
+		auto result = generateLoopAttempt(request, sampleRate, requestTimeoutMS, control, imageExpired);
+
+		// The server evicted the uploaded canvas; its hash is forgotten by now,
+		// so the second attempt uploads it again.
+		if (imageExpired && !result.cancelled)
+		{
+			DBG("Canvas expired on server, uploading again");
+			result = generateLoopAttempt(request, sampleRate, requestTimeoutMS, control, imageExpired);
+		}
+		return result;
+	}
+
+private:
+	// The server reports errors as {"detail": {"error": {"code": ...}}}.
+	static juce::String getErrorCode(const juce::String& responseBody)
+	{
+		auto json = juce::JSON::parse(responseBody);
+		return json.getProperty("detail", {}).getProperty("error", {}).getProperty("code", "").toString();
+	}
+
+	struct ImageUploadSupport
+	{
+		bool probed = false;
+		bool supported = false;
+		int maxDimension = 0;
+		int quantizeBits = 0;
+	};
+
+	LoopResponse generateLoopAttempt(const LoopRequest& request, double sampleRate, int requestTimeoutMS,
+		const GenerationControl::Ptr& control, bool& imageExpired)
+	{
+		juce::File audioFile;
+		imageExpired = false;
+
 		try
 		{
 			juce::var jsonRequest(new juce::DynamicObject());
@@ -184,10 +227,23 @@ public:
 			jsonRequest.getDynamicObject()->setProperty("key", request.key);
 			jsonRequest.getDynamicObject()->setProperty("sample_rate", sampleRate);
 			jsonRequest.getDynamicObject()->setProperty("generation_duration", request.generationDuration);
-			if (request.useImage && !request.imageBase64.isEmpty())
+			if (request.seed >= 0)
+			{
+				jsonRequest.getDynamicObject()->setProperty("seed", request.seed);
+			}
+			juce::String imageHash;
+			if (request.useImage && request.image)
 			{
 				jsonRequest.getDynamicObject()->setProperty("use_image", true);
-				jsonRequest.getDynamicObject()->setProperty("image_base64", request.imageBase64);
+				imageHash = uploadImage(request.image, control);
+				if (imageHash.isNotEmpty())
+				{
+					jsonRequest.getDynamicObject()->setProperty("image_hash", imageHash);
+				}
+				else
+				{
+					jsonRequest.getDynamicObject()->setProperty("image_base64", request.image->base64);
+				}
 			}
 
 			if (request.keywords.size() > 0)
@@ -229,18 +285,24 @@ public:
 				throw std::runtime_error("Invalid server URL format. Must start with http:// or https://");
 			}
 
-			int statusCode = 0;
-			juce::StringPairArray responseHeaders;
 			auto url = juce::URL(currentBaseUrl + "/generate")
 				.withPOSTData(jsonString);
-			auto options = juce::URL::InputStreamOptions(juce::URL::ParameterHandling::inPostData)
-				.withStatusCode(&statusCode)
-				.withResponseHeaders(&responseHeaders)
-				.withExtraHeaders(headerString)
-				.withConnectionTimeoutMs(requestTimeoutMS);
+			juce::WebInputStream response(url, true);
+			response.withExtraHeaders(headerString)
+				.withConnectionTimeout(requestTimeoutMS);
 
-			auto response = url.createInputStream(options);
-			if (!response)
+			GenerationControl::ScopedAbortHandler abortHandler(control, [&response]()
+				{
+					response.cancel();
+				});
+
+			if (control)
+				control->reportProgress(GenerationControl::Stage::running);
+
+			bool connected = response.connect(nullptr);
+			throwIfCancelled(control);
+
+			if (!connected)
 			{
 				DBG("ERROR: Failed to connect to server");
 				throw std::runtime_error(("Cannot connect to server at " + currentBaseUrl +
@@ -248,6 +310,8 @@ public:
 					.toStdString());
 			}
 
+			int statusCode = response.getStatusCode();
+			juce::StringPairArray responseHeaders = response.getResponseHeaders();
 			DBG("HTTP Status Code: " + juce::String(statusCode));
 
 			if (statusCode == 403)
@@ -260,6 +324,14 @@ public:
 				DBG("ERROR: HTTP 401 Unauthorized");
 				throw std::runtime_error("Authentication failed: API key required or invalid.");
 			}
+			else if (statusCode == 404 && imageHash.isNotEmpty()
+				&& getErrorCode(response.readEntireStreamAsString()) == "IMAGE_NOT_FOUND")
+			{
+				DBG("ERROR: Uploaded image " + imageHash + " no longer on server");
+				forgetUploadedImage(imageHash);
+				imageExpired = true;
+				throw std::runtime_error("The server no longer has this drawing. Please generate again to re-upload it.");
+			}
 			else if (statusCode == 422)
 			{
 				DBG("ERROR: HTTP 422 Unprocessable Entity");
@@ -281,23 +353,23 @@ public:
 				throw std::runtime_error("HTTP Error " + std::to_string(statusCode) + ": Request failed.");
 			}
 
-			if (response->isExhausted())
+			if (response.isExhausted())
 			{
 				DBG("ERROR: Empty response from server");
 				throw std::runtime_error("Server returned empty response. Server may be overloaded or misconfigured.");
 			}
 
 			LoopResponse result;
-			result.audioData = juce::File::createTempFile(".wav");
-			juce::FileOutputStream stream(result.audioData);
-			if (stream.openedOk())
-			{
-				stream.writeFromInputStream(*response, response->getTotalLength());
-			}
-			else
+			audioFile = juce::File::createTempFile(".wav");
+			result.audioData = audioFile;
 			{
-				DBG("ERROR: Cannot create temp file");
-				throw std::runtime_error("Cannot create temporary file for audio data.");
+				juce::FileOutputStream stream(result.audioData);
+				if (!stream.openedOk())
+				{
+					DBG("ERROR: Cannot create temp file");
+					throw std::runtime_error("Cannot create temporary file for audio data.");
+				}
+				downloadToStream(response, stream, control);
 			}
 			result.duration = request.generationDuration;
 			result.bpm = bpm;
@@ -329,6 +401,10 @@ public:
 				DBG("No X-Detected-BPM header from server");
 			}
 
+			auto seedStr = responseHeaders["X-Seed"];
+			if (seedStr.isNotEmpty())
+				result.seed = seedStr.getIntValue();
+
 			DBG("WAV file created: " + result.audioData.getFullPathName() +
 				" (" + juce::String(result.audioData.getSize()) + " bytes)");
 
@@ -337,14 +413,214 @@ public:
 		catch (const std::exception& e)
 		{
 			DBG("API Error: " + juce::String(e.what()));
+			audioFile.deleteFile();
 			LoopResponse emptyResponse;
 			emptyResponse.errorMessage = e.what();
+			emptyResponse.cancelled = control && control->isCancelled();
 			return emptyResponse;
 		}
 	}
 
-private:
+	// Sends the canvas as raw PNG bytes to /images, keyed by its SHA-256, so the
+	// generate request only carries the hash. Canvases the server already holds
+	// are not sent again. Returns an empty string when the server has no upload
+	// endpoint, in which case the caller falls back to inline base64.
+	juce::String uploadImage(const CanvasImage::Ptr& image, const GenerationControl::Ptr& control)
+	{
+		auto support = getImageUploadSupport();
+		if (!support.supported)
+		{
+			return {};
+		}
+
+		auto uploadVariant = getReducedImage(image, support);
+
+		juce::String currentBaseUrl;
+		juce::String currentApiKey;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (uploadedImages.count(uploadVariant->hash) > 0)
+			{
+				return uploadVariant->hash;
+			}
+			currentBaseUrl = baseUrl;
+			currentApiKey = apiKey;
+		}
+
+		juce::String headerString = "Content-Type: image/png\n";
+		headerString += "X-Image-Hash: " + uploadVariant->hash + "\n";
+		if (currentApiKey.isNotEmpty())
+		{
+			headerString += "X-API-Key: " + currentApiKey + "\n";
+		}
+
+		auto url = juce::URL(currentBaseUrl + "/images").withPOSTData(uploadVariant->png);
+		juce::WebInputStream response(url, true);
+		response.withExtraHeaders(headerString)
+			.withConnectionTimeout(imageUploadTimeoutMs);
+
+		GenerationControl::ScopedAbortHandler abortHandler(control, [&response]()
+			{
+				response.cancel();
+			});
+
+		bool connected = response.connect(nullptr);
+		throwIfCancelled(control);
+
+		if (!connected || response.getStatusCode() != 200)
+		{
+			DBG("Image upload failed (HTTP " + juce::String(response.getStatusCode()) + "), sending inline");
+			return {};
+		}
+
+		auto json = juce::JSON::parse(response.readEntireStreamAsString());
+		juce::String serverHash = json.getProperty("image_hash", "").toString();
+		if (serverHash != uploadVariant->hash)
+		{
+			DBG("Image upload hash mismatch, sending inline");
+			return {};
+		}
+
+		DBG("Canvas uploaded: " + juce::String((int)uploadVariant->png.getSize()) + " bytes, "
+			+ juce::String(uploadVariant->width) + "x" + juce::String(uploadVariant->height));
+
+		std::lock_guard<std::mutex> lock(mutex);
+		uploadedImages.insert(serverHash);
+		return serverHash;
+	}
+
+	ImageUploadSupport getImageUploadSupport()
+	{
+		juce::String currentBaseUrl;
+		juce::String currentApiKey;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (imageUploadSupport.probed)
+			{
+				return imageUploadSupport;
+			}
+			currentBaseUrl = baseUrl;
+			currentApiKey = apiKey;
+		}
+
+		ImageUploadSupport support;
+		support.probed = true;
+
+		juce::String headerString;
+		if (currentApiKey.isNotEmpty())
+		{
+			headerString = "X-API-Key: " + currentApiKey + "\n";
+		}
+
+		int statusCode = 0;
+		auto options = juce::URL::InputStreamOptions(juce::URL::ParameterHandling::inAddress)
+			.withStatusCode(&statusCode)
+			.withExtraHeaders(headerString)
+			.withConnectionTimeoutMs(imageUploadTimeoutMs);
+
+		if (auto stream = juce::URL(currentBaseUrl + "/images/capabilities").createInputStream(options))
+		{
+			if (statusCode == 200)
+			{
+				auto json = juce::JSON::parse(stream->readEntireStreamAsString());
+				support.supported = true;
+				support.maxDimension = (int)json.getProperty("max_dimension", 0);
+				support.quantizeBits = (int)json.getProperty("quantize_bits", 0);
+			}
+		}
+		else
+		{
+			// Unreachable server: try again next time rather than caching a "no".
+			support.probed = false;
+		}
+
+		DBG("Image upload " + juce::String(support.supported ? "supported" : "not supported")
+			+ " (max " + juce::String(support.maxDimension) + "px, "
+			+ juce::String(support.quantizeBits) + " bits)");
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (currentBaseUrl == baseUrl)
+		{
+			imageUploadSupport = support;
+		}
+		return support;
+	}
+
+	CanvasImage::Ptr getReducedImage(const CanvasImage::Ptr& image, const ImageUploadSupport& support)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (lastReducedSource == image->hash && lastReducedImage)
+			{
+				return lastReducedImage;
+			}
+		}
+
+		auto reduced = CanvasImage::reduce(image, support.maxDimension, support.quantizeBits);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		lastReducedSource = image->hash;
+		lastReducedImage = reduced;
+		return reduced;
+	}
+
+	void forgetUploadedImage(const juce::String& hash)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		uploadedImages.erase(hash);
+	}
+
+	void resetImageUploadStateLocked()
+	{
+		imageUploadSupport = {};
+		uploadedImages.clear();
+		lastReducedSource.clear();
+		lastReducedImage = nullptr;
+	}
+
+	static void throwIfCancelled(const GenerationControl::Ptr& control)
+	{
+		if (control && control->isCancelled())
+		{
+			throw std::runtime_error("Generation cancelled");
+		}
+	}
+
+	static void downloadToStream(juce::WebInputStream& response, juce::OutputStream& output, const GenerationControl::Ptr& control)
+	{
+		const int chunkSize = 64 * 1024;
+		juce::HeapBlock<char> chunk(chunkSize);
+		juce::int64 totalLength = response.getTotalLength();
+		juce::int64 received = 0;
+
+		while (!response.isExhausted())
+		{
+			throwIfCancelled(control);
+
+			int bytesRead = response.read(chunk.getData(), chunkSize);
+			if (bytesRead <= 0)
+				break;
+
+			output.write(chunk.getData(), (size_t)bytesRead);
+			received += bytesRead;
+
+			if (control)
+			{
+				float percent = totalLength > 0 ? 100.0f * (float)received / (float)totalLength : -1.0f;
+				control->reportProgress(GenerationControl::Stage::downloading, percent);
+			}
+		}
+
+		throwIfCancelled(control);
+	}
+
+	static constexpr int imageUploadTimeoutMs = 15000;
+
 	mutable std::mutex mutex;
 	juce::String apiKey;
 	juce::String baseUrl;
+	ImageUploadSupport imageUploadSupport;
+	std::set<juce::String> uploadedImages;
+	juce::String lastReducedSource;
+	CanvasImage::Ptr lastReducedImage;
 };
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include "ColourPalette.h"
 #include "PluginProcessor.h"
 #include "CustomLookAndFeel.h"
+#include "CanvasImage.h"
 
 class KeywordBadge : public juce::TextButton
 {
@@ -114,7 +115,10 @@ public:
 	CanvasState getState() const
 	{
 		CanvasState state;
-		state.imageBase64 = const_cast<DrawingCanvas*>(this)->getBase64Image();
+		if (auto image = const_cast<DrawingCanvas*>(this)->getEncodedImage())
+		{
+			state.imageBase64 = image->base64;
+		}
 
 		switch (currentBrushType)
 		{
@@ -328,7 +332,7 @@ public:
 				auto point = getCanvasPoint(e.getPosition());
 				juce::Colour targetColor = canvas.getPixelAt(point.x, point.y);
 				floodFill(point.x, point.y, targetColor, currentColor);
-				needsRepaint = true;
+				markCanvasDirty();
 				saveToHistory();
 			}
 			else
@@ -343,7 +347,7 @@ public:
 
 				juce::Graphics g(canvas);
 				drawAtPoint(g, lastPoint);
-				needsRepaint = true;
+				markCanvasDirty();
 			}
 		}
 	}
@@ -359,7 +363,7 @@ public:
 				juce::Graphics g(canvas);
 				drawLine(g, lastPoint, currentPoint);
 				lastPoint = currentPoint;
-				needsRepaint = true;
+				markCanvasDirty();
 			}
 		}
 	}
@@ -471,6 +475,7 @@ public:
 	{
 		juce::Graphics g(canvas);
 		g.fillAll(juce::Colours::white);
+		markCanvasDirty();
 		repaint();
 	}
 
@@ -494,6 +499,7 @@ public:
 					{
 						juce::Graphics g(canvas);
 						g.fillAll(juce::Colours::white);
+						markCanvasDirty();
 						repaint();
 						undoHistory.clear();
 						historyIndex = -1;
@@ -505,23 +511,32 @@ public:
 
 	juce::String getBase64Image()
 	{
-		juce::MemoryOutputStream memStream;
-		juce::PNGImageFormat pngFormat;
+		auto image = getEncodedImage();
+		return image ? image->base64 : juce::String();
+	}
 
-		if (pngFormat.writeImageToStream(canvas, memStream))
+	CanvasImage::Ptr getEncodedImage()
+	{
+		if (encodedImage && encodedVersion == canvasVersion)
 		{
-			juce::MemoryBlock block = memStream.getMemoryBlock();
-			juce::String base64 = juce::Base64::toBase64(block.getData(), block.getSize());
-
+			return encodedImage;
+		}
 
-			int padding = 0;
-			if (base64.endsWith("==")) padding = 2;
-			else if (base64.endsWith("=")) padding = 1;
+		encodedImage = CanvasImage::encode(canvas);
+		encodedVersion = canvasVersion;
+		return encodedImage;
+	}
 
-			return base64;
+	void requestEncodedImage(std::function<void(CanvasImage::Ptr)> onReady)
+	{
+		if (encodedImage && encodedVersion == canvasVersion)
+		{
+			onReady(encodedImage);
+			return;
 		}
 
-		return {};
+		pendingEncodeCallbacks.push_back(std::move(onReady));
+		startBackgroundEncode();
 	}
 
 	void loadFromBase64(const juce::String& base64Data)
@@ -552,7 +567,9 @@ public:
 			canvas = loadedImage;
 
 			repaint();
-			needsRepaint = true;
+			markCanvasDirty();
+			encodedImage = CanvasImage::fromPng(decodedData, base64Data, loadedImage);
+			encodedVersion = canvasVersion;
 		}
 	}
 
@@ -613,7 +630,7 @@ public:
 			<< ", keywords: " << selectedKeywords.joinIntoString(", "));
 	}
 
-	std::function<void(const juce::String&)> onGenerate;
+	std::function<void(const CanvasImage::Ptr&)> onGenerate;
 	std::function<void()> onClose;
 
 private:
@@ -989,6 +1006,70 @@ private:
 			repaint(canvasAreaBounds);
 			needsRepaint = false;
 		}
+
+		if (!isDrawing && encodedVersion != canvasVersion
+			&& juce::Time::getMillisecondCounter() - lastCanvasChangeTime >= encodeIdleDelayMs)
+		{
+			startBackgroundEncode();
+		}
+	}
+
+	void markCanvasDirty()
+	{
+		++canvasVersion;
+		lastCanvasChangeTime = juce::Time::getMillisecondCounter();
+		needsRepaint = true;
+	}
+
+	// PNG encoding and hashing a 512x512 canvas takes long enough to stall the
+	// UI, so it runs on a snapshot off the message thread once drawing pauses.
+	// The result is only kept if the canvas hasn't changed since the snapshot.
+	void startBackgroundEncode()
+	{
+		if (encodingVersion == canvasVersion)
+		{
+			return;
+		}
+
+		encodingVersion = canvasVersion;
+		auto snapshot = juce::SoftwareImageType().convert(canvas.createCopy());
+		auto version = canvasVersion;
+		juce::Component::SafePointer<DrawingCanvas> safeThis(this);
+
+		juce::Thread::launch([safeThis, snapshot, version]()
+			{
+				auto image = CanvasImage::encode(snapshot);
+				juce::MessageManager::callAsync([safeThis, image, version]()
+					{
+						if (safeThis)
+						{
+							safeThis->encodeFinished(image, version);
+						}
+					});
+			});
+	}
+
+	void encodeFinished(const CanvasImage::Ptr& image, juce::uint32 version)
+	{
+		if (version != canvasVersion)
+		{
+			if (!pendingEncodeCallbacks.empty())
+			{
+				startBackgroundEncode();
+			}
+			return;
+		}
+
+		encodedImage = image;
+		encodedVersion = version;
+		encodingVersion = 0;
+
+		auto callbacks = std::move(pendingEncodeCallbacks);
+		pendingEncodeCallbacks.clear();
+		for (auto& callback : callbacks)
+		{
+			callback(image);
+		}
 	}
 
 	bool isPointInCanvas(juce::Point<int> p)
@@ -1155,7 +1236,15 @@ private:
 			{
 				if (onGenerate && !isGenerating)
 				{
-					onGenerate(getBase64Image());
+					generateButton.setEnabled(false);
+					requestEncodedImage([this](CanvasImage::Ptr image)
+						{
+							generateButton.setEnabled(!isGenerating);
+							if (image && onGenerate && !isGenerating)
+							{
+								onGenerate(image);
+							}
+						});
 				}
 			};
 
@@ -1229,7 +1318,7 @@ private:
 		{
 			historyIndex--;
 			canvas = undoHistory[historyIndex].createCopy();
-			needsRepaint = true;
+			markCanvasDirty();
 			updateUndoRedoButtons();
 		}
 	}
@@ -1240,7 +1329,7 @@ private:
 		{
 			historyIndex++;
 			canvas = undoHistory[historyIndex].createCopy();
-			needsRepaint = true;
+			markCanvasDirty();
 			updateUndoRedoButtons();
 		}
 	}
@@ -1298,6 +1387,13 @@ private:
 	juce::Rectangle<int> canvasAreaBounds;
 	bool isDrawing = false;
 	bool needsRepaint = false;
+	juce::uint32 canvasVersion = 1;
+	juce::uint32 encodedVersion = 0;
+	juce::uint32 encodingVersion = 0;
+	juce::uint32 lastCanvasChangeTime = 0;
+	CanvasImage::Ptr encodedImage;
+	std::vector<std::function<void(CanvasImage::Ptr)>> pendingEncodeCallbacks;
+	static constexpr juce::uint32 encodeIdleDelayMs = 300;
 	juce::Point<int> lastPoint;
 	juce::Random random;
 
@@ -0,0 +1,411 @@
+#pragma once
+#include "JuceHeader.h"
+#include "DjIaClient.h"
+#include <unordered_map>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+
+// One cache per directory and host process, shared by every plugin instance
+// through getShared(), so instances never overwrite each other's index or
+// evict files the other one still lists.
+class GenerationCache
+{
+public:
+	struct Stats
+	{
+		juce::int64 hits = 0;
+		juce::int64 misses = 0;
+		juce::int64 stores = 0;
+		juce::int64 evictions = 0;
+		juce::int64 totalBytes = 0;
+		juce::int64 maxBytes = 0;
+		int numEntries = 0;
+
+		double getHitRate() const
+		{
+			auto lookups = hits + misses;
+			return lookups > 0 ? static_cast<double>(hits) / static_cast<double>(lookups) : 0.0;
+		}
+	};
+
+	// Decoded audio rather than a path, so an eviction from another thread
+	// can't delete the file between the lookup and the caller opening it.
+	struct CachedResult
+	{
+		std::shared_ptr<juce::AudioBuffer<float>> audio;
+		double sampleRate = 0.0;
+		float detectedBpm = -1.0f;
+		int seed = -1;
+		bool found = false;
+	};
+
+	static constexpr juce::int64 defaultMaxBytes = (juce::int64)1024 * 1024 * 1024;
+
+	explicit GenerationCache(const juce::File& directory, juce::int64 maxBytes = defaultMaxBytes)
+		: cacheDirectory(directory), indexFile(directory.getChildFile("generation_cache.json")), maxCacheBytes(maxBytes)
+	{
+		cacheDirectory.createDirectory();
+		loadIndex();
+	}
+
+	static std::shared_ptr<GenerationCache> getShared(const juce::File& directory, juce::int64 maxBytes = defaultMaxBytes)
+	{
+		static std::mutex mutex;
+		static std::map<juce::String, std::weak_ptr<GenerationCache>> instances;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		auto& slot = instances[directory.getFullPathName()];
+		auto cache = slot.lock();
+		if (!cache)
+		{
+			cache = std::make_shared<GenerationCache>(directory, maxBytes);
+			slot = cache;
+		}
+		return cache;
+	}
+
+	static bool isCacheable(const DjIaClient::LoopRequest& request)
+	{
+		return request.seed >= 0;
+	}
+
+	static juce::String buildRequestKey(const DjIaClient::LoopRequest& request,
+		double sampleRate,
+		const juce::String& backend)
+	{
+		juce::String imageHash = request.useImage && request.image != nullptr
+			? request.image->hash
+			: juce::String("none");
+
+		juce::StringArray canonical;
+		canonical.add("backend=" + backend);
+		canonical.add("prompt=" + request.prompt.trim());
+		canonical.add("bpm=" + juce::String(request.bpm, 2));
+		canonical.add("key=" + request.key);
+		canonical.add("duration=" + juce::String(request.generationDuration, 2));
+		canonical.add("keywords=" + request.keywords.joinIntoString(","));
+		canonical.add("image=" + imageHash);
+		canonical.add("seed=" + juce::String(request.seed));
+		canonical.add("sampleRate=" + juce::String(static_cast<int>(sampleRate)));
+		return canonical.joinIntoString("|");
+	}
+
+	void setEnabled(bool shouldBeEnabled) { enabled = shouldBeEnabled; }
+	bool isEnabled() const { return enabled.load(); }
+
+	void setMaxBytes(juce::int64 newMaxBytes)
+	{
+		{
+			juce::ScopedLock lock(cacheLock);
+			maxCacheBytes = newMaxBytes;
+			enforceBudget();
+		}
+		saveIndex();
+	}
+
+	CachedResult lookup(const juce::String& requestKey)
+	{
+		CachedResult result;
+		if (!enabled.load())
+			return result;
+
+		juce::MemoryBlock fileData;
+		juce::String filename;
+		{
+			juce::ScopedLock lock(cacheLock);
+			auto it = entries.find(hashKey(requestKey));
+
+			if (it == entries.end() || it->second.requestKey != requestKey)
+			{
+				++misses;
+				return result;
+			}
+
+			// Read while holding the lock: evictions delete under it too.
+			juce::File audioFile = cacheDirectory.getChildFile(it->second.filename);
+			if (!audioFile.loadFileAsData(fileData))
+			{
+				totalBytes -= it->second.sizeBytes;
+				entries.erase(it);
+				++misses;
+				indexDirty = true;
+				return result;
+			}
+
+			it->second.lastAccessMs = juce::Time::currentTimeMillis();
+			indexDirty = true;
+			++hits;
+
+			filename = it->second.filename;
+			result.detectedBpm = it->second.detectedBpm;
+			result.seed = it->second.seed;
+		}
+
+		juce::WavAudioFormat wavFormat;
+		std::unique_ptr<juce::AudioFormatReader> reader(wavFormat.createReaderFor(
+			new juce::MemoryInputStream(std::move(fileData)), true));
+		if (reader == nullptr || reader->lengthInSamples <= 0)
+		{
+			DBG("GenerationCache: failed to decode " + filename);
+			return result;
+		}
+
+		result.audio = std::make_shared<juce::AudioBuffer<float>>(static_cast<int>(reader->numChannels),
+			static_cast<int>(reader->lengthInSamples));
+		reader->read(result.audio.get(), 0, result.audio->getNumSamples(), 0, true, true);
+		result.sampleRate = reader->sampleRate;
+		result.found = true;
+
+		DBG("GenerationCache hit: " + filename);
+		return result;
+	}
+
+	bool store(const juce::String& requestKey, const juce::File& audioFile, float detectedBpm, int seed)
+	{
+		if (!enabled.load() || !audioFile.existsAsFile())
+			return false;
+
+		auto hash = hashKey(requestKey);
+		juce::File destination = cacheDirectory.getChildFile(juce::String(hash) + ".wav");
+
+		if (!copyFile(audioFile, destination))
+		{
+			DBG("GenerationCache: failed to store " + destination.getFullPathName());
+			return false;
+		}
+
+		addEntry(hash, requestKey, destination, detectedBpm, seed);
+		return true;
+	}
+
+	// For results that only exist in memory: writes the WAV straight into the
+	// cache instead of through a temporary file.
+	bool store(const juce::String& requestKey, const juce::AudioBuffer<float>& audio, double sampleRate, float detectedBpm, int seed)
+	{
+		if (!enabled.load() || audio.getNumSamples() == 0)
+			return false;
+
+		auto hash = hashKey(requestKey);
+		juce::File destination = cacheDirectory.getChildFile(juce::String(hash) + ".wav");
+
+		if (!writeWavFile(destination, audio, sampleRate))
+		{
+			DBG("GenerationCache: failed to store " + destination.getFullPathName());
+			return false;
+		}
+
+		addEntry(hash, requestKey, destination, detectedBpm, seed);
+		return true;
+	}
+
+	void clear()
+	{
+		{
+			juce::ScopedLock lock(cacheLock);
+			for (const auto& pair : entries)
+			{
+				cacheDirectory.getChildFile(pair.second.filename).deleteFile();
+			}
+			entries.clear();
+			totalBytes = 0;
+			indexDirty = true;
+		}
+		saveIndex();
+	}
+
+	Stats getStats() const
+	{
+		juce::ScopedLock lock(cacheLock);
+		Stats stats;
+		stats.hits = hits;
+		stats.misses = misses;
+		stats.stores = stores;
+		stats.evictions = evictions;
+		stats.totalBytes = totalBytes;
+		stats.maxBytes = maxCacheBytes;
+		stats.numEntries = static_cast<int>(entries.size());
+		return stats;
+	}
+
+	void saveIndex()
+	{
+		juce::ScopedLock lock(cacheLock);
+		if (!indexDirty)
+			return;
+
+		juce::DynamicObject::Ptr indexData = new juce::DynamicObject();
+		juce::Array<juce::var> entriesArray;
+
+		for (const auto& pair : entries)
+		{
+			juce::DynamicObject::Ptr entryData = new juce::DynamicObject();
+			entryData->setProperty("hash", juce::String(pair.first));
+			entryData->setProperty("requestKey", pair.second.requestKey);
+			entryData->setProperty("filename", pair.second.filename);
+			entryData->setProperty("sizeBytes", pair.second.sizeBytes);
+			entryData->setProperty("lastAccessMs", pair.second.lastAccessMs);
+			entryData->setProperty("detectedBpm", static_cast<double>(pair.second.detectedBpm));
+			entryData->setProperty("seed", pair.second.seed);
+			entriesArray.add(entryData.get());
+		}
+
+		indexData->setProperty("entries", entriesArray);
+		indexData->setProperty("version", "1.0");
+
+		indexFile.replaceWithText(juce::JSON::toString(juce::var(indexData.get()), true));
+		indexDirty = false;
+	}
+
+private:
+	struct Entry
+	{
+		juce::String requestKey;
+		juce::String filename;
+		juce::int64 sizeBytes = 0;
+		juce::int64 lastAccessMs = 0;
+		float detectedBpm = -1.0f;
+		int seed = -1;
+	};
+
+	juce::File cacheDirectory;
+	juce::File indexFile;
+	juce::int64 maxCacheBytes;
+	mutable juce::CriticalSection cacheLock;
+	std::unordered_map<std::string, Entry> entries;
+	std::atomic<bool> enabled{ false };
+	bool indexDirty = false;
+
+	juce::int64 totalBytes = 0;
+	juce::int64 hits = 0;
+	juce::int64 misses = 0;
+	juce::int64 stores = 0;
+	juce::int64 evictions = 0;
+
+	// Also the file name, so it has to be collision-free in practice: two keys
+	// sharing a name would overwrite each other's audio.
+	static std::string hashKey(const juce::String& requestKey)
+	{
+		return juce::SHA256(requestKey.toUTF8()).toHexString().toStdString();
+	}
+
+	void addEntry(const std::string& hash, const juce::String& requestKey, const juce::File& destination, float detectedBpm, int seed)
+	{
+		{
+			juce::ScopedLock lock(cacheLock);
+			auto existing = entries.find(hash);
+			if (existing != entries.end())
+			{
+				totalBytes -= existing->second.sizeBytes;
+				// Entries from older versions were named by a 64-bit hash.
+				if (existing->second.filename != destination.getFileName())
+					cacheDirectory.getChildFile(existing->second.filename).deleteFile();
+			}
+
+			Entry entry;
+			entry.requestKey = requestKey;
+			entry.filename = destination.getFileName();
+			entry.sizeBytes = destination.getSize();
+			entry.lastAccessMs = juce::Time::currentTimeMillis();
+			entry.detectedBpm = detectedBpm;
+			entry.seed = seed;
+
+			totalBytes += entry.sizeBytes;
+			entries[hash] = entry;
+			++stores;
+
+			enforceBudget();
+			indexDirty = true;
+		}
+
+		saveIndex();
+	}
+
+	// Same temporary-file dance as writeWavFile.
+	static bool copyFile(const juce::File& source, const juce::File& destination)
+	{
+		juce::TemporaryFile temporary(destination);
+		return source.copyFileTo(temporary.getFile()) && temporary.overwriteTargetFileWithTemporary();
+	}
+
+	// Written next to the destination and renamed, so a lookup from another
+	// thread never sees a half-written file.
+	static bool writeWavFile(const juce::File& destination, const juce::AudioBuffer<float>& audio, double sampleRate)
+	{
+		juce::TemporaryFile temporary(destination);
+		{
+			std::unique_ptr<juce::OutputStream> stream = temporary.getFile().createOutputStream();
+			if (stream == nullptr)
+				return false;
+
+			juce::WavAudioFormat wavFormat;
+			std::unique_ptr<juce::AudioFormatWriter> writer(wavFormat.createWriterFor(stream.get(), sampleRate,
+				static_cast<unsigned int>(audio.getNumChannels()), 24, {}, 0));
+			if (writer == nullptr)
+				return false;
+
+			stream.release();
+			if (!writer->writeFromAudioSampleBuffer(audio, 0, audio.getNumSamples()))
+				return false;
+		}
+		return temporary.overwriteTargetFileWithTemporary();
+	}
+
+	void enforceBudget()
+	{
+		while (totalBytes > maxCacheBytes && !entries.empty())
+		{
+			auto oldest = entries.begin();
+			for (auto it = entries.begin(); it != entries.end(); ++it)
+			{
+				if (it->second.lastAccessMs < oldest->second.lastAccessMs)
+					oldest = it;
+			}
+
+			cacheDirectory.getChildFile(oldest->second.filename).deleteFile();
+			totalBytes -= oldest->second.sizeBytes;
+			entries.erase(oldest);
+			++evictions;
+			indexDirty = true;
+		}
+	}
+
+	void loadIndex()
+	{
+		juce::ScopedLock lock(cacheLock);
+		entries.clear();
+		totalBytes = 0;
+
+		if (!indexFile.existsAsFile())
+			return;
+
+		juce::var indexJson = juce::JSON::parse(indexFile);
+		auto* entriesArray = indexJson.getProperty("entries", juce::var()).getArray();
+		if (!entriesArray)
+			return;
+
+		for (const auto& entryVar : *entriesArray)
+		{
+			Entry entry;
+			entry.requestKey = entryVar.getProperty("requestKey", "").toString();
+			entry.filename = entryVar.getProperty("filename", "").toString();
+			entry.lastAccessMs = static_cast<juce::int64>(entryVar.getProperty("lastAccessMs", 0));
+			entry.detectedBpm = static_cast<float>(entryVar.getProperty("detectedBpm", -1.0));
+			entry.seed = static_cast<int>(entryVar.getProperty("seed", -1));
+
+			juce::File audioFile = cacheDirectory.getChildFile(entry.filename);
+			if (entry.requestKey.isEmpty() || !audioFile.existsAsFile())
+				continue;
+
+			entry.sizeBytes = audioFile.getSize();
+			totalBytes += entry.sizeBytes;
+			entries[hashKey(entry.requestKey)] = entry;
+		}
+
+		DBG("GenerationCache loaded " + juce::String((int)entries.size()) + " entries ("
+			+ juce::File::descriptionOfSizeInBytes(totalBytes) + ")");
+	}
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(GenerationCache)
+};
@@ -0,0 +1,129 @@
+#pragma once
+#include "JuceHeader.h"
+#include "GenerationTrace.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+
+class GenerationControl
+{
+public:
+	using Ptr = std::shared_ptr<GenerationControl>;
+
+	enum class Stage
+	{
+		queued,
+		running,
+		downloading
+	};
+
+	using ProgressCallback = std::function<void(Stage stage, float percent)>;
+
+	static Ptr create() { return std::make_shared<GenerationControl>(); }
+
+	static juce::String getStageName(Stage stage)
+	{
+		switch (stage)
+		{
+		case Stage::queued:
+			return "Queued";
+		case Stage::running:
+			return "Generating";
+		case Stage::downloading:
+			return "Downloading";
+		}
+		return {};
+	}
+
+	void cancel()
+	{
+		if (cancelled.exchange(true))
+			return;
+
+		const juce::ScopedLock lock(controlLock);
+		if (abortHandler)
+			abortHandler();
+	}
+
+	bool isCancelled() const { return cancelled.load(); }
+
+	void setProgressCallback(ProgressCallback callback)
+	{
+		const juce::ScopedLock lock(controlLock);
+		progressCallback = std::move(callback);
+	}
+
+	void setTrace(GenerationTrace::Ptr newTrace)
+	{
+		const juce::ScopedLock lock(controlLock);
+		trace = std::move(newTrace);
+	}
+
+	void reportProgress(Stage stage, float percent = -1.0f)
+	{
+		ProgressCallback callback;
+		GenerationTrace::Ptr currentTrace;
+		{
+			const juce::ScopedLock lock(controlLock);
+			callback = progressCallback;
+			currentTrace = trace;
+		}
+		GenerationTrace::transition(currentTrace, getTracePhase(stage));
+		if (callback)
+			callback(stage, percent);
+	}
+
+	// Registers an action that aborts blocking work (closing a socket, killing a
+	// process) for as long as the guard lives. The handler runs under the control
+	// lock, so it never outlives the object it refers to.
+	class ScopedAbortHandler
+	{
+	public:
+		ScopedAbortHandler(const Ptr& controlToUse, std::function<void()> handler)
+			: control(controlToUse)
+		{
+			if (control)
+				control->setAbortHandler(std::move(handler));
+		}
+
+		~ScopedAbortHandler()
+		{
+			if (control)
+				control->setAbortHandler(nullptr);
+		}
+
+	private:
+		Ptr control;
+
+		JUCE_DECLARE_NON_COPYABLE(ScopedAbortHandler)
+	};
+
+private:
+	std::atomic<bool> cancelled{ false };
+	GenerationTrace::Ptr trace;
+	juce::CriticalSection controlLock;
+	std::function<void()> abortHandler;
+	ProgressCallback progressCallback;
+
+	static GenerationTrace::Phase getTracePhase(Stage stage)
+	{
+		switch (stage)
+		{
+		case Stage::queued:
+			return GenerationTrace::Phase::queue;
+		case Stage::running:
+			return GenerationTrace::Phase::generate;
+		case Stage::downloading:
+			return GenerationTrace::Phase::download;
+		}
+		return GenerationTrace::Phase::generate;
+	}
+
+	void setAbortHandler(std::function<void()> handler)
+	{
+		const juce::ScopedLock lock(controlLock);
+		abortHandler = std::move(handler);
+		if (abortHandler && cancelled.load())
+			abortHandler();
+	}
+};
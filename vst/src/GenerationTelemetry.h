@@ -0,0 +1,132 @@
+#pragma once
+#include "JuceHeader.h"
+#include "GenerationTrace.h"
+#include <algorithm>
+#include <array>
+#include <vector>
+
+// Collects finished generation traces: appends each one to a rotating JSONL
+// log and keeps per-phase p50/p95 for the current session.
+class GenerationTelemetry
+{
+public:
+	GenerationTelemetry()
+		: logFile(juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+			.getChildFile("OBSIDIAN-Neural")
+			.getChildFile("Logs")
+			.getChildFile("generation-telemetry.jsonl"))
+	{
+	}
+
+	void record(const GenerationTrace& trace)
+	{
+		const juce::ScopedLock lock(telemetryLock);
+
+		if (trace.getOutcome() == "loaded")
+		{
+			for (int i = 0; i < GenerationTrace::numPhases; ++i)
+			{
+				auto phase = static_cast<GenerationTrace::Phase>(i);
+				if (trace.hasPhase(phase))
+					addSample(phaseSamples[(size_t)i], trace.getPhaseDurationMs(phase));
+			}
+			addSample(totalSamples, trace.getTotalMs());
+		}
+
+		appendToLog(juce::JSON::toString(trace.toJson(), true));
+
+		DBG("Generation trace " + trace.getTraceId() + " [" + trace.getOutcome() + "] "
+			+ juce::String(juce::roundToInt(trace.getTotalMs())) + " ms");
+	}
+
+	juce::String getSessionSummary() const
+	{
+		const juce::ScopedLock lock(telemetryLock);
+
+		if (totalSamples.empty())
+			return {};
+
+		juce::StringArray lines;
+		lines.add("Session p50 / p95 (" + juce::String((int)totalSamples.size()) + " loads):");
+		lines.add("  total: " + formatPercentiles(totalSamples));
+		for (int i = 0; i < GenerationTrace::numPhases; ++i)
+		{
+			const auto& samples = phaseSamples[(size_t)i];
+			if (!samples.empty())
+				lines.add("  " + GenerationTrace::getPhaseName(static_cast<GenerationTrace::Phase>(i))
+					+ ": " + formatPercentiles(samples));
+		}
+		return lines.joinIntoString("\n");
+	}
+
+	juce::File getLogFile() const { return logFile; }
+
+private:
+	static constexpr juce::int64 maxLogBytes = 1024 * 1024;
+	static constexpr int maxRotatedLogs = 3;
+	static constexpr size_t maxSessionSamples = 512;
+
+	juce::File logFile;
+	mutable juce::CriticalSection telemetryLock;
+	std::array<std::vector<double>, GenerationTrace::numPhases> phaseSamples;
+	std::vector<double> totalSamples;
+
+	static void addSample(std::vector<double>& samples, double value)
+	{
+		if (samples.size() >= maxSessionSamples)
+			samples.erase(samples.begin());
+		samples.push_back(value);
+	}
+
+	static double percentile(std::vector<double> samples, double fraction)
+	{
+		if (samples.empty())
+			return 0.0;
+
+		auto index = (size_t)juce::jlimit(0, (int)samples.size() - 1,
+			(int)std::ceil(fraction * (double)samples.size()) - 1);
+		std::nth_element(samples.begin(), samples.begin() + (std::ptrdiff_t)index, samples.end());
+		return samples[index];
+	}
+
+	static juce::String formatPercentiles(const std::vector<double>& samples)
+	{
+		return juce::String(juce::roundToInt(percentile(samples, 0.5))) + " / "
+			+ juce::String(juce::roundToInt(percentile(samples, 0.95))) + " ms";
+	}
+
+	juce::File getRotatedFile(int index) const
+	{
+		return logFile.getSiblingFile(logFile.getFileNameWithoutExtension()
+			+ "." + juce::String(index) + logFile.getFileExtension());
+	}
+
+	void rotateIfNeeded()
+	{
+		if (!logFile.existsAsFile() || logFile.getSize() < maxLogBytes)
+			return;
+
+		getRotatedFile(maxRotatedLogs).deleteFile();
+		for (int i = maxRotatedLogs - 1; i >= 1; --i)
+		{
+			auto rotated = getRotatedFile(i);
+			if (rotated.existsAsFile())
+				rotated.moveFileTo(getRotatedFile(i + 1));
+		}
+		logFile.moveFileTo(getRotatedFile(1));
+	}
+
+	void appendToLog(const juce::String& line)
+	{
+		logFile.getParentDirectory().createDirectory();
+		rotateIfNeeded();
+
+		juce::FileOutputStream stream(logFile);
+		if (stream.openedOk())
+		{
+			stream.writeText(line + "\n", false, false, nullptr);
+		}
+	}
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(GenerationTelemetry)
+};
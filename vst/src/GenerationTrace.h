@@ -0,0 +1,194 @@
+#pragma once
+#include "JuceHeader.h"
+#include <array>
+#include <memory>
+
+// Per-generation timing record. A trace follows one generation from the
+// request through the audio-thread swap. Each thread that picks up the work
+// moves the trace to its next phase, so time spent in a phase includes any
+// waiting that happens before the next transition.
+class GenerationTrace
+{
+public:
+	using Ptr = std::shared_ptr<GenerationTrace>;
+
+	enum class Phase
+	{
+		queue,
+		generate,
+		download,
+		waitForLoad,
+		decode,
+		bpmDetect,
+		timeStretch,
+		wavWrite,
+		bankCopy,
+		swap,
+		numPhases
+	};
+
+	static constexpr int numPhases = static_cast<int>(Phase::numPhases);
+
+	static Ptr create(const juce::String& trackId, const juce::String& backend)
+	{
+		return std::make_shared<GenerationTrace>(trackId, backend);
+	}
+
+	GenerationTrace(const juce::String& trackIdToUse, const juce::String& backendToUse)
+		: traceId(juce::Uuid().toString().substring(0, 12)),
+		trackId(trackIdToUse),
+		backend(backendToUse),
+		source(backendToUse),
+		outcome("loaded"),
+		startTime(juce::Time::getCurrentTime()),
+		startMs(juce::Time::getMillisecondCounterHiRes())
+	{
+		phaseStartMs.fill(-1.0);
+		phaseDurationMs.fill(0.0);
+		enter(Phase::queue, startMs);
+	}
+
+	static juce::String getPhaseName(Phase phase)
+	{
+		switch (phase)
+		{
+		case Phase::queue: return "queue";
+		case Phase::generate: return "generate";
+		case Phase::download: return "download";
+		case Phase::waitForLoad: return "waitForLoad";
+		case Phase::decode: return "decode";
+		case Phase::bpmDetect: return "bpmDetect";
+		case Phase::timeStretch: return "timeStretch";
+		case Phase::wavWrite: return "wavWrite";
+		case Phase::bankCopy: return "bankCopy";
+		case Phase::swap: return "swap";
+		case Phase::numPhases: break;
+		}
+		return {};
+	}
+
+	// Null-safe so call sites shared with non-generation loads stay one line.
+	static void transition(const Ptr& trace, Phase phase)
+	{
+		if (trace)
+			trace->transitionTo(phase);
+	}
+
+	void transitionTo(Phase phase)
+	{
+		if (finished || phase == currentPhase)
+			return;
+
+		double now = juce::Time::getMillisecondCounterHiRes();
+		leave(now);
+		enter(phase, now);
+	}
+
+	void finish()
+	{
+		finish(juce::Time::getMillisecondCounterHiRes());
+	}
+
+	// For a trace closed after the fact, e.g. at the swap time the audio
+	// thread recorded.
+	void finish(double endMs)
+	{
+		if (finished)
+			return;
+
+		leave(endMs);
+		totalMs = endMs - startMs;
+		finished = true;
+	}
+
+	void setSource(const juce::String& newSource) { source = newSource; }
+	void setOutcome(const juce::String& newOutcome) { outcome = newOutcome; }
+
+	bool isFinished() const { return finished; }
+	const juce::String& getTraceId() const { return traceId; }
+	const juce::String& getTrackId() const { return trackId; }
+	const juce::String& getBackend() const { return backend; }
+	const juce::String& getSource() const { return source; }
+	const juce::String& getOutcome() const { return outcome; }
+	juce::Time getStartTime() const { return startTime; }
+	double getTotalMs() const { return totalMs; }
+
+	bool hasPhase(Phase phase) const { return phaseStartMs[(size_t)phase] >= 0.0; }
+	double getPhaseStartMs(Phase phase) const { return phaseStartMs[(size_t)phase]; }
+	double getPhaseDurationMs(Phase phase) const { return phaseDurationMs[(size_t)phase]; }
+
+	juce::var toJson() const
+	{
+		auto* phases = new juce::DynamicObject();
+		for (int i = 0; i < numPhases; ++i)
+		{
+			auto phase = static_cast<Phase>(i);
+			if (!hasPhase(phase))
+				continue;
+
+			auto* entry = new juce::DynamicObject();
+			entry->setProperty("start_ms", juce::roundToInt(getPhaseStartMs(phase)));
+			entry->setProperty("duration_ms", juce::roundToInt(getPhaseDurationMs(phase)));
+			phases->setProperty(getPhaseName(phase), juce::var(entry));
+		}
+
+		auto* root = new juce::DynamicObject();
+		root->setProperty("trace_id", traceId);
+		root->setProperty("track_id", trackId);
+		root->setProperty("backend", backend);
+		root->setProperty("source", source);
+		root->setProperty("outcome", outcome);
+		root->setProperty("started_at", startTime.toISO8601(true));
+		root->setProperty("total_ms", juce::roundToInt(totalMs));
+		root->setProperty("phases", juce::var(phases));
+		return juce::var(root);
+	}
+
+	juce::String toSummary() const
+	{
+		juce::StringArray lines;
+		lines.add("Last generation (" + source + ", trace " + traceId + "): "
+			+ juce::String(totalMs / 1000.0, 2) + " s");
+		for (int i = 0; i < numPhases; ++i)
+		{
+			auto phase = static_cast<Phase>(i);
+			if (hasPhase(phase))
+				lines.add("  " + getPhaseName(phase) + ": " + juce::String(juce::roundToInt(getPhaseDurationMs(phase))) + " ms");
+		}
+		return lines.joinIntoString("\n");
+	}
+
+private:
+	juce::String traceId;
+	juce::String trackId;
+	juce::String backend;
+	juce::String source;
+	juce::String outcome;
+	juce::Time startTime;
+	double startMs = 0.0;
+	double totalMs = 0.0;
+	double currentPhaseEnteredMs = 0.0;
+	Phase currentPhase = Phase::numPhases;
+	bool finished = false;
+
+	std::array<double, numPhases> phaseStartMs;
+	std::array<double, numPhases> phaseDurationMs;
+
+	void enter(Phase phase, double now)
+	{
+		currentPhase = phase;
+		currentPhaseEnteredMs = now;
+		auto index = (size_t)phase;
+		if (phaseStartMs[index] < 0.0)
+			phaseStartMs[index] = now - startMs;
+	}
+
+	void leave(double now)
+	{
+		if (currentPhase != Phase::numPhases)
+			phaseDurationMs[(size_t)currentPhase] += now - currentPhaseEnteredMs;
+		currentPhase = Phase::numPhases;
+	}
+
+	JUCE_DECLARE_NON_COPYABLE(GenerationTrace)
+};
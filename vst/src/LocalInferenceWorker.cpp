@@ -0,0 +1,459 @@
+#include "LocalInferenceWorker.h"
+#include <random>
+
+// Worker protocol: the plugin listens on a loopback port and launches
+// "audiogen-worker --models <dir> --port <port> --token <token>". The worker
+// loads its models once, connects back, sends {"type":"hello","token":...}
+// as its first frame and then serves jobs until it receives "shutdown".
+// Connections that don't open with the right token are dropped, so another
+// local process can't take the worker's place on the port.
+// Every message is a frame: "OBSW", uint32 header size, JSON header,
+// uint32 payload size, payload. Generation results carry interleaved
+// little-endian float32 PCM in the payload. While a job runs the worker may
+// send "progress" frames, and answers a "cancel" frame with a failed result.
+
+namespace
+{
+	const char frameMagic[4] = { 'O', 'B', 'S', 'W' };
+	constexpr juce::uint32 maxHeaderBytes = 64 * 1024;
+	constexpr juce::uint32 maxPayloadBytes = 512u * 1024u * 1024u;
+
+	// 256 bits from the OS generator, fresh for every launch.
+	juce::String createSessionToken()
+	{
+		std::random_device device;
+		juce::String token;
+		for (int i = 0; i < 8; ++i)
+			token << juce::String::toHexString((juce::uint32)device()).paddedLeft('0', 8);
+		return token;
+	}
+
+	bool tokensMatch(const juce::String& expected, const juce::String& received)
+	{
+		auto a = expected.toStdString();
+		auto b = received.toStdString();
+		if (a.size() != b.size())
+			return false;
+
+		unsigned char difference = 0;
+		for (size_t i = 0; i < a.size(); ++i)
+			difference |= (unsigned char)(a[i] ^ b[i]);
+		return difference == 0;
+	}
+}
+
+LocalInferenceWorker::LocalInferenceWorker(const juce::File& executable, const juce::String& modelsDir)
+	: workerExecutable(executable), modelsDirectory(modelsDir)
+{
+}
+
+LocalInferenceWorker::~LocalInferenceWorker()
+{
+	shutdown();
+}
+
+juce::File LocalInferenceWorker::findExecutable(const juce::String& modelsDir)
+{
+#ifdef _WIN32
+	return juce::File(modelsDir).getChildFile("audiogen-worker.exe");
+#else
+	return juce::File(modelsDir).getChildFile("audiogen-worker");
+#endif
+}
+
+bool LocalInferenceWorker::ensureRunning()
+{
+	const juce::ScopedLock lock(workerLock);
+
+	if (disabled)
+		return false;
+
+	if (isRunningLocked())
+	{
+		auto idleMs = juce::Time::getMillisecondCounter() - lastContactTime;
+		if (idleMs < (juce::uint32)healthCheckIntervalMs || pingLocked())
+			return true;
+
+		DBG("Inference worker failed health check, restarting");
+	}
+
+	stopLocked();
+	if (startLocked())
+	{
+		consecutiveFailures = 0;
+		return true;
+	}
+
+	if (++consecutiveFailures >= maxConsecutiveFailures)
+	{
+		DBG("Inference worker failed to start " << consecutiveFailures << " times, falling back to audiogen");
+		disabled = true;
+	}
+	return false;
+}
+
+bool LocalInferenceWorker::ping()
+{
+	const juce::ScopedLock lock(workerLock);
+	return isRunningLocked() && pingLocked();
+}
+
+void LocalInferenceWorker::shutdown()
+{
+	const juce::ScopedLock lock(workerLock);
+	stopLocked();
+}
+
+LocalInferenceWorker::JobResult LocalInferenceWorker::runJob(const Job& job, int timeoutMs, const GenerationControl::Ptr& control)
+{
+	JobResult result;
+
+	if (!ensureRunning())
+	{
+		result.workerFailed = true;
+		result.errorMessage = "Inference worker unavailable";
+		return result;
+	}
+
+	// workerLock is only held around each exchange with the worker, so
+	// shutdown() and the health check never wait for a whole generation.
+	auto startTime = juce::Time::getMillisecondCounterHiRes();
+	juce::int64 jobId = 0;
+	{
+		const juce::ScopedLock lock(workerLock);
+		jobId = nextJobId++;
+
+		juce::DynamicObject::Ptr request = new juce::DynamicObject();
+		request->setProperty("type", "generate");
+		request->setProperty("id", jobId);
+		request->setProperty("prompt", job.prompt);
+		request->setProperty("duration", job.duration);
+		request->setProperty("threads", job.numThreads);
+		request->setProperty("seed", job.seed);
+
+		if (!writeFrame(juce::var(request.get()), nullptr, 0))
+		{
+			stopLocked();
+			result.workerFailed = true;
+			result.errorMessage = "Lost connection to inference worker";
+			return result;
+		}
+	}
+
+	juce::var header;
+	juce::MemoryBlock payload;
+	auto deadline = juce::Time::getMillisecondCounter() + (juce::uint32)timeoutMs;
+	bool cancelSent = false;
+
+	for (;;)
+	{
+		const juce::ScopedLock lock(workerLock);
+
+		if (control && control->isCancelled() && !cancelSent)
+		{
+			juce::DynamicObject::Ptr cancelRequest = new juce::DynamicObject();
+			cancelRequest->setProperty("type", "cancel");
+			cancelRequest->setProperty("id", jobId);
+			writeFrame(juce::var(cancelRequest.get()), nullptr, 0);
+			deadline = juce::jmin(deadline, juce::Time::getMillisecondCounter() + (juce::uint32)cancelGraceMs);
+			cancelSent = true;
+		}
+
+		auto now = juce::Time::getMillisecondCounter();
+		bool frameReady = now < deadline && waitForFrame(juce::jmin(100, (int)(deadline - now)));
+
+		if (!frameReady)
+		{
+			if (juce::Time::getMillisecondCounter() < deadline && process != nullptr && process->isRunning())
+				continue;
+
+			stopLocked();
+			result.cancelled = cancelSent;
+			result.workerFailed = !cancelSent;
+			result.errorMessage = cancelSent ? "Generation cancelled" : "Inference worker timed out or crashed";
+			return result;
+		}
+
+		if (!readFrame(header, payload, 10000))
+		{
+			stopLocked();
+			result.workerFailed = true;
+			result.errorMessage = "Inference worker timed out or crashed";
+			return result;
+		}
+
+		lastContactTime = juce::Time::getMillisecondCounter();
+
+		if (header.getProperty("type", "").toString() != "progress")
+			break;
+
+		if (control)
+		{
+			control->reportProgress(GenerationControl::Stage::running,
+				static_cast<float>(header.getProperty("percent", -1.0)));
+		}
+	}
+
+	if (cancelSent)
+	{
+		result.cancelled = true;
+		result.errorMessage = "Generation cancelled";
+		return result;
+	}
+
+	if (header.getProperty("type", "").toString() != "result"
+		|| static_cast<juce::int64>(header.getProperty("id", -1)) != jobId)
+	{
+		shutdown();
+		result.workerFailed = true;
+		result.errorMessage = "Unexpected reply from inference worker";
+		return result;
+	}
+
+	if (!static_cast<bool>(header.getProperty("ok", false)))
+	{
+		result.errorMessage = header.getProperty("error", "Unknown worker error").toString();
+		return result;
+	}
+
+	int numChannels = static_cast<int>(header.getProperty("channels", 1));
+	result.sampleRate = static_cast<double>(header.getProperty("sampleRate", 44100.0));
+
+	if (numChannels <= 0 || numChannels > 2 || payload.getSize() % (sizeof(float) * (size_t)numChannels) != 0)
+	{
+		result.errorMessage = "Invalid PCM payload from inference worker";
+		return result;
+	}
+
+	int numFrames = static_cast<int>(payload.getSize() / (sizeof(float) * (size_t)numChannels));
+	result.audio.setSize(numChannels, numFrames);
+
+	auto* interleaved = static_cast<const float*>(payload.getData());
+	for (int ch = 0; ch < numChannels; ++ch)
+	{
+		float* dest = result.audio.getWritePointer(ch);
+		for (int i = 0; i < numFrames; ++i)
+			dest[i] = interleaved[i * numChannels + ch];
+	}
+
+	result.elapsedMs = juce::Time::getMillisecondCounterHiRes() - startTime;
+	result.success = numFrames > 0;
+	if (!result.success)
+		result.errorMessage = "Inference worker returned no audio";
+
+	return result;
+}
+
+bool LocalInferenceWorker::isRunningLocked() const
+{
+	return process != nullptr && process->isRunning()
+		&& connection != nullptr && connection->isConnected();
+}
+
+bool LocalInferenceWorker::startLocked()
+{
+	if (!workerExecutable.existsAsFile())
+		return false;
+
+	auto startTime = juce::Time::getMillisecondCounterHiRes();
+
+	juce::StreamingSocket listener;
+	if (!listener.createListener(0, "127.0.0.1"))
+	{
+		DBG("Inference worker: failed to open loopback listener");
+		return false;
+	}
+
+	auto token = createSessionToken();
+	juce::StringArray command;
+	command.add(workerExecutable.getFullPathName());
+	command.add("--models");
+	command.add(modelsDirectory);
+	command.add("--port");
+	command.add(juce::String(listener.getBoundPort()));
+	command.add("--token");
+	command.add(token);
+
+	process = std::make_unique<juce::ChildProcess>();
+	if (!process->start(command, 0))
+	{
+		DBG("Inference worker: failed to launch " << workerExecutable.getFullPathName());
+		process.reset();
+		return false;
+	}
+
+	auto deadline = juce::Time::getMillisecondCounter() + (juce::uint32)connectTimeoutMs;
+	for (;;)
+	{
+		auto remainingMs = (int)(deadline - juce::Time::getMillisecondCounter());
+		if (remainingMs <= 0 || listener.waitUntilReady(true, remainingMs) != 1)
+		{
+			DBG("Inference worker: no connection within " << connectTimeoutMs << "ms");
+			stopLocked();
+			return false;
+		}
+
+		connection.reset(listener.waitForNextConnection());
+		if (connection != nullptr && authenticateLocked(token))
+			break;
+
+		DBG("Inference worker: dropped a connection without the session token");
+		connection.reset();
+	}
+
+	if (!pingLocked())
+	{
+		stopLocked();
+		return false;
+	}
+
+	lastStartupMs = juce::Time::getMillisecondCounterHiRes() - startTime;
+	++launchCount;
+	DBG("Inference worker ready in " << lastStartupMs << "ms");
+	return true;
+}
+
+void LocalInferenceWorker::stopLocked()
+{
+	if (connection != nullptr && connection->isConnected())
+	{
+		juce::DynamicObject::Ptr request = new juce::DynamicObject();
+		request->setProperty("type", "shutdown");
+		writeFrame(juce::var(request.get()), nullptr, 0);
+	}
+	connection.reset();
+
+	if (process != nullptr)
+	{
+		if (process->isRunning() && !process->waitForProcessToFinish(2000))
+			process->kill();
+		process.reset();
+	}
+}
+
+bool LocalInferenceWorker::authenticateLocked(const juce::String& token)
+{
+	juce::var header;
+	juce::MemoryBlock payload;
+	return readFrame(header, payload, pingTimeoutMs)
+		&& header.getProperty("type", "").toString() == "hello"
+		&& tokensMatch(token, header.getProperty("token", "").toString());
+}
+
+bool LocalInferenceWorker::pingLocked()
+{
+	juce::DynamicObject::Ptr request = new juce::DynamicObject();
+	request->setProperty("type", "ping");
+
+	if (!writeFrame(juce::var(request.get()), nullptr, 0))
+		return false;
+
+	juce::var header;
+	juce::MemoryBlock payload;
+	if (!readFrame(header, payload, pingTimeoutMs) || header.getProperty("type", "").toString() != "pong")
+		return false;
+
+	lastContactTime = juce::Time::getMillisecondCounter();
+	return true;
+}
+
+bool LocalInferenceWorker::writeFrame(const juce::var& header, const void* payload, size_t payloadSize)
+{
+	auto headerText = juce::JSON::toString(header, true).toStdString();
+	auto headerSize = juce::ByteOrder::swapIfBigEndian((juce::uint32)headerText.size());
+	auto payloadSizeLE = juce::ByteOrder::swapIfBigEndian((juce::uint32)payloadSize);
+
+	return writeExactly(frameMagic, sizeof(frameMagic))
+		&& writeExactly(&headerSize, sizeof(headerSize))
+		&& writeExactly(headerText.data(), headerText.size())
+		&& writeExactly(&payloadSizeLE, sizeof(payloadSizeLE))
+		&& (payloadSize == 0 || writeExactly(payload, payloadSize));
+}
+
+bool LocalInferenceWorker::readFrame(juce::var& header, juce::MemoryBlock& payload, int timeoutMs)
+{
+	char magic[4];
+	juce::uint32 headerSize = 0;
+	juce::uint32 payloadSize = 0;
+
+	if (!readExactly(magic, sizeof(magic), timeoutMs) || memcmp(magic, frameMagic, sizeof(magic)) != 0)
+		return false;
+
+	if (!readExactly(&headerSize, sizeof(headerSize), timeoutMs))
+		return false;
+	headerSize = juce::ByteOrder::swapIfBigEndian(headerSize);
+	if (headerSize == 0 || headerSize > maxHeaderBytes)
+		return false;
+
+	juce::MemoryBlock headerData(headerSize);
+	if (!readExactly(headerData.getData(), headerSize, timeoutMs))
+		return false;
+
+	if (!readExactly(&payloadSize, sizeof(payloadSize), timeoutMs))
+		return false;
+	payloadSize = juce::ByteOrder::swapIfBigEndian(payloadSize);
+	if (payloadSize > maxPayloadBytes)
+		return false;
+
+	payload.setSize(payloadSize);
+	if (payloadSize > 0 && !readExactly(payload.getData(), payloadSize, timeoutMs))
+		return false;
+
+	header = juce::JSON::parse(headerData.toString());
+	return header.isObject();
+}
+
+bool LocalInferenceWorker::waitForFrame(int timeoutMs)
+{
+	return connection != nullptr && connection->waitUntilReady(true, timeoutMs) == 1;
+}
+
+bool LocalInferenceWorker::readExactly(void* dest, size_t numBytes, int timeoutMs)
+{
+	if (connection == nullptr)
+		return false;
+
+	auto* bytes = static_cast<char*>(dest);
+	size_t received = 0;
+	auto deadline = juce::Time::getMillisecondCounter() + (juce::uint32)timeoutMs;
+
+	while (received < numBytes)
+	{
+		auto now = juce::Time::getMillisecondCounter();
+		if (now >= deadline)
+			return false;
+
+		int ready = connection->waitUntilReady(true, juce::jmin(100, (int)(deadline - now)));
+		if (ready < 0)
+			return false;
+		if (ready == 0)
+		{
+			if (process == nullptr || !process->isRunning())
+				return false;
+			continue;
+		}
+
+		int count = connection->read(bytes + received, (int)(numBytes - received), false);
+		if (count <= 0)
+			return false;
+		received += (size_t)count;
+	}
+	return true;
+}
+
+bool LocalInferenceWorker::writeExactly(const void* data, size_t numBytes)
+{
+	if (connection == nullptr)
+		return false;
+
+	auto* bytes = static_cast<const char*>(data);
+	size_t sent = 0;
+	while (sent < numBytes)
+	{
+		int count = connection->write(bytes + sent, (int)(numBytes - sent));
+		if (count <= 0)
+			return false;
+		sent += (size_t)count;
+	}
+	return true;
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <JuceHeader.h>
+#include "GenerationControl.h"
+#include <atomic>
+
+class LocalInferenceWorker
+{
+public:
+	struct Job
+	{
+		juce::String prompt;
+		float duration = 10.0f;
+		int numThreads = 0;
+		int seed = -1;
+	};
+
+	struct JobResult
+	{
+		juce::AudioBuffer<float> audio;
+		double sampleRate = 44100.0;
+		bool success = false;
+		bool workerFailed = false;
+		bool cancelled = false;
+		juce::String errorMessage;
+		double elapsedMs = 0.0;
+	};
+
+	explicit LocalInferenceWorker(const juce::File& executable, const juce::String& modelsDir);
+	~LocalInferenceWorker();
+
+	static juce::File findExecutable(const juce::String& modelsDir);
+
+	bool isAvailable() const { return workerExecutable.existsAsFile() && !disabled; }
+	bool ensureRunning();
+	bool ping();
+	void shutdown();
+
+	// A worker process serves one job at a time, so a caller claims it for the
+	// duration of runJob(); StableAudioEngine keeps one worker per concurrent job.
+	bool tryClaim() { return !claimed.exchange(true); }
+	void release() { claimed = false; }
+
+	JobResult runJob(const Job& job, int timeoutMs = 600000, const GenerationControl::Ptr& control = nullptr);
+
+	double getLastStartupMs() const { return lastStartupMs; }
+	int getLaunchCount() const { return launchCount; }
+
+private:
+	static constexpr int connectTimeoutMs = 60000;
+	static constexpr int pingTimeoutMs = 5000;
+	static constexpr int healthCheckIntervalMs = 30000;
+	static constexpr int maxConsecutiveFailures = 3;
+	static constexpr int cancelGraceMs = 2000;
+
+	juce::File workerExecutable;
+	juce::String modelsDirectory;
+
+	juce::CriticalSection workerLock;
+	std::unique_ptr<juce::ChildProcess> process;
+	std::unique_ptr<juce::StreamingSocket> connection;
+	juce::uint32 lastContactTime = 0;
+	juce::int64 nextJobId = 1;
+	int consecutiveFailures = 0;
+	int launchCount = 0;
+	double lastStartupMs = 0.0;
+	std::atomic<bool> disabled{ false };
+	std::atomic<bool> claimed{ false };
+
+	bool isRunningLocked() const;
+	bool startLocked();
+	void stopLocked();
+	bool authenticateLocked(const juce::String& token);
+	bool pingLocked();
+
+	bool writeFrame(const juce::var& header, const void* payload, size_t payloadSize);
+	bool readFrame(juce::var& header, juce::MemoryBlock& payload, int timeoutMs);
+	bool readExactly(void* dest, size_t numBytes, int timeoutMs);
+	bool waitForFrame(int timeoutMs);
+	bool writeExactly(const void* data, size_t numBytes);
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(LocalInferenceWorker)
+};
@@ -0,0 +1,161 @@
+#pragma once
+#include "JuceHeader.h"
+#include "AudioAnalyzer.h"
+#include "TransientIndex.h"
+#include <vector>
+
+struct LoopSuggestion
+{
+	double startSeconds = 0.0;
+	double endSeconds = 0.0;
+	int bars = 0;
+	float score = 0.0f;
+
+	bool isValid() const { return bars > 0 && endSeconds > startSeconds; }
+
+	bool matches(double loopStart, double loopEnd) const
+	{
+		return std::abs(loopStart - startSeconds) < 0.001 && std::abs(loopEnd - endSeconds) < 0.001;
+	}
+};
+
+// Proposes a 1/2/4/8-bar loop window for a freshly loaded buffer. Candidate
+// windows sit on the beat grid that best matches the onset envelope; they are
+// scored on a strong first beat, a strong beat right after the end (so the
+// wrap sounds like the next bar), and how much of the window is not silence.
+// The window edges are then moved to the nearest zero crossing.
+class LoopDetector
+{
+public:
+	static LoopSuggestion detect(const juce::AudioBuffer<float>& buffer,
+		int numSamples,
+		double sampleRate,
+		float bpm,
+		const TransientIndex* transientIndex)
+	{
+		LoopSuggestion result;
+		numSamples = juce::jmin(numSamples, buffer.getNumSamples());
+		if (bpm <= 0.0f || sampleRate <= 0.0 || numSamples <= 0 || buffer.getNumChannels() == 0)
+			return result;
+
+		double beatSamples = 60.0 / bpm * sampleRate;
+		if (numSamples < beatSamples * beatsPerBar)
+			return result;
+
+		auto strength = AudioAnalyzer::computeOnsetStrength(buffer, numSamples, sampleRate);
+		if (strength.envelope.empty())
+			return result;
+
+		double phase = findGridPhase(strength, beatSamples, numSamples);
+		std::vector<double> grid;
+		for (double position = phase; position <= numSamples + 1.0; position += beatSamples)
+			grid.push_back(position);
+
+		auto active = findActiveBeats(buffer, grid, numSamples);
+		int numBeats = (int)grid.size() - 1;
+
+		for (int bars : { 8, 4, 2, 1 })
+		{
+			int lengthBeats = bars * beatsPerBar;
+			for (int first = 0; first + lengthBeats <= numBeats; ++first)
+			{
+				if (!active[(size_t)first])
+					continue;
+
+				int activeCount = 0;
+				for (int b = first; b < first + lengthBeats; ++b)
+					activeCount += active[(size_t)b] ? 1 : 0;
+				float coverage = (float)activeCount / (float)lengthBeats;
+
+				double start = grid[(size_t)first];
+				double end = grid[(size_t)(first + lengthBeats)];
+				float startStrength = strength.at(start);
+				// A window ending at the end of the file wraps onto its own
+				// start, which is what the loop will sound like anyway.
+				float endStrength = end < numSamples - strength.hopSize ? strength.at(end) : startStrength;
+
+				float score = 0.35f * startStrength + 0.15f * endStrength + 0.35f * coverage + getLengthBonus(bars);
+				if (score > result.score)
+				{
+					result.score = score;
+					result.bars = bars;
+					result.startSeconds = start;
+					result.endSeconds = end;
+				}
+			}
+		}
+
+		if (result.bars == 0)
+			return result;
+
+		double start = result.startSeconds;
+		double end = result.endSeconds;
+		if (transientIndex)
+		{
+			start = transientIndex->snapToZeroCrossing(start);
+			end = transientIndex->snapToZeroCrossing(end);
+		}
+		result.startSeconds = juce::jlimit(0.0, (double)numSamples, start) / sampleRate;
+		result.endSeconds = juce::jlimit(0.0, (double)numSamples, end) / sampleRate;
+		return result;
+	}
+
+private:
+	static constexpr int beatsPerBar = 4;
+
+	static float getLengthBonus(int bars)
+	{
+		switch (bars)
+		{
+		case 8: return 0.2f;
+		case 4: return 0.18f;
+		case 2: return 0.1f;
+		default: return 0.0f;
+		}
+	}
+
+	// Offset of the first beat, in samples, that puts the most onset energy
+	// on the grid. Anything before it is treated as a pickup.
+	static double findGridPhase(const AudioAnalyzer::OnsetStrength& strength, double beatSamples, int numSamples)
+	{
+		double bestPhase = 0.0;
+		float bestSum = -1.0f;
+		for (double phase = 0.0; phase < beatSamples; phase += strength.hopSize)
+		{
+			float sum = 0.0f;
+			for (double position = phase; position < numSamples; position += beatSamples)
+				sum += strength.at(position);
+			if (sum > bestSum + 1.0e-4f)
+			{
+				bestSum = sum;
+				bestPhase = phase;
+			}
+		}
+		return bestPhase;
+	}
+
+	// A beat is active when its RMS is within 30 dB of the loudest beat.
+	static std::vector<bool> findActiveBeats(const juce::AudioBuffer<float>& buffer, const std::vector<double>& grid, int numSamples)
+	{
+		std::vector<float> rms;
+		float loudest = 0.0f;
+		for (size_t b = 0; b + 1 < grid.size(); ++b)
+		{
+			int start = (int)grid[b];
+			int count = juce::jmin((int)grid[b + 1], numSamples) - start;
+			float level = 0.0f;
+			if (count > 0)
+			{
+				for (int ch = 0; ch < juce::jmin(2, buffer.getNumChannels()); ++ch)
+					level = juce::jmax(level, buffer.getRMSLevel(ch, start, count));
+			}
+			rms.push_back(level);
+			loudest = juce::jmax(loudest, level);
+		}
+
+		std::vector<bool> active(rms.size());
+		for (size_t b = 0; b < rms.size(); ++b)
+			active[b] = loudest > 0.0f && rms[b] > loudest * 0.0316f;
+		return active;
+	}
+};
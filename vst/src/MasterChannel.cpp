@@ -357,6 +357,12 @@ void MasterChannel::drawMasterVUMeterStereo(juce::Graphics& g, juce::Rectangle<i
 		g.setFont(juce::FontOptions(8.0f, juce::Font::bold));
 		g.drawText("CLIP", clipRect, juce::Justification::centred);
 	}
+
+	auto lufsArea = juce::Rectangle<float>(startX - 40, vuAreaLeft.getBottom() + 1, totalWidth + 42, 9);
+	g.setColour(ColourPalette::textSecondary);
+	g.setFont(juce::FontOptions(8.0f));
+	g.drawText(momentaryLufs > OutputMeter::silenceLufs ? juce::String(momentaryLufs, 1) + " LUFS" : "-inf LUFS",
+		lufsArea, juce::Justification::centredRight);
 }
 
 void MasterChannel::fillMasterMeterSegment(juce::Graphics& g, juce::Rectangle<float>& vuArea,
@@ -450,8 +456,16 @@ inline float dbToNormalized(float db, float minDb = -60.0f, float maxDb = 0.0f)
 
 void MasterChannel::updateMasterLevels()
 {
-	float instantLevelLeft = realAudioLevelLeft;
-	float instantLevelRight = realAudioLevelRight;
+	auto reading = audioProcessor.readMasterMeter();
+	float instantLevelLeft = OutputMeter::toNormalized(reading.peak[0]);
+	float instantLevelRight = OutputMeter::toNormalized(reading.peak[1]);
+
+	float previousLeft = masterLevelLeft;
+	float previousRight = masterLevelRight;
+	float previousPeakLeft = masterPeakHoldLeft;
+	float previousPeakRight = masterPeakHoldRight;
+	float previousLufs = momentaryLufs;
+	momentaryLufs = reading.momentaryLufs;
 
 	if (instantLevelLeft > masterLevelLeft)
 	{
@@ -499,8 +513,13 @@ void MasterChannel::updateMasterLevels()
 		masterPeakHoldRight *= 0.98f;
 	}
 
-	juce::MessageManager::callAsync([this]()
-		{ repaint(); });
+	auto moved = [](float a, float b) { return std::abs(a - b) > 0.001f; };
+	if (moved(previousLeft, masterLevelLeft) || moved(previousRight, masterLevelRight)
+		|| moved(previousPeakLeft, masterPeakHoldLeft) || moved(previousPeakRight, masterPeakHoldRight)
+		|| moved(previousLufs, momentaryLufs))
+	{
+		repaint();
+	}
 }
 
 void MasterChannel::learn(juce::String param, juce::String description, MidiLearnableBase* component, std::function<void(float)> uiCallback)
@@ -524,13 +543,6 @@ void MasterChannel::removeMidiMapping(const juce::String& param)
 	audioProcessor.getMidiLearnManager().removeMappingForParameter(param);
 }
 
-void MasterChannel::setRealAudioLevelStereo(float levelLeft, float levelRight)
-{
-	realAudioLevelLeft = juce::jlimit(0.0f, 1.0f, levelLeft);
-	realAudioLevelRight = juce::jlimit(0.0f, 1.0f, levelRight);
-	hasRealAudio = true;
-}
-
 void MasterChannel::setupMidiLearn()
 {
 	masterVolumeSlider.onMidiLearn = [this]()
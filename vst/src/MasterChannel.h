@@ -8,7 +8,6 @@ class MasterChannel : public juce::Component, public juce::AudioProcessorParamet
 public:
 	MasterChannel(DjIaVstProcessor& processor);
 	~MasterChannel();
-	void setRealAudioLevelStereo(float levelLeft, float levelRight);
 	void updateMasterLevels();
 
 	std::function<void(float)> onMasterVolumeChanged;
@@ -24,8 +23,6 @@ private:
 
 	std::atomic<bool> isDestroyed{ false };
 
-	bool hasRealAudio = false;
-
 	juce::Label masterLabel;
 	juce::Label highLabel, midLabel, lowLabel, panLabel;
 
@@ -34,10 +31,8 @@ private:
 	float masterLevelLeft = 0.0f;
 	float masterLevelRight = 0.0f;
 	float masterPeakHoldLeft = 0.0f;
-	float realAudioLevelLeft = 0.0f;
-	float realAudioLevelRight = 0.0f;
 	float masterPeakHoldRight = 0.0f;
-	float realAudioLevel = 0.0f;
+	float momentaryLufs = OutputMeter::silenceLufs;
 
 	int masterPeakHoldTimerLeft = 0;
 	int masterPeakHoldTimerRight = 0;
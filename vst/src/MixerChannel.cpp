@@ -543,13 +543,8 @@ void MixerChannel::updateVUMeters()
 	if (isDestroyed.load())
 		return;
 
-	updateVUMeter();
-
-	juce::MessageManager::callAsync([this]()
-		{
-			if (!isDestroyed.load()) {
-				repaint();
-			} });
+	if (updateVUMeter())
+		repaint();
 }
 
 void MixerChannel::updateFromTrackData()
@@ -829,119 +824,45 @@ void MixerChannel::resized()
 	panKnob.setBounds(panArea.reduced(2));
 }
 
-void MixerChannel::updateVUMeter()
+bool MixerChannel::updateVUMeter()
 {
-	if (!track || !track->isPlaying.load())
-	{
-		currentAudioLevelLeft *= 0.88f;
-		currentAudioLevelRight *= 0.88f;
+	OutputMeter::Reading reading;
+	if (track && track->slotIndex >= 0)
+		reading = audioProcessor.readTrackMeter(track->slotIndex);
 
-		if (peakHoldTimerLeft > 0)
-		{
-			peakHoldTimerLeft--;
-			if (peakHoldTimerLeft == 0)
-				peakHoldLeft *= 0.9f;
-		}
+	float previousLeft = currentAudioLevelLeft;
+	float previousRight = currentAudioLevelRight;
+	float previousPeakLeft = peakHoldLeft;
+	float previousPeakRight = peakHoldRight;
 
-		if (peakHoldTimerRight > 0)
+	auto applyBallistics = [](float level, float& current, float& peak, int& peakTimer)
 		{
-			peakHoldTimerRight--;
-			if (peakHoldTimerRight == 0)
-				peakHoldRight *= 0.9f;
-		}
-		return;
-	}
-
-	auto levels = calculateInstantLevel();
-
-	if (levels.left > currentAudioLevelLeft)
-	{
-		currentAudioLevelLeft = levels.left;
-	}
-	else
-	{
-		currentAudioLevelLeft = currentAudioLevelLeft * 0.92f + levels.left * 0.08f;
-	}
-
-	if (currentAudioLevelLeft > peakHoldLeft)
-	{
-		peakHoldLeft = currentAudioLevelLeft;
-		peakHoldTimerLeft = 45;
-	}
-
-	if (levels.right > currentAudioLevelRight)
-	{
-		currentAudioLevelRight = levels.right;
-	}
-	else
-	{
-		currentAudioLevelRight = currentAudioLevelRight * 0.92f + levels.right * 0.08f;
-	}
-
-	if (currentAudioLevelRight > peakHoldRight)
-	{
-		peakHoldRight = currentAudioLevelRight;
-		peakHoldTimerRight = 45;
-	}
-}
-
-StereoLevel MixerChannel::calculateInstantLevel()
-{
-
-	if (!track || track->numSamples == 0)
-		return { 0.0f, 0.0f };
-
-	double readPos = track->readPosition.load();
-	int sampleIndex = (int)(readPos);
-
-	if (sampleIndex >= 0 && sampleIndex < track->numSamples)
-	{
-		int numChannels = track->audioBuffer.getNumChannels();
-		int windowSize = 8;
-		int endSample = std::min(sampleIndex + windowSize, track->numSamples);
-
-		float peakLeft = 0.0f;
-		float peakRight = 0.0f;
+			if (level > current)
+				current = level;
+			else
+				current = current * 0.92f + level * 0.08f;
 
-		for (int i = sampleIndex; i < endSample; ++i)
-		{
-			if (numChannels >= 1)
+			if (current > peak)
 			{
-				peakLeft = std::max(peakLeft, std::abs(track->audioBuffer.getSample(0, i)));
+				peak = current;
+				peakTimer = 45;
 			}
-
-			if (numChannels >= 2)
+			else if (peakTimer > 0)
 			{
-				peakRight = std::max(peakRight, std::abs(track->audioBuffer.getSample(1, i)));
+				peakTimer--;
 			}
 			else
 			{
-				peakRight = peakLeft;
+				peak *= 0.9f;
 			}
-		}
-
-		float volume = track->volume.load();
-		peakLeft *= volume;
-		peakRight *= volume;
-
-		auto linearToDb = [](float linear) -> float
-			{
-				if (linear <= 0.00001f)
-					return -100.0f;
-				return 20.0f * ::log10f(linear);
-			};
-
-		auto dbToNormalized = [](float db) -> float
-			{
-				return juce::jlimit(0.0f, 1.0f, (db + 60.0f) / 60.0f);
-			};
+		};
 
-		return {
-			dbToNormalized(linearToDb(peakLeft)),
-			dbToNormalized(linearToDb(peakRight)) };
-	}
+	applyBallistics(OutputMeter::toNormalized(reading.peak[0]), currentAudioLevelLeft, peakHoldLeft, peakHoldTimerLeft);
+	applyBallistics(OutputMeter::toNormalized(reading.peak[1]), currentAudioLevelRight, peakHoldRight, peakHoldTimerRight);
 
-	return { 0.0f, 0.0f };
+	auto moved = [](float a, float b) { return std::abs(a - b) > 0.001f; };
+	return moved(previousLeft, currentAudioLevelLeft) || moved(previousRight, currentAudioLevelRight)
+		|| moved(previousPeakLeft, peakHoldLeft) || moved(previousPeakRight, peakHoldRight);
 }
 
 void MixerChannel::setSelected(bool selected)
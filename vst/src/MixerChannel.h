@@ -3,12 +3,6 @@
 #include "PluginProcessor.h"
 #include "MidiLearnableComponents.h"
 
-struct StereoLevel
-{
-	float left;
-	float right;
-};
-
 class MixerChannel : public juce::Component, public juce::Timer, public juce::AudioProcessorParameter::Listener
 {
 public:
@@ -80,8 +74,7 @@ private:
 	void drawVUMeter(juce::Graphics& g, juce::Rectangle<int> bounds);
 	void fillMeters(juce::Rectangle<float>& vuArea, int i, float segmentHeight, int numSegments, float currentLevel, juce::Graphics& g);
 	void resized() override;
-	void updateVUMeter();
-	StereoLevel calculateInstantLevel();
+	bool updateVUMeter();
 	void setCurrentLevel(float level);
 	void timerCallback() override;
 	void setupMidiLearn();
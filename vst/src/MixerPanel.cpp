@@ -38,7 +38,6 @@ void MixerPanel::updateAllMixerComponents()
 	{
 		channel->updateVUMeters();
 	}
-	calculateMasterLevel();
 	masterChannel->updateMasterLevels();
 }
 
@@ -52,49 +51,6 @@ float MixerPanel::getMasterPan() const
 	return masterPan;
 }
 
-void MixerPanel::calculateMasterLevel()
-{
-	float maxPeakLeft = 0.0f;
-	float maxPeakRight = 0.0f;
-
-	for (auto &channel : mixerChannels)
-	{
-		float channelPeakLeft = channel->getCurrentAudioLevelLeft();
-		float channelPeakRight = channel->getCurrentAudioLevelRight();
-
-		maxPeakLeft = std::max(maxPeakLeft, channelPeakLeft);
-		maxPeakRight = std::max(maxPeakRight, channelPeakRight);
-	}
-
-	auto dbToLinear = [](float normalized) -> float
-	{
-		float db = -60.0f + normalized * 60.0f;
-		return ::powf(10.0f, db / 20.0f);
-	};
-
-	auto linearToDb = [](float linear) -> float
-	{
-		if (linear <= 0.00001f)
-			return -100.0f;
-		return 20.0f * ::log10f(linear);
-	};
-
-	auto dbToNormalized = [](float db) -> float
-	{
-		return juce::jlimit(0.0f, 1.0f, (db + 60.0f) / 60.0f);
-	};
-
-	float linearLeft = dbToLinear(maxPeakLeft);
-	float linearRight = dbToLinear(maxPeakRight);
-
-	linearLeft *= masterVolume;
-	linearRight *= masterVolume;
-
-	masterChannel->setRealAudioLevelStereo(
-		dbToNormalized(linearToDb(linearLeft)),
-		dbToNormalized(linearToDb(linearRight)));
-}
-
 void MixerPanel::refreshMixerChannels()
 {
 	for (auto &mixerChannel : mixerChannels)
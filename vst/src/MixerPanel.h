@@ -17,7 +17,6 @@ public:
 	float getMasterVolume() const;
 	float getMasterPan() const;
 
-	void calculateMasterLevel();
 	void refreshMixerChannels();
 	void refreshAllChannels();
 
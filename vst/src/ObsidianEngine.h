@@ -19,9 +19,8 @@ public:
 	{
 		bool success = false;
 		juce::String errorMessage;
-		std::vector<float> audioData;
-		std::vector<float> leftChannel;
-		std::vector<float> rightChannel;
+		juce::AudioBuffer<float> audio;
+		double sampleRate = 44100.0;
 		float actualDuration = 0.0f;
 		float bpm = 120.0f;
 		float duration = 0.0f;
@@ -60,8 +59,8 @@ public:
 		juce::Thread::launch([this, request, callback]()
 							 {
 				auto response = generateLoop(request);
-				juce::MessageManager::callAsync([callback, response]() {
-					callback(response);
+				juce::MessageManager::callAsync([callback, response = std::move(response)]() mutable {
+					callback(std::move(response));
 					}); });
 	}
 
@@ -77,7 +76,6 @@ private:
 			StableAudioEngine::GenerationParams audioParams;
 			audioParams.prompt = optimizedPrompt;
 			audioParams.duration = request.generationDuration;
-			audioParams.numThreads = 4;
 			audioParams.seed = -1;
 
 			auto audioResult = stableAudioEngine->generateSample(audioParams);
@@ -85,9 +83,8 @@ private:
 			if (audioResult.success)
 			{
 				response.success = true;
-				response.audioData = audioResult.audioData;
-				response.leftChannel = audioResult.leftChannel;
-				response.rightChannel = audioResult.rightChannel;
+				response.audio = std::move(audioResult.audio);
+				response.sampleRate = audioResult.sampleRate;
 				response.actualDuration = audioResult.actualDuration;
 				response.duration = audioResult.actualDuration;
 				response.bpm = request.bpm;
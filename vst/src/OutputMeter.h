@@ -0,0 +1,178 @@
+#pragma once
+#include "JuceHeader.h"
+#include "AudioAnalyzer.h"
+#include <array>
+#include <atomic>
+
+// Peak, RMS and momentary loudness of one stereo output. process() runs on
+// the audio thread on the buffer that is actually sent to the host; read()
+// is called by the mixer once per frame. Each value is its own relaxed
+// atomic, so a reader can pair the peak of one block with the RMS of the
+// next. That is harmless for a meter and keeps both sides wait-free.
+class OutputMeter
+{
+public:
+	static constexpr float silenceLufs = -70.0f;
+
+	struct Reading
+	{
+		// Linear. The peak is the highest sample since the previous read, so
+		// short transients between two frames still show up.
+		std::array<float, 2> peak{};
+		std::array<float, 2> rms{};
+		float momentaryLufs = silenceLufs;
+	};
+
+	void prepare(double newSampleRate, int maxBlockSize)
+	{
+		sampleRate = newSampleRate;
+		scratch.setSize(2, juce::jmax(1, maxBlockSize));
+		segmentLength = juce::jmax(1, (int)(sampleRate * segmentSeconds));
+		for (int ch = 0; ch < 2; ++ch)
+		{
+			shelf[(size_t)ch].setCoefficients(AudioAnalyzer::makeKWeightingShelf(sampleRate));
+			highPass[(size_t)ch].setCoefficients(AudioAnalyzer::makeKWeightingHighPass(sampleRate));
+		}
+		reset();
+	}
+
+	void reset()
+	{
+		for (int ch = 0; ch < 2; ++ch)
+		{
+			shelf[(size_t)ch].reset();
+			highPass[(size_t)ch].reset();
+			meanSquare[(size_t)ch] = 0.0f;
+			peak[(size_t)ch].store(0.0f, std::memory_order_relaxed);
+			rms[(size_t)ch].store(0.0f, std::memory_order_relaxed);
+		}
+		segments.fill(0.0);
+		segmentIndex = 0;
+		segmentEnergy = 0.0;
+		segmentSamples = 0;
+		momentaryLufs.store(silenceLufs, std::memory_order_relaxed);
+	}
+
+	void process(const juce::AudioBuffer<float>& buffer, int numSamples)
+	{
+		int numChannels = juce::jmin(2, buffer.getNumChannels());
+		numSamples = juce::jmin(numSamples, buffer.getNumSamples());
+		if (numChannels == 0 || numSamples <= 0 || segmentLength == 0)
+			return;
+
+		// Hosts may send bigger blocks than announced; measure in pieces
+		// rather than reallocating here.
+		int chunkSize = scratch.getNumSamples();
+		for (int start = 0; start < numSamples; start += chunkSize)
+			processChunk(buffer, numChannels, start, juce::jmin(chunkSize, numSamples - start));
+	}
+
+	Reading read()
+	{
+		Reading reading;
+		for (int ch = 0; ch < 2; ++ch)
+		{
+			reading.peak[(size_t)ch] = peak[(size_t)ch].exchange(0.0f, std::memory_order_relaxed);
+			reading.rms[(size_t)ch] = rms[(size_t)ch].load(std::memory_order_relaxed);
+		}
+		reading.momentaryLufs = momentaryLufs.load(std::memory_order_relaxed);
+		return reading;
+	}
+
+	static float toNormalized(float linear, float minDb = -60.0f)
+	{
+		return juce::jlimit(0.0f, 1.0f, (juce::Decibels::gainToDecibels(linear, minDb) - minDb) / -minDb);
+	}
+
+private:
+	// BS.1770 momentary loudness: mean K-weighted energy over 400 ms, made of
+	// four 100 ms segments so it updates ten times a second.
+	static constexpr double segmentSeconds = 0.1;
+	static constexpr int numSegments = 4;
+	static constexpr double rmsSeconds = 0.3;
+
+	double sampleRate = 44100.0;
+	juce::AudioBuffer<float> scratch;
+	std::array<juce::IIRFilter, 2> shelf;
+	std::array<juce::IIRFilter, 2> highPass;
+	std::array<float, 2> meanSquare{};
+
+	std::array<double, numSegments> segments{};
+	int segmentIndex = 0;
+	int segmentLength = 0;
+	int segmentSamples = 0;
+	double segmentEnergy = 0.0;
+
+	std::array<std::atomic<float>, 2> peak{};
+	std::array<std::atomic<float>, 2> rms{};
+	std::atomic<float> momentaryLufs{ silenceLufs };
+
+	void processChunk(const juce::AudioBuffer<float>& buffer, int numChannels, int start, int count)
+	{
+		float decay = (float)std::exp(-count / (rmsSeconds * sampleRate));
+		for (int ch = 0; ch < 2; ++ch)
+		{
+			const float* data = buffer.getReadPointer(juce::jmin(ch, numChannels - 1), start);
+			auto range = juce::FloatVectorOperations::findMinAndMax(data, count);
+			storeMax(peak[(size_t)ch], juce::jmax(std::abs(range.getStart()), std::abs(range.getEnd())));
+
+			float blockMeanSquare = sumOfSquares(data, count) / (float)count;
+			meanSquare[(size_t)ch] = meanSquare[(size_t)ch] * decay + blockMeanSquare * (1.0f - decay);
+			rms[(size_t)ch].store(std::sqrt(meanSquare[(size_t)ch]), std::memory_order_relaxed);
+
+			float* weighted = scratch.getWritePointer(ch);
+			juce::FloatVectorOperations::copy(weighted, data, count);
+			shelf[(size_t)ch].processSamples(weighted, count);
+			highPass[(size_t)ch].processSamples(weighted, count);
+		}
+
+		for (int offset = 0; offset < count;)
+		{
+			int length = juce::jmin(count - offset, segmentLength - segmentSamples);
+			for (int ch = 0; ch < numChannels; ++ch)
+				segmentEnergy += sumOfSquares(scratch.getReadPointer(ch, offset), length);
+			segmentSamples += length;
+			offset += length;
+
+			if (segmentSamples == segmentLength)
+			{
+				segments[(size_t)segmentIndex] = segmentEnergy / segmentLength;
+				segmentIndex = (segmentIndex + 1) % numSegments;
+				segmentEnergy = 0.0;
+				segmentSamples = 0;
+
+				double energy = 0.0;
+				for (double segment : segments)
+					energy += segment;
+				energy /= numSegments;
+				float lufs = energy > 0.0 ? (float)(-0.691 + 10.0 * std::log10(energy)) : silenceLufs;
+				momentaryLufs.store(juce::jmax(silenceLufs, lufs), std::memory_order_relaxed);
+			}
+		}
+	}
+
+	// Four independent accumulators so the loop vectorises.
+	static float sumOfSquares(const float* data, int count)
+	{
+		float sums[4] = {};
+		int i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			sums[0] += data[i] * data[i];
+			sums[1] += data[i + 1] * data[i + 1];
+			sums[2] += data[i + 2] * data[i + 2];
+			sums[3] += data[i + 3] * data[i + 3];
+		}
+		for (; i < count; ++i)
+			sums[0] += data[i] * data[i];
+		return sums[0] + sums[1] + sums[2] + sums[3];
+	}
+
+	static void storeMax(std::atomic<float>& target, float value)
+	{
+		float current = target.load(std::memory_order_relaxed);
+		while (value > current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed))
+		{
+		}
+	}
+};
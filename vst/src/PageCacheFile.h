@@ -0,0 +1,201 @@
+#pragma once
+#include "JuceHeader.h"
+#include "SampleAnalysis.h"
+
+// Cached page files stay plain WAV so they can still be dragged into a DAW
+// or imported anywhere, but carry an extra RIFF chunk with everything we
+// know about the audio: peak summary, analysis results and the generation
+// parameters. Other readers skip unknown chunks. The PCM data chunk stays
+// contiguous, so the file can still be memory-mapped. Reading the chunk only
+// walks the chunk headers, so waveforms and metadata are available without
+// decoding any audio.
+class PageCacheFile
+{
+public:
+	struct Contents
+	{
+		SampleAnalysis::Ptr analysis;
+		juce::var generation;
+		PeakSummary peaks;
+	};
+
+	static bool read(const juce::File& file, Contents& contents, bool includePeaks = true)
+	{
+		juce::FileInputStream stream(file);
+		ChunkLocation location;
+		if (!stream.openedOk() || !findChunk(stream, location) || location.payloadPosition < 0)
+			return false;
+
+		stream.setPosition(location.payloadPosition);
+		if (stream.readInt() != formatVersion)
+			return false;
+
+		int jsonLength = stream.readInt();
+		if (jsonLength < 0 || jsonLength > location.payloadSize)
+			return false;
+
+		juce::MemoryBlock json;
+		if (stream.readIntoMemoryBlock(json, jsonLength) != (size_t)jsonLength)
+			return false;
+
+		auto data = juce::JSON::parse(json.toString());
+		contents = {};
+		contents.analysis = SampleAnalysis::fromVar(data.getProperty("analysis", {}));
+		contents.generation = data.getProperty("generation", {});
+
+		if (includePeaks && !PeakSummary::readFromStream(stream, contents.peaks))
+			contents.peaks = {};
+		return true;
+	}
+
+	static bool readPeaks(const juce::File& file, PeakSummary& peaks)
+	{
+		Contents contents;
+		if (!read(file, contents) || contents.peaks.levels.empty())
+			return false;
+		peaks = std::move(contents.peaks);
+		return true;
+	}
+
+	static SampleAnalysis::Ptr readAnalysis(const juce::File& file)
+	{
+		Contents contents;
+		return read(file, contents, false) ? contents.analysis : nullptr;
+	}
+
+	// Held by anything that rewrites a cached page file, so a metadata
+	// update never copies a WAV that is still being written and two updates
+	// never overwrite each other.
+	static juce::CriticalSection& getFileLock()
+	{
+		static juce::CriticalSection lock;
+		return lock;
+	}
+
+	// Replaces the chunk if the file already has one. Only touches files that
+	// are RIFF/WAVE, anything else is left alone. The new file is written
+	// next to the old one and moved over it, so neither a crash nor a reader
+	// ever sees it half-written.
+	static bool write(const juce::File& file, const Contents& contents)
+	{
+		const juce::ScopedLock fileScope(getFileLock());
+		auto source = std::make_unique<juce::FileInputStream>(file);
+		ChunkLocation location;
+		if (!source->openedOk() || !findChunk(*source, location))
+			return false;
+
+		juce::MemoryOutputStream payload;
+		payload.writeInt(formatVersion);
+
+		auto* object = new juce::DynamicObject();
+		if (contents.analysis)
+			object->setProperty("analysis", contents.analysis->toVar());
+		object->setProperty("generation", contents.generation);
+		auto json = juce::JSON::toString(juce::var(object), true).toUTF8();
+		auto jsonLength = (int)json.sizeInBytes() - 1;
+		payload.writeInt(jsonLength);
+		payload.write(json.getAddress(), (size_t)jsonLength);
+
+		if (!contents.peaks.levels.empty())
+			contents.peaks.writeToStream(payload);
+
+		juce::TemporaryFile temp(file);
+		{
+			juce::FileOutputStream stream(temp.getFile());
+			if (!stream.openedOk())
+				return false;
+
+			// An old chunk at the end is dropped; one with something after it
+			// is blanked out rather than moving the chunks that follow it.
+			bool dropOldChunk = location.headerPosition >= 0 && location.isLastChunk;
+			auto keptLength = dropOldChunk ? location.headerPosition : source->getTotalLength();
+			source->setPosition(0);
+			if (stream.writeFromInputStream(*source, keptLength) != keptLength)
+				return false;
+			source.reset();
+
+			if (location.headerPosition >= 0 && !dropOldChunk)
+			{
+				stream.setPosition(location.headerPosition);
+				stream.write("JUNK", 4);
+				stream.setPosition(keptLength);
+			}
+
+			auto size = (juce::uint32)payload.getDataSize();
+			stream.write(chunkId, 4);
+			stream.writeInt((int)size);
+			stream.write(payload.getData(), payload.getDataSize());
+			if ((size & 1) != 0)
+				stream.writeByte(0);
+
+			auto riffSize = stream.getPosition() - 8;
+			stream.setPosition(4);
+			stream.writeInt((int)(juce::uint32)riffSize);
+			stream.flush();
+			if (stream.getStatus().failed())
+				return false;
+		}
+
+		return temp.overwriteTargetFileWithTemporary();
+	}
+
+	// Adds analysis that finished after the file was written, keeping the
+	// peaks and generation parameters that are already there. Skipped when
+	// the analysis was made from a different length of audio, e.g. the
+	// unstretched original.
+	static bool updateAnalysis(const juce::File& file, const SampleAnalysis::Ptr& analysis)
+	{
+		const juce::ScopedLock fileScope(getFileLock());
+		Contents contents;
+		if (!analysis || !read(file, contents) || contents.peaks.numSamples != analysis->numSamples)
+			return false;
+		contents.analysis = analysis;
+		return write(file, contents);
+	}
+
+private:
+	static constexpr const char* chunkId = "obsn";
+	static constexpr int formatVersion = 1;
+
+	struct ChunkLocation
+	{
+		juce::int64 headerPosition = -1;
+		juce::int64 payloadPosition = -1;
+		juce::int64 payloadSize = 0;
+		bool isLastChunk = false;
+	};
+
+	// Returns false if the stream is not a RIFF/WAVE file. Otherwise fills in
+	// where our chunk is, leaving the positions at -1 if there is none.
+	static bool findChunk(juce::InputStream& stream, ChunkLocation& location)
+	{
+		char riff[4] = {}, wave[4] = {};
+		if (stream.read(riff, 4) != 4 || std::memcmp(riff, "RIFF", 4) != 0)
+			return false;
+		stream.readInt();
+		if (stream.read(wave, 4) != 4 || std::memcmp(wave, "WAVE", 4) != 0)
+			return false;
+
+		auto length = stream.getTotalLength();
+		juce::int64 position = 12;
+		while (position + 8 <= length)
+		{
+			stream.setPosition(position);
+			char id[4] = {};
+			if (stream.read(id, 4) != 4)
+				break;
+			auto size = (juce::int64)(juce::uint32)stream.readInt();
+			auto next = position + 8 + size + (size & 1);
+
+			if (std::memcmp(id, chunkId, 4) == 0)
+			{
+				location.headerPosition = position;
+				location.payloadPosition = position + 8;
+				location.payloadSize = size;
+				location.isLastChunk = next >= length;
+			}
+			position = next;
+		}
+		return true;
+	}
+};
@@ -0,0 +1,147 @@
+#pragma once
+#include "JuceHeader.h"
+#include <memory>
+#include <vector>
+
+// Mip-mapped min/max/RMS summary of a track buffer for the waveform view.
+// Built once per buffer next to the transient index, off the message and
+// audio threads, and shared with the display by pointer. Each level halves
+// the resolution of the one below it, so any view can be drawn by reading
+// a couple of buckets per pixel from the level that matches the zoom.
+class PeakPyramid
+{
+public:
+	using Ptr = std::shared_ptr<const PeakPyramid>;
+
+	struct Bucket
+	{
+		float min = 0.0f;
+		float max = 0.0f;
+		float meanSquare = 0.0f;
+	};
+
+	struct Range
+	{
+		float min = 0.0f;
+		float max = 0.0f;
+		float rms = 0.0f;
+
+		float getPeak() const { return juce::jmax(std::abs(min), std::abs(max)); }
+	};
+
+	static constexpr int baseSamplesPerBucket = 32;
+
+	static Ptr build(const juce::AudioBuffer<float>& buffer, int numSamples)
+	{
+		numSamples = juce::jmin(numSamples, buffer.getNumSamples());
+		if (numSamples <= 0 || buffer.getNumChannels() == 0)
+			return nullptr;
+
+		auto pyramid = std::make_shared<PeakPyramid>();
+		pyramid->numSamples = numSamples;
+		pyramid->numChannels = juce::jmin(2, buffer.getNumChannels());
+
+		Level base;
+		base.samplesPerBucket = baseSamplesPerBucket;
+		base.numBuckets = (numSamples + baseSamplesPerBucket - 1) / baseSamplesPerBucket;
+		base.buckets.resize((size_t)base.numBuckets * pyramid->numChannels);
+
+		for (int ch = 0; ch < pyramid->numChannels; ++ch)
+		{
+			const float* data = buffer.getReadPointer(ch);
+			for (int b = 0; b < base.numBuckets; ++b)
+			{
+				int start = b * baseSamplesPerBucket;
+				int count = juce::jmin(baseSamplesPerBucket, numSamples - start);
+				auto range = juce::FloatVectorOperations::findMinAndMax(data + start, count);
+
+				float sumSquares = 0.0f;
+				for (int i = start; i < start + count; ++i)
+					sumSquares += data[i] * data[i];
+
+				auto& bucket = base.buckets[(size_t)b * pyramid->numChannels + ch];
+				bucket.min = range.getStart();
+				bucket.max = range.getEnd();
+				bucket.meanSquare = sumSquares / (float)count;
+			}
+		}
+		pyramid->levels.push_back(std::move(base));
+
+		while (pyramid->levels.back().numBuckets > 1)
+		{
+			const auto& below = pyramid->levels.back();
+			Level level;
+			level.samplesPerBucket = below.samplesPerBucket * 2;
+			level.numBuckets = (below.numBuckets + 1) / 2;
+			level.buckets.resize((size_t)level.numBuckets * pyramid->numChannels);
+
+			for (int b = 0; b < level.numBuckets; ++b)
+			{
+				int first = b * 2;
+				int last = juce::jmin(first + 1, below.numBuckets - 1);
+				for (int ch = 0; ch < pyramid->numChannels; ++ch)
+				{
+					const auto& a = below.buckets[(size_t)first * pyramid->numChannels + ch];
+					const auto& c = below.buckets[(size_t)last * pyramid->numChannels + ch];
+					auto& bucket = level.buckets[(size_t)b * pyramid->numChannels + ch];
+					bucket.min = juce::jmin(a.min, c.min);
+					bucket.max = juce::jmax(a.max, c.max);
+					bucket.meanSquare = (a.meanSquare + c.meanSquare) * 0.5f;
+				}
+			}
+			pyramid->levels.push_back(std::move(level));
+		}
+		return pyramid;
+	}
+
+	// Summary of [startSample, endSample) on one channel, read from the
+	// coarsest level whose buckets are no wider than the requested span.
+	// Mono buffers answer for channel 1 with channel 0.
+	Range getRange(int channel, int startSample, int endSample) const
+	{
+		Range result;
+		startSample = juce::jlimit(0, numSamples - 1, startSample);
+		endSample = juce::jlimit(startSample + 1, numSamples, endSample);
+		channel = juce::jmin(channel, numChannels - 1);
+
+		const auto& level = getLevelFor(endSample - startSample);
+		int first = startSample / level.samplesPerBucket;
+		int last = juce::jmin(level.numBuckets, (endSample + level.samplesPerBucket - 1) / level.samplesPerBucket);
+
+		float meanSquareSum = 0.0f;
+		for (int b = first; b < last; ++b)
+		{
+			const auto& bucket = level.buckets[(size_t)b * numChannels + channel];
+			result.min = b == first ? bucket.min : juce::jmin(result.min, bucket.min);
+			result.max = b == first ? bucket.max : juce::jmax(result.max, bucket.max);
+			meanSquareSum += bucket.meanSquare;
+		}
+		if (last > first)
+			result.rms = std::sqrt(meanSquareSum / (float)(last - first));
+		return result;
+	}
+
+	int getNumSamples() const { return numSamples; }
+	int getNumChannels() const { return numChannels; }
+
+private:
+	struct Level
+	{
+		int samplesPerBucket = 0;
+		int numBuckets = 0;
+		// Interleaved by channel within each bucket.
+		std::vector<Bucket> buckets;
+	};
+
+	int numSamples = 0;
+	int numChannels = 0;
+	std::vector<Level> levels;
+
+	const Level& getLevelFor(int spanSamples) const
+	{
+		size_t index = 0;
+		while (index + 1 < levels.size() && levels[index + 1].samplesPerBucket <= spanSamples)
+			++index;
+		return levels[index];
+	}
+};
@@ -56,7 +56,7 @@ DjIaVstEditor::DjIaVstEditor(DjIaVstProcessor& p)
 
 DjIaVstEditor::~DjIaVstEditor()
 {
-	audioProcessor.onUIUpdateNeeded = nullptr;
+	displayRefresh.reset();
 	audioProcessor.setGenerationListener(nullptr);
 	audioProcessor.getMidiLearnManager().registerUICallback("promptPresetSelector", nullptr);
 	setLookAndFeel(nullptr);
@@ -115,8 +115,35 @@ void DjIaVstEditor::updateMidiIndicator(const juce::String& noteInfo)
 			} });
 }
 
-void DjIaVstEditor::updateUIComponents()
+// Runs once per display frame while the editor is on screen. The processor
+// only sets dirty bits, so frames with nothing new cost two atomic swaps and
+// the meter poll.
+void DjIaVstEditor::onDisplayRefresh()
 {
+	// Meters read a few atomics and only repaint when a level moved. They run
+	// every frame, dirty or not, so they decay to zero and the LUFS readout
+	// settles after playback stops.
+	if (mixerPanel)
+	{
+		mixerPanel->updateAllMixerComponents();
+	}
+
+	auto dirtyFlags = audioProcessor.consumeUIDirtyFlags();
+	auto dirtySequencerSlots = audioProcessor.consumeDirtySequencerSlots();
+	auto loadedSampleSlots = audioProcessor.consumeLoadedSampleSlots();
+	if (loadedSampleSlots != 0)
+		onSamplesSwapped(loadedSampleSlots);
+	if (dirtyFlags == 0 && dirtySequencerSlots == 0)
+		return;
+
+	updateUIComponents(dirtyFlags, dirtySequencerSlots);
+}
+
+void DjIaVstEditor::updateUIComponents(juce::uint32 dirtyFlags, juce::uint32 dirtySequencerSlots)
+{
+	const bool tracksChanged = (dirtyFlags & DjIaVstProcessor::uiDirtyTracks) != 0;
+	const bool playbackMoved = (dirtyFlags & DjIaVstProcessor::uiDirtyPlayback) != 0;
+
 	if (!isGenerating.load() && audioProcessor.getIsGenerating())
 	{
 		isGenerating.store(true);
@@ -126,20 +153,25 @@ void DjIaVstEditor::updateUIComponents()
 	}
 	for (auto& trackComp : trackComponents)
 	{
-		if (trackComp->isShowing())
+		if (!trackComp->isShowing())
+			continue;
+
+		TrackData* track = audioProcessor.getTrack(trackComp->getTrackId());
+		if (!track)
+			continue;
+
+		if (tracksChanged && !trackComp->isEditingLabel)
 		{
-			TrackData* track = audioProcessor.getTrack(trackComp->getTrackId());
-			if (track && !trackComp->isEditingLabel)
-			{
-				trackComp->updateFromTrackData();
-			}
+			trackComp->updateFromTrackData();
 		}
-	}
-	if (mixerPanel)
-	{
-		mixerPanel->updateAllMixerComponents();
-	}
 
+		bool sequencerChanged = track->slotIndex >= 0 && track->slotIndex < 32
+			&& (dirtySequencerSlots & (1u << track->slotIndex)) != 0;
+		if (auto* sequencer = trackComp->getSequencer(); sequencer && (tracksChanged || sequencerChanged))
+		{
+			sequencer->updateFromTrackData();
+		}
+	}
 	if (!lastMidiNote.isEmpty())
 	{
 		static int midiBlinkCounter = 0;
@@ -156,15 +188,18 @@ void DjIaVstEditor::updateUIComponents()
 		updateLoadButtonState();
 	}
 
-	for (auto& trackComp : trackComponents)
+	if (playbackMoved)
 	{
-		TrackData* track = audioProcessor.getTrack(trackComp->getTrackId());
-		if (track && track->isPlaying.load() && track->numSamples > 0)
+		for (auto& trackComp : trackComponents)
 		{
-			double startSample = track->loopStart * track->sampleRate;
-			double currentTimeInSection = (startSample + track->readPosition.load()) / track->sampleRate;
+			TrackData* track = audioProcessor.getTrack(trackComp->getTrackId());
+			if (track && track->isPlaying.load() && track->numSamples > 0)
+			{
+				double startSample = track->loopStart * track->sampleRate;
+				double currentTimeInSection = (startSample + track->readPosition.load()) / track->sampleRate;
 
-			trackComp->updatePlaybackPosition(currentTimeInSection);
+				trackComp->updatePlaybackPosition(currentTimeInSection);
+			}
 		}
 	}
 
@@ -183,11 +218,13 @@ void DjIaVstEditor::updateUIComponents()
 void DjIaVstEditor::onGenerationComplete(const juce::String& trackId, const juce::String& message)
 {
 	bool isError = message.startsWith("ERROR:");
-	stopGenerationUI(trackId, !isError, isError ? message : "");
+	bool isCancelled = message.startsWith("CANCELLED:");
+	stopGenerationUI(trackId, !isError && !isCancelled, isError ? message : "");
 
 	if (isShowing())
 	{
-		statusLabel.setText(message, juce::dontSendNotification);
+		statusLabel.setText(isCancelled ? message.fromFirstOccurrenceOf(":", false, false).trim() : message,
+			juce::dontSendNotification);
 
 		if (isError)
 		{
@@ -217,6 +254,26 @@ void DjIaVstEditor::onGenerationComplete(const juce::String& trackId, const juce
 	refreshCredits();
 }
 
+void DjIaVstEditor::onGenerationProgress(const juce::String& trackId, const juce::String& stage, float percent)
+{
+	if (!audioProcessor.getIsGenerating() || audioProcessor.getGeneratingTrackId() != trackId)
+		return;
+
+	for (auto& trackComp : trackComponents)
+	{
+		if (trackComp->getTrackId() == trackId)
+		{
+			trackComp->setGenerationProgress(stage, percent);
+			break;
+		}
+	}
+
+	juce::String text = stage + "...";
+	if (percent >= 0.0f)
+		text = stage + " " + juce::String(juce::roundToInt(percent)) + "%";
+	statusLabel.setText(text, juce::dontSendNotification);
+}
+
 void DjIaVstEditor::refreshTracks()
 {
 	trackComponents.clear();
@@ -251,11 +308,8 @@ void DjIaVstEditor::initUI()
 			} });
 			loadPromptPresets();
 			refreshTracks();
-			audioProcessor.onUIUpdateNeeded = [this]()
-				{
-					juce::MessageManager::callAsync([this]()
-						{ updateUIComponents(); });
-				};
+			displayRefresh = std::make_unique<juce::VBlankAttachment>(this, [this]()
+				{ onDisplayRefresh(); });
 }
 
 void DjIaVstEditor::showFirstTimeSetup()
@@ -381,6 +435,50 @@ void DjIaVstEditor::showConfigDialog()
 		timeoutCombo->setSelectedItemIndex(selectedIndex);
 	}
 
+	juce::StringArray cacheSizes = { "Disabled", "256 MB", "1 GB", "4 GB" };
+	juce::Array<int> cacheSizesMB = { 0, 256, 1024, 4096 };
+	alertWindow->addComboBox("generationCache", cacheSizes, "Seeded Result Cache:");
+	if (auto* cacheCombo = alertWindow->getComboBoxComponent("generationCache"))
+	{
+		int selectedIndex = 0;
+		if (audioProcessor.getGenerationCacheEnabled())
+		{
+			selectedIndex = 2;
+			for (int i = 1; i < cacheSizesMB.size(); ++i)
+			{
+				if (cacheSizesMB[i] == audioProcessor.getGenerationCacheMaxMB())
+				{
+					selectedIndex = i;
+					break;
+				}
+			}
+		}
+		cacheCombo->setSelectedItemIndex(selectedIndex);
+	}
+
+	if (auto* cache = audioProcessor.getGenerationCache())
+	{
+		auto stats = cache->getStats();
+		alertWindow->addTextBlock("Cache: " + juce::String(stats.numEntries) + " loops, "
+			+ juce::File::descriptionOfSizeInBytes(stats.totalBytes) + " - "
+			+ juce::String(stats.hits) + " hits / " + juce::String(stats.misses) + " misses");
+	}
+
+	juce::StringArray speculativeOptions = { "Off", "1 per track", "2 per track", "3 per track" };
+	alertWindow->addComboBox("speculativeVariations", speculativeOptions, "Pre-generate Variations:");
+	if (auto* speculativeCombo = alertWindow->getComboBoxComponent("speculativeVariations"))
+	{
+		speculativeCombo->setSelectedItemIndex(audioProcessor.getSpeculativeVariations());
+	}
+
+	if (audioProcessor.getSpeculativeVariations() > 0)
+	{
+		auto speculativeStats = audioProcessor.getSpeculativeStats();
+		alertWindow->addTextBlock("Variations: " + juce::String(speculativeStats.generated) + " generated, "
+			+ juce::String(speculativeStats.served) + " served, "
+			+ juce::String(speculativeStats.cancelled) + " cancelled");
+	}
+
 	alertWindow->addButton("Update", 1);
 	alertWindow->addButton("Cancel", 0);
 
@@ -414,6 +512,19 @@ void DjIaVstEditor::showConfigDialog()
 					int selectedTimeoutMs = timeoutMinutes[timeoutCombo->getSelectedItemIndex()] * 60 * 1000;
 					audioProcessor.setRequestTimeout(selectedTimeoutMs);
 
+					if (auto* cacheCombo = windowPtr->getComboBoxComponent("generationCache")) {
+						juce::Array<int> cacheSizesMB = { 0, 256, 1024, 4096 };
+						int cacheIndex = cacheCombo->getSelectedItemIndex();
+						audioProcessor.setGenerationCacheEnabled(cacheIndex > 0);
+						if (cacheIndex > 0) {
+							audioProcessor.setGenerationCacheMaxMB(cacheSizesMB[cacheIndex]);
+						}
+					}
+
+					if (auto* speculativeCombo = windowPtr->getComboBoxComponent("speculativeVariations")) {
+						audioProcessor.setSpeculativeVariations(speculativeCombo->getSelectedItemIndex());
+					}
+
 					audioProcessor.saveGlobalConfig();
 
 					if (modeChanged) {
@@ -1456,6 +1567,21 @@ void DjIaVstEditor::stopGenerationUI(const juce::String& trackId, bool success,
 	}
 }
 
+void DjIaVstEditor::onSamplesSwapped(juce::uint32 slotMask)
+{
+	for (auto& trackComp : trackComponents)
+	{
+		TrackData* track = audioProcessor.getTrack(trackComp->getTrackId());
+		if (!track || track->slotIndex < 0 || track->slotIndex >= 32
+			|| (slotMask & (1u << track->slotIndex)) == 0)
+			continue;
+
+		if (trackComp->isWaveformVisible())
+			trackComp->refreshWaveformDisplay();
+		onSampleLoaded(trackComp->getTrackId());
+	}
+}
+
 void DjIaVstEditor::onSampleLoaded(const juce::String& trackId)
 {
 	for (auto& trackComp : trackComponents)
@@ -1885,7 +2011,7 @@ void DjIaVstEditor::refreshTrackComponents()
 						}
 					};
 
-				trackComp->onGenerateWithImage = [this](const juce::String& trackId, const juce::String& image, const juce::StringArray& keywords)
+				trackComp->onGenerateWithImage = [this](const juce::String& trackId, const CanvasImage::Ptr& image, const juce::StringArray& keywords)
 					{
 						audioProcessor.generateSampleWithImage(trackId, image, keywords);
 					};
@@ -1904,6 +2030,12 @@ void DjIaVstEditor::refreshTrackComponents()
 						generateFromTrackComponent(id);
 					};
 
+				trackComp->onCancelGeneration = [this](const juce::String& /*id*/)
+					{
+						statusLabel.setText("Cancelling generation...", juce::dontSendNotification);
+						audioProcessor.cancelGeneration();
+					};
+
 				trackComp->onReorderTrack = [this](const juce::String& fromId, const juce::String& toId)
 					{
 						audioProcessor.reorderTracks(fromId, toId);
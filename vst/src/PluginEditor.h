@@ -41,6 +41,7 @@ public:
 	void updateUIFromProcessor();
 	void refreshTracks();
 	void onGenerationComplete(const juce::String& trackId, const juce::String& message) override;
+	void onGenerationProgress(const juce::String& trackId, const juce::String& stage, float percent) override;
 	void refreshMixerChannels();
 	void initUI();
 	void refreshWavevormsAndSequencers();
@@ -65,6 +66,7 @@ private:
 	juce::Image bannerImage;
 	juce::Rectangle<int> bannerArea;
 	std::unique_ptr<juce::TooltipWindow> tooltipWindow;
+	std::unique_ptr<juce::VBlankAttachment> displayRefresh;
 	std::unique_ptr<SampleBankPanel> sampleBankPanel;
 	juce::TextButton showSampleBankButton;
 	bool sampleBankVisible = false;
@@ -89,7 +91,9 @@ private:
 	void updateLoadButtonState();
 	void updateMidiIndicator(const juce::String& noteInfo);
 	void onAddTrack();
-	void updateUIComponents();
+	void onDisplayRefresh();
+	void onSamplesSwapped(juce::uint32 slotMask);
+	void updateUIComponents(juce::uint32 dirtyFlags, juce::uint32 dirtySequencerSlots);
 	void setAllGenerateButtonsEnabled(bool enabled);
 	void showFirstTimeSetup();
 	void showConfigDialog();
@@ -5,6 +5,40 @@
 #include "MidiMapping.h"
 #include "SequencerComponent.h"
 
+// Polls for the audio thread's go-ahead while a sample is pending and runs
+// the load itself; idle otherwise.
+class DjIaVstProcessor::PendingLoadWorker : public juce::Thread
+{
+public:
+	explicit PendingLoadWorker(DjIaVstProcessor& ownerToUse)
+		: juce::Thread("Pending Sample Loader"), owner(ownerToUse)
+	{
+	}
+
+	~PendingLoadWorker() override
+	{
+		stopThread(5000);
+	}
+
+	void run() override
+	{
+		while (!threadShouldExit())
+		{
+			wait(owner.hasPendingAudioData.load() ? pollIntervalMs : idleIntervalMs);
+			if (threadShouldExit())
+				break;
+			if (owner.loadRequested.load())
+				owner.dispatchPendingLoad();
+		}
+	}
+
+private:
+	static constexpr int pollIntervalMs = 5;
+	static constexpr int idleIntervalMs = 1000;
+
+	DjIaVstProcessor& owner;
+};
+
 juce::AudioProcessor::BusesProperties DjIaVstProcessor::createBusLayout()
 {
 	auto layout = juce::AudioProcessor::BusesProperties();
@@ -98,10 +132,14 @@ DjIaVstProcessor::DjIaVstProcessor()
 	{
 		DBG("OBSIDIAN Engine ready!");
 	}
-	sampleBankInitFuture = std::async(std::launch::async, [this]()
-		{
-			sampleBank = std::make_unique<SampleBank>();
-			sampleBankReady = true; });
+	sampleBank = SampleBank::getShared();
+	sampleBank->addListener(this);
+	// Created here rather than on a background thread: generation threads
+	// read the pointer without a lock, so it must be set before any can start.
+	generationCache = GenerationCache::getShared(sampleBank->getGenerationCacheDirectory(),
+		static_cast<juce::int64>(generationCacheMaxMB) * 1024 * 1024);
+	generationCache->setEnabled(generationCacheEnabled);
+	sampleBankReady = true;
 	loadParameters();
 	initTracks();
 	initDummySynth();
@@ -109,13 +147,55 @@ DjIaVstProcessor::DjIaVstProcessor()
 		{
 			handleSampleParams(slot, track);
 		};
-	startTimerHz(30);
+	initSpeculativeGenerator();
+	pendingLoadWorker = std::make_unique<PendingLoadWorker>(*this);
+	pendingLoadWorker->startThread();
 	autoLoadEnabled.store(true);
 	stateLoaded = true;
 	juce::Timer::callAfterDelay(1000, [this]()
 		{ performMigrationIfNeeded(); });
 }
 
+void DjIaVstProcessor::attachSampleAnalysis(const juce::String& sampleId, const SampleAnalysis::Ptr& analysis)
+{
+	juce::Array<juce::File> cacheFiles;
+	for (const auto& trackId : trackManager.getAllTrackIds())
+	{
+		TrackData* track = trackManager.getTrack(trackId);
+		if (!track)
+			continue;
+
+		if (track->usePages.load())
+		{
+			for (auto& page : track->pages)
+			{
+				if (page.sampleId == sampleId)
+				{
+					PlaybackAudio::attachAnalysis(page.playback, analysis);
+					if (page.audioFilePath.isNotEmpty())
+						cacheFiles.add(juce::File(page.audioFilePath));
+				}
+			}
+		}
+		else if (track->currentSampleId == sampleId)
+		{
+			PlaybackAudio::attachAnalysis(track->playback, analysis);
+			if (track->audioFilePath.isNotEmpty())
+				cacheFiles.add(juce::File(track->audioFilePath));
+		}
+	}
+
+	if (cacheFiles.isEmpty())
+		return;
+
+	DBG("Attached analysis for sample " + sampleId);
+	cacheFileWriter.addJob([cacheFiles, analysis]()
+		{
+			for (const auto& file : cacheFiles)
+				PageCacheFile::updateAnalysis(file, analysis);
+		});
+}
+
 void DjIaVstProcessor::performMigrationIfNeeded()
 {
 	if (migrationCompleted)
@@ -208,6 +288,13 @@ void DjIaVstProcessor::loadGlobalConfig()
 				useLocalModel = false;
 			}
 
+			generationCacheEnabled = object->getProperty("generationCacheEnabled").toString() == "true";
+			if (object->hasProperty("generationCacheMaxMB"))
+			{
+				generationCacheMaxMB = juce::jmax(64, object->getProperty("generationCacheMaxMB").toString().getIntValue());
+			}
+			speculativeVariations = juce::jlimit(0, 3, object->getProperty("speculativeVariations").toString().getIntValue());
+
 			auto promptsVar = object->getProperty("customPrompts");
 			DBG("Prompts property exists: " + juce::String(!promptsVar.isVoid() ? "false" : "true"));
 			DBG("Prompts is array: " + juce::String(promptsVar.isArray() ? "false" : "true"));
@@ -256,6 +343,9 @@ void DjIaVstProcessor::saveGlobalConfig()
 	config->setProperty("requestTimeoutMS", requestTimeoutMS);
 	config->setProperty("useLocalModel", useLocalModel ? "true" : "false");
 	config->setProperty("localModelsPath", localModelsPath);
+	config->setProperty("generationCacheEnabled", generationCacheEnabled ? "true" : "false");
+	config->setProperty("generationCacheMaxMB", generationCacheMaxMB);
+	config->setProperty("speculativeVariations", speculativeVariations);
 
 	juce::Array<juce::var> promptsArray;
 	for (const auto& prompt : customPrompts)
@@ -401,7 +491,6 @@ void DjIaVstProcessor::loadParameters()
 
 DjIaVstProcessor::~DjIaVstProcessor()
 {
-	stopTimer();
 	try
 	{
 		cleanProcessor();
@@ -414,6 +503,12 @@ DjIaVstProcessor::~DjIaVstProcessor()
 
 void DjIaVstProcessor::cleanProcessor()
 {
+	if (sampleBank)
+		sampleBank->removeListener(this);
+	pendingLoadWorker.reset();
+	cancelGeneration();
+	speculativeGenerator.stop();
+	variationPool.clear();
 	parameters.removeParameterListener("generate", this);
 	parameters.removeParameterListener("play", this);
 	parameters.removeParameterListener("nextTrack", this);
@@ -439,17 +534,10 @@ void DjIaVstProcessor::cleanProcessor()
 	synth.clearVoices();
 	synth.clearSounds();
 	obsidianEngine.reset();
-}
-
-void DjIaVstProcessor::timerCallback()
-{
-	if (!needsUIUpdate.load())
-		return;
-	if (onUIUpdateNeeded)
 	{
-		onUIUpdateNeeded();
+		const juce::ScopedLock lock(localEngineLock);
+		localAudioEngine.reset();
 	}
-	needsUIUpdate = false;
 }
 
 void DjIaVstProcessor::prepareToPlay(double newSampleRate, int samplesPerBlock)
@@ -463,6 +551,10 @@ void DjIaVstProcessor::prepareToPlay(double newSampleRate, int samplesPerBlock)
 		buffer.clear();
 	}
 	masterEQ.prepare(newSampleRate, samplesPerBlock);
+	for (auto& meter : trackMeters)
+		meter.prepare(newSampleRate, samplesPerBlock);
+	masterMeter.prepare(newSampleRate, samplesPerBlock);
+	previewVoice.prepare(newSampleRate, samplesPerBlock);
 }
 
 void DjIaVstProcessor::releaseResources()
@@ -492,6 +584,7 @@ bool DjIaVstProcessor::isBusesLayoutSupported(const BusesLayout& layouts) const
 
 void DjIaVstProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages)
 {
+	SharedAudioCache::Reader::ScopedBlock renderBlock(audioReader);
 	internalSampleCounter += buffer.getNumSamples();
 	checkAndSwapStagingBuffers();
 	for (auto i = getTotalNumInputChannels(); i < getTotalNumOutputChannels(); ++i)
@@ -523,9 +616,12 @@ void DjIaVstProcessor::processBlock(juce::AudioBuffer<float>& buffer, juce::Midi
 	mainOutput.clear();
 	updateTimeStretchRatios(hostBpm);
 	trackManager.renderAllTracks(mainOutput, individualOutputBuffers, hostBpm);
+	for (int slot = 0; slot < MAX_TRACKS && slot < (int)individualOutputBuffers.size(); ++slot)
+		trackMeters[(size_t)slot].process(individualOutputBuffers[(size_t)slot], buffer.getNumSamples());
 	copyTracksToIndividualOutputs(buffer);
 	handlePreviewPlaying(buffer);
 	applyMasterEffects(mainOutput);
+	masterMeter.process(mainOutput, mainOutput.getNumSamples());
 	checkIfUIUpdateNeeded(midiMessages);
 }
 
@@ -540,35 +636,9 @@ void DjIaVstProcessor::clearMasterChannel(juce::AudioSampleBuffer& mainOutput)
 
 void DjIaVstProcessor::handlePreviewPlaying(juce::AudioSampleBuffer& buffer)
 {
-	if (isPreviewPlaying.load())
-	{
-		juce::ScopedLock lock(previewLock);
-		if (previewBuffer.getNumSamples() > 0)
-		{
-			double currentPos = previewPosition.load();
-			double ratio = previewSampleRate.load() / hostSampleRate;
-
-			const int previewBusIndex = 9;
-			auto previewOutput = getBusBuffer(buffer, false, previewBusIndex);
-
-			for (int i = 0; i < buffer.getNumSamples(); ++i)
-			{
-				int sampleIndex = (int)currentPos;
-				if (sampleIndex >= previewBuffer.getNumSamples())
-				{
-					isPreviewPlaying = false;
-					break;
-				}
-				for (int ch = 0; ch < std::min(previewOutput.getNumChannels(), 2); ++ch)
-				{
-					float sample = previewBuffer.getSample(ch, sampleIndex) * 0.7f;
-					previewOutput.addSample(ch, i, sample);
-				}
-				currentPos += ratio;
-			}
-			previewPosition.store(currentPos);
-		}
-	}
+	const int previewBusIndex = 9;
+	auto previewOutput = getBusBuffer(buffer, false, previewBusIndex);
+	previewVoice.render(previewOutput, buffer.getNumSamples());
 }
 
 void DjIaVstProcessor::addSequencerMidiMessage(const juce::MidiMessage& message)
@@ -631,7 +701,7 @@ void DjIaVstProcessor::handleSequencerPlayState(bool hostIsPlaying)
 				track->lastPpqPosition = -1.0;
 			}
 		}
-		needsUIUpdate = true;
+		markUIDirty(uiDirtyTracks);
 	}
 	else if (!hostIsPlaying && !wasPlaying)
 	{
@@ -656,7 +726,7 @@ void DjIaVstProcessor::handleSequencerPlayState(bool hostIsPlaying)
 				track->isPlaying.store(false);
 			}
 		}
-		needsUIUpdate = true;
+		markUIDirty(uiDirtyTracks);
 	}
 
 	wasPlaying = hostIsPlaying;
@@ -676,10 +746,10 @@ void DjIaVstProcessor::checkIfUIUpdateNeeded(juce::MidiBuffer& midiMessages)
 		}
 	}
 
-	if (anyTrackPlaying || midiMessages.getNumEvents() > 0)
-	{
-		needsUIUpdate = true;
-	}
+	if (anyTrackPlaying)
+		markUIDirty(uiDirtyPlayback);
+	if (midiMessages.getNumEvents() > 0)
+		markUIDirty(uiDirtyTracks);
 }
 
 void DjIaVstProcessor::applyMasterEffects(juce::AudioSampleBuffer& mainOutput)
@@ -810,7 +880,7 @@ void DjIaVstProcessor::processMidiMessages(juce::MidiBuffer& midiMessages, bool
 	int midiEventCount = midiMessages.getNumEvents();
 	if (midiEventCount > 0)
 	{
-		needsUIUpdate = true;
+		markUIDirty(uiDirtyTracks);
 	}
 	juce::Array<int> notesPlayedInThisBuffer;
 	for (const auto metadata : midiMessages)
@@ -856,7 +926,7 @@ void DjIaVstProcessor::previewTrack(const juce::String& trackId)
 	{
 		track->readPosition = 0.0;
 		track->isPlaying.store(true);
-		needsUIUpdate = true;
+		markUIDirty(uiDirtyTracks);
 
 		currentPreviewTrackId = trackId;
 
@@ -939,7 +1009,7 @@ void DjIaVstProcessor::handleGenerate()
 				if (paramGenerate)
 				{
 					generateLoopFromMidi(trackId);
-					needsUIUpdate.store(true);
+					markUIDirty(uiDirtyTracks);
 				}
 				break;
 			}
@@ -948,9 +1018,9 @@ void DjIaVstProcessor::handleGenerate()
 	}
 }
 
-void DjIaVstProcessor::generateSampleWithImage(const juce::String& trackId, const juce::String& base64Image, const juce::StringArray& keywords)
+void DjIaVstProcessor::generateSampleWithImage(const juce::String& trackId, const CanvasImage::Ptr& image, const juce::StringArray& keywords)
 {
-	if (isGenerating)
+	if (isGenerating || !image)
 	{
 		return;
 	}
@@ -972,7 +1042,7 @@ void DjIaVstProcessor::generateSampleWithImage(const juce::String& trackId, cons
 				editor->statusLabel.setText("Analyzing image and generating audio...", juce::dontSendNotification);
 			} });
 
-			juce::Thread::launch([this, trackId, base64Image, keywords]()
+			juce::Thread::launch([this, trackId, image, keywords]()
 				{
 					try
 					{
@@ -1003,9 +1073,10 @@ void DjIaVstProcessor::generateSampleWithImage(const juce::String& trackId, cons
 						if (request.key.isEmpty()) request.key = "C Minor";
 						if (request.generationDuration <= 0) request.generationDuration = 6.0f;
 
+						request.seed = track->getRequestSeed();
 						request.prompt = "";
 						request.useImage = true;
-						request.imageBase64 = base64Image;
+						request.image = image;
 						request.keywords = keywords;
 
 						generateLoopWithImage(request, trackId, 300000);
@@ -1029,10 +1100,28 @@ void DjIaVstProcessor::generateSampleWithImage(const juce::String& trackId, cons
 
 void DjIaVstProcessor::generateLoopWithImage(const DjIaClient::LoopRequest& request, const juce::String& trackId, int timeoutMS)
 {
-	auto response = apiClient.generateLoop(request, hostSampleRate, timeoutMS);
+	beginGenerationTrace(trackId);
+
+	if (loadGenerationFromCache(request, trackId))
+	{
+		return;
+	}
+
+	speculativeGenerator.cancelSpeculativeWork();
+
+	auto control = beginGenerationControl(trackId);
+	auto response = apiClient.generateLoop(request, hostSampleRate, timeoutMS, control);
+	endGenerationControl(control);
+	speculativeGenerator.updateKnownCredits(response.creditsRemaining, response.isUnlimitedKey);
 
 	try
 	{
+		if (response.cancelled)
+		{
+			finishCancelledGeneration(trackId);
+			return;
+		}
+
 		if (!response.errorMessage.isEmpty())
 		{
 			setIsGenerating(false);
@@ -1061,12 +1150,19 @@ void DjIaVstProcessor::generateLoopWithImage(const DjIaClient::LoopRequest& requ
 		return;
 	}
 
+	auto generatedRequest = request;
+	if (response.seed >= 0)
+		generatedRequest.seed = response.seed;
+	storeGenerationInCache(generatedRequest, response.audioData, response.detectedBpm);
+
 	{
 		const juce::ScopedLock lock(apiLock);
 		pendingTrackId = trackId;
 		pendingAudioFile = response.audioData;
+		pendingAudioBuffer.reset();
 		pendingDetectedBpm = response.detectedBpm;
 		hasPendingAudioData = true;
+		publishPendingTraceLocked();
 		waitingForMidiToLoad = true;
 		trackIdWaitingForLoad = trackId;
 		correctMidiNoteReceived = false;
@@ -1090,6 +1186,7 @@ void DjIaVstProcessor::generateLoopWithImage(const DjIaClient::LoopRequest& requ
 			track->generationPrompt = generatedPrompt;
 			track->generationKey = response.key;
 		}
+		track->setGeneratedSeed(response.seed);
 	}
 
 	setIsGenerating(false);
@@ -1179,6 +1276,7 @@ void DjIaVstProcessor::generateLoopFromMidi(const juce::String& trackId)
 							}
 							track->updateFromRequest(request);
 						}
+						request.seed = track->getRequestSeed();
 
 						juce::String promptSource = !request.prompt.isEmpty() ?
 							"track prompt: " + request.prompt.substring(0, 20) + "..." :
@@ -1258,14 +1356,14 @@ void DjIaVstProcessor::handleSampleParams(int slot, TrackData* track)
 	if (std::abs(track->bpmOffset - paramPitch) > 0.01f)
 	{
 		track->bpmOffset = paramPitch;
-		needsUIUpdate = true;
+		markUIDirty(uiDirtyTracks);
 	}
 
 	if (std::abs(track->fineOffset - paramFine) > 0.01f)
 	{
 		track->fineOffset = paramFine * 0.05f;
 		track->bpmOffset = paramPitch + track->fineOffset;
-		needsUIUpdate = true;
+		markUIDirty(uiDirtyTracks);
 	}
 	bool isSolo = paramSolo > 0.5f;
 	bool isMuted = paramMute > 0.5f;
@@ -1306,13 +1404,9 @@ void DjIaVstProcessor::handleSampleParams(int slot, TrackData* track)
 			double repeatDuration = calculateRetriggerInterval(retriggerInterval, hostBpm);
 			double repeatDurationSamples = repeatDuration * track->sampleRate;
 
-			track->beatRepeatEndPosition.store(startPosition + repeatDurationSamples);
-
-			double maxSamples = track->numSamples;
-			if (track->beatRepeatEndPosition.load() > maxSamples)
-			{
-				track->beatRepeatEndPosition.store(maxSamples);
-			}
+			auto* playback = track->getRenderPlayback();
+			track->setBeatRepeatWindow(playback ? playback->transientIndex.get() : nullptr,
+				startPosition, repeatDurationSamples, false);
 		}
 	}
 }
@@ -1357,23 +1451,22 @@ void DjIaVstProcessor::checkBeatRepeatWithSampleCounter()
 				}
 
 				double currentPosition = track->readPosition.load();
+				double loopStartSamples = track->loopStart * track->sampleRate;
 				double repeatDuration = calculateRetriggerInterval(track->randomRetriggerInterval.load(), hostBpm);
 				double repeatDurationSamples = repeatDuration * track->sampleRate;
 
+				// The counter only advances per block, so the read position is
+				// an arbitrary sample; snap the window to the nearest attack.
 				track->originalReadPosition.store(currentPosition);
-				track->beatRepeatStartPosition.store(currentPosition);
-				track->beatRepeatEndPosition.store(currentPosition + repeatDurationSamples);
-
-				double maxSamples = track->numSamples;
-				if (track->beatRepeatEndPosition.load() > maxSamples)
-				{
-					track->beatRepeatEndPosition.store(maxSamples);
-				}
+				auto* playback = track->getRenderPlayback();
+				track->setBeatRepeatWindow(playback ? playback->transientIndex.get() : nullptr,
+					loopStartSamples + currentPosition, repeatDurationSamples, true);
+				track->startRepeatCrossfade(loopStartSamples + currentPosition);
 
 				track->beatRepeatActive.store(true);
 				track->beatRepeatPending.store(false);
 				track->pendingBeatNumber.store(-1);
-				track->readPosition.store(track->beatRepeatStartPosition.load());
+				track->readPosition.store(track->beatRepeatStartPosition.load() - loopStartSamples);
 			}
 		}
 
@@ -1398,6 +1491,7 @@ void DjIaVstProcessor::checkBeatRepeatWithSampleCounter()
 				track->beatRepeatStopPending.store(false);
 				track->randomRetriggerActive.store(false);
 				track->lastRetriggerTime.store(-1.0);
+				track->startRepeatCrossfade(track->loopStart * track->sampleRate + track->readPosition.load());
 				track->readPosition.store(track->originalReadPosition.load());
 				track->pendingStopBeatNumber.store(-1);
 				DBG("Beat repeat stopped at sample: " << currentSample);
@@ -1585,6 +1679,7 @@ void DjIaVstProcessor::performTrackDeletion(const juce::String& trackId)
 	{
 		sampleBank->markSampleAsUnused(trackToDelete->currentSampleId, projectId);
 	}
+	variationPool.removeTrack(trackId);
 	auto trackIds = trackManager.getAllTrackIds();
 	int deletedTrackIndex = -1;
 	for (int i = 0; i < trackIds.size(); ++i)
@@ -1737,21 +1832,37 @@ void DjIaVstProcessor::selectTrack(const juce::String& trackId)
 void DjIaVstProcessor::generateLoop(const DjIaClient::LoopRequest& request, const juce::String& targetTrackId)
 {
 	juce::String trackId = targetTrackId.isEmpty() ? selectedTrackId : targetTrackId;
+	beginGenerationTrace(trackId);
 
 	try
 	{
+		if (loadGenerationFromCache(request, trackId))
+		{
+			return;
+		}
+
+		if (serveFromVariationPool(request, trackId))
+		{
+			return;
+		}
+
+		speculativeGenerator.cancelSpeculativeWork();
+
+		auto control = beginGenerationControl(trackId);
 		if (useLocalModel)
 		{
-			generateLoopLocal(request, trackId);
+			generateLoopLocal(request, trackId, control);
 		}
 		else
 		{
 			DjIaClient::LoopRequest apiRequest = request;
-			generateLoopAPI(apiRequest, trackId);
+			generateLoopAPI(apiRequest, trackId, control);
 		}
+		endGenerationControl(control);
 	}
 	catch (const std::exception& e)
 	{
+		endGenerationControl(nullptr);
 		hasPendingAudioData = false;
 		waitingForMidiToLoad = false;
 		trackIdWaitingForLoad.clear();
@@ -1763,12 +1874,19 @@ void DjIaVstProcessor::generateLoop(const DjIaClient::LoopRequest& request, cons
 	}
 }
 
-void DjIaVstProcessor::generateLoopAPI(const DjIaClient::LoopRequest& request, const juce::String& trackId)
+void DjIaVstProcessor::generateLoopAPI(const DjIaClient::LoopRequest& request, const juce::String& trackId, const GenerationControl::Ptr& control)
 {
-	auto response = apiClient.generateLoop(request, hostSampleRate, requestTimeoutMS);
+	auto response = apiClient.generateLoop(request, hostSampleRate, requestTimeoutMS, control);
+	speculativeGenerator.updateKnownCredits(response.creditsRemaining, response.isUnlimitedKey);
 
 	try
 	{
+		if (response.cancelled)
+		{
+			finishCancelledGeneration(trackId);
+			return;
+		}
+
 		if (!response.errorMessage.isEmpty())
 		{
 			setIsGenerating(false);
@@ -1798,12 +1916,19 @@ void DjIaVstProcessor::generateLoopAPI(const DjIaClient::LoopRequest& request, c
 		return;
 	}
 
+	auto generatedRequest = request;
+	if (response.seed >= 0)
+		generatedRequest.seed = response.seed;
+	storeGenerationInCache(generatedRequest, response.audioData, response.detectedBpm);
+
 	{
 		const juce::ScopedLock lock(apiLock);
 		pendingTrackId = trackId;
 		pendingAudioFile = response.audioData;
+		pendingAudioBuffer.reset();
 		pendingDetectedBpm = response.detectedBpm;
 		hasPendingAudioData = true;
+		publishPendingTraceLocked();
 		waitingForMidiToLoad = true;
 		trackIdWaitingForLoad = trackId;
 		correctMidiNoteReceived = false;
@@ -1813,6 +1938,7 @@ void DjIaVstProcessor::generateLoopAPI(const DjIaClient::LoopRequest& request, c
 	{
 		track->prompt = request.prompt;
 		track->bpm = request.bpm;
+		track->setGeneratedSeed(response.seed);
 	}
 
 	setIsGenerating(false);
@@ -1837,7 +1963,7 @@ void DjIaVstProcessor::loadSampleFromBank(const juce::String& sampleId, const ju
 	if (!sampleBank)
 		return;
 
-	auto* sampleEntry = sampleBank->getSample(sampleId);
+	auto sampleEntry = sampleBank->getSample(sampleId);
 	if (!sampleEntry)
 		return;
 
@@ -1864,7 +1990,9 @@ void DjIaVstProcessor::loadSampleFromBank(const juce::String& sampleId, const ju
 		track->currentSampleId = sampleId;
 	}
 
-	juce::Thread::launch([this, trackId, sampleFile, sampleId]()
+	auto knownAnalysis = sampleBank->getAnalysis(sampleId);
+
+	juce::Thread::launch([this, trackId, sampleFile, sampleId, knownAnalysis]()
 		{
 			TrackData* track = trackManager.getTrack(trackId);
 			if (!track) return;
@@ -1873,7 +2001,7 @@ void DjIaVstProcessor::loadSampleFromBank(const juce::String& sampleId, const ju
 				loadSampleToBankPage(trackId, track->currentPageIndex, sampleFile, sampleId);
 			}
 			else {
-				loadAudioFileAsync(trackId, sampleFile);
+				loadAudioFileAsync(trackId, sampleFile, nullptr, knownAnalysis);
 			}
 
 			juce::Timer::callAfterDelay(2000, [this]()
@@ -1883,14 +2011,10 @@ void DjIaVstProcessor::loadSampleFromBank(const juce::String& sampleId, const ju
 				}); });
 }
 
-void DjIaVstProcessor::generateLoopLocal(const DjIaClient::LoopRequest& request, const juce::String& trackId)
+void DjIaVstProcessor::generateLoopLocal(const DjIaClient::LoopRequest& request, const juce::String& trackId, const GenerationControl::Ptr& control)
 {
-	auto appDataDir = juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
-		.getChildFile("OBSIDIAN-Neural");
-	auto stableAudioDir = appDataDir.getChildFile("stable-audio");
-
-	StableAudioEngine localEngine;
-	if (!localEngine.initialize(stableAudioDir.getFullPathName()))
+	auto localEngine = getLocalAudioEngine();
+	if (!localEngine)
 	{
 		setIsGenerating(false);
 		setGeneratingTrackId("");
@@ -1901,34 +2025,37 @@ void DjIaVstProcessor::generateLoopLocal(const DjIaClient::LoopRequest& request,
 
 	StableAudioEngine::GenerationParams params(request.prompt, 6.0f);
 	params.sampleRate = static_cast<int>(hostSampleRate);
-	params.numThreads = 4;
+	params.seed = request.seed;
 
-	auto result = localEngine.generateSample(params);
+	auto result = localEngine->generateSample(params, control);
 
-	if (!result.success || result.audioData.empty())
+	if (result.cancelled)
 	{
-		setIsGenerating(false);
-		setGeneratingTrackId("");
-		reEnableCanvasGenerate();
-		notifyGenerationComplete(trackId, "ERROR: Local generation failed - " + result.errorMessage);
+		finishCancelledGeneration(trackId);
 		return;
 	}
 
-	juce::File tempFile = createTempAudioFile(result.audioData, result.actualDuration);
-	if (!tempFile.exists() || tempFile.getSize() == 0)
+	if (!result.success || result.audio.getNumSamples() == 0)
 	{
 		setIsGenerating(false);
 		setGeneratingTrackId("");
 		reEnableCanvasGenerate();
-		notifyGenerationComplete(trackId, "ERROR: Failed to create audio file");
+		notifyGenerationComplete(trackId, "ERROR: Local generation failed - " + result.errorMessage);
 		return;
 	}
 
+	auto generatedRequest = request;
+	generatedRequest.seed = result.seed;
+	storeGenerationInCache(generatedRequest, result.audio, result.sampleRate, -1.0f);
+
 	{
 		const juce::ScopedLock lock(apiLock);
 		pendingTrackId = trackId;
-		pendingAudioFile = tempFile;
+		pendingAudioFile = juce::File();
+		pendingAudioBuffer = std::make_shared<juce::AudioBuffer<float>>(std::move(result.audio));
+		pendingAudioBufferSampleRate = result.sampleRate;
 		hasPendingAudioData = true;
+		publishPendingTraceLocked();
 		waitingForMidiToLoad = true;
 		trackIdWaitingForLoad = trackId;
 		correctMidiNoteReceived = false;
@@ -1938,6 +2065,7 @@ void DjIaVstProcessor::generateLoopLocal(const DjIaClient::LoopRequest& request,
 	{
 		track->prompt = request.prompt;
 		track->bpm = request.bpm;
+		track->setGeneratedSeed(result.seed);
 	}
 
 	setIsGenerating(false);
@@ -1951,6 +2079,247 @@ void DjIaVstProcessor::generateLoopLocal(const DjIaClient::LoopRequest& request,
 	notifyGenerationComplete(trackId, successMessage);
 }
 
+juce::String DjIaVstProcessor::getGenerationBackendId() const
+{
+	return useLocalModel ? juce::String("local") : apiClient.getBaseUrl();
+}
+
+// Returns a reference of the caller's own, so the engine outlives its job even
+// if another caller replaces it or the processor resets it meanwhile.
+std::shared_ptr<StableAudioEngine> DjIaVstProcessor::getLocalAudioEngine()
+{
+	const juce::ScopedLock lock(localEngineLock);
+	if (localAudioEngine && localAudioEngine->isReady())
+		return localAudioEngine;
+
+	auto stableAudioDir = juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+		.getChildFile("OBSIDIAN-Neural")
+		.getChildFile("stable-audio");
+
+	localAudioEngine = std::make_shared<StableAudioEngine>();
+	if (!localAudioEngine->initialize(stableAudioDir.getFullPathName()))
+	{
+		localAudioEngine.reset();
+		return nullptr;
+	}
+	return localAudioEngine;
+}
+
+juce::String DjIaVstProcessor::getGenerationCacheKey(const DjIaClient::LoopRequest& request) const
+{
+	return GenerationCache::buildRequestKey(request, hostSampleRate, getGenerationBackendId());
+}
+
+bool DjIaVstProcessor::loadGenerationFromCache(const DjIaClient::LoopRequest& request, const juce::String& trackId)
+{
+	if (!generationCache || !generationCache->isEnabled() || !GenerationCache::isCacheable(request))
+		return false;
+
+	auto cached = generationCache->lookup(getGenerationCacheKey(request));
+	if (!cached.found)
+		return false;
+
+	{
+		const juce::ScopedLock lock(apiLock);
+		pendingTrackId = trackId;
+		pendingAudioFile = juce::File();
+		pendingAudioBuffer = cached.audio;
+		pendingAudioBufferSampleRate = cached.sampleRate;
+		pendingDetectedBpm = cached.detectedBpm;
+		hasPendingAudioData = true;
+		publishPendingTraceLocked("cache");
+		waitingForMidiToLoad = true;
+		trackIdWaitingForLoad = trackId;
+		correctMidiNoteReceived = false;
+	}
+
+	if (TrackData* track = trackManager.getTrack(trackId))
+	{
+		track->prompt = request.prompt;
+		track->bpm = request.bpm;
+		// Entries from before the seed was stored fall back to the requested
+		// one, which is part of the key and so the seed that made the audio.
+		track->setGeneratedSeed(cached.seed >= 0 ? cached.seed : request.seed);
+	}
+
+	setIsGenerating(false);
+	setGeneratingTrackId("");
+	reEnableCanvasGenerate();
+
+	notifyGenerationComplete(trackId, "Loop loaded from cache (seed " + juce::String(request.seed) + ")! Press Play to listen.");
+	return true;
+}
+
+void DjIaVstProcessor::storeGenerationInCache(const DjIaClient::LoopRequest& request, const juce::File& audioFile, float detectedBpm)
+{
+	if (!generationCache || !generationCache->isEnabled() || !GenerationCache::isCacheable(request))
+		return;
+
+	generationCache->store(getGenerationCacheKey(request), audioFile, detectedBpm, request.seed);
+}
+
+void DjIaVstProcessor::storeGenerationInCache(const DjIaClient::LoopRequest& request, const juce::AudioBuffer<float>& audio,
+	double sampleRate, float detectedBpm)
+{
+	if (!generationCache || !generationCache->isEnabled() || !GenerationCache::isCacheable(request))
+		return;
+
+	generationCache->store(getGenerationCacheKey(request), audio, sampleRate, detectedBpm, request.seed);
+}
+
+void DjIaVstProcessor::initSpeculativeGenerator()
+{
+	speculativeGenerator.isIdle = [this]()
+		{
+			return !isGenerating && !hasPendingAudioData.load();
+		};
+	speculativeGenerator.requestTargets = [this]()
+		{
+			juce::MessageManager::callAsync([this]()
+				{
+					speculativeGenerator.setTargets(collectSpeculativeTargets());
+				});
+		};
+	speculativeGenerator.generate = [this](const DjIaClient::LoopRequest& request, const GenerationControl::Ptr& control)
+		{
+			SpeculativeGenerator::Result generated;
+			if (!useLocalModel)
+			{
+				generated.response = apiClient.generateLoop(request, hostSampleRate, requestTimeoutMS, control);
+				return generated;
+			}
+
+			auto& response = generated.response;
+			auto localEngine = getLocalAudioEngine();
+			if (!localEngine)
+			{
+				response.errorMessage = "Local models not found";
+				return generated;
+			}
+
+			StableAudioEngine::GenerationParams params(request.prompt, 6.0f);
+			params.sampleRate = static_cast<int>(hostSampleRate);
+			params.seed = request.seed;
+			auto result = localEngine->generateSample(params, control);
+			if (!result.success || result.audio.getNumSamples() == 0)
+			{
+				response.cancelled = result.cancelled;
+				response.errorMessage = result.errorMessage;
+				return generated;
+			}
+
+			// Kept in memory like generateLoopLocal, no temporary WAV.
+			response.duration = result.actualDuration;
+			response.seed = result.seed;
+			generated.sampleRate = result.sampleRate;
+			generated.audio = std::make_shared<juce::AudioBuffer<float>>(std::move(result.audio));
+			return generated;
+		};
+
+	setSpeculativeVariations(speculativeVariations);
+}
+
+std::vector<SpeculativeGenerator::Target> DjIaVstProcessor::collectSpeculativeTargets()
+{
+	std::vector<SpeculativeGenerator::Target> targets;
+	float currentHostBpm = static_cast<float>(getHostBpm());
+	juce::String backend = getGenerationBackendId();
+
+	for (const auto& trackId : trackManager.getAllTrackIds())
+	{
+		TrackData* track = trackManager.getTrack(trackId);
+		if (!track)
+			continue;
+
+		auto request = track->createLoopRequest();
+		if (request.prompt.isEmpty() || request.seed >= 0)
+			continue;
+
+		if (currentHostBpm > 0.0f)
+			request.bpm = currentHostBpm;
+		if (request.key.isEmpty())
+			request.key = getGlobalKey();
+		if (request.generationDuration <= 0.0f)
+			request.generationDuration = static_cast<float>(getGlobalDuration());
+
+		SpeculativeGenerator::Target target;
+		target.trackId = trackId;
+		target.request = request;
+		target.signature = VariationPool::buildSignature(request, backend);
+		targets.push_back(target);
+	}
+
+	return targets;
+}
+
+bool DjIaVstProcessor::serveFromVariationPool(const DjIaClient::LoopRequest& request, const juce::String& trackId)
+{
+	if (!speculativeGenerator.isEnabled() || request.seed >= 0 || request.useImage)
+		return false;
+
+	VariationPool::Variation variation;
+	auto signature = VariationPool::buildSignature(request, getGenerationBackendId());
+	if (!variationPool.take(trackId, signature, variation))
+		return false;
+
+	{
+		const juce::ScopedLock lock(apiLock);
+		pendingTrackId = trackId;
+		pendingAudioFile = variation.audioFile;
+		pendingAudioBuffer = variation.audio;
+		pendingAudioBufferSampleRate = variation.sampleRate;
+		pendingDetectedBpm = variation.detectedBpm;
+		hasPendingAudioData = true;
+		publishPendingTraceLocked("pool");
+		waitingForMidiToLoad = true;
+		trackIdWaitingForLoad = trackId;
+		correctMidiNoteReceived = false;
+	}
+
+	if (TrackData* track = trackManager.getTrack(trackId))
+	{
+		track->prompt = request.prompt;
+		track->bpm = request.bpm;
+	}
+
+	setIsGenerating(false);
+	setGeneratingTrackId("");
+	reEnableCanvasGenerate();
+
+	speculativeGenerator.recordServed();
+	speculativeGenerator.notifyStateChanged();
+
+	notifyGenerationComplete(trackId, "Loop ready instantly from variation pool! Press Play to listen.");
+	return true;
+}
+
+void DjIaVstProcessor::setSpeculativeVariations(int variationsPerTrack)
+{
+	speculativeVariations = juce::jlimit(0, 3, variationsPerTrack);
+	auto budget = speculativeGenerator.getBudget();
+	budget.variationsPerTrack = speculativeVariations;
+	budget.maxConcurrentJobs = useLocalModel ? LocalJobScheduler::getInstance().getMaxConcurrentJobs() : 1;
+	speculativeGenerator.setBudget(budget);
+}
+
+void DjIaVstProcessor::setGenerationCacheEnabled(bool enabled)
+{
+	generationCacheEnabled = enabled;
+	if (generationCache)
+	{
+		generationCache->setEnabled(enabled);
+	}
+}
+
+void DjIaVstProcessor::setGenerationCacheMaxMB(int maxMB)
+{
+	generationCacheMaxMB = juce::jmax(64, maxMB);
+	if (generationCache)
+	{
+		generationCache->setMaxBytes(static_cast<juce::int64>(generationCacheMaxMB) * 1024 * 1024);
+	}
+}
+
 juce::StringArray DjIaVstProcessor::getBuiltInPrompts() const
 {
 	if (auto* editor = dynamic_cast<DjIaVstEditor*>(getActiveEditor()))
@@ -1974,11 +2343,11 @@ juce::StringArray DjIaVstProcessor::getBuiltInPrompts() const
 
 void DjIaVstProcessor::handleGenerationComplete(const juce::String& trackId,
 	const DjIaClient::LoopRequest& /*originalRequest*/,
-	const ObsidianEngine::LoopResponse& response)
+	ObsidianEngine::LoopResponse&& response)
 {
 	try
 	{
-		if (!response.success || response.audioData.empty())
+		if (!response.success || response.audio.getNumSamples() == 0)
 		{
 			setIsGenerating(false);
 			setGeneratingTrackId("");
@@ -1987,20 +2356,14 @@ void DjIaVstProcessor::handleGenerationComplete(const juce::String& trackId,
 			return;
 		}
 
-		juce::File tempFile = createTempAudioFile(response.audioData, response.actualDuration);
-		if (!tempFile.exists() || tempFile.getSize() == 0)
-		{
-			setIsGenerating(false);
-			setGeneratingTrackId("");
-			notifyGenerationComplete(trackId, "ERROR: Failed to create audio file");
-			return;
-		}
-
 		{
 			const juce::ScopedLock lock(apiLock);
 			pendingTrackId = trackId;
-			pendingAudioFile = tempFile;
+			pendingAudioFile = juce::File();
+			pendingAudioBuffer = std::make_shared<juce::AudioBuffer<float>>(std::move(response.audio));
+			pendingAudioBufferSampleRate = response.sampleRate;
 			hasPendingAudioData = true;
+			publishPendingTraceLocked();
 			waitingForMidiToLoad = true;
 			trackIdWaitingForLoad = trackId;
 			correctMidiNoteReceived = false;
@@ -2034,17 +2397,11 @@ void DjIaVstProcessor::handleGenerationComplete(const juce::String& trackId,
 	}
 }
 
-juce::File DjIaVstProcessor::createTempAudioFile(const std::vector<float>& audioData, float /*duration*/)
+juce::File DjIaVstProcessor::createTempAudioFile(const juce::AudioBuffer<float>& buffer, double sampleRate)
 {
 	try
 	{
 		juce::File tempFile = juce::File::createTempFile(".wav");
-		int numSamples = static_cast<int>(audioData.size());
-		juce::AudioBuffer<float> buffer(1, numSamples);
-		if (audioData.size() > 0)
-		{
-			buffer.copyFrom(0, 0, audioData.data(), numSamples);
-		}
 		juce::WavAudioFormat wavFormat;
 		juce::FileOutputStream* outputStream = new juce::FileOutputStream(tempFile);
 		if (!outputStream->openedOk())
@@ -2056,9 +2413,9 @@ juce::File DjIaVstProcessor::createTempAudioFile(const std::vector<float>& audio
 		std::unique_ptr<juce::AudioFormatWriter> writer(
 			wavFormat.createWriterFor(
 				outputStream,
-				hostSampleRate,
-				1,
-				16,
+				sampleRate,
+				static_cast<unsigned int>(buffer.getNumChannels()),
+				24,
 				{},
 				0));
 
@@ -2082,22 +2439,145 @@ juce::File DjIaVstProcessor::createTempAudioFile(const std::vector<float>& audio
 	}
 }
 
-void DjIaVstProcessor::notifyGenerationComplete(const juce::String& trackId, const juce::String& message)
+GenerationControl::Ptr DjIaVstProcessor::beginGenerationControl(const juce::String& trackId)
 {
-	lastGeneratedTrackId = trackId;
-	pendingMessage = message;
-	hasPendingNotification = true;
-	triggerAsyncUpdate();
+	auto control = GenerationControl::create();
+	auto lastReported = std::make_shared<std::pair<int, int>>(-1, -2);
+
+	control->setProgressCallback([this, trackId, lastReported](GenerationControl::Stage stage, float percent)
+		{
+			int stageIndex = static_cast<int>(stage);
+			int roundedPercent = percent < 0.0f ? -1 : juce::roundToInt(percent);
+			if (lastReported->first == stageIndex && lastReported->second == roundedPercent)
+				return;
+			*lastReported = { stageIndex, roundedPercent };
+
+			juce::String stageName = GenerationControl::getStageName(stage);
+			juce::MessageManager::callAsync([this, trackId, stageName, percent]()
+				{
+					if (generationListener)
+						generationListener->onGenerationProgress(trackId, stageName, percent);
+				});
+		});
+
+	const juce::ScopedLock lock(apiLock);
+	control->setTrace(activeTrace);
+	activeGenerationControl = control;
+	return control;
 }
 
-void DjIaVstProcessor::handleAsyncUpdate()
+void DjIaVstProcessor::endGenerationControl(const GenerationControl::Ptr& control)
 {
-	if (!hasPendingNotification)
-		return;
-
-	hasPendingNotification = false;
+	const juce::ScopedLock lock(apiLock);
+	if (control == nullptr || activeGenerationControl == control)
+		activeGenerationControl.reset();
+}
 
-	juce::MessageManager::callAsync([this]()
+void DjIaVstProcessor::cancelGeneration()
+{
+	GenerationControl::Ptr control;
+	{
+		const juce::ScopedLock lock(apiLock);
+		control = activeGenerationControl;
+	}
+	if (control)
+		control->cancel();
+}
+
+void DjIaVstProcessor::finishCancelledGeneration(const juce::String& trackId)
+{
+	setIsGenerating(false);
+	setGeneratingTrackId("");
+	reEnableCanvasGenerate();
+	notifyGenerationComplete(trackId, "CANCELLED: Generation cancelled");
+}
+
+void DjIaVstProcessor::beginGenerationTrace(const juce::String& trackId)
+{
+	auto trace = GenerationTrace::create(trackId, getGenerationBackendId());
+	const juce::ScopedLock lock(apiLock);
+	activeTrace = trace;
+}
+
+// Every site that sets hasPendingAudioData goes through here, so this is also
+// where the load worker is told to start watching for the go-ahead.
+void DjIaVstProcessor::publishPendingTraceLocked(const juce::String& source)
+{
+	if (pendingLoadWorker)
+		pendingLoadWorker->notify();
+	pendingTrace = std::move(activeTrace);
+	if (pendingTrace)
+	{
+		if (source.isNotEmpty())
+			pendingTrace->setSource(source);
+		pendingTrace->transitionTo(GenerationTrace::Phase::waitForLoad);
+	}
+}
+
+void DjIaVstProcessor::abandonActiveTrace(const juce::String& outcome)
+{
+	GenerationTrace::Ptr trace;
+	{
+		const juce::ScopedLock lock(apiLock);
+		trace = std::move(activeTrace);
+	}
+	if (!trace)
+		return;
+
+	trace->finish();
+	trace->setOutcome(outcome);
+	generationTelemetry.record(*trace);
+}
+
+// The audio thread only stamps the swap time, so the trace is closed here on
+// the loader once that stamp moves past the request. Gives up after a while
+// in case the host stopped calling processBlock.
+void DjIaVstProcessor::finishTraceAfterSwap(TrackData* track, GenerationTrace::Ptr trace, double requestedMs)
+{
+	const double deadlineMs = requestedMs + swapTraceTimeoutMs;
+	while (track->lastSwapMs.load() < requestedMs && juce::Time::getMillisecondCounterHiRes() < deadlineMs)
+		juce::Thread::sleep(1);
+
+	double swappedMs = track->lastSwapMs.load();
+	trace->finish(swappedMs >= requestedMs ? swappedMs : juce::Time::getMillisecondCounterHiRes());
+	juce::MessageManager::callAsync([this, trace]()
+		{ finishGenerationTrace(trace); });
+}
+
+void DjIaVstProcessor::finishGenerationTrace(const GenerationTrace::Ptr& trace)
+{
+	trace->finish();
+	generationTelemetry.record(*trace);
+
+	if (TrackData* track = trackManager.getTrack(trace->getTrackId()))
+	{
+		juce::String timings = trace->toSummary();
+		juce::String session = generationTelemetry.getSessionSummary();
+		if (session.isNotEmpty())
+			timings += "\n\n" + session;
+		track->lastGenerationTimings = timings;
+	}
+}
+
+void DjIaVstProcessor::notifyGenerationComplete(const juce::String& trackId, const juce::String& message)
+{
+	// Anything still active here never reached the loader.
+	abandonActiveTrace(message.startsWith("CANCELLED:") ? "cancelled" : "failed");
+
+	lastGeneratedTrackId = trackId;
+	pendingMessage = message;
+	hasPendingNotification = true;
+	triggerAsyncUpdate();
+}
+
+void DjIaVstProcessor::handleAsyncUpdate()
+{
+	if (!hasPendingNotification)
+		return;
+
+	hasPendingNotification = false;
+
+	juce::MessageManager::callAsync([this]()
 		{
 			if (auto* editor = dynamic_cast<DjIaVstEditor*>(getActiveEditor())) {
 				if (generationListener) {
@@ -2108,7 +2588,7 @@ void DjIaVstProcessor::handleAsyncUpdate()
 
 void DjIaVstProcessor::processIncomingAudio(bool hostIsPlaying)
 {
-	if (!hasPendingAudioData.load())
+	if (!hasPendingAudioData.load() || loadRequested.load())
 	{
 		return;
 	}
@@ -2132,21 +2612,42 @@ void DjIaVstProcessor::processIncomingAudio(bool hostIsPlaying)
 		return;
 	}
 
+	hasUnloadedSample = false;
+	waitingForMidiToLoad = false;
+	correctMidiNoteReceived = false;
+	canLoad = false;
+	loadRequested = true;
+}
+
+void DjIaVstProcessor::dispatchPendingLoad()
+{
+	juce::String trackId;
+	juce::File audioFile;
+	std::shared_ptr<juce::AudioBuffer<float>> audio;
+	double sampleRate = 0.0;
+	GenerationTrace::Ptr trace;
+	{
+		const juce::ScopedLock lock(apiLock);
+		trackId = pendingTrackId;
+		audioFile = pendingAudioFile;
+		audio = pendingAudioBuffer;
+		sampleRate = pendingAudioBufferSampleRate;
+		trace = pendingTrace;
+		trackIdWaitingForLoad.clear();
+		clearPendingAudio();
+	}
+	loadRequested = false;
+
 	juce::MessageManager::callAsync([this]()
 		{
 			if (auto* editor = dynamic_cast<DjIaVstEditor*>(getActiveEditor())) {
 				editor->statusLabel.setText("Loading sample...", juce::dontSendNotification);
 			} });
 
-			juce::Thread::launch([this, trackId = pendingTrackId, audioFile = pendingAudioFile]()
-				{ loadAudioFileAsync(trackId, audioFile); });
-
-			clearPendingAudio();
-			hasUnloadedSample = false;
-			waitingForMidiToLoad = false;
-			correctMidiNoteReceived = false;
-			canLoad = false;
-			trackIdWaitingForLoad.clear();
+	if (audio)
+		loadAudioBufferAsync(trackId, audio, sampleRate, trace);
+	else
+		loadAudioFileAsync(trackId, audioFile, trace);
 }
 
 void DjIaVstProcessor::checkAndSwapStagingBuffers()
@@ -2176,7 +2677,13 @@ void DjIaVstProcessor::performAtomicSwap(TrackData* track, const juce::String& t
 	{
 		auto& currentPage = track->getCurrentPage();
 		bool preservedHasOriginal = currentPage.hasOriginalVersion.load();
-		std::swap(currentPage.audioBuffer, track->stagingBuffer);
+		// The outgoing buffer and its transient index are handed to the
+		// collector and freed off the audio thread once this block is over.
+		if (!currentPage.playback.takeFrom(track->stagingPlayback, audioReader))
+		{
+			track->swapRequested = true;
+			return;
+		}
 		currentPage.numSamples = track->stagingNumSamples.load();
 		currentPage.sampleRate = track->stagingSampleRate.load();
 		currentPage.originalBpm = track->stagingOriginalBpm;
@@ -2197,25 +2704,20 @@ void DjIaVstProcessor::performAtomicSwap(TrackData* track, const juce::String& t
 		{
 			currentPage.hasOriginalVersion.store(track->nextHasOriginalVersion.load());
 			currentPage.useOriginalFile = false;
-			double sampleDuration = currentPage.numSamples / currentPage.sampleRate;
-			if (sampleDuration <= 8.0)
-			{
-				currentPage.loopStart = 0.0;
-				currentPage.loopEnd = sampleDuration;
-			}
-			else
-			{
-				double beatDuration = 60.0 / currentPage.originalBpm;
-				double fourBars = beatDuration * 16.0;
-				currentPage.loopStart = 0.0;
-				currentPage.loopEnd = std::min(fourBars, sampleDuration);
-			}
+			auto* loaded = currentPage.playback.get();
+			applyLoadedLoopPoints(track, currentPage.loopStart, currentPage.loopEnd,
+				currentPage.numSamples / currentPage.sampleRate, currentPage.originalBpm,
+				loaded ? loaded->loopSuggestion : LoopSuggestion{});
 		}
 		track->syncLegacyProperties();
 	}
 	else
 	{
-		std::swap(track->audioBuffer, track->stagingBuffer);
+		if (!track->playback.takeFrom(track->stagingPlayback, audioReader))
+		{
+			track->swapRequested = true;
+			return;
+		}
 		track->numSamples = track->stagingNumSamples.load();
 		track->sampleRate = track->stagingSampleRate.load();
 		track->originalBpm = track->stagingOriginalBpm;
@@ -2234,33 +2736,50 @@ void DjIaVstProcessor::performAtomicSwap(TrackData* track, const juce::String& t
 		else
 		{
 			track->useOriginalFile = false;
-			double sampleDuration = track->numSamples / track->sampleRate;
-			if (sampleDuration <= 8.0)
-			{
-				track->loopStart = 0.0;
-				track->loopEnd = sampleDuration;
-			}
-			else
-			{
-				double beatDuration = 60.0 / track->originalBpm;
-				double fourBars = beatDuration * 16.0;
-				track->loopStart = 0.0;
-				track->loopEnd = std::min(fourBars, sampleDuration);
-			}
+			auto* loaded = track->playback.get();
+			applyLoadedLoopPoints(track, track->loopStart, track->loopEnd,
+				track->numSamples / track->sampleRate, track->originalBpm,
+				loaded ? loaded->loopSuggestion : LoopSuggestion{});
 		}
 
 		track->readPosition = 0.0;
 		track->hasStagingData = false;
-		track->stagingBuffer.setSize(0, 0);
 	}
 
-	juce::MessageManager::callAsync([this, trackId]()
-		{ updateWaveformDisplay(trackId); });
+	track->lastSwapMs = juce::Time::getMillisecondCounterHiRes();
 
-	if (auto* editor = dynamic_cast<DjIaVstEditor*>(getActiveEditor()))
+	// Picked up by the editor's next display frame.
+	markSampleLoaded(track->slotIndex);
+	markUIDirty(uiDirtyTracks);
+}
+
+void DjIaVstProcessor::applyLoadedLoopPoints(TrackData* track, double& loopStart, double& loopEnd,
+	double sampleDuration, float originalBpm, const LoopSuggestion& suggestion)
+{
+	// Locked loop points survive a new sample; the detector's window is only
+	// offered as a suggestion in the waveform view.
+	if (track->loopPointsLocked.load() && loopEnd > loopStart && loopStart < sampleDuration)
+	{
+		loopEnd = std::min(loopEnd, sampleDuration);
+		return;
+	}
+
+	if (suggestion.isValid())
+	{
+		loopStart = suggestion.startSeconds;
+		loopEnd = std::min(suggestion.endSeconds, sampleDuration);
+	}
+	else if (sampleDuration <= 8.0)
 	{
-		juce::MessageManager::callAsync([editor, trackId]()
-			{ editor->onSampleLoaded(trackId); });
+		loopStart = 0.0;
+		loopEnd = sampleDuration;
+	}
+	else
+	{
+		double beatDuration = 60.0 / originalBpm;
+		double fourBars = beatDuration * 16.0;
+		loopStart = 0.0;
+		loopEnd = std::min(fourBars, sampleDuration);
 	}
 }
 
@@ -2282,7 +2801,8 @@ void DjIaVstProcessor::updateWaveformDisplay(const juce::String& trackId)
 	}
 }
 
-void DjIaVstProcessor::loadAudioFileAsync(const juce::String& trackId, const juce::File& audioFile)
+void DjIaVstProcessor::loadAudioFileAsync(const juce::String& trackId, const juce::File& audioFile, GenerationTrace::Ptr trace,
+	SampleAnalysis::Ptr knownAnalysis)
 {
 	TrackData* track = trackManager.getTrack(trackId);
 	if (!track)
@@ -2290,63 +2810,50 @@ void DjIaVstProcessor::loadAudioFileAsync(const juce::String& trackId, const juc
 		return;
 	}
 
+	GenerationTrace::transition(trace, GenerationTrace::Phase::decode);
+	track->stagingTrace = std::move(trace);
+	if (!knownAnalysis)
+		knownAnalysis = PageCacheFile::readAnalysis(audioFile);
+	track->stagingAnalysis = std::move(knownAnalysis);
+
 	try
 	{
-		std::unique_ptr<juce::AudioFormatReader> reader(
-			sharedFormatManager.createReaderFor(audioFile));
-
-		if (!reader)
+		double sampleRate = 0.0;
+		auto decoded = SharedAudioCache::getInstance().load(audioFile, sampleRate);
+		if (!decoded)
 		{
 			return;
 		}
 
-		loadAudioToStagingBuffer(reader, track);
-		processAudioBPMAndSync(track);
-		juce::File permanentFile;
-		if (track->usePages.load())
-		{
-			permanentFile = getTrackPageAudioFile(trackId, track->currentPageIndex);
-		}
-		else
-		{
-			permanentFile = getTrackAudioFile(trackId);
-		}
-		permanentFile.getParentDirectory().createDirectory();
+		// Copied, because the staging buffer may still be time-stretched.
+		track->stagingBuffer.makeCopyOf(*decoded);
+		track->stagingNumSamples = decoded->getNumSamples();
+		track->stagingSampleRate = sampleRate;
+		finishStagedLoad(trackId, track);
+	}
+	catch (const std::exception& /*e*/)
+	{
+		track->hasStagingData = false;
+		track->swapRequested = false;
+	}
+}
 
-		DBG("Saving buffer(s) with " << track->stagingBuffer.getNumSamples() << " samples");
-		if (track->nextHasOriginalVersion.load())
-		{
-			saveOriginalAndStretchedBuffers(track->originalStagingBuffer, track->stagingBuffer, trackId, track->stagingSampleRate);
-			DBG("Both files saved for track: " << trackId);
-		}
-		else
-		{
-			saveBufferToFile(track->stagingBuffer, permanentFile, track->stagingSampleRate);
-			DBG("File saved to: " << permanentFile.getFullPathName());
-		}
+void DjIaVstProcessor::loadAudioBufferAsync(const juce::String& trackId, std::shared_ptr<juce::AudioBuffer<float>> audio, double sampleRate, GenerationTrace::Ptr trace)
+{
+	TrackData* track = trackManager.getTrack(trackId);
+	if (!track || !audio || audio->getNumSamples() == 0)
+	{
+		return;
+	}
 
-		if (track->usePages.load())
-		{
-			auto& currentPage = track->getCurrentPage();
-			currentPage.audioFilePath = permanentFile.getFullPathName();
-		}
-		else
-		{
-			track->audioFilePath = permanentFile.getFullPathName();
-		}
-		track->hasStagingData = true;
-		track->swapRequested = true;
+	GenerationTrace::transition(trace, GenerationTrace::Phase::decode);
+	track->stagingTrace = std::move(trace);
+	track->stagingAnalysis.reset();
 
-		juce::MessageManager::callAsync([this]()
-			{
-				if (auto* editor = dynamic_cast<DjIaVstEditor*>(getActiveEditor())) {
-					editor->statusLabel.setText("Sample loaded! Ready to play.", juce::dontSendNotification);
-					juce::Timer::callAfterDelay(2000, [this]() {
-						if (auto* editor = dynamic_cast<DjIaVstEditor*>(getActiveEditor())) {
-							editor->statusLabel.setText("Ready", juce::dontSendNotification);
-						}
-						});
-				} });
+	try
+	{
+		loadBufferToStagingBuffer(*audio, sampleRate, track);
+		finishStagedLoad(trackId, track);
 	}
 	catch (const std::exception& /*e*/)
 	{
@@ -2355,6 +2862,67 @@ void DjIaVstProcessor::loadAudioFileAsync(const juce::String& trackId, const juc
 	}
 }
 
+void DjIaVstProcessor::finishStagedLoad(const juce::String& trackId, TrackData* track)
+{
+	processAudioBPMAndSync(track);
+	track->publishStagingBuffer();
+	auto staged = track->getStagedAudio();
+	if (!staged)
+		return;
+	track->stageLoopSuggestion();
+	juce::File permanentFile;
+	if (track->usePages.load())
+	{
+		permanentFile = getTrackPageAudioFile(trackId, track->currentPageIndex);
+	}
+	else
+	{
+		permanentFile = getTrackAudioFile(trackId);
+	}
+	permanentFile.getParentDirectory().createDirectory();
+
+	DBG("Saving buffer(s) with " << staged->getNumSamples() << " samples");
+	GenerationTrace::transition(track->stagingTrace, GenerationTrace::Phase::wavWrite);
+	if (track->nextHasOriginalVersion.load())
+	{
+		saveOriginalAndStretchedBuffers(track->originalStagingBuffer, *staged, trackId, track->stagingSampleRate);
+		DBG("Both files saved for track: " << trackId);
+	}
+	else
+	{
+		saveBufferToFile(*staged, permanentFile, track->stagingSampleRate);
+		DBG("File saved to: " << permanentFile.getFullPathName());
+	}
+
+	if (track->usePages.load())
+	{
+		auto& currentPage = track->getCurrentPage();
+		currentPage.audioFilePath = permanentFile.getFullPathName();
+	}
+	else
+	{
+		track->audioFilePath = permanentFile.getFullPathName();
+	}
+	GenerationTrace::transition(track->stagingTrace, GenerationTrace::Phase::swap);
+	auto trace = std::move(track->stagingTrace);
+	auto requestedMs = juce::Time::getMillisecondCounterHiRes();
+	track->hasStagingData = true;
+	track->swapRequested = true;
+	if (trace)
+		finishTraceAfterSwap(track, std::move(trace), requestedMs);
+
+	juce::MessageManager::callAsync([this]()
+		{
+			if (auto* editor = dynamic_cast<DjIaVstEditor*>(getActiveEditor())) {
+				editor->statusLabel.setText("Sample loaded! Ready to play.", juce::dontSendNotification);
+				juce::Timer::callAfterDelay(2000, [this]() {
+					if (auto* editor = dynamic_cast<DjIaVstEditor*>(getActiveEditor())) {
+						editor->statusLabel.setText("Ready", juce::dontSendNotification);
+					}
+					});
+			} });
+}
+
 void DjIaVstProcessor::reloadTrackWithVersion(const juce::String& trackId, bool useOriginal)
 {
 	TrackData* track = trackManager.getTrack(trackId);
@@ -2468,41 +3036,32 @@ void DjIaVstProcessor::loadAudioFileForPageSwitch(const juce::String& trackId, i
 
 	try
 	{
-		juce::AudioFormatManager formatManager;
-		formatManager.registerBasicFormats();
-
-		std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(audioFile));
-		if (!reader)
+		// Toggling back and forth finds both versions still in memory.
+		double sampleRate = 0.0;
+		auto audio = SharedAudioCache::getInstance().load(audioFile, sampleRate);
+		if (!audio)
 			return;
-		int numChannels = reader->numChannels;
-		int numSamples = static_cast<int>(reader->lengthInSamples);
+		int numSamples = audio->getNumSamples();
 
-		track->stagingBuffer.setSize(2, numSamples);
-		reader->read(&track->stagingBuffer, 0, numSamples, 0, true, true);
-
-		if (numChannels == 1)
+		if (pageIndex == track->currentPageIndex)
 		{
-			track->stagingBuffer.copyFrom(1, 0, track->stagingBuffer, 0, 0, numSamples);
-		}
+			track->stagingNumSamples = numSamples;
+			track->stagingSampleRate = sampleRate;
+			track->stageAudio(std::move(audio), page.getAnalysis());
 
-		track->stagingNumSamples = numSamples;
-		track->stagingSampleRate = reader->sampleRate;
+			track->isVersionSwitch = true;
+			track->preservedLoopStart = preservedLoopStart;
+			track->preservedLoopEnd = preservedLoopEnd;
+			track->preservedLoopLocked = preservedLocked;
 
-		track->isVersionSwitch = true;
-		track->preservedLoopStart = preservedLoopStart;
-		track->preservedLoopEnd = preservedLoopEnd;
-		track->preservedLoopLocked = preservedLocked;
-
-		if (pageIndex == track->currentPageIndex)
-		{
 			track->hasStagingData = true;
 			track->swapRequested = true;
 		}
 		else
 		{
-			page.audioBuffer.makeCopyOf(track->stagingBuffer);
 			page.numSamples = numSamples;
-			page.sampleRate = reader->sampleRate;
+			page.sampleRate = sampleRate;
+			page.publishAudio(std::move(audio));
 			page.isLoaded = true;
 		}
 
@@ -2528,15 +3087,13 @@ void DjIaVstProcessor::loadAudioFileForSwitch(const juce::String& trackId, const
 
 	try
 	{
-		juce::AudioFormatManager formatManager;
-		formatManager.registerBasicFormats();
-
-		std::unique_ptr<juce::AudioFormatReader> reader(
-			formatManager.createReaderFor(audioFile));
-
-		if (!reader)
+		double sampleRate = 0.0;
+		auto audio = SharedAudioCache::getInstance().load(audioFile, sampleRate);
+		if (!audio)
 			return;
-		loadAudioToStagingBuffer(reader, track);
+		track->stagingNumSamples = audio->getNumSamples();
+		track->stagingSampleRate = sampleRate;
+		track->stageAudio(std::move(audio), track->getAnalysis());
 		track->isVersionSwitch = true;
 		track->preservedLoopStart = preservedLoopStart;
 		track->preservedLoopEnd = preservedLoopEnd;
@@ -2600,33 +3157,39 @@ void DjIaVstProcessor::saveBufferToFile(const juce::AudioBuffer<float>& buffer,
 		return;
 	}
 
-	juce::WavAudioFormat wavFormat;
-	if (outputFile.exists())
 	{
-		outputFile.deleteFile();
-	}
+		// Keeps a queued analysis update from copying the file mid-write.
+		const juce::ScopedLock fileScope(PageCacheFile::getFileLock());
+		juce::WavAudioFormat wavFormat;
+		if (outputFile.exists())
+		{
+			outputFile.deleteFile();
+		}
 
-	juce::FileOutputStream* fileStream = new juce::FileOutputStream(outputFile);
-	if (!fileStream->openedOk())
-	{
-		delete fileStream;
-		return;
-	}
+		juce::FileOutputStream* fileStream = new juce::FileOutputStream(outputFile);
+		if (!fileStream->openedOk())
+		{
+			delete fileStream;
+			return;
+		}
 
-	std::unique_ptr<juce::AudioFormatWriter> writer(
-		wavFormat.createWriterFor(fileStream, sampleRate, buffer.getNumChannels(), 16, {}, 0));
-	if (writer == nullptr)
-	{
-		delete fileStream;
-		return;
-	}
+		std::unique_ptr<juce::AudioFormatWriter> writer(
+			wavFormat.createWriterFor(fileStream, sampleRate, buffer.getNumChannels(), 16, {}, 0));
+		if (writer == nullptr)
+		{
+			delete fileStream;
+			return;
+		}
 
-	if (!writer->writeFromAudioSampleBuffer(buffer, 0, buffer.getNumSamples()))
-	{
+		if (!writer->writeFromAudioSampleBuffer(buffer, 0, buffer.getNumSamples()))
+		{
+			writer.reset();
+			return;
+		}
 		writer.reset();
-		return;
+
+		writePageCacheMetadata(buffer, outputFile);
 	}
-	writer.reset();
 
 	if (sampleBank && outputFile.getFileName().endsWith(".wav") && !isLoadingFromBank.load())
 	{
@@ -2638,30 +3201,7 @@ void DjIaVstProcessor::saveBufferToFile(const juce::AudioBuffer<float>& buffer,
 			return;
 		}
 
-		juce::String trackId = filename;
-
-		for (char page = 'A'; page <= 'D'; ++page)
-		{
-			juce::String pageSuffix = "_" + juce::String::charToString(page);
-			if (trackId.endsWith(pageSuffix))
-			{
-				trackId = trackId.dropLastCharacters(2);
-				DBG("Removed new format page suffix: " + pageSuffix);
-				break;
-			}
-		}
-
-		for (int asciiCode = 65; asciiCode <= 68; ++asciiCode)
-		{
-			juce::String asciiSuffix = "_" + juce::String(asciiCode);
-			if (trackId.endsWith(asciiSuffix))
-			{
-				trackId = trackId.dropLastCharacters(asciiSuffix.length());
-				DBG("Removed legacy ASCII page suffix: " + asciiSuffix);
-				break;
-			}
-		}
-
+		juce::String trackId = getTrackIdFromCacheFile(outputFile);
 		DBG("Extracted trackId: " + trackId + " from filename: " + filename);
 
 		if (trackId == currentBankLoadTrackId)
@@ -2716,7 +3256,9 @@ void DjIaVstProcessor::saveBufferToFile(const juce::AudioBuffer<float>& buffer,
 			DBG("Marked previous sample as unused: " + track->currentSampleId);
 		}
 
-		juce::String sampleId = sampleBank->addSample(prompt, outputFile, bpm, key);
+		GenerationTrace::transition(track->stagingTrace, GenerationTrace::Phase::bankCopy);
+		juce::String sampleId = sampleBank->addSample(prompt, outputFile, bpm, key, &buffer, sampleRate);
+		GenerationTrace::transition(track->stagingTrace, GenerationTrace::Phase::wavWrite);
 
 		if (!sampleId.isEmpty())
 		{
@@ -2727,6 +3269,7 @@ void DjIaVstProcessor::saveBufferToFile(const juce::AudioBuffer<float>& buffer,
 			if (track->usePages.load())
 			{
 				track->getCurrentPage().generationPrompt = "";
+				track->getCurrentPage().sampleId = sampleId;
 			}
 			else
 			{
@@ -2740,6 +3283,74 @@ void DjIaVstProcessor::saveBufferToFile(const juce::AudioBuffer<float>& buffer,
 	}
 }
 
+juce::String DjIaVstProcessor::getTrackIdFromCacheFile(const juce::File& file)
+{
+	juce::String trackId = file.getFileNameWithoutExtension();
+
+	for (char page = 'A'; page <= 'D'; ++page)
+	{
+		juce::String pageSuffix = "_" + juce::String::charToString(page);
+		if (trackId.endsWith(pageSuffix))
+		{
+			trackId = trackId.dropLastCharacters(2);
+			break;
+		}
+	}
+
+	for (int asciiCode = 65; asciiCode <= 68; ++asciiCode)
+	{
+		juce::String asciiSuffix = "_" + juce::String(asciiCode);
+		if (trackId.endsWith(asciiSuffix))
+		{
+			trackId = trackId.dropLastCharacters(asciiSuffix.length());
+			break;
+		}
+	}
+
+	if (trackId.endsWith("_original"))
+		trackId = trackId.dropLastCharacters(9);
+
+	return trackId;
+}
+
+// Embeds peaks, generation parameters and, when it is already known and
+// matches this buffer, the analysis into the cached WAV we just wrote.
+void DjIaVstProcessor::writePageCacheMetadata(const juce::AudioBuffer<float>& buffer, const juce::File& outputFile)
+{
+	PageCacheFile::Contents contents;
+	contents.peaks = PeakSummary::build(buffer);
+
+	if (TrackData* track = trackManager.getTrack(getTrackIdFromCacheFile(outputFile)))
+	{
+		auto* generation = new juce::DynamicObject();
+		if (track->usePages.load())
+		{
+			const auto& page = track->getCurrentPage();
+			generation->setProperty("prompt", page.generationPrompt.isNotEmpty() ? page.generationPrompt : page.selectedPrompt);
+			generation->setProperty("bpm", (double)page.generationBpm);
+			generation->setProperty("key", page.generationKey);
+			generation->setProperty("duration", page.generationDuration);
+			generation->setProperty("seed", page.generationSeed);
+		}
+		else
+		{
+			generation->setProperty("prompt", track->generationPrompt.isNotEmpty() ? track->generationPrompt : track->selectedPrompt);
+			generation->setProperty("bpm", (double)track->generationBpm);
+			generation->setProperty("key", track->generationKey);
+			generation->setProperty("duration", track->generationDuration);
+			generation->setProperty("seed", track->generationSeed);
+		}
+		contents.generation = juce::var(generation);
+
+		auto analysis = track->stagingAnalysis;
+		if (analysis && analysis->numSamples == buffer.getNumSamples())
+			contents.analysis = analysis;
+	}
+
+	if (!PageCacheFile::write(outputFile, contents))
+		DBG("Could not embed cache metadata in " + outputFile.getFullPathName());
+}
+
 juce::File DjIaVstProcessor::getTrackAudioFile(const juce::String& trackId)
 {
 	auto audioDir = juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
@@ -2765,11 +3376,24 @@ void DjIaVstProcessor::processAudioBPMAndSync(TrackData* track)
 	track->nextHasOriginalVersion.store(false);
 
 	float serverDetectedBpm = pendingDetectedBpm.load();
-	float soundTouchDetectedBpm = AudioAnalyzer::detectBPM(track->stagingBuffer, track->stagingSampleRate);
+	GenerationTrace::transition(track->stagingTrace, GenerationTrace::Phase::bpmDetect);
+	AudioAnalyzer::TempoEstimate tempo;
+	const auto& knownAnalysis = track->stagingAnalysis;
+	if (knownAnalysis && knownAnalysis->isCurrent()
+		&& knownAnalysis->numSamples == track->stagingBuffer.getNumSamples())
+	{
+		tempo = knownAnalysis->getTempo();
+		DBG("Using stored sample analysis: " + juce::String(tempo.bpm, 2) + " BPM");
+	}
+	else
+	{
+		tempo = AudioAnalyzer::analyzeTempo(track->stagingBuffer, track->stagingSampleRate);
+	}
+	float analyzedBpm = tempo.bpm;
 	double hostBpm = cachedHostBpm.load();
 
 	float correctedServerBpm = serverDetectedBpm;
-	float correctedSoundTouchBpm = soundTouchDetectedBpm;
+	float correctedAnalyzedBpm = analyzedBpm;
 
 	if (hostBpm > 0)
 	{
@@ -2806,33 +3430,33 @@ void DjIaVstProcessor::processAudioBPMAndSync(TrackData* track)
 			}
 		}
 
-		if (soundTouchDetectedBpm > 0.0f)
+		if (analyzedBpm > 0.0f)
 		{
-			float directDiff = std::abs(soundTouchDetectedBpm - static_cast<float>(hostBpm));
-			float halfDiff = std::abs(soundTouchDetectedBpm * 2.0f - static_cast<float>(hostBpm));
-			float doubleDiff = std::abs(soundTouchDetectedBpm / 2.0f - static_cast<float>(hostBpm));
+			float directDiff = std::abs(analyzedBpm - static_cast<float>(hostBpm));
+			float halfDiff = std::abs(analyzedBpm * 2.0f - static_cast<float>(hostBpm));
+			float doubleDiff = std::abs(analyzedBpm / 2.0f - static_cast<float>(hostBpm));
 
 			if (directDiff <= directTolerance)
 			{
-				correctedSoundTouchBpm = soundTouchDetectedBpm;
-				DBG("SoundTouch BPM is close enough: " + juce::String(soundTouchDetectedBpm, 2));
+				correctedAnalyzedBpm = analyzedBpm;
+				DBG("Analyzed BPM is close enough: " + juce::String(analyzedBpm, 2));
 			}
 			else if (halfDiff < directDiff && halfDiff <= halfDoubleTolerance)
 			{
-				correctedSoundTouchBpm = soundTouchDetectedBpm * 2.0f;
-				DBG("SoundTouch BPM corrected for half tempo: " + juce::String(soundTouchDetectedBpm, 2) +
-					" -> " + juce::String(correctedSoundTouchBpm, 2));
+				correctedAnalyzedBpm = analyzedBpm * 2.0f;
+				DBG("Analyzed BPM corrected for half tempo: " + juce::String(analyzedBpm, 2) +
+					" -> " + juce::String(correctedAnalyzedBpm, 2));
 			}
 			else if (doubleDiff < directDiff && doubleDiff <= halfDoubleTolerance)
 			{
-				correctedSoundTouchBpm = soundTouchDetectedBpm / 2.0f;
-				DBG("SoundTouch BPM corrected for double tempo: " + juce::String(soundTouchDetectedBpm, 2) +
-					" -> " + juce::String(correctedSoundTouchBpm, 2));
+				correctedAnalyzedBpm = analyzedBpm / 2.0f;
+				DBG("Analyzed BPM corrected for double tempo: " + juce::String(analyzedBpm, 2) +
+					" -> " + juce::String(correctedAnalyzedBpm, 2));
 			}
 			else
 			{
-				correctedSoundTouchBpm = soundTouchDetectedBpm;
-				DBG("SoundTouch BPM used as-is (no good match): " + juce::String(soundTouchDetectedBpm, 2));
+				correctedAnalyzedBpm = analyzedBpm;
+				DBG("Analyzed BPM used as-is (no good match): " + juce::String(analyzedBpm, 2));
 			}
 		}
 	}
@@ -2846,8 +3470,18 @@ void DjIaVstProcessor::processAudioBPMAndSync(TrackData* track)
 	}
 	else
 	{
-		detectedBPM = correctedSoundTouchBpm;
-		DBG("Using SoundTouch-detected BPM (server unavailable): " + juce::String(detectedBPM, 2));
+		detectedBPM = correctedAnalyzedBpm;
+		DBG("Using analyzed BPM (server unavailable): " + juce::String(detectedBPM, 2)
+			+ ", confidence " + juce::String(tempo.confidence, 2));
+	}
+
+	// Without a server estimate, a low-confidence local tempo is more likely to
+	// be wrong than the host's, and stretching to a wrong tempo is audible.
+	bool tempoTrusted = serverDetectedBpm > 0.0f || tempo.confidence >= AudioAnalyzer::minimumTempoConfidence;
+	if (!tempoTrusted)
+	{
+		DBG("Tempo confidence too low (" + juce::String(tempo.confidence, 2) + "), skipping time-stretch");
+		detectedBPM = 0.0f;
 	}
 
 	pendingDetectedBpm.store(-1.0f);
@@ -2860,8 +3494,9 @@ void DjIaVstProcessor::processAudioBPMAndSync(TrackData* track)
 	bool originalBpmValid = (track->stagingOriginalBpm > 0.0f);
 	bool bpmDifferenceSignificant = (bpmDifference > 0.01 && bpmDifference < 5.0);
 
-	if ((hostBpmValid && originalBpmValid && bpmDifferenceSignificant) || useLocalModel)
+	if (tempoTrusted && ((hostBpmValid && originalBpmValid && bpmDifferenceSignificant) || useLocalModel))
 	{
+		GenerationTrace::transition(track->stagingTrace, GenerationTrace::Phase::timeStretch);
 		track->originalStagingBuffer.makeCopyOf(track->stagingBuffer);
 		double stretchRatio = hostBpm / static_cast<double>(track->stagingOriginalBpm);
 		AudioAnalyzer::timeStretchBufferHQ(track->stagingBuffer, stretchRatio, track->stagingSampleRate);
@@ -2891,20 +3526,19 @@ void DjIaVstProcessor::processAudioBPMAndSync(TrackData* track)
 	}
 }
 
-void DjIaVstProcessor::loadAudioToStagingBuffer(std::unique_ptr<juce::AudioFormatReader>& reader, TrackData* track)
+void DjIaVstProcessor::loadBufferToStagingBuffer(juce::AudioBuffer<float>& audio, double sampleRate, TrackData* track)
 {
-	int numChannels = reader->numChannels;
-	int numSamples = static_cast<int>(reader->lengthInSamples);
-	double sampleRate = reader->sampleRate;
-
-	track->stagingBuffer.setSize(2, numSamples, false, false, true);
-	track->stagingBuffer.clear();
+	int numSamples = audio.getNumSamples();
 
-	reader->read(&track->stagingBuffer, 0, numSamples, 0, true, true);
-
-	if (numChannels == 1)
+	if (audio.getNumChannels() == 2)
 	{
-		track->stagingBuffer.copyFrom(1, 0, track->stagingBuffer, 0, 0, numSamples);
+		track->stagingBuffer = std::move(audio);
+	}
+	else
+	{
+		track->stagingBuffer.setSize(2, numSamples, false, false, true);
+		track->stagingBuffer.copyFrom(0, 0, audio, 0, 0, numSamples);
+		track->stagingBuffer.copyFrom(1, 0, audio, juce::jmin(1, audio.getNumChannels() - 1), 0, numSamples);
 	}
 
 	track->stagingNumSamples = numSamples;
@@ -2925,6 +3559,8 @@ void DjIaVstProcessor::clearPendingAudio()
 {
 	const juce::ScopedLock lock(apiLock);
 	pendingAudioFile = juce::File();
+	pendingAudioBuffer.reset();
+	pendingTrace.reset();
 	pendingTrackId.clear();
 	hasPendingAudioData = false;
 }
@@ -3356,11 +3992,8 @@ void DjIaVstProcessor::handleSequenceChange(const juce::String& parameterID)
 			currentPage.currentSequenceIndex = seqNumber - 1;
 
 			DBG("Switched to sequence " << seqNumber << " for slot " << slotNumber);
-			juce::MessageManager::callAsync([this]()
-				{
-					if (onUIUpdateNeeded)
-						onUIUpdateNeeded();
-				});
+			markUIDirty(uiDirtyTracks);
+			markSequencerDirty(track->slotIndex);
 			break;
 		}
 	}
@@ -3689,8 +4322,7 @@ void DjIaVstProcessor::executePendingAction(TrackData* track) const
 		track->isPlaying = false;
 		track->isArmedToStop = false;
 		track->isCurrentlyPlaying = false;
-		if (onUIUpdateNeeded)
-			onUIUpdateNeeded();
+		markUIDirty(uiDirtyTracks);
 		break;
 
 	default:
@@ -3745,20 +4377,7 @@ void DjIaVstProcessor::updateSequencers(bool hostIsPlaying)
 			if (shouldAdvanceStep)
 			{
 				handleAdvanceStep(track, hostIsPlaying);
-			}
-
-			if (auto* editor = dynamic_cast<DjIaVstEditor*>(getActiveEditor()))
-			{
-				juce::Component::SafePointer<DjIaVstEditor> safeEditor(editor);
-				juce::MessageManager::callAsync([safeEditor, trackId]()
-					{
-						if (safeEditor.getComponent() != nullptr)
-						{
-							if (auto* sequencer = static_cast<SequencerComponent*>(safeEditor->getSequencerForTrack(trackId)))
-							{
-								sequencer->updateFromTrackData();
-							}
-						} });
+				markSequencerDirty(track->slotIndex);
 			}
 		}
 	}
@@ -3859,7 +4478,7 @@ bool DjIaVstProcessor::previewSampleFromBank(const juce::String& sampleId)
 {
 	if (!sampleBank)
 		return false;
-	auto* entry = sampleBank->getSample(sampleId);
+	auto entry = sampleBank->getSample(sampleId);
 	if (!entry)
 		return false;
 
@@ -3867,42 +4486,10 @@ bool DjIaVstProcessor::previewSampleFromBank(const juce::String& sampleId)
 	if (!sampleFile.exists())
 		return false;
 
-	juce::AudioFormatManager formatManager;
-	formatManager.registerBasicFormats();
-	std::unique_ptr<juce::AudioFormatReader> testReader(formatManager.createReaderFor(sampleFile));
-	if (!testReader)
-	{
-		DBG("Cannot read audio file: " + sampleFile.getFullPathName());
-		return false;
-	}
-
+	// The file is opened and streamed by the preview voice; one it cannot
+	// read just ends the preview.
 	stopSamplePreview();
-
-	juce::Thread::launch([this, sampleFile]()
-		{
-			juce::AudioFormatManager formatManager;
-			formatManager.registerBasicFormats();
-			std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(sampleFile));
-			if (!reader) {
-				juce::ScopedLock lock(previewLock);
-				isPreviewPlaying = false;
-				return;
-			}
-
-			{
-				juce::ScopedLock lock(previewLock);
-				previewBuffer.setSize(2, (int)reader->lengthInSamples);
-				reader->read(&previewBuffer, 0, (int)reader->lengthInSamples, 0, true, true);
-				if (reader->numChannels == 1)
-				{
-					previewBuffer.copyFrom(1, 0, previewBuffer, 0, 0, previewBuffer.getNumSamples());
-				}
-				previewSampleRate = reader->sampleRate;
-				previewPosition = 0.0;
-				isPreviewPlaying = true;
-			}
-			DBG("Preview loaded: " + sampleFile.getFileName()); });
-
+	previewVoice.play(sampleFile);
 	return true;
 }
 
@@ -3933,8 +4520,7 @@ void DjIaVstProcessor::triggerSequencerStep(TrackData* track)
 
 void DjIaVstProcessor::stopSamplePreview()
 {
-	isPreviewPlaying = false;
-	previewPosition = 0.0;
+	previewVoice.stop();
 	if (!currentPreviewTrackId.isEmpty())
 	{
 		if (auto* editor = dynamic_cast<DjIaVstEditor*>(getActiveEditor()))
@@ -3974,29 +4560,23 @@ void DjIaVstProcessor::loadSampleToBankPage(const juce::String& trackId, int pag
 
 	try
 	{
-		juce::AudioFormatManager formatManager;
-		formatManager.registerBasicFormats();
-
-		std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(sampleFile));
-		if (!reader)
+		// The same bank sample on several tracks or pages is decoded once.
+		double sampleRate = 0.0;
+		auto decoded = SharedAudioCache::getInstance().load(sampleFile, sampleRate);
+		if (!decoded)
 			return;
 
-		int numChannels = reader->numChannels;
-		int numSamples = static_cast<int>(reader->lengthInSamples);
-
-		track->stagingBuffer.setSize(2, numSamples);
-		reader->read(&track->stagingBuffer, 0, numSamples, 0, true, true);
-
-		if (numChannels == 1)
-		{
-			track->stagingBuffer.copyFrom(1, 0, track->stagingBuffer, 0, 0, numSamples);
-		}
-
-		track->stagingNumSamples = numSamples;
-		track->stagingSampleRate = reader->sampleRate;
+		track->stagingBuffer.makeCopyOf(*decoded);
+		track->stagingNumSamples = decoded->getNumSamples();
+		track->stagingSampleRate = sampleRate;
 		track->stagingOriginalBpm = 126.0f;
+		track->stagingAnalysis = sampleBank->getAnalysis(sampleId);
 
 		processAudioBPMAndSync(track);
+		track->publishStagingBuffer();
+		auto staged = track->getStagedAudio();
+		if (!staged)
+			return;
 
 		auto permanentFile = getTrackPageAudioFile(trackId, pageIndex);
 		permanentFile.getParentDirectory().createDirectory();
@@ -4008,21 +4588,26 @@ void DjIaVstProcessor::loadSampleToBankPage(const juce::String& trackId, int pag
 			auto originalFile = getTrackPageAudioFile(trackId + "_original", pageIndex);
 			auto stretchedFile = getTrackPageAudioFile(trackId, pageIndex);
 			saveBufferToFile(track->originalStagingBuffer, originalFile, track->stagingSampleRate);
-			saveBufferToFile(track->stagingBuffer, stretchedFile, track->stagingSampleRate);
+			saveBufferToFile(*staged, stretchedFile, track->stagingSampleRate);
 		}
 		else
 		{
-			saveBufferToFile(track->stagingBuffer, permanentFile, track->stagingSampleRate);
+			saveBufferToFile(*staged, permanentFile, track->stagingSampleRate);
 		}
 
 		page.audioFilePath = permanentFile.getFullPathName();
 		page.numSamples = track->stagingNumSamples.load();
 		page.sampleRate = track->stagingSampleRate.load();
 		page.originalBpm = track->stagingOriginalBpm;
+		page.sampleId = sampleId;
 		page.isLoaded = true;
 		page.isLoading = false;
+		if (pageIndex != track->currentPageIndex)
+		{
+			page.playback.store(track->stagingPlayback.load());
+		}
 
-		auto* sampleEntry = sampleBank->getSample(sampleId);
+		auto sampleEntry = sampleBank->getSample(sampleId);
 		if (sampleEntry)
 		{
 			page.prompt = sampleEntry->originalPrompt;
@@ -4033,6 +4618,7 @@ void DjIaVstProcessor::loadSampleToBankPage(const juce::String& trackId, int pag
 
 		if (pageIndex == track->currentPageIndex)
 		{
+			track->stageLoopSuggestion();
 			track->hasStagingData = true;
 			track->swapRequested = true;
 		}
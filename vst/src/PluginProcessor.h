@@ -6,6 +6,11 @@
 #include "ObsidianEngine.h"
 #include "SimpleEQ.h"
 #include "SampleBank.h"
+#include "GenerationCache.h"
+#include "VariationPool.h"
+#include "GenerationTelemetry.h"
+#include "OutputMeter.h"
+#include "PreviewVoice.h"
 #include <memory>
 #include <unordered_map>
 #include <vector>
@@ -16,20 +21,20 @@ class TrackComponent;
 
 class DjIaVstProcessor : public juce::AudioProcessor,
 	public juce::AudioProcessorValueTreeState::Listener,
-	public juce::Timer,
-	public juce::AsyncUpdater
+	public juce::AsyncUpdater,
+	public SampleBank::Listener
 {
 public:
 	struct GenerationListener
 	{
 		virtual ~GenerationListener() = default;
 		virtual void onGenerationComplete(const juce::String& trackId, const juce::String& message) = 0;
+		virtual void onGenerationProgress(const juce::String& /*trackId*/, const juce::String& /*stage*/, float /*percent*/) {}
 	};
 
 	DjIaVstProcessor();
 	~DjIaVstProcessor() override;
 
-	std::function<void()> onUIUpdateNeeded;
 	std::function<void(double)> onHostBpmChanged = nullptr;
 
 	juce::AudioProcessorEditor* createEditor() override;
@@ -42,6 +47,11 @@ public:
 	DjIaClient& getApiClient() { return apiClient; }
 
 	SampleBank* getSampleBank() { return sampleBank.get(); }
+	void sampleAnalyzed(const juce::String& sampleId, SampleAnalysis::Ptr analysis) override
+	{
+		attachSampleAnalysis(sampleId, analysis);
+	}
+	GenerationCache* getGenerationCache() { return generationCache.get(); }
 
 	TrackData* getCurrentTrack() { return trackManager.getTrack(selectedTrackId); }
 	TrackData* getTrack(const juce::String& trackId) { return trackManager.getTrack(trackId); }
@@ -63,7 +73,39 @@ public:
 	juce::AudioProcessorValueTreeState& getParameterTreeState() { return parameters; }
 	juce::AudioProcessorValueTreeState& getParameters() { return parameters; }
 
-	std::atomic<bool> needsUIUpdate{ false };
+	// What the editor has to refresh on its next frame. Set from any thread
+	// (including the audio thread) and consumed once per vblank, so nothing
+	// here allocates or posts messages.
+	enum UIDirtyFlags : juce::uint32
+	{
+		uiDirtyTracks = 1 << 0,
+		uiDirtyPlayback = 1 << 1
+	};
+
+	void markUIDirty(juce::uint32 flags) { uiDirtyFlags.fetch_or(flags, std::memory_order_release); }
+	void markSequencerDirty(int slotIndex)
+	{
+		if (slotIndex >= 0 && slotIndex < 32)
+			dirtySequencerSlots.fetch_or(1u << slotIndex, std::memory_order_release);
+	}
+	void markSampleLoaded(int slotIndex)
+	{
+		if (slotIndex >= 0 && slotIndex < 32)
+			loadedSampleSlots.fetch_or(1u << slotIndex, std::memory_order_release);
+	}
+	juce::uint32 consumeUIDirtyFlags() { return uiDirtyFlags.exchange(0, std::memory_order_acquire); }
+	juce::uint32 consumeDirtySequencerSlots() { return dirtySequencerSlots.exchange(0, std::memory_order_acquire); }
+	juce::uint32 consumeLoadedSampleSlots() { return loadedSampleSlots.exchange(0, std::memory_order_acquire); }
+
+	// Levels of what was actually sent to the host, measured in processBlock.
+	// Reading takes the peak accumulated since the previous read.
+	OutputMeter::Reading readTrackMeter(int slotIndex)
+	{
+		if (slotIndex < 0 || slotIndex >= MAX_TRACKS)
+			return {};
+		return trackMeters[(size_t)slotIndex].read();
+	}
+	OutputMeter::Reading readMasterMeter() { return masterMeter.read(); }
 
 	juce::String getGlobalKey() const { return globalKey; }
 	juce::String getGlobalPrompt() const { return globalPrompt; }
@@ -97,7 +139,6 @@ public:
 	juce::File getExportDirectory();
 	juce::File exportSampleForDragDrop(const juce::File& originalFile);
 
-	void timerCallback() override;
 	void setGenerationListener(GenerationListener* listener) { generationListener = listener; }
 	void initDummySynth();
 	void initTracks();
@@ -141,6 +182,7 @@ public:
 	void selectTrack(const juce::String& trackId);
 	void reorderTracks(const juce::String& fromTrackId, const juce::String& toTrackId);
 	void generateLoop(const DjIaClient::LoopRequest& request, const juce::String& targetTrackId = "");
+	void cancelGeneration();
 	void startNotePlaybackForTrack(const juce::String& trackId, int noteNumber, double hostBpm = 126.0);
 	void setApiKey(const juce::String& key);
 	void setServerUrl(const juce::String& url);
@@ -165,11 +207,15 @@ public:
 	void previewTrack(const juce::String& trackId);
 	void setGlobalStems(const std::vector<juce::String>& stems) { globalStems = stems; }
 	void setUseLocalModel(bool useLocal) { useLocalModel = useLocal; }
+	void setGenerationCacheEnabled(bool enabled);
+	void setGenerationCacheMaxMB(int maxMB);
+	void setSpeculativeVariations(int variationsPerTrack);
 	void loadSampleFromBank(const juce::String& sampleId, const juce::String& trackId);
-	void loadAudioFileAsync(const juce::String& trackId, const juce::File& audioData);
+	void loadAudioFileAsync(const juce::String& trackId, const juce::File& audioData, GenerationTrace::Ptr trace = nullptr,
+		SampleAnalysis::Ptr knownAnalysis = nullptr);
 	void stopSamplePreview();
 	void setLocalModelsPath(const juce::String& path) { localModelsPath = path; }
-	void generateSampleWithImage(const juce::String& trackId, const juce::String& base64Image, const juce::StringArray& keywords);
+	void generateSampleWithImage(const juce::String& trackId, const CanvasImage::Ptr& image, const juce::StringArray& keywords);
 	void generateLoopWithImage(const DjIaClient::LoopRequest& request, const juce::String& trackId, int timeoutMS);
 	void setGlobalBpm(float bpm) { globalBpm = bpm; }
 	void setCanLoad(bool load) { canLoad = load; }
@@ -218,6 +264,7 @@ public:
 	double calculateRetriggerInterval(int intervalValue, double hostBpm) const;
 
 	bool getUseLocalModel() const { return useLocalModel; }
+	bool getGenerationCacheEnabled() const { return generationCacheEnabled; }
 	bool getIsGenerating() const { return isGenerating; }
 	bool hasSampleWaiting() const { return hasUnloadedSample.load(); }
 	bool getHostBpmEnabled() const { return hostBpmEnabled; }
@@ -233,7 +280,7 @@ public:
 	bool isBusesLayoutSupported(const BusesLayout& layouts) const override;
 	bool getDrumsEnabled() const { return drumsEnabled; }
 	bool getBypassSequencer() const { return bypassSequencer.load(); }
-	bool isSamplePreviewing() const { return isPreviewPlaying.load(); }
+	bool isSamplePreviewing() const { return previewVoice.isPlaying(); }
 	bool previewSampleFromBank(const juce::String& sampleId);
 	bool isStateReady() const { return stateLoaded; }
 	bool getAutoLoadEnabled() const { return autoLoadEnabled.load(); }
@@ -242,6 +289,9 @@ public:
 
 	int getSamplesPerBlock() const { return currentBlockSize; };
 	int getRequestTimeout() const { return requestTimeoutMS; };
+	int getGenerationCacheMaxMB() const { return generationCacheMaxMB; }
+	int getSpeculativeVariations() const { return speculativeVariations; }
+	SpeculativeGenerator::Stats getSpeculativeStats() const { return speculativeGenerator.getStats(); }
 	int getGlobalDuration() const { return globalDuration; }
 	int getLastKeyIndex() const { return lastKeyIndex; }
 	int getNumPrograms() override { return 1; }
@@ -261,7 +311,12 @@ private:
 	GenerationListener* generationListener = nullptr;
 	juce::String projectId;
 	bool migrationCompleted = false;
-	std::unique_ptr<SampleBank> sampleBank;
+	// Shared with every other instance in this host process.
+	std::shared_ptr<SampleBank> sampleBank;
+	// Shared with every other instance in this host process.
+	std::shared_ptr<GenerationCache> generationCache;
+	// Analysis updates to the cached page files, one at a time.
+	juce::ThreadPool cacheFileWriter{ 1 };
 	juce::StringArray customKeywords;
 
 	std::atomic<float>* nextTrackParam = nullptr;
@@ -269,26 +324,29 @@ private:
 	std::atomic<int64_t> internalSampleCounter{ 0 };
 	std::atomic<double> lastHostBpmForQuantization{ 120.0 };
 
-	std::atomic<bool> isPreviewPlaying{ false };
-	juce::AudioBuffer<float> previewBuffer;
-	std::atomic<double> previewPosition{ 0.0 };
-	std::atomic<double> previewSampleRate{ 44100.0 };
-	juce::CriticalSection previewLock;
+	PreviewVoice previewVoice;
 
 	std::atomic<bool> isLoadingFromBank{ false };
 	juce::String currentBankLoadTrackId;
 	juce::String currentPreviewTrackId;
 
-	std::future<void> sampleBankInitFuture;
 	std::atomic<bool> sampleBankReady{ false };
 
 	bool useLocalModel = false;
 	juce::String localModelsPath = "";
 
+	bool generationCacheEnabled = false;
+	int generationCacheMaxMB = 1024;
+	int speculativeVariations = 0;
+
+	VariationPool variationPool;
+	SpeculativeGenerator speculativeGenerator{ variationPool };
+
 	juce::Synthesiser synth;
 
 	static juce::AudioProcessor::BusesProperties createBusLayout();
 	static const int MAX_TRACKS = 8;
+	static const int swapTraceTimeoutMs = 2000;
 
 	juce::StringArray customPrompts;
 
@@ -327,6 +385,8 @@ private:
 	void handleAsyncUpdate() override;
 
 	std::unique_ptr<ObsidianEngine> obsidianEngine;
+	std::shared_ptr<StableAudioEngine> localAudioEngine;
+	juce::CriticalSection localEngineLock;
 
 	struct PendingRequest
 	{
@@ -339,9 +399,15 @@ private:
 	std::mutex requestsMutex;
 
 	juce::CriticalSection apiLock;
+	GenerationControl::Ptr activeGenerationControl;
+	GenerationTrace::Ptr activeTrace;
+	GenerationTrace::Ptr pendingTrace;
+	GenerationTelemetry generationTelemetry;
 	juce::CriticalSection sequencerMidiLock;
 
 	juce::File pendingAudioFile;
+	std::shared_ptr<juce::AudioBuffer<float>> pendingAudioBuffer;
+	double pendingAudioBufferSampleRate = 0.0;
 
 	juce::MidiBuffer sequencerMidiBuffer;
 
@@ -394,6 +460,13 @@ private:
 	std::atomic<double> cachedHostBpm{ 126.0 };
 
 	std::vector<juce::AudioBuffer<float>> individualOutputBuffers;
+	std::array<OutputMeter, MAX_TRACKS> trackMeters;
+	OutputMeter masterMeter;
+	// processBlock's claim on the track slots it reads; lets loaders free
+	// replaced audio once the block that might still be using it is over.
+	SharedAudioCache::Reader audioReader;
+	class PendingLoadWorker;
+	std::unique_ptr<PendingLoadWorker> pendingLoadWorker;
 
 	std::unordered_map<int, juce::String> playingTracks;
 
@@ -408,6 +481,12 @@ private:
 	std::atomic<bool> stateLoaded{ false };
 	std::atomic<bool> canLoad{ false };
 	std::atomic<bool> bypassSequencer{ false };
+	std::atomic<juce::uint32> uiDirtyFlags{ 0 };
+	std::atomic<juce::uint32> dirtySequencerSlots{ 0 };
+	std::atomic<juce::uint32> loadedSampleSlots{ 0 };
+	// Set by the audio thread once the pending sample may load; the load
+	// worker picks it up, so processBlock never launches threads or posts.
+	std::atomic<bool> loadRequested{ false };
 
 	std::atomic<float>* generateParam = nullptr;
 	std::atomic<float>* playParam = nullptr;
@@ -443,6 +522,7 @@ private:
 	}
 
 	void processIncomingAudio(bool hostIsPlaying);
+	void dispatchPendingLoad();
 	void clearPendingAudio();
 	void processMidiMessages(juce::MidiBuffer& midiMessages, bool hostIsPlaying, double hostBpm);
 	void playTrack(const juce::MidiMessage& message, double hostBpm);
@@ -450,7 +530,9 @@ private:
 	void updateTimeStretchRatios(double hostBpm);
 	void updateMasterEQ();
 	void processAudioBPMAndSync(TrackData* track);
-	void loadAudioToStagingBuffer(std::unique_ptr<juce::AudioFormatReader>& reader, TrackData* track);
+	void loadBufferToStagingBuffer(juce::AudioBuffer<float>& audio, double sampleRate, TrackData* track);
+	void loadAudioBufferAsync(const juce::String& trackId, std::shared_ptr<juce::AudioBuffer<float>> audio, double sampleRate, GenerationTrace::Ptr trace = nullptr);
+	void finishStagedLoad(const juce::String& trackId, TrackData* track);
 	void checkAndSwapStagingBuffers();
 	void performAtomicSwap(TrackData* track, const juce::String& trackId);
 	void updateWaveformDisplay(const juce::String& trackId);
@@ -463,13 +545,36 @@ private:
 	void saveBufferToFile(const juce::AudioBuffer<float>& buffer,
 		const juce::File& outputFile,
 		double sampleRate);
+	void writePageCacheMetadata(const juce::AudioBuffer<float>& buffer, const juce::File& outputFile);
+	juce::String getTrackIdFromCacheFile(const juce::File& file);
 	void executePendingAction(TrackData* track) const;
 	void handleGenerate();
 	void notifyGenerationComplete(const juce::String& trackId, const juce::String& message);
 	void generateLoopFromMidi(const juce::String& trackId);
 	void updateMidiIndicatorWithActiveNotes(double hostBpm, const juce::Array<int>& triggeredNotes);
-	void generateLoopAPI(const DjIaClient::LoopRequest& request, const juce::String& trackId);
-	void generateLoopLocal(const DjIaClient::LoopRequest& request, const juce::String& trackId);
+	void generateLoopAPI(const DjIaClient::LoopRequest& request, const juce::String& trackId, const GenerationControl::Ptr& control);
+	void generateLoopLocal(const DjIaClient::LoopRequest& request, const juce::String& trackId, const GenerationControl::Ptr& control);
+	GenerationControl::Ptr beginGenerationControl(const juce::String& trackId);
+	void endGenerationControl(const GenerationControl::Ptr& control);
+	void finishCancelledGeneration(const juce::String& trackId);
+	void beginGenerationTrace(const juce::String& trackId);
+	void publishPendingTraceLocked(const juce::String& source = {});
+	void abandonActiveTrace(const juce::String& outcome);
+	void finishTraceAfterSwap(TrackData* track, GenerationTrace::Ptr trace, double requestedMs);
+	void finishGenerationTrace(const GenerationTrace::Ptr& trace);
+	void attachSampleAnalysis(const juce::String& sampleId, const SampleAnalysis::Ptr& analysis);
+	void applyLoadedLoopPoints(TrackData* track, double& loopStart, double& loopEnd,
+		double sampleDuration, float originalBpm, const LoopSuggestion& suggestion);
+	std::shared_ptr<StableAudioEngine> getLocalAudioEngine();
+	juce::String getGenerationBackendId() const;
+	bool loadGenerationFromCache(const DjIaClient::LoopRequest& request, const juce::String& trackId);
+	void storeGenerationInCache(const DjIaClient::LoopRequest& request, const juce::File& audioFile, float detectedBpm);
+	void storeGenerationInCache(const DjIaClient::LoopRequest& request, const juce::AudioBuffer<float>& audio,
+		double sampleRate, float detectedBpm);
+	juce::String getGenerationCacheKey(const DjIaClient::LoopRequest& request) const;
+	bool serveFromVariationPool(const DjIaClient::LoopRequest& request, const juce::String& trackId);
+	void initSpeculativeGenerator();
+	std::vector<SpeculativeGenerator::Target> collectSpeculativeTargets();
 	void saveOriginalAndStretchedBuffers(const juce::AudioBuffer<float>& originalBuffer,
 		const juce::AudioBuffer<float>& stretchedBuffer,
 		const juce::String& trackId,
@@ -490,9 +595,9 @@ private:
 
 	void handleGenerationComplete(const juce::String& trackId,
 		const DjIaClient::LoopRequest& originalRequest,
-		const ObsidianEngine::LoopResponse& response);
+		ObsidianEngine::LoopResponse&& response);
 
-	juce::File createTempAudioFile(const std::vector<float>& audioData, float duration);
+	juce::File createTempAudioFile(const juce::AudioBuffer<float>& buffer, double sampleRate);
 	void performMigrationIfNeeded();
 	void updateTrackPathsAfterMigration();
 	void checkBeatRepeatWithSampleCounter();
@@ -0,0 +1,301 @@
+#pragma once
+#include "JuceHeader.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Sample bank preview, streamed from disk. play() and stop() are called on the
+// message thread and return at once; a background thread opens the file,
+// buffers a short head and keeps a read-ahead ring topped up while the audio
+// thread plays it through a windowed-sinc resampler. The audio thread never
+// locks, allocates or touches the file: streams are handed over and back
+// through atomics, and only the streaming thread creates or deletes them.
+class PreviewVoice : private juce::Thread
+{
+public:
+	PreviewVoice()
+		: juce::Thread("Sample Preview")
+	{
+		formatManager.registerBasicFormats();
+		startThread(juce::Thread::Priority::high);
+	}
+
+	~PreviewVoice() override
+	{
+		stopThread(2000);
+	}
+
+	// Message thread, before the audio thread renders.
+	void prepare(double newSampleRate, int /*maxBlockSize*/)
+	{
+		hostSampleRate = newSampleRate;
+		scratch.setSize(2, scratchSize);
+		for (auto& interpolator : interpolators)
+			interpolator.reset();
+	}
+
+	// Replaces whatever is playing. Rapid calls only open the last file.
+	void play(const juce::File& file)
+	{
+		auto requestGeneration = ++generation;
+		playing = true;
+		{
+			std::lock_guard<std::mutex> lock(requestMutex);
+			requestedFile = file;
+			requested = requestGeneration;
+		}
+		notify();
+	}
+
+	void stop()
+	{
+		++generation;
+		playing = false;
+	}
+
+	bool isPlaying() const { return playing.load(); }
+
+	// Audio thread. Adds the preview into output.
+	void render(juce::AudioBuffer<float>& output, int numSamples)
+	{
+		auto wanted = generation.load(std::memory_order_acquire);
+		if (auto* next = pending.exchange(nullptr, std::memory_order_acq_rel))
+		{
+			release(current);
+			current = next;
+			for (auto& interpolator : interpolators)
+				interpolator.reset();
+		}
+
+		if (current != nullptr && current->generation != wanted)
+			release(current);
+
+		int numChannels = juce::jmin(2, output.getNumChannels());
+		if (current == nullptr || numChannels == 0 || hostSampleRate <= 0.0 || scratch.getNumSamples() == 0)
+			return;
+
+		double ratio = current->sampleRate / hostSampleRate;
+		int maxOutputChunk = juce::jmax(1, (int)((scratchSize - interpolationMargin) / ratio));
+
+		for (int done = 0; done < numSamples;)
+		{
+			int outputCount = juce::jmin(numSamples - done, maxOutputChunk);
+			int needed = (int)std::ceil(outputCount * ratio) + interpolationMargin;
+			int ready = current->fifo.getNumReady();
+			bool endOfFile = current->finishedReading.load(std::memory_order_acquire);
+
+			if (ready == 0 && endOfFile)
+			{
+				if (current->generation == generation.load())
+					playing = false;
+				release(current);
+				return;
+			}
+
+			// The disk fell behind: play what is buffered and leave the rest
+			// of the block silent rather than wait.
+			if (ready < needed && !endOfFile)
+			{
+				outputCount = juce::jmin(outputCount, (int)((ready - interpolationMargin) / ratio));
+				if (outputCount <= 0)
+					return;
+			}
+
+			int available = juce::jmin(ready, needed);
+			int start1, size1, start2, size2;
+			current->fifo.prepareToRead(available, start1, size1, start2, size2);
+			for (int ch = 0; ch < 2; ++ch)
+			{
+				scratch.copyFrom(ch, 0, current->ring, ch, start1, size1);
+				if (size2 > 0)
+					scratch.copyFrom(ch, size1, current->ring, ch, start2, size2);
+			}
+
+			int consumed = 0;
+			for (int ch = 0; ch < 2; ++ch)
+			{
+				float* destination = output.getWritePointer(juce::jmin(ch, numChannels - 1), done);
+				// A mono output gets the average of both channels.
+				float channelGain = numChannels == 1 ? gain * 0.5f : gain;
+				consumed = interpolators[(size_t)ch].processAdding(ratio, scratch.getReadPointer(ch), destination,
+					outputCount, available, 0, channelGain);
+			}
+			current->fifo.finishedRead(juce::jmin(consumed, available));
+			done += outputCount;
+		}
+	}
+
+private:
+	struct Stream
+	{
+		std::unique_ptr<juce::AudioFormatReader> reader;
+		juce::uint32 generation = 0;
+		double sampleRate = 44100.0;
+		juce::int64 nextReadPosition = 0;
+
+		juce::AbstractFifo fifo{ ringSize };
+		juce::AudioBuffer<float> ring{ 2, ringSize };
+
+		std::atomic<bool> finishedReading{ false };
+		// Set once the audio thread (or nobody) will touch it again.
+		std::atomic<bool> released{ false };
+	};
+
+	// About a second and a half of read-ahead at 44.1 kHz, of which the
+	// first fifth is read before playback starts.
+	static constexpr int ringSize = 1 << 16;
+	static constexpr int headSize = 1 << 14;
+	static constexpr int readChunkSize = 4096;
+	static constexpr int scratchSize = 8192;
+	static constexpr int interpolationMargin = 4;
+	static constexpr float gain = 0.7f;
+
+	// Shared between the threads.
+	std::atomic<juce::uint32> generation{ 0 };
+	std::atomic<bool> playing{ false };
+	std::atomic<Stream*> pending{ nullptr };
+
+	std::mutex requestMutex;
+	juce::File requestedFile;
+	juce::uint32 requested = 0;
+
+	// Streaming thread only.
+	juce::AudioFormatManager formatManager;
+	std::vector<std::unique_ptr<Stream>> streams;
+	juce::AudioBuffer<float> readBuffer{ 2, readChunkSize };
+	juce::uint32 opened = 0;
+
+	// Audio thread only.
+	Stream* current = nullptr;
+	double hostSampleRate = 0.0;
+	juce::AudioBuffer<float> scratch;
+	std::array<juce::WindowedSincInterpolator, 2> interpolators;
+
+	static void release(Stream*& stream)
+	{
+		if (stream != nullptr)
+			stream->released.store(true, std::memory_order_release);
+		stream = nullptr;
+	}
+
+	void run() override
+	{
+		while (!threadShouldExit())
+		{
+			openRequestedFile();
+			bool buffering = fillStreams();
+			collectStreams();
+			wait(buffering ? 5 : 50);
+		}
+	}
+
+	void openRequestedFile()
+	{
+		juce::File file;
+		juce::uint32 requestGeneration;
+		{
+			std::lock_guard<std::mutex> lock(requestMutex);
+			if (requested == opened)
+				return;
+			file = requestedFile;
+			requestGeneration = opened = requested;
+		}
+		if (generation.load() != requestGeneration)
+			return;
+
+		auto stream = std::make_unique<Stream>();
+		stream->generation = requestGeneration;
+		stream->reader.reset(formatManager.createReaderFor(file));
+		if (!stream->reader || stream->reader->lengthInSamples <= 0 || stream->reader->sampleRate <= 0.0)
+		{
+			DBG("Cannot preview audio file: " + file.getFullPathName());
+			if (generation.load() == requestGeneration)
+				playing = false;
+			return;
+		}
+		stream->sampleRate = stream->reader->sampleRate;
+
+		while (stream->nextReadPosition < headSize && readNextChunk(*stream))
+		{
+		}
+
+		// Dropped right away if stop() or another play() came in meanwhile.
+		if (generation.load() != requestGeneration)
+			return;
+
+		if (auto* superseded = pending.exchange(stream.get(), std::memory_order_acq_rel))
+			superseded->released = true;
+		streams.push_back(std::move(stream));
+		DBG("Preview streaming: " + file.getFileName());
+	}
+
+	// Tops up every live stream; true while any still has file left to read.
+	bool fillStreams()
+	{
+		auto wanted = generation.load();
+		bool buffering = false;
+		for (auto& stream : streams)
+		{
+			if (stream->released || stream->finishedReading)
+				continue;
+
+			// Superseded but not handed back yet, e.g. while the host is not
+			// processing; don't hold the file open meanwhile.
+			if (stream->generation != wanted)
+			{
+				stream->reader.reset();
+				stream->finishedReading = true;
+				continue;
+			}
+
+			while (stream->fifo.getFreeSpace() >= readChunkSize && readNextChunk(*stream))
+			{
+			}
+			buffering = buffering || !stream->finishedReading;
+		}
+		return buffering;
+	}
+
+	bool readNextChunk(Stream& stream)
+	{
+		auto remaining = stream.reader->lengthInSamples - stream.nextReadPosition;
+		int count = (int)juce::jmin((juce::int64)readChunkSize, remaining);
+		if (count <= 0 || !stream.reader->read(&readBuffer, 0, count, stream.nextReadPosition, true, true))
+		{
+			stream.finishedReading.store(true, std::memory_order_release);
+			return false;
+		}
+		if (stream.reader->numChannels == 1)
+			readBuffer.copyFrom(1, 0, readBuffer, 0, 0, count);
+
+		int start1, size1, start2, size2;
+		stream.fifo.prepareToWrite(count, start1, size1, start2, size2);
+		for (int ch = 0; ch < 2; ++ch)
+		{
+			stream.ring.copyFrom(ch, start1, readBuffer, ch, 0, size1);
+			if (size2 > 0)
+				stream.ring.copyFrom(ch, start2, readBuffer, ch, size1, size2);
+		}
+		stream.fifo.finishedWrite(size1 + size2);
+		stream.nextReadPosition += count;
+
+		if (stream.nextReadPosition >= stream.reader->lengthInSamples)
+		{
+			stream.finishedReading.store(true, std::memory_order_release);
+			return false;
+		}
+		return true;
+	}
+
+	void collectStreams()
+	{
+		streams.erase(std::remove_if(streams.begin(), streams.end(),
+			[](const std::unique_ptr<Stream>& stream) { return stream->released.load(std::memory_order_acquire); }),
+			streams.end());
+	}
+
+	JUCE_DECLARE_NON_COPYABLE(PreviewVoice)
+};
@@ -0,0 +1,363 @@
+#pragma once
+#include "JuceHeader.h"
+#include "AudioAnalyzer.h"
+#include <memory>
+#include <vector>
+
+// Multi-resolution min/max summary of a sample, small enough to draw an
+// overview without opening the audio file. Stored as a binary sidecar next to
+// the sample because it is far too bulky for the bank index JSON.
+struct PeakSummary
+{
+	struct Level
+	{
+		int samplesPerBucket = 0;
+		int numBuckets = 0;
+		// Interleaved per bucket: min/max for each channel.
+		std::vector<juce::int16> minMax;
+	};
+
+	int numChannels = 0;
+	int numSamples = 0;
+	std::vector<Level> levels;
+
+	static PeakSummary build(const juce::AudioBuffer<float>& buffer)
+	{
+		PeakSummary summary;
+		summary.numChannels = juce::jmin(2, buffer.getNumChannels());
+		summary.numSamples = buffer.getNumSamples();
+		if (summary.numChannels == 0 || summary.numSamples == 0)
+			return summary;
+
+		for (int samplesPerBucket : { 256, 2048, 16384 })
+		{
+			Level level;
+			level.samplesPerBucket = samplesPerBucket;
+			level.numBuckets = (summary.numSamples + samplesPerBucket - 1) / samplesPerBucket;
+			level.minMax.resize((size_t)level.numBuckets * summary.numChannels * 2);
+
+			for (int bucket = 0; bucket < level.numBuckets; ++bucket)
+			{
+				int start = bucket * samplesPerBucket;
+				int count = juce::jmin(samplesPerBucket, summary.numSamples - start);
+				for (int ch = 0; ch < summary.numChannels; ++ch)
+				{
+					auto range = juce::FloatVectorOperations::findMinAndMax(buffer.getReadPointer(ch, start), count);
+					auto index = ((size_t)bucket * summary.numChannels + ch) * 2;
+					level.minMax[index] = toInt16(range.getStart());
+					level.minMax[index + 1] = toInt16(range.getEnd());
+				}
+			}
+			summary.levels.push_back(std::move(level));
+		}
+		return summary;
+	}
+
+	bool writeToFile(const juce::File& file) const
+	{
+		juce::TemporaryFile temp(file);
+		{
+			juce::FileOutputStream stream(temp.getFile());
+			if (!stream.openedOk())
+				return false;
+
+			writeToStream(stream);
+			stream.flush();
+			if (stream.getStatus().failed())
+				return false;
+		}
+		return temp.overwriteTargetFileWithTemporary();
+	}
+
+	static bool readFromFile(const juce::File& file, PeakSummary& summary)
+	{
+		juce::FileInputStream stream(file);
+		return stream.openedOk() && readFromStream(stream, summary);
+	}
+
+	void writeToStream(juce::OutputStream& stream) const
+	{
+		stream.write(fileMagic, 4);
+		stream.writeInt(fileVersion);
+		stream.writeInt(numChannels);
+		stream.writeInt(numSamples);
+		stream.writeInt((int)levels.size());
+		for (const auto& level : levels)
+		{
+			stream.writeInt(level.samplesPerBucket);
+			stream.writeInt(level.numBuckets);
+			stream.write(level.minMax.data(), level.minMax.size() * sizeof(juce::int16));
+		}
+	}
+
+	static bool readFromStream(juce::InputStream& stream, PeakSummary& summary)
+	{
+		char magic[4] = {};
+		if (stream.read(magic, 4) != 4 || std::memcmp(magic, fileMagic, 4) != 0 || stream.readInt() != fileVersion)
+			return false;
+
+		summary = {};
+		summary.numChannels = stream.readInt();
+		summary.numSamples = stream.readInt();
+		int numLevels = stream.readInt();
+		if (summary.numChannels <= 0 || summary.numChannels > 2 || numLevels <= 0 || numLevels > 8)
+			return false;
+
+		for (int i = 0; i < numLevels; ++i)
+		{
+			Level level;
+			level.samplesPerBucket = stream.readInt();
+			level.numBuckets = stream.readInt();
+			if (level.samplesPerBucket <= 0 || level.numBuckets < 0
+				|| (juce::int64)level.numBuckets * level.samplesPerBucket < summary.numSamples)
+				return false;
+
+			level.minMax.resize((size_t)level.numBuckets * summary.numChannels * 2);
+			auto bytes = (int)(level.minMax.size() * sizeof(juce::int16));
+			if (stream.read(level.minMax.data(), bytes) != bytes)
+				return false;
+			summary.levels.push_back(std::move(level));
+		}
+		return true;
+	}
+
+private:
+	static constexpr const char* fileMagic = "OBPK";
+	static constexpr int fileVersion = 1;
+
+	static juce::int16 toInt16(float value)
+	{
+		return (juce::int16)juce::jlimit(-32767, 32767, juce::roundToInt(value * 32767.0f));
+	}
+};
+
+// Everything about a sample that only depends on its audio. Computed once in
+// the bank's background worker and carried with the bank entry and the track
+// page, so loading a known sample never has to look at the samples again.
+struct SampleAnalysis
+{
+	using Ptr = std::shared_ptr<const SampleAnalysis>;
+
+	// Bump whenever an analyzer changes so stale entries are re-analyzed.
+	static constexpr int currentVersion = 2;
+	// Length of the similarity vector; padded to a multiple of eight floats so
+	// dot products over it vectorise without a remainder loop.
+	static constexpr int featureSize = 48;
+
+	int version = 0;
+	double sampleRate = 0.0;
+	int numChannels = 0;
+	int numSamples = 0;
+	float bpm = 0.0f;
+	float tempoConfidence = 0.0f;
+	double beatOffsetSeconds = 0.0;
+	double downbeatOffsetSeconds = 0.0;
+	juce::String key;
+	float keyConfidence = 0.0f;
+	float integratedLufs = -70.0f;
+	float truePeakDb = -100.0f;
+	std::vector<float> onsets;
+	// Unit-length summary of timbre, harmony, rhythm and level for "more like
+	// this" searches; the dot product of two is their similarity. Empty for
+	// entries analyzed before it existed.
+	std::vector<float> features;
+
+	bool isCurrent() const { return version == currentVersion; }
+	float getDurationSeconds() const { return sampleRate > 0.0 ? (float)(numSamples / sampleRate) : 0.0f; }
+
+	AudioAnalyzer::TempoEstimate getTempo() const
+	{
+		AudioAnalyzer::TempoEstimate tempo;
+		tempo.bpm = bpm;
+		tempo.confidence = tempoConfidence;
+		tempo.beatOffsetSeconds = beatOffsetSeconds;
+		tempo.downbeatOffsetSeconds = downbeatOffsetSeconds;
+		return tempo;
+	}
+
+	static Ptr analyze(const juce::AudioBuffer<float>& buffer, double sampleRate)
+	{
+		auto result = std::make_shared<SampleAnalysis>();
+		result->version = currentVersion;
+		result->sampleRate = sampleRate;
+		result->numChannels = buffer.getNumChannels();
+		result->numSamples = buffer.getNumSamples();
+
+		auto tempo = AudioAnalyzer::analyzeTempo(buffer, sampleRate);
+		result->bpm = tempo.bpm;
+		result->tempoConfidence = tempo.confidence;
+		result->beatOffsetSeconds = tempo.beatOffsetSeconds;
+		result->downbeatOffsetSeconds = tempo.downbeatOffsetSeconds;
+
+		auto keyEstimate = AudioAnalyzer::estimateKey(buffer, sampleRate);
+		result->key = keyEstimate.key;
+		result->keyConfidence = keyEstimate.confidence;
+
+		auto loudness = AudioAnalyzer::measureLoudness(buffer, sampleRate);
+		result->integratedLufs = loudness.integratedLufs;
+		result->truePeakDb = loudness.truePeakDb;
+
+		result->onsets = AudioAnalyzer::detectOnsets(buffer, sampleRate);
+		result->features = buildFeatures(*result, AudioAnalyzer::analyzeTimbre(buffer, sampleRate), keyEstimate);
+		return result;
+	}
+
+	juce::var toVar() const
+	{
+		auto* object = new juce::DynamicObject();
+		object->setProperty("version", version);
+		object->setProperty("sampleRate", sampleRate);
+		object->setProperty("numChannels", numChannels);
+		object->setProperty("numSamples", numSamples);
+		object->setProperty("bpm", (double)bpm);
+		object->setProperty("tempoConfidence", (double)tempoConfidence);
+		object->setProperty("beatOffset", beatOffsetSeconds);
+		object->setProperty("downbeatOffset", downbeatOffsetSeconds);
+		object->setProperty("key", key);
+		object->setProperty("keyConfidence", (double)keyConfidence);
+		object->setProperty("integratedLufs", (double)integratedLufs);
+		object->setProperty("truePeakDb", (double)truePeakDb);
+
+		// Millisecond ints keep the bank index compact; nothing downstream
+		// needs sub-millisecond onset times from the index.
+		juce::Array<juce::var> onsetArray;
+		for (auto onset : onsets)
+			onsetArray.add(juce::roundToInt(onset * 1000.0f));
+		object->setProperty("onsetsMs", onsetArray);
+
+		// Same idea: four decimals are plenty for a similarity ranking.
+		juce::Array<juce::var> featureArray;
+		for (auto feature : features)
+			featureArray.add(juce::roundToInt(feature * 10000.0f));
+		object->setProperty("features", featureArray);
+		return juce::var(object);
+	}
+
+	static Ptr fromVar(const juce::var& data)
+	{
+		auto* object = data.getDynamicObject();
+		if (object == nullptr || (int)object->getProperty("version") <= 0)
+			return nullptr;
+
+		auto result = std::make_shared<SampleAnalysis>();
+		result->version = object->getProperty("version");
+		result->sampleRate = object->getProperty("sampleRate");
+		result->numChannels = object->getProperty("numChannels");
+		result->numSamples = object->getProperty("numSamples");
+		result->bpm = (float)(double)object->getProperty("bpm");
+		result->tempoConfidence = (float)(double)object->getProperty("tempoConfidence");
+		result->beatOffsetSeconds = object->getProperty("beatOffset");
+		result->downbeatOffsetSeconds = object->getProperty("downbeatOffset");
+		result->key = object->getProperty("key").toString();
+		result->keyConfidence = (float)(double)object->getProperty("keyConfidence");
+		result->integratedLufs = (float)(double)object->getProperty("integratedLufs");
+		result->truePeakDb = (float)(double)object->getProperty("truePeakDb");
+
+		if (auto* onsetArray = object->getProperty("onsetsMs").getArray())
+		{
+			result->onsets.reserve((size_t)onsetArray->size());
+			for (const auto& onset : *onsetArray)
+				result->onsets.push_back((float)(int)onset / 1000.0f);
+		}
+
+		auto* featureArray = object->getProperty("features").getArray();
+		if (featureArray != nullptr && featureArray->size() == featureSize)
+		{
+			result->features.reserve((size_t)featureSize);
+			for (const auto& feature : *featureArray)
+				result->features.push_back((float)(int)feature / 10000.0f);
+		}
+		return result;
+	}
+
+	static Ptr fromJsonString(const juce::String& json)
+	{
+		return json.isEmpty() ? nullptr : fromVar(juce::JSON::parse(json));
+	}
+
+	juce::String toJsonString() const
+	{
+		return juce::JSON::toString(toVar(), true);
+	}
+
+private:
+	// Each group is scaled to unit length and then weighted, so how much a
+	// group counts does not depend on how many dimensions it has or on the
+	// units it is measured in.
+	static std::vector<float> buildFeatures(const SampleAnalysis& analysis,
+		const AudioAnalyzer::TimbreSummary& timbre,
+		const AudioAnalyzer::KeyEstimate& keyEstimate)
+	{
+		std::vector<float> features;
+		features.reserve((size_t)featureSize);
+
+		auto addGroup = [&features](std::initializer_list<float> values, float weight)
+			{
+				float length = 0.0f;
+				for (auto value : values)
+					length += value * value;
+				length = std::sqrt(length);
+				for (auto value : values)
+					features.push_back(length > 0.0f ? value / length * weight : 0.0f);
+			};
+
+		// The first coefficient is overall level, which the loudness group
+		// already covers.
+		const auto& mean = timbre.mfccMean;
+		const auto& deviation = timbre.mfccDeviation;
+		addGroup({ mean[1], mean[2], mean[3], mean[4], mean[5], mean[6],
+			mean[7], mean[8], mean[9], mean[10], mean[11], mean[12] }, 1.0f);
+		addGroup({ deviation[1], deviation[2], deviation[3], deviation[4], deviation[5], deviation[6],
+			deviation[7], deviation[8], deviation[9], deviation[10], deviation[11], deviation[12] }, 0.5f);
+
+		const auto& chroma = timbre.chroma;
+		addGroup({ chroma[0], chroma[1], chroma[2], chroma[3], chroma[4], chroma[5],
+			chroma[6], chroma[7], chroma[8], chroma[9], chroma[10], chroma[11] }, 0.6f);
+
+		// Absolute values from here on, mapped to roughly [-1, 1] by hand
+		// rather than normalised per group.
+		auto addScalar = [&features](float value, float weight)
+			{ features.push_back(juce::jlimit(-1.0f, 1.0f, value) * weight); };
+
+		addScalar(timbre.centroidMean / 4.0f - 1.0f, 0.5f);
+		addScalar(timbre.centroidDeviation, 0.3f);
+
+		float duration = analysis.getDurationSeconds();
+		float onsetsPerSecond = duration > 0.0f ? (float)analysis.onsets.size() / duration : 0.0f;
+		addScalar(std::log2(1.0f + onsetsPerSecond) / 2.0f - 1.0f, 0.4f);
+
+		// Tempo as an angle that turns once per octave, so a half- or
+		// double-time reading lands on the same spot.
+		float tempoWeight = 0.4f * juce::jlimit(0.0f, 1.0f, analysis.tempoConfidence);
+		float tempoAngle = analysis.bpm > 0.0f
+			? juce::MathConstants<float>::twoPi * std::log2(analysis.bpm / 60.0f) : 0.0f;
+		addScalar(std::sin(tempoAngle), analysis.bpm > 0.0f ? tempoWeight : 0.0f);
+		addScalar(std::cos(tempoAngle), analysis.bpm > 0.0f ? tempoWeight : 0.0f);
+
+		// Key on the circle of fifths, minor keys on their relative major, so
+		// compatible keys sit next to each other; the mode gets its own axis.
+		float keyWeight = 0.5f * juce::jlimit(0.0f, 1.0f, keyEstimate.confidence);
+		if (keyEstimate.tonic >= 0)
+		{
+			int major = keyEstimate.minor ? (keyEstimate.tonic + 3) % 12 : keyEstimate.tonic;
+			float keyAngle = juce::MathConstants<float>::twoPi * (float)((major * 7) % 12) / 12.0f;
+			addScalar(std::sin(keyAngle), keyWeight);
+			addScalar(std::cos(keyAngle), keyWeight);
+			addScalar(keyEstimate.minor ? -0.5f : 0.5f, keyWeight);
+		}
+		else
+		{
+			features.insert(features.end(), 3, 0.0f);
+		}
+
+		addScalar((analysis.integratedLufs + 20.0f) / 20.0f, 0.3f);
+
+		features.resize((size_t)featureSize, 0.0f);
+		float length = 0.0f;
+		for (auto value : features)
+			length += value * value;
+		if (length > 0.0f)
+			juce::FloatVectorOperations::multiply(features.data(), 1.0f / std::sqrt(length), featureSize);
+		return features;
+	}
+};
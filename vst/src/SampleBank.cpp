@@ -1,22 +1,180 @@
 #include "SampleBank.h"
+#include "PageCacheFile.h"
+
+// Analyzes bank samples one at a time at background priority. Results are
+// saved in batches so re-analyzing a large bank does not rewrite the index
+// once per sample.
+class SampleBank::AnalysisWorker : public juce::Thread
+{
+public:
+	explicit AnalysisWorker(SampleBank& bankToUse)
+		: juce::Thread("SampleBank Analysis"), bank(bankToUse)
+	{
+	}
+
+	~AnalysisWorker() override
+	{
+		stopThread(5000);
+	}
+
+	void enqueue(const juce::String& sampleId)
+	{
+		{
+			const juce::ScopedLock lock(queueLock);
+			if (std::find(queue.begin(), queue.end(), sampleId) != queue.end())
+				return;
+			queue.push_back(sampleId);
+		}
+		notify();
+	}
+
+	void run() override
+	{
+		bank.sweepSampleFiles(*this);
+		int unsavedResults = 0;
+
+		while (!threadShouldExit())
+		{
+			juce::String sampleId;
+			{
+				const juce::ScopedLock lock(queueLock);
+				if (!queue.empty())
+				{
+					sampleId = queue.front();
+					queue.pop_front();
+				}
+			}
+
+			if (sampleId.isEmpty())
+			{
+				if (unsavedResults > 0)
+				{
+					bank.finishAnalysisBatch();
+					unsavedResults = 0;
+				}
+				wait(-1);
+				continue;
+			}
+
+			if (bank.analyzeQueuedSample(sampleId) && ++unsavedResults >= saveBatchSize)
+			{
+				bank.finishAnalysisBatch();
+				unsavedResults = 0;
+			}
+		}
+
+		if (unsavedResults > 0)
+			bank.finishAnalysisBatch();
+	}
+
+private:
+	static constexpr int saveBatchSize = 16;
+
+	SampleBank& bank;
+	juce::CriticalSection queueLock;
+	std::deque<juce::String> queue;
+};
+
+// Appends journal records shortly after they are made, so a burst of changes
+// becomes one write, and compacts the journal into a fresh snapshot once it
+// has grown long enough. Also looks for changes made by other host processes
+// every couple of seconds.
+class SampleBank::JournalWriter : public juce::Thread
+{
+public:
+	explicit JournalWriter(SampleBank& bankToUse)
+		: juce::Thread("SampleBank Journal"), bank(bankToUse)
+	{
+	}
+
+	~JournalWriter() override
+	{
+		stopThread(5000);
+	}
+
+	void run() override
+	{
+		while (!threadShouldExit())
+		{
+			wait(pollIntervalMs);
+			if (threadShouldExit())
+				break;
+
+			if (bank.hasPendingJournal())
+				wait(flushDelayMs);
+			bank.flushJournal();
+
+			if (bank.needsCompaction())
+				bank.compact();
+		}
+	}
+
+private:
+	static constexpr int flushDelayMs = 250;
+	static constexpr int pollIntervalMs = 2000;
+
+	SampleBank& bank;
+};
+
+std::shared_ptr<SampleBank> SampleBank::getShared()
+{
+	static std::mutex mutex;
+	static std::weak_ptr<SampleBank> instance;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto bank = instance.lock();
+	if (!bank)
+	{
+		bank = std::make_shared<SampleBank>();
+		instance = bank;
+	}
+	return bank;
+}
 
 SampleBank::SampleBank()
+	: processLock("OBSIDIAN-Neural-SampleBank")
 {
 	bankDirectory = getBankDirectory();
 	bankIndexFile = bankDirectory.getChildFile("sample_bank.json");
+	journalFile = bankDirectory.getChildFile("sample_bank.journal");
+	compactingJournalFile = bankDirectory.getChildFile("sample_bank.journal.compacting");
 	ensureBankDirectoryExists();
-	loadBankData();
-	if (!bankIndexFile.exists())
-	{
-		saveBankData();
-	}
+	analysisWorker = std::make_unique<AnalysisWorker>(*this);
+	journalWriter = std::make_unique<JournalWriter>(*this);
+
+	// Parsing a large index would hold up plugin instantiation, so it happens
+	// here; every call that needs the entries waits for it.
+	ready = std::async(std::launch::async, [this]()
+		{
+			loadBankData();
+			if (!bankIndexFile.exists())
+			{
+				compact();
+			}
+			isLoaded = true;
+			analysisWorker->startThread(juce::Thread::Priority::background);
+			journalWriter->startThread(juce::Thread::Priority::background);
+			if (needsCompaction())
+				journalWriter->notify();
+		}).share();
+}
+
+SampleBank::~SampleBank()
+{
+	ready.wait();
+	analysisWorker.reset();
+	journalWriter.reset();
+	flushJournal();
 }
 
 juce::String SampleBank::addSample(const juce::String& prompt,
 	const juce::File& audioFile,
 	float bpm,
-	const juce::String& key)
+	const juce::String& key,
+	const juce::AudioBuffer<float>* audio,
+	double sampleRate)
 {
+	waitUntilReady();
 	juce::ScopedLock lock(bankLock);
 
 	auto entry = std::make_unique<SampleBankEntry>();
@@ -57,15 +215,24 @@ juce::String SampleBank::addSample(const juce::String& prompt,
 
 	entry->filePath = destinationFile.getFullPathName();
 
-	analyzeSampleFile(entry.get(), destinationFile);
+	if (audio != nullptr && sampleRate > 0.0)
+	{
+		entry->sampleRate = sampleRate;
+		entry->numChannels = audio->getNumChannels();
+		entry->numSamples = audio->getNumSamples();
+		entry->duration = static_cast<float>(audio->getNumSamples() / sampleRate);
+	}
+	else
+	{
+		analyzeSampleFile(entry.get(), destinationFile);
+	}
 
 	juce::String sampleId = entry->id;
-	samples.push_back(std::move(entry));
+	journalPut(*entry);
+	insertEntry(std::move(entry));
 
-	saveBankData();
-
-	if (onBankChanged)
-		onBankChanged();
+	queueAnalysis(sampleId);
+	notifyBankChanged();
 
 	DBG("Sample added to bank: " + sampleId + " -> " + destinationFile.getFileName());
 	return sampleId;
@@ -73,70 +240,152 @@ juce::String SampleBank::addSample(const juce::String& prompt,
 
 bool SampleBank::removeSample(const juce::String& sampleId)
 {
+	waitUntilReady();
 	juce::File fileToDelete;
 	bool needsCallback = false;
 
 	{
 		juce::ScopedLock lock(bankLock);
 
-		auto it = std::find_if(samples.begin(), samples.end(),
-			[&sampleId](const std::unique_ptr<SampleBankEntry>& entry)
-			{
-				return entry->id == sampleId;
-			});
-
-		if (it == samples.end())
+		auto entry = extractEntry(sampleId);
+		if (!entry)
 			return false;
 
-		fileToDelete = juce::File((*it)->filePath);
-
-		samples.erase(it);
+		fileToDelete = juce::File(entry->filePath);
+		journalRemove(sampleId);
 		needsCallback = true;
-
-		saveBankData();
-
 	}
 
 	if (fileToDelete.exists())
 	{
 		fileToDelete.deleteFile();
 	}
+	getPeakSummaryFile(fileToDelete).deleteFile();
 
-	if (needsCallback && onBankChanged)
-	{
-		onBankChanged();
-	}
+	if (needsCallback)
+		notifyBankChanged();
 
 	return true;
 }
 
-SampleBankEntry* SampleBank::getSample(const juce::String& sampleId)
+SampleBankEntry::Ptr SampleBank::getSample(const juce::String& sampleId)
 {
+	waitUntilReady();
 	juce::ScopedLock lock(bankLock);
+	auto* entry = findEntry(sampleId);
 
-	auto it = std::find_if(samples.begin(), samples.end(),
-		[&sampleId](const std::unique_ptr<SampleBankEntry>& entry)
-		{
-			return entry->id == sampleId;
-		});
+	// Files are only checked for existence by the startup sweep, which may
+	// not have reached this one yet.
+	if (entry && !juce::File(entry->filePath).existsAsFile())
+	{
+		queueAnalysis(sampleId);
+		return nullptr;
+	}
+	return entry ? getSnapshot(*entry) : nullptr;
+}
+
+void SampleBank::waitUntilReady() const
+{
+	if (!isLoaded)
+		ready.wait();
+}
+
+SampleBankEntry* SampleBank::findEntry(const juce::String& sampleId) const
+{
+	auto position = positions.find(sampleId);
+	return position != positions.end() ? samples[position->second].get() : nullptr;
+}
+
+void SampleBank::insertEntry(std::unique_ptr<SampleBankEntry> entry)
+{
+	positions[entry->id] = samples.size();
+	index.add(entry.get());
+	if (entry->analysis)
+		similarity.set(entry->id, entry->analysis->features);
+	samples.push_back(std::move(entry));
+}
 
-	return (it != samples.end()) ? it->get() : nullptr;
+std::unique_ptr<SampleBankEntry> SampleBank::extractEntry(const juce::String& sampleId)
+{
+	auto position = positions.find(sampleId);
+	if (position == positions.end())
+		return nullptr;
+
+	size_t removedIndex = position->second;
+	auto removed = std::move(samples[removedIndex]);
+	index.remove(removed.get());
+	similarity.remove(sampleId);
+	snapshots.erase(sampleId);
+	positions.erase(position);
+
+	if (removedIndex != samples.size() - 1)
+	{
+		samples[removedIndex] = std::move(samples.back());
+		positions[samples[removedIndex]->id] = removedIndex;
+	}
+	samples.pop_back();
+	return removed;
 }
 
-std::vector<SampleBankEntry*> SampleBank::getAllSamples()
+std::vector<SampleBankEntry::Ptr> SampleBank::getAllSamples()
 {
+	waitUntilReady();
 	juce::ScopedLock lock(bankLock);
 
-	std::vector<SampleBankEntry*> result;
+	std::vector<SampleBankEntry::Ptr> result;
+	result.reserve(samples.size());
 	for (auto& entry : samples)
 	{
-		result.push_back(entry.get());
+		result.push_back(getSnapshot(*entry));
 	}
 	return result;
 }
 
+std::vector<SampleBankEntry::Ptr> SampleBank::query(const SampleBankIndex::Query& query)
+{
+	waitUntilReady();
+	juce::ScopedLock lock(bankLock);
+
+	auto matches = index.find(query);
+	std::vector<SampleBankEntry::Ptr> result;
+	result.reserve(matches.size());
+	for (auto* entry : matches)
+		result.push_back(getSnapshot(*entry));
+	return result;
+}
+
+std::vector<SampleBankEntry::Ptr> SampleBank::findSimilar(const juce::String& sampleId, int maxResults)
+{
+	waitUntilReady();
+	juce::ScopedLock lock(bankLock);
+
+	std::vector<SampleBankEntry::Ptr> result;
+	for (const auto& id : similarity.findNearest(sampleId, maxResults))
+		if (auto* entry = findEntry(id))
+			result.push_back(getSnapshot(*entry));
+	return result;
+}
+
+// Called with bankLock held.
+SampleBankEntry::Ptr SampleBank::getSnapshot(const SampleBankEntry& entry)
+{
+	auto& snapshot = snapshots[entry.id];
+	if (!snapshot)
+		snapshot = std::make_shared<const SampleBankEntry>(entry);
+	return snapshot;
+}
+
+SampleAnalysis::Ptr SampleBank::getAnalysis(const juce::String& sampleId)
+{
+	waitUntilReady();
+	juce::ScopedLock lock(bankLock);
+	auto* entry = findEntry(sampleId);
+	return entry ? entry->analysis : nullptr;
+}
+
 std::vector<juce::String> SampleBank::getUnusedSamples() const
 {
+	waitUntilReady();
 	juce::ScopedLock lock(bankLock);
 
 	std::vector<juce::String> unused;
@@ -161,14 +410,8 @@ int SampleBank::removeUnusedSamples()
 			removedCount++;
 	}
 
-	if (removedCount > 0 && onBankChanged)
-	{
-		juce::MessageManager::callAsync([this]()
-			{
-				if (onBankChanged)
-					onBankChanged();
-			});
-	}
+	if (removedCount > 0)
+		notifyBankChanged();
 
 	return removedCount;
 }
@@ -176,44 +419,89 @@ int SampleBank::removeUnusedSamples()
 
 void SampleBank::markSampleAsUsed(const juce::String& sampleId, const juce::String& projectId)
 {
-	bool needsSave = false;
+	waitUntilReady();
+	juce::ScopedLock lock(bankLock);
 
-	{
-		juce::ScopedLock lock(bankLock);
+	bool changed = modifyEntry(findEntry(sampleId), [&projectId](SampleBankEntry& entry)
+		{
+			auto& projects = entry.usedInProjects;
+			if (std::find(projects.begin(), projects.end(), projectId) != projects.end())
+				return false;
+			projects.push_back(projectId);
+			return true;
+		});
 
-		auto it = std::find_if(samples.begin(), samples.end(),
-			[&sampleId](const std::unique_ptr<SampleBankEntry>& entry)
-			{
-				return entry->id == sampleId;
-			});
+	if (changed)
+		journalUsage(sampleId, projectId, true);
+}
 
-		if (it != samples.end())
+void SampleBank::markSampleAsUnused(const juce::String& sampleId, const juce::String& projectId)
+{
+	waitUntilReady();
+	juce::ScopedLock lock(bankLock);
+
+	bool changed = modifyEntry(findEntry(sampleId), [&projectId](SampleBankEntry& entry)
 		{
-			auto& projects = (*it)->usedInProjects;
-			if (std::find(projects.begin(), projects.end(), projectId) == projects.end())
-			{
-				projects.push_back(projectId);
-				needsSave = true;
-			}
-		}
-	}
+			auto& projects = entry.usedInProjects;
+			auto it = std::remove(projects.begin(), projects.end(), projectId);
+			if (it == projects.end())
+				return false;
+			projects.erase(it, projects.end());
+			return true;
+		});
+
+	if (changed)
+		journalUsage(sampleId, projectId, false);
+}
 
-	if (needsSave)
+bool SampleBank::setCategories(const juce::String& sampleId, const std::vector<juce::String>& categories)
+{
+	waitUntilReady();
+	juce::ScopedLock lock(bankLock);
+	auto* entry = findEntry(sampleId);
+	bool changed = modifyEntry(entry, [&categories](SampleBankEntry& target)
+		{
+			if (target.categories == categories)
+				return false;
+			target.categories = categories;
+			return true;
+		});
+
+	if (changed)
+		journalPut(*entry);
+	return changed;
+}
+
+void SampleBank::renameCategory(const juce::String& oldName, const juce::String& newName)
+{
+	waitUntilReady();
+	juce::ScopedLock lock(bankLock);
+	for (auto* indexed : index.getEntriesInCategory(oldName))
 	{
-		saveBankData();
+		auto* entry = findEntry(indexed->id);
+		modifyEntry(entry, [&oldName, &newName](SampleBankEntry& target)
+			{
+				std::replace(target.categories.begin(), target.categories.end(), oldName, newName);
+				return true;
+			});
+		journalPut(*entry);
 	}
 }
 
-void SampleBank::markSampleAsUnused(const juce::String& sampleId, const juce::String& projectId)
+void SampleBank::removeCategory(const juce::String& name)
 {
+	waitUntilReady();
 	juce::ScopedLock lock(bankLock);
-
-	auto* entry = getSample(sampleId);
-	if (entry)
+	for (auto* indexed : index.getEntriesInCategory(name))
 	{
-		auto& projects = entry->usedInProjects;
-		projects.erase(std::remove(projects.begin(), projects.end(), projectId), projects.end());
-		saveBankData();
+		auto* entry = findEntry(indexed->id);
+		modifyEntry(entry, [&name](SampleBankEntry& target)
+			{
+				auto& categories = target.categories;
+				categories.erase(std::remove(categories.begin(), categories.end(), name), categories.end());
+				return true;
+			});
+		journalPut(*entry);
 	}
 }
 
@@ -267,6 +555,163 @@ void SampleBank::analyzeSampleFile(SampleBankEntry* entry, const juce::File& aud
 	}
 }
 
+void SampleBank::queueAnalysis(const juce::String& sampleId)
+{
+	if (analysisWorker)
+		analysisWorker->enqueue(sampleId);
+}
+
+// Runs on the analysis worker before it starts on its queue. Existence
+// checks are done in small batches outside the lock, so a large bank adds
+// nothing to startup and never keeps other callers waiting for long.
+void SampleBank::sweepSampleFiles(juce::Thread& worker)
+{
+	std::vector<std::pair<juce::String, juce::File>> files;
+	{
+		juce::ScopedLock lock(bankLock);
+		files.reserve(samples.size());
+		for (const auto& entry : samples)
+		{
+			if (!entry->analysis || !entry->analysis->isCurrent())
+				queueAnalysis(entry->id);
+			files.emplace_back(entry->id, juce::File(entry->filePath));
+		}
+	}
+
+	constexpr size_t batchSize = 256;
+	int removed = 0;
+	for (size_t start = 0; start < files.size() && !worker.threadShouldExit(); start += batchSize)
+	{
+		std::vector<juce::String> missing;
+		size_t end = juce::jmin(files.size(), start + batchSize);
+		for (size_t i = start; i < end; ++i)
+		{
+			const auto& [sampleId, file] = files[i];
+			if (!file.existsAsFile())
+				missing.push_back(sampleId);
+			else if (!getPeakSummaryFile(file).existsAsFile())
+				queueAnalysis(sampleId);
+		}
+
+		if (!missing.empty())
+		{
+			juce::ScopedLock lock(bankLock);
+			for (const auto& sampleId : missing)
+			{
+				if (extractEntry(sampleId))
+				{
+					journalRemove(sampleId);
+					++removed;
+				}
+			}
+		}
+	}
+
+	if (removed > 0)
+	{
+		DBG("Removed " + juce::String(removed) + " bank samples whose files are gone");
+		notifyBankChanged();
+	}
+}
+
+bool SampleBank::analyzeQueuedSample(const juce::String& sampleId)
+{
+	juce::File sampleFile;
+	{
+		juce::ScopedLock lock(bankLock);
+		auto* entry = findEntry(sampleId);
+		if (!entry)
+			return false;
+		sampleFile = juce::File(entry->filePath);
+	}
+
+	// Samples copied from the track cache usually carry their peaks and
+	// analysis already, in which case nothing needs decoding.
+	SampleAnalysis::Ptr analysis;
+	PageCacheFile::Contents embedded;
+	if (PageCacheFile::read(sampleFile, embedded) && embedded.analysis && embedded.analysis->isCurrent()
+		&& !embedded.peaks.levels.empty())
+	{
+		analysis = embedded.analysis;
+		embedded.peaks.writeToFile(getPeakSummaryFile(sampleFile));
+	}
+	else
+	{
+		juce::AudioFormatManager formatManager;
+		formatManager.registerBasicFormats();
+		std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(sampleFile));
+		if (!reader || reader->lengthInSamples <= 0)
+		{
+			DBG("Cannot analyze bank sample: " + sampleFile.getFullPathName());
+			if (!sampleFile.existsAsFile())
+				forgetMissingSample(sampleId);
+			return false;
+		}
+
+		int numSamples = static_cast<int>(reader->lengthInSamples);
+		juce::AudioBuffer<float> buffer(juce::jmin(2, (int)reader->numChannels), numSamples);
+		reader->read(&buffer, 0, numSamples, 0, true, true);
+
+		analysis = SampleAnalysis::analyze(buffer, reader->sampleRate);
+		PeakSummary::build(buffer).writeToFile(getPeakSummaryFile(sampleFile));
+	}
+
+	{
+		juce::ScopedLock lock(bankLock);
+		auto* entry = findEntry(sampleId);
+		bool found = modifyEntry(entry, [&analysis](SampleBankEntry& target)
+			{
+				target.analysis = analysis;
+				target.duration = analysis->getDurationSeconds();
+				target.sampleRate = analysis->sampleRate;
+				target.numChannels = analysis->numChannels;
+				target.numSamples = analysis->numSamples;
+				return true;
+			});
+		if (!found)
+			return false;
+		journalPut(*entry);
+	}
+
+	DBG("Analyzed bank sample " + sampleId + ": " + juce::String(analysis->bpm, 1) + " BPM, "
+		+ analysis->key + ", " + juce::String(analysis->integratedLufs, 1) + " LUFS");
+
+	juce::MessageManager::callAsync([weakBank = weak_from_this(), sampleId, analysis]()
+		{
+			if (auto bank = weakBank.lock())
+				bank->listeners.call([&](Listener& l) { l.sampleAnalyzed(sampleId, analysis); });
+		});
+	return true;
+}
+
+void SampleBank::forgetMissingSample(const juce::String& sampleId)
+{
+	{
+		juce::ScopedLock lock(bankLock);
+		if (!extractEntry(sampleId))
+			return;
+		journalRemove(sampleId);
+	}
+
+	notifyBankChanged();
+}
+
+void SampleBank::finishAnalysisBatch()
+{
+	notifyBankChanged();
+}
+
+// Listeners are panels and processors of every plugin instance in the
+// process; they are always called on the message thread.
+void SampleBank::notifyBankChanged()
+{
+	juce::MessageManager::callAsync([weakBank = weak_from_this()]()
+		{
+			if (auto bank = weakBank.lock())
+				bank->listeners.call([](Listener& l) { l.sampleBankChanged(); });
+		});
+}
+
 juce::File SampleBank::getBankDirectory()
 {
 	return juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
@@ -284,139 +729,374 @@ void SampleBank::ensureBankDirectoryExists()
 
 void SampleBank::saveBankData()
 {
-	try
+	flushJournal();
+}
+
+juce::var SampleBank::entryToVar(const SampleBankEntry& entry)
+{
+	juce::DynamicObject::Ptr sampleData = new juce::DynamicObject();
+
+	sampleData->setProperty("id", entry.id);
+	sampleData->setProperty("filename", entry.filename);
+	sampleData->setProperty("originalPrompt", entry.originalPrompt);
+	sampleData->setProperty("filePath", entry.filePath);
+	sampleData->setProperty("creationTime", entry.creationTime.toMilliseconds());
+	sampleData->setProperty("duration", static_cast<double>(entry.duration));
+	sampleData->setProperty("bpm", static_cast<double>(entry.bpm));
+	sampleData->setProperty("key", entry.key);
+	sampleData->setProperty("sampleRate", static_cast<double>(entry.sampleRate));
+	sampleData->setProperty("numChannels", static_cast<int>(entry.numChannels));
+	sampleData->setProperty("numSamples", static_cast<int>(entry.numSamples));
+	if (entry.analysis)
+		sampleData->setProperty("analysis", entry.analysis->toVar());
+
+	juce::Array<juce::var> categoriesArray;
+	for (const auto& category : entry.categories)
 	{
-		if (!bankDirectory.exists())
-		{
-			auto result = bankDirectory.createDirectory();
-			if (!result.wasOk())
-				return;
-		}
+		if (!category.isEmpty())
+			categoriesArray.add(category);
+	}
+	sampleData->setProperty("categories", categoriesArray);
 
-		juce::DynamicObject::Ptr bankData = new juce::DynamicObject();
-		juce::Array<juce::var> samplesArray;
+	juce::Array<juce::var> projectsArray;
+	for (const auto& project : entry.usedInProjects)
+	{
+		if (!project.isEmpty())
+			projectsArray.add(project);
+	}
+	sampleData->setProperty("usedInProjects", projectsArray);
 
-		for (const auto& entry : samples)
-		{
-			if (!entry) continue;
-
-			juce::DynamicObject::Ptr sampleData = new juce::DynamicObject();
-
-			sampleData->setProperty("id", entry->id.isEmpty() ? juce::Uuid().toString() : entry->id);
-			sampleData->setProperty("filename", entry->filename);
-			sampleData->setProperty("originalPrompt", entry->originalPrompt);
-			sampleData->setProperty("filePath", entry->filePath);
-			sampleData->setProperty("creationTime", entry->creationTime.toMilliseconds());
-			sampleData->setProperty("duration", static_cast<double>(entry->duration));
-			sampleData->setProperty("bpm", static_cast<double>(entry->bpm));
-			sampleData->setProperty("key", entry->key);
-			sampleData->setProperty("sampleRate", static_cast<double>(entry->sampleRate));
-			sampleData->setProperty("numChannels", static_cast<int>(entry->numChannels));
-			sampleData->setProperty("numSamples", static_cast<int>(entry->numSamples));
-
-			juce::Array<juce::var> categoriesArray;
-			for (const auto& category : entry->categories)
-			{
-				if (!category.isEmpty())
-					categoriesArray.add(category);
-			}
-			sampleData->setProperty("categories", categoriesArray);
+	return juce::var(sampleData.get());
+}
 
-			juce::Array<juce::var> projectsArray;
-			for (const auto& project : entry->usedInProjects)
-			{
-				if (!project.isEmpty())
-					projectsArray.add(project);
-			}
-			sampleData->setProperty("usedInProjects", projectsArray);
+std::unique_ptr<SampleBankEntry> SampleBank::entryFromVar(const juce::var& sampleVar)
+{
+	auto* sampleObj = sampleVar.getDynamicObject();
+	if (!sampleObj)
+		return nullptr;
 
-			samplesArray.add(sampleData.get());
-		}
+	auto entry = std::make_unique<SampleBankEntry>();
+	entry->id = sampleObj->getProperty("id").toString();
+	if (entry->id.isEmpty())
+		entry->id = juce::Uuid().toString();
+	entry->filename = sampleObj->getProperty("filename").toString();
+	entry->originalPrompt = sampleObj->getProperty("originalPrompt").toString();
+	entry->filePath = sampleObj->getProperty("filePath").toString();
+	auto creationTimeVar = sampleObj->getProperty("creationTime");
+	entry->creationTime = juce::Time(creationTimeVar.isVoid() ? 0 : (juce::int64)creationTimeVar);
+	entry->duration = static_cast<float>(sampleObj->getProperty("duration"));
+	entry->bpm = static_cast<float>(sampleObj->getProperty("bpm"));
+	entry->key = sampleObj->getProperty("key").toString();
+	entry->sampleRate = sampleObj->getProperty("sampleRate");
+	entry->numChannels = sampleObj->getProperty("numChannels");
+	entry->numSamples = sampleObj->getProperty("numSamples");
+	entry->analysis = SampleAnalysis::fromVar(sampleObj->getProperty("analysis"));
+
+	auto categoriesVar = sampleObj->getProperty("categories");
+	if (categoriesVar.isArray())
+	{
+		auto* categoriesArray = categoriesVar.getArray();
+		for (int j = 0; j < categoriesArray->size(); ++j)
+			entry->categories.push_back(categoriesArray->getUnchecked(j).toString());
+	}
 
-		bankData->setProperty("samples", samplesArray);
-		bankData->setProperty("version", "1.0");
+	auto projectsVar = sampleObj->getProperty("usedInProjects");
+	if (projectsVar.isArray())
+	{
+		auto* projectsArray = projectsVar.getArray();
+		for (int j = 0; j < projectsArray->size(); ++j)
+			entry->usedInProjects.push_back(projectsArray->getUnchecked(j).toString());
+	}
 
-		juce::String jsonString = juce::JSON::toString(juce::var(bankData.get()), true);
+	return entry;
+}
 
-		if (jsonString.isEmpty())
-			return;
+void SampleBank::journalPut(const SampleBankEntry& entry)
+{
+	juce::DynamicObject::Ptr record = new juce::DynamicObject();
+	record->setProperty("op", "put");
+	record->setProperty("sample", entryToVar(entry));
+	appendToJournal(juce::var(record.get()));
+}
+
+void SampleBank::journalRemove(const juce::String& sampleId)
+{
+	juce::DynamicObject::Ptr record = new juce::DynamicObject();
+	record->setProperty("op", "remove");
+	record->setProperty("id", sampleId);
+	appendToJournal(juce::var(record.get()));
+}
+
+void SampleBank::journalUsage(const juce::String& sampleId, const juce::String& projectId, bool used)
+{
+	juce::DynamicObject::Ptr record = new juce::DynamicObject();
+	record->setProperty("op", used ? "used" : "unused");
+	record->setProperty("id", sampleId);
+	record->setProperty("project", projectId);
+	appendToJournal(juce::var(record.get()));
+}
+
+void SampleBank::appendToJournal(const juce::var& record)
+{
+	{
+		juce::ScopedLock lock(journalLock);
+		pendingJournal << juce::JSON::toString(record, true) << "\n";
+		++journalRecords;
+	}
+
+	if (journalWriter)
+		journalWriter->notify();
+}
+
+// Other host processes share the same files. Under the process lock, first
+// pick up whatever they appended since we last looked, then append our own
+// records. A new snapshot means someone compacted, and the index is rebuilt.
+void SampleBank::flushJournal()
+{
+	juce::ScopedLock fileScope(fileLock);
+	juce::InterProcessLock::ScopedLockType processScope(processLock);
+
+	bool snapshotReplaced = bankIndexFile.getLastModificationTime() != snapshotTime
+		|| journalFile.getSize() < journalPosition;
+	juce::String foreignRecords = snapshotReplaced ? juce::String() : readJournalTail();
 
-		bankIndexFile.replaceWithText(jsonString);
+	writePendingJournal();
 
+	int applied = 0;
+	if (snapshotReplaced)
+	{
+		DBG("Sample bank was compacted by another process, reloading");
+		loadBankData();
+		applied = 1;
 	}
-	catch (...)
+	else if (foreignRecords.isNotEmpty())
 	{
-		return;
+		juce::ScopedLock lock(bankLock);
+		applied = applyJournalText(foreignRecords);
 	}
+
+	journalPosition = journalFile.getSize();
+	if (applied > 0)
+		notifyBankChanged();
 }
 
-void SampleBank::loadBankData()
+// Complete lines past journalPosition. Records are appended under the
+// process lock, so a partial line can only be left by a crash.
+juce::String SampleBank::readJournalTail()
 {
-	juce::ScopedLock lock(bankLock);
-	if (!bankIndexFile.exists())
-		return;
+	juce::FileInputStream stream(journalFile);
+	if (!stream.openedOk() || stream.getTotalLength() <= journalPosition)
+		return {};
+
+	stream.setPosition(journalPosition);
+	auto text = stream.readEntireStreamAsString();
+	int end = text.lastIndexOfChar('\n');
+	return end >= 0 ? text.substring(0, end + 1) : juce::String();
+}
 
-	juce::var bankJson = juce::JSON::parse(bankIndexFile);
-	if (!bankJson.isObject())
+void SampleBank::writePendingJournal()
+{
+	juce::String text;
+	{
+		juce::ScopedLock lock(journalLock);
+		std::swap(text, pendingJournal);
+	}
+	if (text.isEmpty())
 		return;
 
-	auto* bankObj = bankJson.getDynamicObject();
-	if (!bankObj)
+	juce::FileOutputStream stream(journalFile);
+	if (stream.openedOk())
+	{
+		stream.writeText(text, false, false, nullptr);
+		stream.flush();
+		if (stream.getStatus().wasOk())
+			return;
+	}
+
+	DBG("Cannot write sample bank journal: " + journalFile.getFullPathName());
+	juce::ScopedLock lock(journalLock);
+	pendingJournal = text + pendingJournal;
+}
+
+bool SampleBank::hasPendingJournal() const
+{
+	juce::ScopedLock lock(journalLock);
+	return pendingJournal.isNotEmpty();
+}
+
+bool SampleBank::needsCompaction() const
+{
+	juce::ScopedLock lock(journalLock);
+	return journalRecords >= compactAfterRecords;
+}
+
+void SampleBank::compact()
+{
+	juce::ScopedLock fileScope(fileLock);
+	juce::InterProcessLock::ScopedLockType processScope(processLock);
+
+	// Catch up with the other processes first, so the snapshot holds their
+	// changes too.
+	flushJournal();
+
+	juce::var snapshot;
+	{
+		juce::ScopedLock lock(bankLock);
+
+		juce::Array<juce::var> samplesArray;
+		for (const auto& entry : samples)
+			samplesArray.add(entryToVar(*entry));
+
+		juce::DynamicObject::Ptr bankData = new juce::DynamicObject();
+		bankData->setProperty("samples", samplesArray);
+		bankData->setProperty("version", "1.0");
+		snapshot = juce::var(bankData.get());
+
+		// Everything journaled so far is in the snapshot. Set the journal
+		// aside rather than deleting it, so a crash before the snapshot is
+		// renamed into place still replays it on the next load. Records
+		// made from here on wait in pendingJournal for the new journal.
+		if (!setJournalAside())
+			return;
+
+		juce::ScopedLock journalScope(journalLock);
+		journalRecords = 0;
+	}
+
+	auto jsonString = juce::JSON::toString(snapshot, true);
+	juce::TemporaryFile temp(bankIndexFile);
+	if (jsonString.isEmpty() || !temp.getFile().replaceWithText(jsonString) || !temp.overwriteTargetFileWithTemporary())
+	{
+		DBG("Sample bank compaction failed, keeping the journal");
 		return;
+	}
+
+	compactingJournalFile.deleteFile();
+	snapshotTime = bankIndexFile.getLastModificationTime();
+	journalPosition = 0;
+	DBG("Sample bank compacted: " + juce::String(snapshot.getProperty("samples", {}).size()) + " samples");
+}
 
-	auto samplesVar = bankObj->getProperty("samples");
-	if (!samplesVar.isArray())
+// A journal left over from an interrupted compaction is extended rather
+// than replaced, its records may not be in any snapshot yet.
+bool SampleBank::setJournalAside()
+{
+	if (!journalFile.existsAsFile())
+		return true;
+	if (!compactingJournalFile.existsAsFile())
+		return journalFile.moveFileTo(compactingJournalFile);
+
+	juce::FileOutputStream stream(compactingJournalFile);
+	if (!stream.openedOk() || !stream.writeText(journalFile.loadFileAsString(), false, false, nullptr))
+		return false;
+	stream.flush();
+	return stream.getStatus().wasOk() && journalFile.deleteFile();
+}
+
+void SampleBank::replayJournal(const juce::File& file)
+{
+	if (!file.existsAsFile())
 		return;
 
-	auto* samplesArray = samplesVar.getArray();
-	samples.clear();
+	int applied = applyJournalText(file.loadFileAsString());
+	DBG("Replayed " + juce::String(applied) + " sample bank journal records from " + file.getFileName());
+}
+
+int SampleBank::applyJournalText(const juce::String& text)
+{
+	juce::StringArray lines;
+	lines.addLines(text);
 
-	for (int i = 0; i < samplesArray->size(); ++i)
+	int applied = 0;
+	for (const auto& line : lines)
 	{
-		auto sampleVar = samplesArray->getUnchecked(i);
-		if (!sampleVar.isObject())
+		if (line.isEmpty())
 			continue;
 
-		auto* sampleObj = sampleVar.getDynamicObject();
-		if (!sampleObj)
+		// A crash in the middle of an append leaves a partial last line.
+		auto record = juce::JSON::parse(line);
+		if (!record.isObject())
 			continue;
 
-		auto entry = std::make_unique<SampleBankEntry>();
-		entry->id = sampleObj->getProperty("id").toString();
-		entry->filename = sampleObj->getProperty("filename").toString();
-		entry->originalPrompt = sampleObj->getProperty("originalPrompt").toString();
-		entry->filePath = sampleObj->getProperty("filePath").toString();
-		auto creationTimeVar = sampleObj->getProperty("creationTime");
-		entry->creationTime = juce::Time(creationTimeVar.isVoid() ? 0 : (juce::int64)creationTimeVar);
-		entry->duration = static_cast<float>(sampleObj->getProperty("duration"));
-		entry->bpm = static_cast<float>(sampleObj->getProperty("bpm"));
-		entry->key = sampleObj->getProperty("key").toString();
-		entry->sampleRate = sampleObj->getProperty("sampleRate");
-		entry->numChannels = sampleObj->getProperty("numChannels");
-		entry->numSamples = sampleObj->getProperty("numSamples");
-
-		auto categoriesVar = sampleObj->getProperty("categories");
-		if (categoriesVar.isArray())
-		{
-			auto* categoriesArray = categoriesVar.getArray();
-			for (int j = 0; j < categoriesArray->size(); ++j)
-				entry->categories.push_back(categoriesArray->getUnchecked(j).toString());
-		}
+		applyJournalRecord(record);
+		++applied;
+	}
 
-		auto projectsVar = sampleObj->getProperty("usedInProjects");
-		if (projectsVar.isArray())
-		{
-			auto* projectsArray = projectsVar.getArray();
-			for (int j = 0; j < projectsArray->size(); ++j)
-				entry->usedInProjects.push_back(projectsArray->getUnchecked(j).toString());
-		}
+	juce::ScopedLock lock(journalLock);
+	journalRecords += applied;
+	return applied;
+}
+
+// Every operation is idempotent, so records that are already part of the
+// snapshot can be replayed again without harm.
+void SampleBank::applyJournalRecord(const juce::var& record)
+{
+	auto op = record.getProperty("op", {}).toString();
+	auto sampleId = record.getProperty("id", {}).toString();
+
+	if (op == "put")
+	{
+		auto entry = entryFromVar(record.getProperty("sample", {}));
+		if (!entry)
+			return;
+
+		if (auto* existing = findEntry(entry->id))
+			modifyEntry(existing, [&entry](SampleBankEntry& target) { target = std::move(*entry); return true; });
+		else
+			insertEntry(std::move(entry));
+	}
+	else if (op == "remove")
+	{
+		extractEntry(sampleId);
+	}
+	else if (op == "used" || op == "unused")
+	{
+		auto projectId = record.getProperty("project", {}).toString();
+		modifyEntry(findEntry(sampleId), [&op, &projectId](SampleBankEntry& entry)
+			{
+				auto& projects = entry.usedInProjects;
+				projects.erase(std::remove(projects.begin(), projects.end(), projectId), projects.end());
+				if (op == "used")
+					projects.push_back(projectId);
+				return true;
+			});
+	}
+}
+
+void SampleBank::loadBankData()
+{
+	juce::ScopedLock fileScope(fileLock);
+	juce::InterProcessLock::ScopedLockType processScope(processLock);
+	juce::ScopedLock lock(bankLock);
+	samples.clear();
+	positions.clear();
+	index.clear();
+	similarity.clear();
+	snapshots.clear();
+	{
+		juce::ScopedLock journalScope(journalLock);
+		journalRecords = 0;
+	}
 
-		juce::File sampleFile(entry->filePath);
-		if (sampleFile.exists())
+	if (bankIndexFile.exists())
+	{
+		juce::var bankJson = juce::JSON::parse(bankIndexFile);
+		auto samplesVar = bankJson.getProperty("samples", {});
+		if (auto* samplesArray = samplesVar.getArray())
 		{
-			samples.push_back(std::move(entry));
+			for (const auto& sampleVar : *samplesArray)
+			{
+				auto entry = entryFromVar(sampleVar);
+				if (entry && positions.count(entry->id) == 0)
+					insertEntry(std::move(entry));
+			}
 		}
 	}
 
+	replayJournal(compactingJournalFile);
+	replayJournal(journalFile);
+	snapshotTime = bankIndexFile.getLastModificationTime();
+	journalPosition = journalFile.getSize();
+
 	DBG("Loaded " + juce::String(samples.size()) + " samples from bank");
-}
\ No newline at end of file
+}
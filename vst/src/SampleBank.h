@@ -1,69 +1,176 @@
 #pragma once
 #include "JuceHeader.h"
+#include "SampleBankIndex.h"
+#include "SimilarityIndex.h"
+#include <atomic>
+#include <deque>
+#include <future>
 #include <vector>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 
-struct SampleBankEntry
+// One bank per host process, shared by every plugin instance through
+// getShared(). Other processes using the same files are kept in step through
+// the journal, under an inter-process lock.
+class SampleBank : public std::enable_shared_from_this<SampleBank>
 {
-	juce::String id;
-	juce::String filename;
-	juce::String originalPrompt;
-	juce::String filePath;
-	juce::Time creationTime;
-	float duration;
-	float bpm;
-	juce::String key;
-	std::vector<juce::String> stems;
-	std::vector<juce::String> usedInProjects;
-
-	std::vector<juce::String> categories;
-
-	double sampleRate;
-	int numChannels;
-	int numSamples;
-
-	SampleBankEntry() : duration(0.0f), bpm(126.0f), sampleRate(48000.0),
-		numChannels(2), numSamples(0)
+public:
+	class Listener
 	{
-	}
-};
+	public:
+		virtual ~Listener() = default;
+		virtual void sampleBankChanged() {}
+		virtual void sampleAnalyzed(const juce::String& /*sampleId*/, SampleAnalysis::Ptr /*analysis*/) {}
+	};
+
+	static std::shared_ptr<SampleBank> getShared();
 
-class SampleBank
-{
-public:
 	SampleBank();
-	~SampleBank() = default;
+	~SampleBank();
+
+	// Add and remove on the message thread.
+	void addListener(Listener* listener) { listeners.add(listener); }
+	void removeListener(Listener* listener) { listeners.remove(listener); }
+
+	// The index is loaded in the background. Everything that reads or changes
+	// entries waits for it; this lets callers wait or poll instead.
+	std::shared_future<void> getReadyFuture() const { return ready; }
+	bool isReady() const { return isLoaded; }
 
 	juce::String addSample(const juce::String& prompt,
 		const juce::File& audioFile,
 		float bpm = 126.0f,
-		const juce::String& key = "");
+		const juce::String& key = "",
+		const juce::AudioBuffer<float>* audio = nullptr,
+		double sampleRate = 0.0);
 
 	bool removeSample(const juce::String& sampleId);
-	SampleBankEntry* getSample(const juce::String& sampleId);
-	std::vector<SampleBankEntry*> getAllSamples();
+	// Immutable copies, like query(); entries in the bank itself can be
+	// replaced or freed at any time by a journal replay or reload.
+	SampleBankEntry::Ptr getSample(const juce::String& sampleId);
+	std::vector<SampleBankEntry::Ptr> getAllSamples();
+	// Matching entries in display order, as immutable copies that can be used
+	// off the message thread without holding pointers into the bank.
+	std::vector<SampleBankEntry::Ptr> query(const SampleBankIndex::Query& query);
+	SampleAnalysis::Ptr getAnalysis(const juce::String& sampleId);
+	// The entries that sound most like the given one, closest first, as
+	// snapshots like query(). Empty until the sample has been analyzed.
+	std::vector<SampleBankEntry::Ptr> findSimilar(const juce::String& sampleId, int maxResults);
+
+	static juce::File getPeakSummaryFile(const juce::File& sampleFile) { return sampleFile.withFileExtension(".peaks"); }
 
 	std::vector<juce::String> getUnusedSamples() const;
 	int removeUnusedSamples();
 	void markSampleAsUsed(const juce::String& sampleId, const juce::String& projectId);
 	void markSampleAsUnused(const juce::String& sampleId, const juce::String& projectId);
 
+	bool setCategories(const juce::String& sampleId, const std::vector<juce::String>& categories);
+	void renameCategory(const juce::String& oldName, const juce::String& newName);
+	void removeCategory(const juce::String& name);
+
+	// Changes are journaled as they happen and written shortly after; this
+	// writes whatever is still pending right away.
 	void saveBankData();
 	void loadBankData();
 
-	std::function<void()> onBankChanged;
+	juce::File getGenerationCacheDirectory() const { return bankDirectory.getChildFile("GenerationCache"); }
 
 private:
+	class AnalysisWorker;
+	class JournalWriter;
+
 	std::vector<std::unique_ptr<SampleBankEntry>> samples;
+	// Position of each id in samples; removal swaps the last entry into the gap.
+	std::unordered_map<juce::String, size_t> positions;
+	SampleBankIndex index;
+	SimilarityIndex similarity;
+	// Immutable copies handed out by query(), dropped whenever the entry changes.
+	std::unordered_map<juce::String, SampleBankEntry::Ptr> snapshots;
 	juce::File bankDirectory;
 	juce::File bankIndexFile;
 	juce::CriticalSection bankLock;
+	std::unique_ptr<AnalysisWorker> analysisWorker;
+
+	// sample_bank.json is a snapshot; every change since then is one line in
+	// the journal. Compaction folds the journal into a new snapshot.
+	static constexpr int compactAfterRecords = 1000;
+	juce::File journalFile;
+	juce::File compactingJournalFile;
+	// Taken after bankLock when both are needed.
+	juce::CriticalSection journalLock;
+	juce::String pendingJournal;
+	int journalRecords = 0;
+	std::unique_ptr<JournalWriter> journalWriter;
+
+	// Serializes file access within the process, taken before bankLock;
+	// processLock does the same between processes.
+	juce::CriticalSection fileLock;
+	juce::InterProcessLock processLock;
+	// How much of the journal is already applied, and which snapshot it
+	// applies to.
+	juce::int64 journalPosition = 0;
+	juce::Time snapshotTime;
+
+	juce::ListenerList<Listener> listeners;
+
+	std::shared_future<void> ready;
+	std::atomic<bool> isLoaded{ false };
+
+	SampleBankEntry* findEntry(const juce::String& sampleId) const;
+	SampleBankEntry::Ptr getSnapshot(const SampleBankEntry& entry);
+	void waitUntilReady() const;
+	void insertEntry(std::unique_ptr<SampleBankEntry> entry);
+	std::unique_ptr<SampleBankEntry> extractEntry(const juce::String& sampleId);
+
+	// Applies a change to one entry while keeping the indices consistent.
+	// Must be called with bankLock held.
+	template <typename Modifier>
+	bool modifyEntry(SampleBankEntry* entry, Modifier&& modifier)
+	{
+		if (!entry)
+			return false;
+		index.remove(entry);
+		bool changed = modifier(*entry);
+		index.add(entry);
+		if (changed)
+		{
+			snapshots.erase(entry->id);
+			similarity.set(entry->id, entry->analysis ? entry->analysis->features : std::vector<float>());
+		}
+		return changed;
+	}
 
 	juce::String createSafeFilename(const juce::String& prompt, const juce::Time& timestamp);
 	juce::String promptToSnakeCase(const juce::String& prompt);
 	void analyzeSampleFile(SampleBankEntry* entry, const juce::File& audioFile);
+	void queueAnalysis(const juce::String& sampleId);
+	void sweepSampleFiles(juce::Thread& worker);
+	bool analyzeQueuedSample(const juce::String& sampleId);
+	void forgetMissingSample(const juce::String& sampleId);
+	void finishAnalysisBatch();
+	void notifyBankChanged();
 	juce::File getBankDirectory();
 	void ensureBankDirectoryExists();
 
+	static juce::var entryToVar(const SampleBankEntry& entry);
+	static std::unique_ptr<SampleBankEntry> entryFromVar(const juce::var& sampleVar);
+	// The journal* calls must be made with bankLock held, so records land in
+	// the same order as the changes they describe.
+	void journalPut(const SampleBankEntry& entry);
+	void journalRemove(const juce::String& sampleId);
+	void journalUsage(const juce::String& sampleId, const juce::String& projectId, bool used);
+	void appendToJournal(const juce::var& record);
+	void flushJournal();
+	juce::String readJournalTail();
+	void writePendingJournal();
+	bool hasPendingJournal() const;
+	bool needsCompaction() const;
+	void compact();
+	bool setJournalAside();
+	void replayJournal(const juce::File& file);
+	int applyJournalText(const juce::String& text);
+	void applyJournalRecord(const juce::var& record);
+
 	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SampleBank)
 };
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+#include "JuceHeader.h"
+#include "SampleAnalysis.h"
+#include <memory>
+#include <vector>
+
+struct SampleBankEntry
+{
+	using Ptr = std::shared_ptr<const SampleBankEntry>;
+
+	juce::String id;
+	juce::String filename;
+	juce::String originalPrompt;
+	juce::String filePath;
+	juce::Time creationTime;
+	float duration;
+	float bpm;
+	juce::String key;
+	std::vector<juce::String> stems;
+	std::vector<juce::String> usedInProjects;
+
+	std::vector<juce::String> categories;
+
+	double sampleRate;
+	int numChannels;
+	int numSamples;
+
+	SampleAnalysis::Ptr analysis;
+
+	SampleBankEntry() : duration(0.0f), bpm(126.0f), sampleRate(48000.0),
+		numChannels(2), numSamples(0)
+	{
+	}
+};
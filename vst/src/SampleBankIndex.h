@@ -0,0 +1,270 @@
+#pragma once
+#include "JuceHeader.h"
+#include "SampleBankEntry.h"
+#include <algorithm>
+#include <array>
+#include <map>
+#include <set>
+#include <unordered_set>
+#include <vector>
+
+// Secondary indices over the bank: one ordered set per sort key, category and
+// musical key maps, and an inverted index of prompt words. Kept up to date as
+// entries come and go, so listing, filtering and searching never sort or scan
+// the whole bank. An entry's fields must not change while it is indexed;
+// remove it, change it, then add it again. Not locked on its own, the bank only
+// touches it under bankLock.
+class SampleBankIndex
+{
+public:
+	enum class SortKey
+	{
+		Time = 0,
+		Prompt,
+		Usage,
+		Bpm,
+		Duration,
+		Key,
+		Loudness,
+		NumSortKeys
+	};
+
+	struct Query
+	{
+		SortKey sortKey = SortKey::Prompt;
+		juce::String category;
+		juce::String key;
+		// Every word has to match the start or the inside of a prompt word.
+		juce::String text;
+	};
+
+	void add(const SampleBankEntry* entry)
+	{
+		for (auto& order : sorted)
+			order.insert(entry);
+		for (const auto& category : entry->categories)
+			byCategory[category].insert(entry);
+		if (entry->analysis && entry->analysis->key.isNotEmpty())
+			byKey[entry->analysis->key].insert(entry);
+		for (const auto& token : tokenize(entry->originalPrompt))
+			byToken[token].insert(entry);
+	}
+
+	void remove(const SampleBankEntry* entry)
+	{
+		for (auto& order : sorted)
+			order.erase(entry);
+		for (const auto& category : entry->categories)
+			eraseFrom(byCategory, category, entry);
+		if (entry->analysis)
+			eraseFrom(byKey, entry->analysis->key, entry);
+		for (const auto& token : tokenize(entry->originalPrompt))
+			eraseFrom(byToken, token, entry);
+	}
+
+	void clear()
+	{
+		for (auto& order : sorted)
+			order.clear();
+		byCategory.clear();
+		byKey.clear();
+		byToken.clear();
+	}
+
+	std::vector<const SampleBankEntry*> getEntriesInCategory(const juce::String& category) const
+	{
+		auto it = byCategory.find(category);
+		if (it == byCategory.end())
+			return {};
+		return { it->second.begin(), it->second.end() };
+	}
+
+	std::vector<const SampleBankEntry*> find(const Query& query) const
+	{
+		const auto& order = sorted[(size_t)query.sortKey];
+		std::vector<const EntrySet*> filters;
+
+		if (query.category.isNotEmpty())
+		{
+			auto it = byCategory.find(query.category);
+			if (it == byCategory.end())
+				return {};
+			filters.push_back(&it->second);
+		}
+
+		if (query.key.isNotEmpty())
+		{
+			auto it = byKey.find(query.key);
+			if (it == byKey.end())
+				return {};
+			filters.push_back(&it->second);
+		}
+
+		EntrySet textMatches;
+		if (query.text.trim().isNotEmpty())
+		{
+			textMatches = findText(query.text);
+			if (textMatches.empty())
+				return {};
+			filters.push_back(&textMatches);
+		}
+
+		std::vector<const SampleBankEntry*> result;
+		if (filters.empty())
+		{
+			result.assign(order.begin(), order.end());
+			return result;
+		}
+
+		auto smallest = *std::min_element(filters.begin(), filters.end(),
+			[](const EntrySet* a, const EntrySet* b) { return a->size() < b->size(); });
+		auto matchesAll = [&filters, smallest](const SampleBankEntry* entry)
+			{
+				for (auto* filter : filters)
+					if (filter != smallest && filter->count(entry) == 0)
+						return false;
+				return true;
+			};
+
+		// A narrow filter is cheaper to sort on its own than to find by
+		// walking the whole ordered set.
+		if (smallest->size() * 8 < order.size())
+		{
+			for (auto* entry : *smallest)
+				if (matchesAll(entry))
+					result.push_back(entry);
+			std::sort(result.begin(), result.end(), Order{ query.sortKey });
+		}
+		else
+		{
+			for (auto* entry : order)
+				if (smallest->count(entry) != 0 && matchesAll(entry))
+					result.push_back(entry);
+		}
+		return result;
+	}
+
+	static juce::StringArray tokenize(const juce::String& text)
+	{
+		juce::StringArray tokens;
+		juce::String current;
+		for (auto c : text.toLowerCase())
+		{
+			if (juce::CharacterFunctions::isLetterOrDigit(c))
+			{
+				current += c;
+			}
+			else if (current.isNotEmpty())
+			{
+				tokens.addIfNotAlreadyThere(current);
+				current.clear();
+			}
+		}
+		if (current.isNotEmpty())
+			tokens.addIfNotAlreadyThere(current);
+		return tokens;
+	}
+
+private:
+	using EntrySet = std::unordered_set<const SampleBankEntry*>;
+
+	// Same orders the sample list has always shown, with the id as a final
+	// tie-break so every entry has a unique position.
+	struct Order
+	{
+		SortKey key;
+
+		bool operator()(const SampleBankEntry* a, const SampleBankEntry* b) const
+		{
+			int result = compare(*a, *b);
+			return result != 0 ? result < 0 : a->id < b->id;
+		}
+
+		int compare(const SampleBankEntry& a, const SampleBankEntry& b) const
+		{
+			auto descending = [](auto x, auto y) { return x > y ? -1 : (x < y ? 1 : 0); };
+
+			switch (key)
+			{
+			case SortKey::Time: return descending(a.creationTime.toMilliseconds(), b.creationTime.toMilliseconds());
+			case SortKey::Prompt: return a.originalPrompt.compareIgnoreCase(b.originalPrompt);
+			case SortKey::Usage: return descending(a.usedInProjects.size(), b.usedInProjects.size());
+			case SortKey::Bpm: return descending(a.bpm, b.bpm);
+			case SortKey::Duration: return descending(a.duration, b.duration);
+			case SortKey::Key:
+				if (!a.analysis || !b.analysis)
+					return (int)(a.analysis == nullptr) - (int)(b.analysis == nullptr);
+				return a.analysis->key.compareNatural(b.analysis->key);
+			case SortKey::Loudness:
+				if (!a.analysis || !b.analysis)
+					return (int)(a.analysis == nullptr) - (int)(b.analysis == nullptr);
+				return descending(a.analysis->integratedLufs, b.analysis->integratedLufs);
+			default:
+				return 0;
+			}
+		}
+	};
+
+	using OrderedSet = std::set<const SampleBankEntry*, Order>;
+
+	std::array<OrderedSet, (size_t)SortKey::NumSortKeys> sorted = makeOrderedSets();
+	std::map<juce::String, EntrySet> byCategory;
+	std::map<juce::String, EntrySet> byKey;
+	// Ordered, so the words starting with a prefix are one contiguous range.
+	std::map<juce::String, EntrySet> byToken;
+
+	static std::array<OrderedSet, (size_t)SortKey::NumSortKeys> makeOrderedSets()
+	{
+		return { OrderedSet(Order{ SortKey::Time }), OrderedSet(Order{ SortKey::Prompt }),
+			OrderedSet(Order{ SortKey::Usage }), OrderedSet(Order{ SortKey::Bpm }),
+			OrderedSet(Order{ SortKey::Duration }), OrderedSet(Order{ SortKey::Key }),
+			OrderedSet(Order{ SortKey::Loudness }) };
+	}
+
+	static void eraseFrom(std::map<juce::String, EntrySet>& map, const juce::String& name, const SampleBankEntry* entry)
+	{
+		auto it = map.find(name);
+		if (it == map.end())
+			return;
+		it->second.erase(entry);
+		if (it->second.empty())
+			map.erase(it);
+	}
+
+	// Entries whose prompt has a word matching every query word. Prefixes come
+	// straight from the ordered token range; longer words also match inside
+	// prompt words, which costs a pass over the vocabulary, not the bank.
+	EntrySet findText(const juce::String& text) const
+	{
+		EntrySet result;
+		bool first = true;
+		for (const auto& word : tokenize(text))
+		{
+			EntrySet wordMatches;
+			for (auto it = byToken.lower_bound(word); it != byToken.end() && it->first.startsWith(word); ++it)
+				wordMatches.insert(it->second.begin(), it->second.end());
+
+			if (word.length() >= 3)
+			{
+				for (const auto& [token, entries] : byToken)
+					if (!token.startsWith(word) && token.contains(word))
+						wordMatches.insert(entries.begin(), entries.end());
+			}
+
+			if (first)
+			{
+				result = std::move(wordMatches);
+				first = false;
+			}
+			else
+			{
+				for (auto it = result.begin(); it != result.end();)
+					it = wordMatches.count(*it) != 0 ? std::next(it) : result.erase(it);
+			}
+
+			if (result.empty())
+				break;
+		}
+		return result;
+	}
+};
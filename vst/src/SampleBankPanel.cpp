@@ -1,9 +1,10 @@
 ﻿#include "SampleBankPanel.h"
 #include "PluginProcessor.h"
 #include "CategoryWindow.h"
+#include "PageCacheFile.h"
 
-SampleBankItem::SampleBankItem(SampleBankEntry* entry, DjIaVstProcessor& processor)
-	: sampleEntry(entry), audioProcessor(processor), validityFlag(std::make_shared<std::atomic<bool>>(true))
+SampleBankItem::SampleBankItem(DjIaVstProcessor& processor)
+	: audioProcessor(processor), validityFlag(std::make_shared<std::atomic<bool>>(true))
 {
 	addAndMakeVisible(nameLabel);
 	addAndMakeVisible(durationLabel);
@@ -37,7 +38,7 @@ SampleBankItem::SampleBankItem(SampleBankEntry* entry, DjIaVstProcessor& process
 			else
 			{
 				if (onPreviewRequested)
-					onPreviewRequested(sampleEntry);
+					onPreviewRequested(sampleEntry.get());
 			}
 		};
 
@@ -48,12 +49,9 @@ SampleBankItem::SampleBankItem(SampleBankEntry* entry, DjIaVstProcessor& process
 	deleteButton.setTooltip("Delete sample");
 	deleteButton.onClick = [this]()
 		{
-			if (onDeleteRequested)
+			if (onDeleteRequested && sampleEntry)
 				onDeleteRequested(sampleEntry->id);
 		};
-	updateLabels();
-	int requiredHeight = getRequiredHeight();
-	setSize(400, requiredHeight);
 }
 
 SampleBankItem::~SampleBankItem()
@@ -64,14 +62,14 @@ SampleBankItem::~SampleBankItem()
 	sampleEntry = nullptr;
 }
 
-int SampleBankItem::getRequiredHeight()
+int SampleBankItem::getRequiredHeight(const SampleBankEntry& entry)
 {
 	const int labelsHeight = 16 + 16 + 4;
 	const int waveformHeight = 30;
 	const int margins = 16;
 	const int baseHeight = labelsHeight + waveformHeight + margins;
 
-	if (sampleEntry && !sampleEntry->categories.empty())
+	if (!entry.categories.empty())
 	{
 		return baseHeight + 25;
 	}
@@ -79,27 +77,48 @@ int SampleBankItem::getRequiredHeight()
 	return baseHeight;
 }
 
-void SampleBankItem::loadAudioDataIfNeeded()
+void SampleBankItem::setSampleEntry(SampleBankEntry::Ptr entry, std::shared_ptr<const PeakSummary> cachedPeaks)
 {
-	if (audioBuffer.getNumSamples() == 0)
+	if (entry == sampleEntry)
 	{
-		loadAudioData();
-		if (!waveformBounds.isEmpty())
-		{
-			generateThumbnail();
-			repaint();
-		}
+		// Back on screen before its peaks arrived; the old request was
+		// dropped when the row was released.
+		if (sampleEntry && !peakSummary)
+			loadPeaks();
+		return;
 	}
+
+	// Anything still loading for the previous entry is no longer wanted.
+	cancelPeakLoad();
+
+	stopTimer();
+	isPlaying = false;
+	isSelected = false;
+	isDragging = false;
+	playbackPosition = 0.0f;
+
+	sampleEntry = std::move(entry);
+	peakSummary = std::move(cachedPeaks);
+
+	updatePlayButton();
+	updateLabels();
+	updateBadgeLayout();
+	generateThumbnail();
+
+	if (sampleEntry && !peakSummary)
+		loadPeaks();
+
+	repaint();
 }
 
-void SampleBankItem::setIsPlaying(bool playing)
+void SampleBankItem::setIsPlaying(bool playing, float startPosition)
 {
 	isPlaying = playing;
 	updatePlayButton();
 
 	if (isPlaying)
 	{
-		playbackPosition = 0.0f;
+		playbackPosition = startPosition;
 		lastTimerCall = juce::Time::getMillisecondCounterHiRes() / 1000.0;
 		startTimer(30);
 	}
@@ -154,6 +173,9 @@ void SampleBankItem::updatePlayButton()
 
 void SampleBankItem::paint(juce::Graphics& g)
 {
+	if (!sampleEntry)
+		return;
+
 	auto bounds = getLocalBounds();
 
 	juce::Colour bgColour;
@@ -295,16 +317,6 @@ void SampleBankItem::resized()
 	waveformBounds = area.removeFromTop(waveformHeight);
 
 	generateThumbnail();
-
-	int requiredHeight = getRequiredHeight();
-	if (getHeight() != requiredHeight)
-	{
-		setSize(getWidth(), requiredHeight);
-		if (auto* parent = getParentComponent())
-			parent->resized();
-		return;
-	}
-
 	updateBadgeLayout();
 	repaint();
 }
@@ -318,6 +330,9 @@ void SampleBankItem::updateBadgeLayout()
 	juce::FontOptions badgeFont(12.0f);
 
 	maxVisibleBadges = 0;
+	if (!sampleEntry)
+		return;
+
 	int currentX = 0;
 
 	for (const auto& category : sampleEntry->categories)
@@ -347,59 +362,125 @@ void SampleBankItem::updateBadgeLayout()
 	}
 }
 
-void SampleBankItem::loadAudioData()
+void SampleBankItem::cancelPeakLoad()
 {
-	if (!sampleEntry)
-		return;
+	validityFlag->store(false);
+	validityFlag = std::make_shared<std::atomic<bool>>(true);
+}
 
+void SampleBankItem::loadPeaks()
+{
 	juce::File audioFile(sampleEntry->filePath);
-	if (!audioFile.exists())
+	if (!peakLoader || !audioFile.exists())
 		return;
 
-	double currentSampleRate = audioProcessor.getSampleRate();
-	auto validity = validityFlag;
-
-	juce::Thread::launch([this, audioFile, currentSampleRate, validity]()
+	auto sampleId = sampleEntry->id;
+	peakLoader->request(this, audioFile, validityFlag, [this, sampleId](std::shared_ptr<const PeakSummary> summary)
 		{
-			if (!validity->load()) return;
+			if (!isDestroyed.load())
+				peaksLoaded(sampleId, summary);
+		});
+}
 
-			juce::AudioFormatManager formatManager;
-			formatManager.registerBasicFormats();
+SamplePeakLoader::SamplePeakLoader()
+	: juce::Thread("SampleBank Peaks")
+{
+}
 
-			auto reader = std::unique_ptr<juce::AudioFormatReader>(
-				formatManager.createReaderFor(audioFile));
+SamplePeakLoader::~SamplePeakLoader()
+{
+	stopThread(5000);
+}
 
-			if (reader && validity->load())
+void SamplePeakLoader::request(const void* row, const juce::File& audioFile,
+	std::shared_ptr<std::atomic<bool>> validity, Callback onLoaded)
+{
+	{
+		const juce::ScopedLock lock(queueLock);
+		queue.erase(std::remove_if(queue.begin(), queue.end(), [row](const Request& queued)
+			{ return queued.row == row; }), queue.end());
+		if (queue.size() >= maxQueuedRequests)
+			queue.pop_front();
+		queue.push_back({ row, audioFile, std::move(validity), std::move(onLoaded) });
+	}
+
+	if (!isThreadRunning())
+		startThread(juce::Thread::Priority::background);
+	notify();
+}
+
+void SamplePeakLoader::run()
+{
+	while (!threadShouldExit())
+	{
+		Request next;
+		{
+			const juce::ScopedLock lock(queueLock);
+			// Rows that were rebound or destroyed since asking are skipped.
+			while (!queue.empty() && !queue.back().validity->load())
+				queue.pop_back();
+			if (!queue.empty())
 			{
-				const int downsampleRatio = std::max(1, (int)(reader->lengthInSamples / 4096));
-				const int numSamples = (int)(reader->lengthInSamples / downsampleRatio);
+				next = std::move(queue.back());
+				queue.pop_back();
+			}
+		}
 
-				auto tempBuffer = std::make_shared<juce::AudioBuffer<float>>(reader->numChannels, numSamples);
+		if (next.validity == nullptr)
+		{
+			wait(-1);
+			continue;
+		}
 
-				for (int i = 0; i < numSamples; ++i)
-				{
-					if (!validity->load()) return;
-					reader->read(tempBuffer.get(), i, 1, i * downsampleRatio, true, true);
-				}
+		auto summary = loadPeaks(next.audioFile, *next.validity);
+		if (summary == nullptr || !next.validity->load())
+			continue;
 
+		juce::MessageManager::callAsync([summary, validity = next.validity, onLoaded = std::move(next.onLoaded)]()
+			{
 				if (validity->load())
-				{
-					juce::MessageManager::callAsync([this, tempBuffer, currentSampleRate, validity]()
-						{
-							if (validity->load() && !isDestroyed.load() && sampleEntry)
-							{
-								audioBuffer = *tempBuffer;
-								sampleRate = currentSampleRate;
-
-								if (!waveformBounds.isEmpty())
-								{
-									generateThumbnail();
-									repaint();
-								}
-							}
-						});
-				}
-			} });
+					onLoaded(summary);
+			});
+	}
+}
+
+std::shared_ptr<PeakSummary> SamplePeakLoader::loadPeaks(const juce::File& audioFile, const std::atomic<bool>& validity)
+{
+	auto summary = std::make_shared<PeakSummary>();
+	auto peakFile = SampleBank::getPeakSummaryFile(audioFile);
+	if (PeakSummary::readFromFile(peakFile, *summary) || PageCacheFile::readPeaks(audioFile, *summary))
+		return summary;
+
+	// Nothing cached yet: decode once and write the sidecar so the next time
+	// this sample is shown it only reads the peaks.
+	juce::AudioFormatManager formatManager;
+	formatManager.registerBasicFormats();
+
+	auto reader = std::unique_ptr<juce::AudioFormatReader>(formatManager.createReaderFor(audioFile));
+	if (!reader || !validity.load())
+		return nullptr;
+
+	juce::AudioBuffer<float> buffer((int)reader->numChannels, (int)reader->lengthInSamples);
+	reader->read(&buffer, 0, (int)reader->lengthInSamples, 0, true, true);
+	*summary = PeakSummary::build(buffer);
+	summary->writeToFile(peakFile);
+	return summary;
+}
+
+void SampleBankItem::peaksLoaded(const juce::String& sampleId, std::shared_ptr<const PeakSummary> summary)
+{
+	if (!sampleEntry || sampleEntry->id != sampleId)
+		return;
+
+	peakSummary = summary;
+	if (onPeaksLoaded)
+		onPeaksLoaded(sampleId, summary);
+
+	if (!waveformBounds.isEmpty())
+	{
+		generateThumbnail();
+		repaint();
+	}
 }
 
 void SampleBankItem::drawMiniWaveform(juce::Graphics& g)
@@ -532,51 +613,45 @@ void SampleBankItem::generateThumbnail()
 	thumbnailLeft.clear();
 	thumbnailRight.clear();
 
-	if (audioBuffer.getNumSamples() == 0)
-		return;
-
-	int numSamples = audioBuffer.getNumSamples();
-	int numChannels = audioBuffer.getNumChannels();
-	bool isMono = (numChannels == 1);
-
 	int waveformWidth = waveformBounds.getWidth() - 20;
-	if (waveformWidth <= 0)
+	if (!peakSummary || waveformWidth <= 0 || peakSummary->levels.empty())
 		return;
 
-	int samplesPerPoint = juce::jmax(1, numSamples / waveformWidth);
-
-	for (int point = 0; point < waveformWidth; ++point)
+	const PeakSummary::Level* level = &peakSummary->levels.front();
+	for (auto it = peakSummary->levels.rbegin(); it != peakSummary->levels.rend(); ++it)
 	{
-		int sampleStart = point * samplesPerPoint;
-		int sampleEnd = juce::jmin(sampleStart + samplesPerPoint, numSamples);
-
-		float rmsSumLeft = 0.0f;
-		float rmsSumRight = 0.0f;
-		float peakLeft = 0.0f;
-		float peakRight = 0.0f;
-		int count = 0;
-
-		for (int sample = sampleStart; sample < sampleEnd; ++sample)
+		if (it->numBuckets >= waveformWidth)
 		{
-			float valLeft = audioBuffer.getSample(0, sample);
-			rmsSumLeft += valLeft * valLeft;
-			peakLeft = juce::jmax(peakLeft, std::abs(valLeft));
+			level = &*it;
+			break;
+		}
+	}
 
-			float valRight = isMono ? valLeft : audioBuffer.getSample(1, sample);
-			rmsSumRight += valRight * valRight;
-			peakRight = juce::jmax(peakRight, std::abs(valRight));
+	int numChannels = peakSummary->numChannels;
+	int bucketsPerPoint = juce::jmax(1, level->numBuckets / waveformWidth);
+	int numPoints = juce::jmin(waveformWidth, level->numBuckets);
 
-			count++;
-		}
+	// Only peaks are stored, so scale them toward the RMS/peak blend that the
+	// track waveform draws.
+	const float peakScale = 0.6f / 32767.0f;
 
-		float rmsLeft = count > 0 ? std::sqrt(rmsSumLeft / count) : 0.0f;
-		float rmsRight = count > 0 ? std::sqrt(rmsSumRight / count) : 0.0f;
+	for (int point = 0; point < numPoints; ++point)
+	{
+		int bucketStart = point * bucketsPerPoint;
+		int bucketEnd = juce::jmin(bucketStart + bucketsPerPoint, level->numBuckets);
+		int peaks[2] = { 0, 0 };
 
-		float finalLeft = (rmsLeft * 0.7f) + (peakLeft * 0.3f);
-		float finalRight = (rmsRight * 0.7f) + (peakRight * 0.3f);
+		for (int bucket = bucketStart; bucket < bucketEnd; ++bucket)
+		{
+			for (int ch = 0; ch < numChannels; ++ch)
+			{
+				auto index = ((size_t)bucket * numChannels + ch) * 2;
+				peaks[ch] = juce::jmax(peaks[ch], std::abs((int)level->minMax[index]), std::abs((int)level->minMax[index + 1]));
+			}
+		}
 
-		thumbnailLeft.push_back(finalLeft);
-		thumbnailRight.push_back(finalRight);
+		thumbnailLeft.push_back(peaks[0] * peakScale);
+		thumbnailRight.push_back((numChannels > 1 ? peaks[1] : peaks[0]) * peakScale);
 	}
 }
 
@@ -613,10 +688,36 @@ void SampleBankItem::mouseDown(const juce::MouseEvent& event)
 	}
 	else if (event.mods.isRightButtonDown())
 	{
-		showCategoryMenu();
+		showContextMenu();
 	}
 }
 
+void SampleBankItem::showContextMenu()
+{
+	if (!sampleEntry)
+		return;
+
+	bool hasFeatures = sampleEntry->analysis && !sampleEntry->analysis->features.empty();
+
+	juce::PopupMenu menu;
+	menu.addItem(1, "Edit categories...");
+	menu.addItem(2, hasFeatures ? "Find similar sounds" : "Find similar sounds (analyzing...)", hasFeatures);
+
+	juce::Component::SafePointer<SampleBankItem> safeThis(this);
+	auto entry = sampleEntry;
+	menu.showMenuAsync(juce::PopupMenu::Options().withTargetComponent(this), [safeThis, entry](int result)
+		{
+			// The row may have been recycled for another sample meanwhile.
+			if (safeThis == nullptr || !safeThis->sampleEntry || safeThis->sampleEntry->id != entry->id)
+				return;
+
+			if (result == 1)
+				safeThis->showCategoryMenu();
+			else if (result == 2 && safeThis->onFindSimilarRequested)
+				safeThis->onFindSimilarRequested(entry.get());
+		});
+}
+
 void SampleBankItem::showCategoryMenu()
 {
 	if (!sampleEntry)
@@ -648,11 +749,11 @@ void SampleBankItem::showCategoryMenu()
 			if (!bank)
 				return;
 
-			auto* sample = bank->getSample(sampleId);
+			auto sample = bank->getSample(sampleId);
 			if (!sample)
 				return;
 
-			sample->categories = newCategories;
+			bank->setCategories(sampleId, newCategories);
 
 			if (onCategoriesChanged)
 				onCategoriesChanged(sample, newCategories);
@@ -721,6 +822,15 @@ void SampleBankItem::updateLabels()
 	nameLabel.setText(sampleEntry->originalPrompt, juce::dontSendNotification);
 	durationLabel.setText(formatDuration(sampleEntry->duration), juce::dontSendNotification);
 	bpmLabel.setText(juce::String(sampleEntry->bpm, 1) + " BPM", juce::dontSendNotification);
+	if (auto analysis = sampleEntry->analysis)
+	{
+		bpmLabel.setTooltip(analysis->key + " | " + juce::String(analysis->integratedLufs, 1) + " LUFS | "
+			+ juce::String(analysis->truePeakDb, 1) + " dBTP | " + juce::String(analysis->bpm, 1) + " BPM detected");
+	}
+	else
+	{
+		bpmLabel.setTooltip({});
+	}
 	usageLabel.setText(formatUsage(), juce::dontSendNotification);
 }
 
@@ -773,34 +883,22 @@ SampleBankPanel::SampleBankPanel(DjIaVstProcessor& processor)
 	setupUI();
 
 	if (auto* bank = audioProcessor.getSampleBank())
-	{
-		bank->onBankChanged = [this]()
-			{
-				juce::MessageManager::callAsync([this]()
-					{ refreshSampleList(); });
-			};
-	}
+		bank->addListener(this);
 }
 
 SampleBankPanel::~SampleBankPanel()
 {
+	latestQuery->store(0);
 	stopPreview();
 	if (auto* bank = audioProcessor.getSampleBank())
-	{
-		bank->onBankChanged = nullptr;
-	}
+		bank->removeListener(this);
 }
 
-void SampleBankPanel::playPreview(SampleBankEntry* entry)
+void SampleBankPanel::playPreview(const SampleBankEntry* entry)
 {
 	if (!entry)
 		return;
 
-	if (currentPreviewEntry && currentPreviewItem)
-	{
-		currentPreviewItem->setIsPlaying(false);
-	}
-
 	stopPreview();
 
 	bool previewStarted = audioProcessor.previewSampleFromBank(entry->id);
@@ -810,15 +908,14 @@ void SampleBankPanel::playPreview(SampleBankEntry* entry)
 		return;
 	}
 
-	currentPreviewEntry = entry;
+	currentPreviewId = entry->id;
+	previewStartTime = juce::Time::getMillisecondCounterHiRes();
 
 	for (auto& item : sampleItems)
 	{
-		if (item->getSampleEntry() == entry)
+		if (item->getRowIndex() >= 0 && item->getSampleEntry() && item->getSampleEntry()->id == currentPreviewId)
 		{
 			item->setIsPlaying(true);
-			currentPreviewItem = item.get();
-			break;
 		}
 	}
 
@@ -829,13 +926,15 @@ void SampleBankPanel::stopPreview()
 {
 	audioProcessor.stopSamplePreview();
 
-	if (currentPreviewItem)
+	for (auto& item : sampleItems)
 	{
-		currentPreviewItem->setIsPlaying(false);
-		currentPreviewItem = nullptr;
+		if (item->getSampleEntry() && item->getSampleEntry()->id == currentPreviewId)
+		{
+			item->setIsPlaying(false);
+		}
 	}
 
-	currentPreviewEntry = nullptr;
+	currentPreviewId.clear();
 	stopTimer();
 }
 
@@ -850,12 +949,12 @@ void SampleBankPanel::timerCallback()
 		repaint();
 	}
 
-	if (currentPreviewEntry && !audioProcessor.isSamplePreviewing())
+	if (currentPreviewId.isNotEmpty() && !audioProcessor.isSamplePreviewing())
 	{
 		stopPreview();
 	}
 
-	if (!isLoading.load() && !currentPreviewEntry)
+	if (!isLoading.load() && currentPreviewId.isEmpty())
 	{
 		stopTimer();
 	}
@@ -880,7 +979,7 @@ void SampleBankPanel::paint(juce::Graphics& g)
 	g.drawRect(bounds, 1);
 
 	bool showLoader = isLoading.load();
-	bool showEmpty = !showLoader && sampleItems.empty() && hasEverLoaded.load();
+	bool showEmpty = !showLoader && listedSamples.empty() && hasEverLoaded.load();
 
 	if (showLoader)
 	{
@@ -958,12 +1057,17 @@ void SampleBankPanel::resized()
 	headerArea.removeFromRight(5);
 	sortMenu.setBounds(headerArea.removeFromRight(150).reduced(5));
 
+	searchInput.setBounds(area.removeFromTop(30).reduced(0, 2));
+	area.removeFromTop(5);
+
 	auto infoArea = area.removeFromTop(50);
 	infoLabel.setBounds(infoArea);
 	area.removeFromTop(5);
 	auto categoryArea = area.removeFromTop(35);
 	categoryFilter.setBounds(categoryArea.removeFromLeft(150));
 	categoryArea.removeFromLeft(10);
+	keyFilter.setBounds(categoryArea.removeFromLeft(110));
+	categoryArea.removeFromLeft(10);
 	categoryInput.setBounds(categoryArea);
 
 	area.removeFromTop(5);
@@ -976,126 +1080,222 @@ void SampleBankPanel::resized()
 
 	area.removeFromTop(5);
 	samplesViewport.setBounds(area);
-
-	int totalHeight = 5;
-	for (auto& item : sampleItems)
-	{
-		totalHeight += item->getRequiredHeight() + 5;
-	}
-	samplesContainer.setSize(area.getWidth() - 20, totalHeight);
+	layoutRows();
 }
 
 void SampleBankPanel::refreshSampleList()
 {
-	auto startTime = juce::Time::getCurrentTime();
-	sampleItems.clear();
-	samplesContainer.removeAllChildren();
 	auto* bank = audioProcessor.getSampleBank();
 	if (!bank)
 	{
-		isLoading.store(false);
-		hasEverLoaded.store(true);
-		stopTimer();
-		repaint();
+		latestQuery->store(++queryVersion);
+		queryFinished(std::make_shared<std::vector<SampleBankEntry::Ptr>>(), queryVersion);
 		return;
 	}
 
-	auto samples = bank->getAllSamples();
-
-	DBG("Before filtering: " + juce::String(samples.size()) + " samples");
-	DBG("Current category ID: " + juce::String(currentCategoryId));
-
+	SampleQuery query;
+	query.similarTo = similarToId;
+	query.key = currentKeyFilter;
+	query.text = searchInput.getText();
+	query.sortType = currentSortType;
 	if (currentCategoryId != 0)
 	{
-		juce::String selectedCategoryName;
 		for (const auto& info : categoryInfos)
 		{
 			if (info.id == currentCategoryId)
 			{
-				selectedCategoryName = info.name;
+				query.category = info.name;
 				break;
 			}
 		}
+	}
+
+	auto version = ++queryVersion;
+	latestQuery->store(version);
+	queryStartTime = juce::Time::getMillisecondCounter();
 
-		DBG("Filtering by category: " + selectedCategoryName);
+	auto latest = latestQuery;
+	juce::Component::SafePointer<SampleBankPanel> safeThis(this);
 
-		if (!selectedCategoryName.isEmpty())
+	juce::Thread::launch([bank, query, version, latest, safeThis]()
 		{
-			samples.erase(
-				std::remove_if(samples.begin(), samples.end(),
-					[&selectedCategoryName](const SampleBankEntry* entry)
-					{
-						return std::find(entry->categories.begin(), entry->categories.end(),
-							selectedCategoryName) == entry->categories.end();
-					}),
-				samples.end());
-		}
+			auto isCancelled = [&latest, version]() { return latest->load() != version; };
+			auto samples = std::make_shared<std::vector<SampleBankEntry::Ptr>>(runQuery(*bank, query, isCancelled));
+			if (isCancelled())
+				return;
+
+			juce::MessageManager::callAsync([safeThis, samples, version]()
+				{
+					if (safeThis != nullptr)
+						safeThis->queryFinished(samples, version);
+				});
+		});
+}
+
+std::vector<SampleBankEntry::Ptr> SampleBankPanel::runQuery(SampleBank& bank, const SampleQuery& query,
+	const std::function<bool()>& isCancelled)
+{
+	if (isCancelled())
+		return {};
+
+	if (query.similarTo.isNotEmpty())
+		return bank.findSimilar(query.similarTo, maxSimilarResults);
+
+	SampleBankIndex::Query indexQuery;
+	indexQuery.category = query.category;
+	indexQuery.key = query.key;
+	indexQuery.text = query.text;
+
+	switch (query.sortType)
+	{
+	case SortType::Time: indexQuery.sortKey = SampleBankIndex::SortKey::Time; break;
+	case SortType::Prompt: indexQuery.sortKey = SampleBankIndex::SortKey::Prompt; break;
+	case SortType::Usage: indexQuery.sortKey = SampleBankIndex::SortKey::Usage; break;
+	case SortType::BPM: indexQuery.sortKey = SampleBankIndex::SortKey::Bpm; break;
+	case SortType::Duration: indexQuery.sortKey = SampleBankIndex::SortKey::Duration; break;
+	case SortType::Key: indexQuery.sortKey = SampleBankIndex::SortKey::Key; break;
+	case SortType::Loudness: indexQuery.sortKey = SampleBankIndex::SortKey::Loudness; break;
 	}
 
-	switch (currentSortType)
+	return bank.query(indexQuery);
+}
+
+void SampleBankPanel::queryFinished(std::shared_ptr<std::vector<SampleBankEntry::Ptr>> samples, juce::uint32 version)
+{
+	if (version != queryVersion)
+		return;
+
+	// Keep the loader up for a moment when the panel opens so it doesn't
+	// just flash.
+	const int minLoaderTime = 600;
+	int elapsedMs = (int)(juce::Time::getMillisecondCounter() - queryStartTime);
+	if (isLoading.load() && elapsedMs < minLoaderTime)
 	{
-	case SortType::Time:
-		std::sort(samples.begin(), samples.end(),
-			[](const SampleBankEntry* a, const SampleBankEntry* b)
+		juce::Component::SafePointer<SampleBankPanel> safeThis(this);
+		juce::Timer::callAfterDelay(minLoaderTime - elapsedMs, [safeThis, samples, version]()
 			{
-				return a->creationTime > b->creationTime;
+				if (safeThis != nullptr)
+				{
+					safeThis->isLoading.store(false);
+					safeThis->queryFinished(samples, version);
+				}
 			});
-		break;
+		return;
+	}
 
-	case SortType::Prompt:
-		std::sort(samples.begin(), samples.end(),
-			[](const SampleBankEntry* a, const SampleBankEntry* b)
-			{
-				return a->originalPrompt.compareIgnoreCase(b->originalPrompt) < 0;
-			});
-		break;
+	DBG("Sample list: " + juce::String(samples->size()) + " samples in " + juce::String(elapsedMs) + " ms");
 
-	case SortType::Usage:
-		std::sort(samples.begin(), samples.end(),
-			[](const SampleBankEntry* a, const SampleBankEntry* b)
-			{
-				return a->usedInProjects.size() > b->usedInProjects.size();
-			});
-		break;
+	listedSamples = std::move(*samples);
+	releaseAllRows();
+	layoutRows();
 
-	case SortType::BPM:
-		std::sort(samples.begin(), samples.end(),
-			[](const SampleBankEntry* a, const SampleBankEntry* b)
-			{
-				return a->bpm > b->bpm;
-			});
-		break;
+	if (currentPreviewId.isEmpty())
+	{
+		stopTimer();
+	}
 
-	case SortType::Duration:
-		std::sort(samples.begin(), samples.end(),
-			[](const SampleBankEntry* a, const SampleBankEntry* b)
-			{
-				return a->duration > b->duration;
-			});
-		break;
+	isLoading.store(false);
+	hasEverLoaded.store(true);
+
+	repaint();
+}
+
+void SampleBankPanel::layoutRows()
+{
+	rowPositions.clear();
+	rowPositions.reserve(listedSamples.size() + 1);
+
+	int yPos = 5;
+	for (const auto& entry : listedSamples)
+	{
+		rowPositions.push_back(yPos);
+		yPos += SampleBankItem::getRequiredHeight(*entry) + 5;
 	}
+	rowPositions.push_back(yPos);
 
-	auto elapsed = juce::Time::getCurrentTime() - startTime;
-	int elapsedMs = (int)elapsed.inMilliseconds();
-	int minLoaderTime = 600;
-	int remainingTime = std::max(0, minLoaderTime - elapsedMs);
+	samplesContainer.setSize(juce::jmax(0, samplesViewport.getWidth() - 20), yPos + 5);
 
-	juce::Timer::callAfterDelay(remainingTime, [this, samples, safeThis = juce::Component::SafePointer(this)]()
+	for (auto& item : sampleItems)
+	{
+		int row = item->getRowIndex();
+		if (row >= 0 && row < (int)listedSamples.size())
 		{
-			if (safeThis != nullptr)
-			{
-				createSampleItems(samples);
-				if (!currentPreviewEntry)
-				{
-					stopTimer();
-				}
+			item->setBounds(5, rowPositions[(size_t)row], samplesContainer.getWidth() - 10,
+				rowPositions[(size_t)row + 1] - rowPositions[(size_t)row] - 5);
+		}
+	}
 
-				isLoading.store(false);
-				hasEverLoaded.store(true);
+	updateVisibleRows();
+}
 
-				repaint();
-			}
-		});
+void SampleBankPanel::releaseAllRows()
+{
+	for (auto& item : sampleItems)
+	{
+		item->setRowIndex(-1);
+		item->setVisible(false);
+		item->cancelPeakLoad();
+	}
+}
+
+void SampleBankPanel::updateVisibleRows()
+{
+	int numRows = (int)listedSamples.size();
+	if (numRows == 0 || rowPositions.size() != listedSamples.size() + 1)
+	{
+		releaseAllRows();
+		return;
+	}
+
+	auto viewArea = samplesViewport.getViewArea();
+	auto rowsBegin = rowPositions.begin();
+	auto rowsEnd = rowPositions.end() - 1;
+
+	int firstRow = (int)(std::upper_bound(rowsBegin, rowsEnd, viewArea.getY()) - rowsBegin) - 1;
+	int lastRow = (int)(std::lower_bound(rowsBegin, rowsEnd, viewArea.getBottom()) - rowsBegin);
+	firstRow = juce::jlimit(0, numRows, firstRow - overscanRows);
+	lastRow = juce::jlimit(firstRow, numRows, lastRow + overscanRows);
+
+	std::vector<bool> rowHasItem((size_t)(lastRow - firstRow), false);
+	for (auto& item : sampleItems)
+	{
+		int row = item->getRowIndex();
+		if (row >= firstRow && row < lastRow)
+		{
+			rowHasItem[(size_t)(row - firstRow)] = true;
+		}
+		else if (row >= 0)
+		{
+			item->setRowIndex(-1);
+			item->setVisible(false);
+			item->cancelPeakLoad();
+		}
+	}
+
+	size_t nextFree = 0;
+	for (int row = firstRow; row < lastRow; ++row)
+	{
+		if (rowHasItem[(size_t)(row - firstRow)])
+			continue;
+
+		while (nextFree < sampleItems.size() && sampleItems[nextFree]->getRowIndex() >= 0)
+			++nextFree;
+		auto* item = nextFree < sampleItems.size() ? sampleItems[nextFree].get() : createSampleItem();
+
+		const auto& entry = listedSamples[(size_t)row];
+		item->setRowIndex(row);
+		item->setBounds(5, rowPositions[(size_t)row], samplesContainer.getWidth() - 10,
+			rowPositions[(size_t)row + 1] - rowPositions[(size_t)row] - 5);
+
+		auto cached = peakCache.find(entry->id);
+		item->setSampleEntry(entry, cached != peakCache.end() ? cached->second : nullptr);
+		if (entry->id == currentPreviewId)
+		{
+			float elapsed = (float)((juce::Time::getMillisecondCounterHiRes() - previewStartTime) / 1000.0);
+			item->setIsPlaying(true, elapsed);
+		}
+		item->setVisible(true);
+	}
 }
 
 void SampleBankPanel::setVisible(bool shouldBeVisible)
@@ -1123,8 +1323,12 @@ void SampleBankPanel::setVisible(bool shouldBeVisible)
 		stopPreview();
 		isLoading.store(false);
 		stopTimer();
+		latestQuery->store(0);
+		listedSamples.clear();
+		rowPositions.clear();
 		sampleItems.clear();
 		samplesContainer.removeAllChildren();
+		peakCache.clear();
 	}
 }
 void SampleBankPanel::setupUI()
@@ -1135,7 +1339,7 @@ void SampleBankPanel::setupUI()
 	titleLabel.setColour(juce::Label::textColourId, ColourPalette::textAccent);
 
 	addAndMakeVisible(infoLabel);
-	infoLabel.setText("Preview plays on channel 9 (Preview). Enable multioutput in DAW to hear it.\nDrag: Drop on track | Ctrl+Drag: Drop in DAW | Right-click: Categories", juce::dontSendNotification);
+	infoLabel.setText("Preview plays on channel 9 (Preview). Enable multioutput in DAW to hear it.\nDrag: Drop on track | Ctrl+Drag: Drop in DAW | Right-click: Categories, Similar sounds", juce::dontSendNotification);
 	infoLabel.setFont(juce::FontOptions(12.0f));
 	infoLabel.setColour(juce::Label::textColourId, ColourPalette::textSecondary);
 	infoLabel.setJustificationType(juce::Justification::centredLeft);
@@ -1152,16 +1356,21 @@ void SampleBankPanel::setupUI()
 	sortMenu.addItem("Sort by: Usage", SortType::Usage);
 	sortMenu.addItem("Sort by: BPM", SortType::BPM);
 	sortMenu.addItem("Sort by: Duration", SortType::Duration);
+	sortMenu.addItem("Sort by: Key", SortType::Key);
+	sortMenu.addItem("Sort by: Loudness", SortType::Loudness);
 	sortMenu.setSelectedId(SortType::Prompt);
 	sortMenu.onChange = [this]()
 		{
 			currentSortType = static_cast<SortType>(sortMenu.getSelectedId());
+			clearSimilarSamples();
 			refreshSampleList();
 		};
 
 	addAndMakeVisible(samplesViewport);
 	samplesViewport.setViewedComponent(&samplesContainer, false);
 	samplesViewport.setScrollBarsShown(true, false);
+	samplesViewport.onVisibleAreaChanged = [this]()
+		{ updateVisibleRows(); };
 
 	addAndMakeVisible(categoryFilter);
 	for (const auto& info : categoryInfos)
@@ -1185,6 +1394,32 @@ void SampleBankPanel::setupUI()
 			editCategoryButton.setEnabled(editable);
 			deleteCategoryButton.setEnabled(editable);
 
+			clearSimilarSamples();
+			refreshSampleList();
+		};
+
+	addAndMakeVisible(keyFilter);
+	keyFilter.addItem("All Keys", 1);
+	{
+		const char* noteNames[] = { "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B" };
+		int itemId = 2;
+		for (const char* mode : { " Major", " Minor" })
+			for (const char* note : noteNames)
+				keyFilter.addItem(juce::String(note) + mode, itemId++);
+	}
+	keyFilter.setSelectedId(1);
+	keyFilter.onChange = [this]()
+		{
+			currentKeyFilter = keyFilter.getSelectedId() > 1 ? keyFilter.getText() : juce::String();
+			clearSimilarSamples();
+			refreshSampleList();
+		};
+
+	addAndMakeVisible(searchInput);
+	searchInput.setTextToShowWhenEmpty("Search prompts...", ColourPalette::textSecondary);
+	searchInput.onTextChange = [this]()
+		{
+			clearSimilarSamples();
 			refreshSampleList();
 		};
 
@@ -1213,67 +1448,82 @@ void SampleBankPanel::setupUI()
 	deleteCategoryButton.setEnabled(false);
 }
 
-void SampleBankPanel::createSampleItems(const std::vector<SampleBankEntry*>& samples)
+SampleBankItem* SampleBankPanel::createSampleItem()
 {
-	int yPos = 5;
-
-	for (auto* sampleEntry : samples)
-	{
-		auto item = std::make_unique<SampleBankItem>(sampleEntry, audioProcessor);
+	auto item = std::make_unique<SampleBankItem>(audioProcessor);
+	item->setPeakLoader(&peakLoader);
 
-		item->onPreviewRequested = [this](SampleBankEntry* entry)
-			{
-				playPreview(entry);
-			};
-		item->onStopRequested = [this]()
-			{
-				stopPreview();
-			};
-		item->onDeleteRequested = [this](const juce::String& sampleId)
-			{
-				auto* entry = audioProcessor.getSampleBank()->getSample(sampleId);
-				if (entry)
-				{
-					showDeleteConfirmation(sampleId, entry->originalPrompt);
-				}
-			};
-		item->onCategoriesChanged = [this](SampleBankEntry* /*entry*/, const std::vector<juce::String>& /*newCategories*/)
+	item->onPreviewRequested = [this](const SampleBankEntry* entry)
+		{
+			playPreview(entry);
+		};
+	item->onFindSimilarRequested = [this](const SampleBankEntry* entry)
+		{
+			showSimilarSamples(entry);
+		};
+	item->onStopRequested = [this]()
+		{
+			stopPreview();
+		};
+	item->onDeleteRequested = [this](const juce::String& sampleId)
+		{
+			auto entry = audioProcessor.getSampleBank()->getSample(sampleId);
+			if (entry)
 			{
-				auto* bank = audioProcessor.getSampleBank();
-				if (bank)
-				{
-					bank->saveBankData();
-				}
-				refreshSampleList();
-			};
-		item->getCategoriesList = [this]() -> std::vector<juce::String>
+				showDeleteConfirmation(sampleId, entry->originalPrompt);
+			}
+		};
+	item->onCategoriesChanged = [this](SampleBankEntry::Ptr /*entry*/, const std::vector<juce::String>& /*newCategories*/)
+		{
+			refreshSampleList();
+		};
+	item->onPeaksLoaded = [this](const juce::String& sampleId, std::shared_ptr<const PeakSummary> summary)
+		{
+			if (peakCache.size() >= maxCachedPeaks)
+				peakCache.clear();
+			peakCache[sampleId] = std::move(summary);
+		};
+	item->getCategoriesList = [this]() -> std::vector<juce::String>
+		{
+			std::vector<juce::String> categories;
+			for (const auto& info : categoryInfos)
 			{
-				std::vector<juce::String> categories;
-				for (const auto& info : categoryInfos)
+				if (info.id > 0)
 				{
-					if (info.id > 0)
-					{
-						categories.push_back(info.name);
-					}
+					categories.push_back(info.name);
 				}
-				return categories;
-			};
-		int itemHeight = item->getRequiredHeight();
-		item->setBounds(5, yPos, samplesContainer.getWidth() - 10, itemHeight);
+			}
+			return categories;
+		};
 
-		samplesContainer.addAndMakeVisible(item.get());
+	samplesContainer.addChildComponent(item.get());
+	sampleItems.push_back(std::move(item));
+	return sampleItems.back().get();
+}
 
-		if (isVisible())
-		{
-			item->loadAudioDataIfNeeded();
-		}
+// Lists the closest matches to one sample until the search text, a filter
+// or the sort order is changed.
+void SampleBankPanel::showSimilarSamples(const SampleBankEntry* entry)
+{
+	if (!entry)
+		return;
 
-		sampleItems.push_back(std::move(item));
-		yPos += itemHeight + 5;
-	}
+	similarToId = entry->id;
+	searchInput.setText({}, juce::dontSendNotification);
+	searchInput.setTextToShowWhenEmpty("Sounds like: " + entry->originalPrompt, ColourPalette::textSecondary);
+	searchInput.repaint();
+	samplesViewport.setViewPosition(0, 0);
+	refreshSampleList();
+}
+
+void SampleBankPanel::clearSimilarSamples()
+{
+	if (similarToId.isEmpty())
+		return;
 
-	samplesContainer.setSize(samplesViewport.getWidth() - 20, yPos + 5);
-	resized();
+	similarToId.clear();
+	searchInput.setTextToShowWhenEmpty("Search prompts...", ColourPalette::textSecondary);
+	searchInput.repaint();
 }
 
 void SampleBankPanel::deleteSample(const juce::String& sampleId)
@@ -1330,7 +1580,7 @@ void SampleBankPanel::cleanupUnusedSamples()
 
 void SampleBankPanel::showDeleteConfirmation(const juce::String& sampleId, const juce::String& sampleName)
 {
-	auto* entry = audioProcessor.getSampleBank()->getSample(sampleId);
+	auto entry = audioProcessor.getSampleBank()->getSample(sampleId);
 	if (!entry)
 		return;
 
@@ -1457,16 +1707,7 @@ void SampleBankPanel::editCategory()
 	auto* bank = audioProcessor.getSampleBank();
 	if (bank)
 	{
-		auto samples = bank->getAllSamples();
-		for (auto* sample : samples)
-		{
-			auto& categories = sample->categories;
-			auto catIt = std::find(categories.begin(), categories.end(), oldName);
-			if (catIt != categories.end())
-			{
-				*catIt = newName;
-			}
-		}
+		bank->renameCategory(oldName, newName);
 	}
 
 	categoryInput.clear();
@@ -1510,15 +1751,7 @@ void SampleBankPanel::deleteCategory()
 				auto* bank = audioProcessor.getSampleBank();
 				if (bank)
 				{
-					auto samples = bank->getAllSamples();
-					for (auto* sample : samples)
-					{
-						auto& categories = sample->categories;
-						categories.erase(
-							std::remove(categories.begin(), categories.end(), categoryName),
-							categories.end());
-					}
-					bank->saveBankData();
+					bank->removeCategory(categoryName);
 				}
 				categoryInfos.erase(
 					std::remove_if(categoryInfos.begin(), categoryInfos.end(),
@@ -2,13 +2,50 @@
 #include "JuceHeader.h"
 #include "SampleBank.h"
 #include "ColourPalette.h"
+#include <deque>
 
 class DjIaVstProcessor;
 
+// Loads the mini-waveform peaks for the sample list on one background thread.
+// Requests are keyed by row: a row that is rebound replaces its queued
+// request, requests whose row has been rebound or destroyed are dropped
+// unread, and the newest request is served first so the rows on screen win.
+class SamplePeakLoader : private juce::Thread
+{
+public:
+	using Callback = std::function<void(std::shared_ptr<const PeakSummary>)>;
+
+	SamplePeakLoader();
+	~SamplePeakLoader() override;
+
+	// onLoaded runs on the message thread, and only while validity is set.
+	void request(const void* row, const juce::File& audioFile,
+		std::shared_ptr<std::atomic<bool>> validity, Callback onLoaded);
+
+private:
+	struct Request
+	{
+		const void* row = nullptr;
+		juce::File audioFile;
+		std::shared_ptr<std::atomic<bool>> validity;
+		Callback onLoaded;
+	};
+
+	static constexpr size_t maxQueuedRequests = 64;
+
+	juce::CriticalSection queueLock;
+	std::deque<Request> queue;
+
+	void run() override;
+	static std::shared_ptr<PeakSummary> loadPeaks(const juce::File& audioFile, const std::atomic<bool>& validity);
+};
+
+// One row of the sample list. Rows are recycled as the list scrolls, so all
+// per-sample state is reset when a row is bound to a different entry.
 class SampleBankItem : public juce::Component, public juce::DragAndDropContainer, public juce::Timer
 {
 public:
-	SampleBankItem(SampleBankEntry* entry, DjIaVstProcessor& processor);
+	SampleBankItem(DjIaVstProcessor& processor);
 	~SampleBankItem() override;
 
 	void paint(juce::Graphics& g) override;
@@ -18,23 +55,33 @@ public:
 	void mouseUp(const juce::MouseEvent& event) override;
 	void mouseEnter(const juce::MouseEvent& event) override;
 	void mouseExit(const juce::MouseEvent& event) override;
-	void setIsPlaying(bool playing);
-	void loadAudioDataIfNeeded();
+	void setIsPlaying(bool playing, float startPosition = 0.0f);
+	void setSampleEntry(SampleBankEntry::Ptr entry, std::shared_ptr<const PeakSummary> cachedPeaks);
+	void setPeakLoader(SamplePeakLoader* loader) { peakLoader = loader; }
+	// For a row that scrolled off: its queued peak load is dropped.
+	void cancelPeakLoad();
 	void showCategoryMenu();
-	int getRequiredHeight();
+	void showContextMenu();
+	static int getRequiredHeight(const SampleBankEntry& entry);
 
-	SampleBankEntry* getSampleEntry() const { return sampleEntry; }
+	const SampleBankEntry* getSampleEntry() const { return sampleEntry.get(); }
+	int getRowIndex() const { return rowIndex; }
+	void setRowIndex(int newRowIndex) { rowIndex = newRowIndex; }
 
 	std::function<void(const juce::String&)> onDeleteRequested;
-	std::function<void(SampleBankEntry*)> onPreviewRequested;
+	std::function<void(const SampleBankEntry*)> onPreviewRequested;
+	std::function<void(const SampleBankEntry*)> onFindSimilarRequested;
 	std::function<void()> onStopRequested;
-	std::function<void(SampleBankEntry*, const std::vector<juce::String>&)> onCategoriesChanged;
+	std::function<void(SampleBankEntry::Ptr, const std::vector<juce::String>&)> onCategoriesChanged;
+	std::function<void(const juce::String&, std::shared_ptr<const PeakSummary>)> onPeaksLoaded;
 
 	std::function<std::vector<juce::String>()> getCategoriesList;
 
 private:
-	SampleBankEntry* sampleEntry;
+	SampleBankEntry::Ptr sampleEntry;
 	DjIaVstProcessor& audioProcessor;
+	SamplePeakLoader* peakLoader = nullptr;
+	int rowIndex = -1;
 
 	juce::Label nameLabel;
 	juce::Label durationLabel;
@@ -46,12 +93,11 @@ private:
 	juce::Rectangle<int> waveformBounds;
 	std::vector<float> thumbnailLeft;
 	std::vector<float> thumbnailRight;
-	juce::AudioBuffer<float> audioBuffer;
+	std::shared_ptr<const PeakSummary> peakSummary;
 	std::shared_ptr<std::atomic<bool>> validityFlag;
 	std::atomic<bool> isDestroyed{ false };
 
 	int maxVisibleBadges = 0;
-	double sampleRate = 48000.0;
 	float playbackPosition = 0.0f;
 	double lastTimerCall = 0.0;
 
@@ -65,7 +111,8 @@ private:
 	juce::String formatUsage();
 	void updatePlayButton();
 	void generateThumbnail();
-	void loadAudioData();
+	void loadPeaks();
+	void peaksLoaded(const juce::String& sampleId, std::shared_ptr<const PeakSummary> summary);
 	void drawMiniWaveform(juce::Graphics& g);
 	void setPlaybackPosition(float positionInSeconds);
 	void timerCallback() override;
@@ -107,7 +154,8 @@ struct CategoryInfo
 };
 
 class SampleBankPanel : public juce::Component,
-	public juce::Timer
+	public juce::Timer,
+	public SampleBank::Listener
 {
 public:
 	SampleBankPanel(DjIaVstProcessor& processor);
@@ -118,6 +166,7 @@ public:
 	void timerCallback() override;
 	void refreshSampleList();
 	void setVisible(bool shouldBeVisible) override;
+	void sampleBankChanged() override { refreshSampleList(); }
 
 	std::function<void(const juce::String&, const juce::String&)> onSampleDroppedToTrack;
 
@@ -126,11 +175,25 @@ private:
 
 	juce::Label titleLabel;
 	juce::TextButton cleanupButton;
-	juce::Viewport samplesViewport;
+	// Tells the panel when the list scrolls so it can move rows around.
+	class SampleListViewport : public juce::Viewport
+	{
+	public:
+		std::function<void()> onVisibleAreaChanged;
+
+		void visibleAreaChanged(const juce::Rectangle<int>& /*newVisibleArea*/) override
+		{
+			if (onVisibleAreaChanged)
+				onVisibleAreaChanged();
+		}
+	};
+
+	SampleListViewport samplesViewport;
 	juce::Component samplesContainer;
 	juce::Label infoLabel;
 	juce::ComboBox sortMenu;
 
+	juce::TextEditor searchInput;
 	juce::TextEditor categoryInput;
 	juce::TextButton addCategoryButton;
 	juce::TextButton editCategoryButton;
@@ -164,6 +227,8 @@ private:
 		{18, "Synth"} };
 
 	juce::ComboBox categoryFilter;
+	juce::ComboBox keyFilter;
+	juce::String currentKeyFilter;
 	SampleCategory currentCategory = SampleCategory::All;
 	std::map<SampleCategory, juce::String> categoryNames;
 	bool isCategoryEditable(int categoryId) const;
@@ -175,18 +240,60 @@ private:
 		Prompt = 2,
 		Usage = 3,
 		BPM = 4,
-		Duration = 5
+		Duration = 5,
+		Key = 6,
+		Loudness = 7
 	};
 	SortType currentSortType = SortType::Prompt;
 
+	struct SampleQuery
+	{
+		juce::String category;
+		juce::String key;
+		juce::String text;
+		SortType sortType = SortType::Prompt;
+		// When set, the list is the samples closest to this one instead,
+		// ordered by similarity; the other fields are ignored.
+		juce::String similarTo;
+	};
+
+	static constexpr int maxSimilarResults = 50;
+	juce::String similarToId;
+
+	// Queries run against the bank's indices off the message thread. Every
+	// refresh bumps the version; older jobs give up at their next check and
+	// their results are dropped.
+	juce::uint32 queryVersion = 0;
+	std::shared_ptr<std::atomic<juce::uint32>> latestQuery = std::make_shared<std::atomic<juce::uint32>>(0);
+	juce::uint32 queryStartTime = 0;
+
+	// The current result in display order, and the top of each row in the
+	// list (plus the end of the last one). Only the rows near the visible
+	// area have a SampleBankItem; the pool is reused as the list scrolls.
+	std::vector<SampleBankEntry::Ptr> listedSamples;
+	std::vector<int> rowPositions;
+	// Declared before the rows so it outlives them.
+	SamplePeakLoader peakLoader;
 	std::vector<std::unique_ptr<SampleBankItem>> sampleItems;
 
-	SampleBankEntry* currentPreviewEntry = nullptr;
-	SampleBankItem* currentPreviewItem = nullptr;
+	static constexpr int overscanRows = 2;
+	static constexpr size_t maxCachedPeaks = 512;
+	std::map<juce::String, std::shared_ptr<const PeakSummary>> peakCache;
+
+	juce::String currentPreviewId;
+	double previewStartTime = 0.0;
 
 	void setupUI();
-	void createSampleItems(const std::vector<SampleBankEntry*>& samples);
-	void playPreview(SampleBankEntry* entry);
+	static std::vector<SampleBankEntry::Ptr> runQuery(SampleBank& bank, const SampleQuery& query,
+		const std::function<bool()>& isCancelled);
+	void queryFinished(std::shared_ptr<std::vector<SampleBankEntry::Ptr>> samples, juce::uint32 version);
+	void layoutRows();
+	void updateVisibleRows();
+	void releaseAllRows();
+	SampleBankItem* createSampleItem();
+	void playPreview(const SampleBankEntry* entry);
+	void showSimilarSamples(const SampleBankEntry* entry);
+	void clearSimilarSamples();
 	void stopPreview();
 	void deleteSample(const juce::String& sampleId);
 	void cleanupUnusedSamples();
@@ -0,0 +1,422 @@
+#pragma once
+#include "JuceHeader.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// Decoded audio shared by every track, page and plugin instance in the
+// process. Published buffers are immutable, so pages and tracks hold
+// pointers and a page switch or version toggle only swaps one. Identical
+// audio is stored once, whichever file or track it came from. The cache keeps
+// weak references only; a buffer is freed with its last user.
+class SharedAudioCache
+{
+public:
+	using Buffer = juce::AudioBuffer<float>;
+	using Ptr = std::shared_ptr<const Buffer>;
+
+	// A value taken out of a Slot, kept until no audio thread can still be
+	// reading it.
+	struct Retired
+	{
+		virtual ~Retired() = default;
+	};
+
+	// One per audio thread, i.e. per processor. Slot::get() and
+	// Slot::takeFrom() are only valid inside a ScopedBlock: anything the
+	// thread may have read during a block is freed after the block ends,
+	// never by the audio thread itself.
+	class Reader
+	{
+	public:
+		Reader() { getInstance().addReader(this); }
+		~Reader() { getInstance().removeReader(this); }
+
+		class ScopedBlock
+		{
+		public:
+			explicit ScopedBlock(Reader& readerToUse) noexcept : reader(readerToUse) { reader.counter.fetch_add(1); }
+			~ScopedBlock() { reader.counter.fetch_add(1); }
+
+		private:
+			Reader& reader;
+
+			JUCE_DECLARE_NON_COPYABLE(ScopedBlock)
+		};
+
+	private:
+		friend class SharedAudioCache;
+		static constexpr int handoffCapacity = 64;
+
+		// Odd while a block is running.
+		std::atomic<juce::uint64> counter{ 0 };
+		// Values the audio thread swapped out, waiting for collectRetired().
+		juce::AbstractFifo handoff{ handoffCapacity };
+		std::array<Retired*, handoffCapacity> handoffValues{};
+
+		bool canHandOff() const noexcept { return handoff.getFreeSpace() > 0; }
+
+		void handOff(Retired* value) noexcept
+		{
+			if (value == nullptr)
+				return;
+			const auto scope = handoff.write(1);
+			if (scope.blockSize1 > 0)
+				handoffValues[(size_t)scope.startIndex1] = value;
+		}
+
+		JUCE_DECLARE_NON_COPYABLE(Reader)
+	};
+
+	// Where a page or track keeps its published audio, or a bundle that holds
+	// it. The audio thread reads and swaps it with plain atomic pointer
+	// operations: no lock, no reference count and no deallocation. Every
+	// other thread goes through load() and store(), which share a mutex with
+	// the collector so a value is never freed while one of them copies it.
+	template <typename Published>
+	class Slot
+	{
+	public:
+		using Value = std::shared_ptr<const Published>;
+
+		Slot() = default;
+		Slot(const Slot& other) { store(other.load()); }
+		Slot& operator=(const Slot& other)
+		{
+			store(other.load());
+			return *this;
+		}
+		~Slot() { getInstance().retire(current.exchange(nullptr)); }
+
+		Value load() const
+		{
+			std::lock_guard<std::mutex> lock(getInstance().retireMutex);
+			auto* holder = current.load();
+			return holder ? holder->value : nullptr;
+		}
+
+		void store(Value newValue)
+		{
+			auto* holder = newValue ? new Holder(std::move(newValue)) : nullptr;
+			getInstance().retire(current.exchange(holder));
+		}
+
+		void reset() { store(nullptr); }
+
+		// Replaces the value with modify(current). If the audio thread swaps
+		// in another value meanwhile, modify runs again on that one, so a
+		// swap is never undone. Holding the mutex keeps the value being
+		// compared against from being freed and reused.
+		template <typename Modifier>
+		void update(Modifier&& modify)
+		{
+			Holder* replaced = nullptr;
+			{
+				std::lock_guard<std::mutex> lock(getInstance().retireMutex);
+				replaced = current.load();
+				for (;;)
+				{
+					auto newValue = modify(replaced ? replaced->value : Value());
+					auto* holder = newValue ? new Holder(std::move(newValue)) : nullptr;
+					if (current.compare_exchange_strong(replaced, holder))
+						break;
+					delete holder;
+				}
+			}
+			getInstance().retire(replaced);
+		}
+
+		// Audio thread only, inside a Reader::ScopedBlock. The pointer stays
+		// valid until the block ends.
+		const Published* get() const noexcept
+		{
+			auto* holder = current.load();
+			return holder ? holder->value.get() : nullptr;
+		}
+
+		// Audio thread only. Moves whatever is staged into this slot with one
+		// exchange on each side and hands the replaced value to reader for
+		// collection. Returns false, touching neither slot, if the reader's
+		// hand-off queue is full.
+		bool takeFrom(Slot& staging, Reader& reader) noexcept
+		{
+			if (!reader.canHandOff())
+				return false;
+			reader.handOff(current.exchange(staging.current.exchange(nullptr)));
+			return true;
+		}
+
+	private:
+		struct Holder : Retired
+		{
+			explicit Holder(Value valueToHold) : value(std::move(valueToHold)) {}
+			const Value value;
+		};
+
+		std::atomic<Holder*> current{ nullptr };
+	};
+
+	static SharedAudioCache& getInstance()
+	{
+		static SharedAudioCache instance;
+		return instance;
+	}
+
+	// Publishes a finished buffer, or returns the one that already holds the
+	// same audio at the same rate.
+	Ptr intern(Buffer&& buffer, double sampleRate)
+	{
+		if (buffer.getNumSamples() == 0)
+			return nullptr;
+
+		ContentKey key{ hashContent(buffer), sampleRate, buffer.getNumChannels(), buffer.getNumSamples() };
+		std::lock_guard<std::mutex> lock(mutex);
+		auto range = byContent.equal_range(key);
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			auto existing = it->second.lock();
+			if (existing && sameContent(*existing, buffer))
+				return existing;
+		}
+
+		auto published = std::make_shared<const Buffer>(std::move(buffer));
+		byContent.emplace(key, published);
+		pruneExpired();
+		return published;
+	}
+
+	// Decodes a file to stereo unless the same, unchanged file is already in
+	// memory. Sets sampleRate to the file's rate.
+	Ptr load(const juce::File& file, double& sampleRate)
+	{
+		auto path = file.getFullPathName();
+		FileStamp stamp{ file.getLastModificationTime().toMilliseconds(), file.getSize() };
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto it = byFile.find(path);
+			if (it != byFile.end() && it->second.stamp == stamp)
+			{
+				if (auto existing = it->second.audio.lock())
+				{
+					sampleRate = it->second.sampleRate;
+					return existing;
+				}
+			}
+		}
+
+		std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(file));
+		if (!reader || reader->lengthInSamples <= 0)
+			return nullptr;
+
+		int numSamples = static_cast<int>(reader->lengthInSamples);
+		Buffer buffer(2, numSamples);
+		buffer.clear();
+		reader->read(&buffer, 0, numSamples, 0, true, true);
+		if (reader->numChannels == 1)
+			buffer.copyFrom(1, 0, buffer, 0, 0, numSamples);
+
+		sampleRate = reader->sampleRate;
+		auto audio = intern(std::move(buffer), sampleRate);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		byFile[path] = { stamp, sampleRate, audio };
+		return audio;
+	}
+
+	// Frees retired values that no audio thread can still be reading.
+	// Runs on every store(); not for the audio thread.
+	void collectRetired()
+	{
+		std::vector<std::unique_ptr<Retired>> released;
+		{
+			std::lock_guard<std::mutex> lock(retireMutex);
+			drainHandoffs();
+			for (auto it = retired.begin(); it != retired.end();)
+			{
+				if (isQuiescent(*it))
+				{
+					released.push_back(std::move(it->value));
+					it = retired.erase(it);
+				}
+				else
+				{
+					++it;
+				}
+			}
+		}
+	}
+
+private:
+	struct ContentKey
+	{
+		juce::uint64 hash;
+		double sampleRate;
+		int numChannels;
+		int numSamples;
+
+		bool operator<(const ContentKey& other) const
+		{
+			return std::tie(hash, sampleRate, numChannels, numSamples)
+				< std::tie(other.hash, other.sampleRate, other.numChannels, other.numSamples);
+		}
+	};
+
+	struct FileStamp
+	{
+		juce::int64 modified = 0;
+		juce::int64 size = 0;
+
+		bool operator==(const FileStamp& other) const { return modified == other.modified && size == other.size; }
+	};
+
+	struct FileEntry
+	{
+		FileStamp stamp;
+		double sampleRate = 0.0;
+		std::weak_ptr<const Buffer> audio;
+	};
+
+	static constexpr int pruneInterval = 64;
+
+	// A retired value and the readers that were mid-block when it was
+	// unpublished, with their counters at the time.
+	struct RetiredEntry
+	{
+		std::unique_ptr<Retired> value;
+		std::vector<std::pair<Reader*, juce::uint64>> busyReaders;
+	};
+
+	std::mutex mutex;
+	std::multimap<ContentKey, std::weak_ptr<const Buffer>> byContent;
+	std::map<juce::String, FileEntry> byFile;
+	std::mutex retireMutex;
+	std::vector<Reader*> readers;
+	std::vector<RetiredEntry> retired;
+	int insertsSincePrune = 0;
+	juce::AudioFormatManager formatManager;
+
+	SharedAudioCache()
+	{
+		formatManager.registerBasicFormats();
+	}
+
+	// FNV-1a over the raw sample words; only has to tell buffers apart, a
+	// match is confirmed by comparing the samples.
+	static juce::uint64 hashContent(const Buffer& buffer)
+	{
+		juce::uint64 hash = 14695981039346656037ull;
+		for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+		{
+			const float* data = buffer.getReadPointer(ch);
+			for (int i = 0; i < buffer.getNumSamples(); ++i)
+			{
+				juce::uint32 word;
+				std::memcpy(&word, data + i, sizeof(word));
+				hash = (hash ^ word) * 1099511628211ull;
+			}
+		}
+		return hash;
+	}
+
+	static bool sameContent(const Buffer& a, const Buffer& b)
+	{
+		for (int ch = 0; ch < a.getNumChannels(); ++ch)
+		{
+			if (std::memcmp(a.getReadPointer(ch), b.getReadPointer(ch), sizeof(float) * (size_t)a.getNumSamples()) != 0)
+				return false;
+		}
+		return true;
+	}
+
+	void addReader(Reader* reader)
+	{
+		std::lock_guard<std::mutex> lock(retireMutex);
+		readers.push_back(reader);
+	}
+
+	void removeReader(Reader* reader)
+	{
+		{
+			std::lock_guard<std::mutex> lock(retireMutex);
+			drainHandoffs();
+			readers.erase(std::remove(readers.begin(), readers.end(), reader), readers.end());
+			for (auto& entry : retired)
+			{
+				auto& busy = entry.busyReaders;
+				busy.erase(std::remove_if(busy.begin(), busy.end(),
+					[reader](const auto& pair) { return pair.first == reader; }), busy.end());
+			}
+		}
+		collectRetired();
+	}
+
+	void retire(Retired* value)
+	{
+		if (value != nullptr)
+		{
+			std::lock_guard<std::mutex> lock(retireMutex);
+			retired.push_back({ std::unique_ptr<Retired>(value), getBusyReaders() });
+		}
+		collectRetired();
+	}
+
+	// Called with retireMutex held. A reader that is mid-block may have read
+	// a value that was just unpublished; one between blocks cannot.
+	std::vector<std::pair<Reader*, juce::uint64>> getBusyReaders() const
+	{
+		std::vector<std::pair<Reader*, juce::uint64>> busy;
+		for (auto* reader : readers)
+		{
+			auto counter = reader->counter.load();
+			if ((counter & 1) != 0)
+				busy.emplace_back(reader, counter);
+		}
+		return busy;
+	}
+
+	// Called with retireMutex held.
+	bool isQuiescent(const RetiredEntry& entry) const
+	{
+		for (const auto& [reader, counter] : entry.busyReaders)
+		{
+			if (reader->counter.load() == counter)
+				return false;
+		}
+		return true;
+	}
+
+	// Called with retireMutex held.
+	void drainHandoffs()
+	{
+		for (auto* reader : readers)
+		{
+			const auto scope = reader->handoff.read(reader->handoff.getNumReady());
+			scope.forEach([this, reader](int index)
+				{
+					retired.push_back({ std::unique_ptr<Retired>(reader->handoffValues[(size_t)index]), getBusyReaders() });
+				});
+		}
+	}
+
+	// Called with the mutex held.
+	void pruneExpired()
+	{
+		if (++insertsSincePrune < pruneInterval)
+			return;
+		insertsSincePrune = 0;
+
+		for (auto it = byContent.begin(); it != byContent.end();)
+			it = it->second.expired() ? byContent.erase(it) : std::next(it);
+		for (auto it = byFile.begin(); it != byFile.end();)
+			it = it->second.audio.expired() ? byFile.erase(it) : std::next(it);
+	}
+
+	JUCE_DECLARE_NON_COPYABLE(SharedAudioCache)
+};
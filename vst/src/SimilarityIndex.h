@@ -0,0 +1,125 @@
+#pragma once
+#include "JuceHeader.h"
+#include "SampleAnalysis.h"
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Feature vectors of every analyzed sample, packed into one contiguous array
+// so a "more like this" search is a single linear pass of dot products. At
+// 48 floats per sample, 100k samples are under 20 MB and a few milliseconds
+// to scan; that beats any clustering scheme at the sizes a bank reaches.
+// Not locked on its own, the bank only touches it under bankLock.
+class SimilarityIndex
+{
+public:
+	static constexpr int dimensions = SampleAnalysis::featureSize;
+
+	// Adds or replaces a sample's vector. Anything that is not a full vector
+	// removes the sample instead.
+	void set(const juce::String& id, const std::vector<float>& features)
+	{
+		if ((int)features.size() != dimensions)
+		{
+			remove(id);
+			return;
+		}
+
+		auto row = rows.find(id);
+		size_t position = row != rows.end() ? row->second : ids.size();
+		if (row == rows.end())
+		{
+			rows[id] = position;
+			ids.push_back(id);
+			vectors.resize(vectors.size() + dimensions);
+		}
+		std::copy(features.begin(), features.end(), vectors.begin() + (std::ptrdiff_t)(position * dimensions));
+	}
+
+	void remove(const juce::String& id)
+	{
+		auto row = rows.find(id);
+		if (row == rows.end())
+			return;
+
+		size_t position = row->second;
+		size_t last = ids.size() - 1;
+		rows.erase(row);
+		if (position != last)
+		{
+			std::copy_n(vectors.begin() + (std::ptrdiff_t)(last * dimensions), dimensions,
+				vectors.begin() + (std::ptrdiff_t)(position * dimensions));
+			ids[position] = std::move(ids[last]);
+			rows[ids[position]] = position;
+		}
+		ids.pop_back();
+		vectors.resize(last * dimensions);
+	}
+
+	void clear()
+	{
+		rows.clear();
+		ids.clear();
+		vectors.clear();
+	}
+
+	bool contains(const juce::String& id) const { return rows.count(id) != 0; }
+	size_t size() const { return ids.size(); }
+
+	// Ids of the maxResults samples closest to the given one, best first.
+	// Empty if the sample has no vector.
+	std::vector<juce::String> findNearest(const juce::String& id, int maxResults) const
+	{
+		auto row = rows.find(id);
+		if (row == rows.end() || maxResults <= 0)
+			return {};
+
+		const float* query = vectors.data() + row->second * dimensions;
+		size_t exclude = row->second;
+
+		// Min-heap of the best matches so far; its top is the one to beat.
+		using Match = std::pair<float, size_t>;
+		std::priority_queue<Match, std::vector<Match>, std::greater<Match>> best;
+		for (size_t position = 0; position < ids.size(); ++position)
+		{
+			if (position == exclude)
+				continue;
+
+			float score = dot(query, vectors.data() + position * dimensions);
+			if ((int)best.size() < maxResults)
+				best.push({ score, position });
+			else if (score > best.top().first)
+			{
+				best.pop();
+				best.push({ score, position });
+			}
+		}
+
+		std::vector<juce::String> result(best.size());
+		for (size_t i = result.size(); i-- > 0; best.pop())
+			result[i] = ids[best.top().second];
+		return result;
+	}
+
+private:
+	std::vector<float> vectors;
+	std::vector<juce::String> ids;
+	std::unordered_map<juce::String, size_t> rows;
+
+	// Four independent accumulators so the loop vectorises.
+	static float dot(const float* a, const float* b)
+	{
+		float sums[4] = {};
+		for (int i = 0; i < dimensions; i += 4)
+		{
+			sums[0] += a[i] * b[i];
+			sums[1] += a[i + 1] * b[i + 1];
+			sums[2] += a[i + 2] * b[i + 2];
+			sums[3] += a[i + 3] * b[i + 3];
+		}
+		return sums[0] + sums[1] + sums[2] + sums[3];
+	}
+};
@@ -1,14 +1,185 @@
 #include "StableAudioEngine.h"
+#ifdef _WIN32
+#include <windows.h>
+#endif
 
+namespace
+{
+	juce::String quoteArgument(const juce::String& argument)
+	{
 #ifdef _WIN32
-#include <direct.h>
-#define GETCWD _getcwd
-#define CHDIR _chdir
+		// Backslashes before the closing quote would escape it.
+		auto unquoted = argument.removeCharacters("\"");
+		auto trailing = unquoted.length() - unquoted.trimCharactersAtEnd("\\").length();
+		return "\"" + unquoted + juce::String::repeatedString("\\", trailing) + "\"";
 #else
-#include <unistd.h>
-#define GETCWD getcwd
-#define CHDIR chdir
+		return "'" + argument.replace("'", "'\\''") + "'";
+#endif
+	}
+
+#ifdef _WIN32
+	// audiogen.exe started directly in the job workspace, inside a job object
+	// so kill() also ends anything it spawned. juce::ChildProcess cannot set
+	// a working directory, and going through cmd.exe left audiogen running
+	// after the shell was killed.
+	class WorkspaceProcess
+	{
+	public:
+		~WorkspaceProcess()
+		{
+			kill();
+			if (process != nullptr)
+				CloseHandle(process);
+			if (job != nullptr)
+				CloseHandle(job);
+		}
+
+		bool start(const juce::String& commandLine, const juce::File& workingDirectory)
+		{
+			job = CreateJobObjectW(nullptr, nullptr);
+			if (job == nullptr)
+				return false;
+
+			JOBOBJECT_EXTENDED_LIMIT_INFORMATION limits = {};
+			limits.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
+			SetInformationJobObject(job, JobObjectExtendedLimitInformation, &limits, sizeof(limits));
+
+			STARTUPINFOW startupInfo = {};
+			startupInfo.cb = sizeof(startupInfo);
+			PROCESS_INFORMATION processInfo = {};
+			std::wstring commandBuffer(commandLine.toWideCharPointer());
+
+			if (!CreateProcessW(nullptr, &commandBuffer[0], nullptr, nullptr, FALSE,
+				CREATE_NO_WINDOW | CREATE_SUSPENDED, nullptr,
+				workingDirectory.getFullPathName().toWideCharPointer(), &startupInfo, &processInfo))
+				return false;
+
+			AssignProcessToJobObject(job, processInfo.hProcess);
+			ResumeThread(processInfo.hThread);
+			CloseHandle(processInfo.hThread);
+			process = processInfo.hProcess;
+			return true;
+		}
+
+		bool waitForProcessToFinish(int timeoutMs) const
+		{
+			return process == nullptr || WaitForSingleObject(process, (DWORD)timeoutMs) == WAIT_OBJECT_0;
+		}
+
+		void kill()
+		{
+			if (job != nullptr)
+				TerminateJobObject(job, 1);
+		}
+
+		juce::uint32 getExitCode() const
+		{
+			DWORD exitCode = 0;
+			if (process != nullptr)
+				GetExitCodeProcess(process, &exitCode);
+			return (juce::uint32)exitCode;
+		}
+
+	private:
+		HANDLE process = nullptr;
+		HANDLE job = nullptr;
+	};
 #endif
+}
+
+LocalJobScheduler& LocalJobScheduler::getInstance()
+{
+	static LocalJobScheduler instance;
+	return instance;
+}
+
+LocalJobScheduler::LocalJobScheduler()
+{
+	availableCores = juce::jmax(1, juce::SystemStats::getNumPhysicalCpus() - 1);
+	maxConcurrentJobs = juce::jlimit(1, 4, availableCores / 2);
+	threadsPerJob = juce::jmax(1, availableCores / maxConcurrentJobs);
+	DBG("Local job scheduler: " << maxConcurrentJobs << " concurrent jobs of " << threadsPerJob << " threads");
+}
+
+std::unique_ptr<LocalJobScheduler::Slot> LocalJobScheduler::acquire(int requestedThreads, const GenerationControl::Ptr& control)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (activeJobs >= maxConcurrentJobs)
+	{
+		if (control)
+		{
+			control->reportProgress(GenerationControl::Stage::queued);
+			if (control->isCancelled())
+				return nullptr;
+		}
+		slotFreed.wait_for(lock, std::chrono::milliseconds(100));
+	}
+
+	// Every slot gets the same fixed share. Sizing it from the jobs running
+	// right now gave the first job all the cores and oversubscribed them as
+	// soon as a second one started.
+	++activeJobs;
+	int numThreads = requestedThreads > 0 ? juce::jmin(requestedThreads, threadsPerJob) : threadsPerJob;
+	return std::unique_ptr<Slot>(new Slot(*this, numThreads));
+}
+
+int LocalJobScheduler::getActiveJobs() const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return activeJobs;
+}
+
+void LocalJobScheduler::release()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		--activeJobs;
+	}
+	slotFreed.notify_one();
+}
+
+StableAudioEngine::~StableAudioEngine()
+{
+	shutdownWorker();
+}
+
+void StableAudioEngine::shutdownWorker()
+{
+	std::lock_guard<std::mutex> lock(workersMutex);
+	for (auto& worker : workers)
+		worker->shutdown();
+}
+
+bool StableAudioEngine::hasPersistentWorker() const
+{
+	if (!workerExecutable.existsAsFile())
+		return false;
+
+	std::lock_guard<std::mutex> lock(workersMutex);
+	for (const auto& worker : workers)
+	{
+		if (!worker->isAvailable())
+			return false;
+	}
+	return true;
+}
+
+LocalInferenceWorker* StableAudioEngine::claimWorker()
+{
+	std::lock_guard<std::mutex> lock(workersMutex);
+	for (auto& worker : workers)
+	{
+		if (worker->isAvailable() && worker->tryClaim())
+			return worker.get();
+	}
+
+	if ((int)workers.size() >= LocalJobScheduler::getInstance().getMaxConcurrentJobs())
+		return nullptr;
+
+	workers.push_back(std::make_unique<LocalInferenceWorker>(workerExecutable, modelsDirectory));
+	workers.back()->tryClaim();
+	return workers.back().get();
+}
 
 bool StableAudioEngine::initialize(const juce::String& modelsDir)
 {
@@ -35,6 +206,12 @@ bool StableAudioEngine::initialize(const juce::String& modelsDir)
 			return false;
 		}
 
+		workerExecutable = LocalInferenceWorker::findExecutable(modelsDir);
+		if (workerExecutable.existsAsFile())
+		{
+			DBG("Persistent inference worker available: " << workerExecutable.getFullPathName());
+		}
+
 		isInitialized = true;
 		return true;
 	}
@@ -71,7 +248,7 @@ bool StableAudioEngine::checkRequiredFiles()
 	return true;
 }
 
-StableAudioEngine::GenerationResult StableAudioEngine::generateSample(const GenerationParams& params)
+StableAudioEngine::GenerationResult StableAudioEngine::generateSample(const GenerationParams& params, const GenerationControl::Ptr& control)
 {
 	GenerationResult result;
 
@@ -86,96 +263,145 @@ StableAudioEngine::GenerationResult StableAudioEngine::generateSample(const Gene
 		DBG("Generating audio: '" << params.prompt << "' (" << params.duration << "s)");
 
 		auto startTime = juce::Time::getMillisecondCounterHiRes();
-		cleanupTempFiles();
 
 		auto sanitizedPrompt = sanitizePrompt(params.prompt);
 		auto seed = (params.seed == -1) ? generateRandomSeed() : params.seed;
+		result.seed = seed;
 
-		juce::StringArray command;
-
-#ifdef _WIN32
-		command.add(audiogenExecutable.getFullPathName());
-		command.add(modelsDirectory);
-		command.add(sanitizedPrompt);
-		command.add(juce::String(params.numThreads));
-		command.add(juce::String(seed));
-#else
-		command.add(audiogenExecutable.getFullPathName());
-		command.add("-m");
-		command.add(modelsDirectory);
-		command.add("-p");
-		command.add(sanitizedPrompt);
-		command.add("-t");
-		command.add(juce::String(params.numThreads));
-		command.add("-s");
-		command.add(juce::String(seed));
-#endif
+		auto slot = LocalJobScheduler::getInstance().acquire(params.numThreads, control);
+		if (!slot)
+		{
+			result.cancelled = true;
+			result.errorMessage = "Generation cancelled";
+			return result;
+		}
 
-		DBG("Executing command: " << command.joinIntoString(" "));
+		GenerationParams jobParams = params;
+		jobParams.numThreads = slot->getNumThreads();
 
-		char originalDir[1024];
-		GETCWD(originalDir, sizeof(originalDir));
+		if (control)
+			control->reportProgress(GenerationControl::Stage::running, 0.0f);
 
-		auto workingDir = juce::File(modelsDirectory);
-		DBG("Changing working directory to: " << workingDir.getFullPathName());
+		if (hasPersistentWorker() && generateWithWorker(jobParams, sanitizedPrompt, seed, result, control))
+		{
+			return result;
+		}
 
-		if (CHDIR(workingDir.getFullPathName().toRawUTF8()) != 0)
+		auto workspace = createJobWorkspace();
+		if (workspace == juce::File())
 		{
-			result.errorMessage = "Failed to change working directory";
+			result.errorMessage = "Failed to create job workspace";
 			return result;
 		}
 
+		juce::StringArray arguments;
+		arguments.add(audiogenExecutable.getFullPathName());
+#ifdef _WIN32
+		arguments.add(modelsDirectory);
+		arguments.add(sanitizedPrompt);
+		arguments.add(juce::String(jobParams.numThreads));
+		arguments.add(juce::String(seed));
+#else
+		arguments.add("-m");
+		arguments.add(modelsDirectory);
+		arguments.add("-p");
+		arguments.add(sanitizedPrompt);
+		arguments.add("-t");
+		arguments.add(juce::String(jobParams.numThreads));
+		arguments.add("-s");
+		arguments.add(juce::String(seed));
+#endif
+
+		juce::StringArray quotedArguments;
+		for (const auto& argument : arguments)
+			quotedArguments.add(quoteArgument(argument));
+
+		// audiogen writes output.wav to its working directory, so each job runs
+		// in its own workspace; the plugin cwd is never touched. Elsewhere than
+		// on Windows the shell execs audiogen, so killing the child kills it.
+		DBG("Executing job in " << workspace.getFullPathName() << " with " << jobParams.numThreads << " threads");
+
+#ifdef _WIN32
+		WorkspaceProcess childProcess;
+		bool started = childProcess.start(quotedArguments.joinIntoString(" "), workspace);
+#else
+		juce::StringArray command;
+		command.add("/bin/sh");
+		command.add("-c");
+		command.add("cd " + quoteArgument(workspace.getFullPathName()) + " && exec " + quotedArguments.joinIntoString(" "));
+
 		juce::ChildProcess childProcess;
+		bool started = childProcess.start(command, 0);
+#endif
 
-		if (!childProcess.start(command))
+		if (!started)
 		{
-			CHDIR(originalDir);
+			workspace.deleteRecursively();
 			result.errorMessage = "Failed to start audiogen process";
 			return result;
 		}
 
-		if (!childProcess.waitForProcessToFinish(600000))
+		auto processStart = juce::Time::getMillisecondCounterHiRes();
+		double expectedMs = lastSubprocessMs.load();
+
+		while (!childProcess.waitForProcessToFinish(100))
 		{
-			childProcess.kill();
-			CHDIR(originalDir);
-			result.errorMessage = "Process timeout (10min)";
-			return result;
+			double elapsedMs = juce::Time::getMillisecondCounterHiRes() - processStart;
+
+			if (control && control->isCancelled())
+			{
+				childProcess.kill();
+				workspace.deleteRecursively();
+				result.cancelled = true;
+				result.errorMessage = "Generation cancelled";
+				return result;
+			}
+
+			if (elapsedMs > 600000.0)
+			{
+				childProcess.kill();
+				workspace.deleteRecursively();
+				result.errorMessage = "Process timeout (10min)";
+				return result;
+			}
+
+			if (control && expectedMs > 0.0)
+				control->reportProgress(GenerationControl::Stage::running,
+					(float)juce::jmin(95.0, 100.0 * elapsedMs / expectedMs));
 		}
 
-		CHDIR(originalDir);
+		lastSubprocessMs = juce::Time::getMillisecondCounterHiRes() - processStart;
 
 		auto exitCode = childProcess.getExitCode();
 		if (exitCode != 0)
 		{
+			workspace.deleteRecursively();
 			result.errorMessage = "Process failed with exit code: " + juce::String(exitCode);
 			return result;
 		}
 
-		auto outputFile = juce::File(modelsDirectory).getChildFile("output.wav");
+		auto outputFile = workspace.getChildFile("output.wav");
 		if (!outputFile.exists())
 		{
+			workspace.deleteRecursively();
 			result.errorMessage = "Output file not found: " + outputFile.getFullPathName();
 			return result;
 		}
 
-		auto audioData = loadAndResampleWavFile(outputFile, params.sampleRate);
-		if (audioData.empty())
+		auto audio = loadAndResampleWavFile(outputFile, params.sampleRate);
+		workspace.deleteRecursively();
+		if (audio.getNumSamples() == 0)
 		{
 			result.errorMessage = "Failed to load and resample generated audio file";
 			return result;
 		}
 
+		setResult(result, std::move(audio), params.sampleRate);
 		auto endTime = juce::Time::getMillisecondCounterHiRes();
-		result.audioData = audioData;
-		result.leftChannel = audioData;
-		result.rightChannel = audioData;
-		result.actualDuration = static_cast<float>(audioData.size()) / params.sampleRate;
-		result.success = true;
 		result.performanceInfo = "Generated in " + juce::String(endTime - startTime, 0) + "ms";
 
-		DBG("Generation successful: " << result.audioData.size() << " samples in "
+		DBG("Generation successful: " << result.audio.getNumSamples() << " samples in "
 			<< (endTime - startTime) << "ms");
-		outputFile.deleteFile();
 
 		return result;
 	}
@@ -187,111 +413,127 @@ StableAudioEngine::GenerationResult StableAudioEngine::generateSample(const Gene
 	}
 }
 
-std::vector<float> StableAudioEngine::loadAndResampleWavFile(const juce::File& wavFile, double targetSampleRate)
+bool StableAudioEngine::generateWithWorker(const GenerationParams& params, const juce::String& prompt, int seed,
+	GenerationResult& result, const GenerationControl::Ptr& control)
+{
+	LocalInferenceWorker::Job job;
+	job.prompt = prompt;
+	job.duration = params.duration;
+	job.numThreads = params.numThreads;
+	job.seed = seed;
+
+	auto* worker = claimWorker();
+	if (worker == nullptr)
+		return false;
+
+	auto jobResult = worker->runJob(job, 600000, control);
+	worker->release();
+	if (jobResult.cancelled)
+	{
+		result.cancelled = true;
+		result.errorMessage = jobResult.errorMessage;
+		return true;
+	}
+
+	if (jobResult.workerFailed)
+	{
+		DBG("Persistent worker failed (" << jobResult.errorMessage << "), using audiogen subprocess");
+		return false;
+	}
+
+	if (!jobResult.success)
+	{
+		result.errorMessage = jobResult.errorMessage;
+		return true;
+	}
+
+	resampleIfNeeded(jobResult.audio, jobResult.sampleRate, params.sampleRate);
+	setResult(result, std::move(jobResult.audio), params.sampleRate);
+	result.performanceInfo = "Generated in " + juce::String(jobResult.elapsedMs, 0) + "ms (persistent worker)";
+
+	DBG("Worker generation successful: " << result.audio.getNumSamples() << " samples in "
+		<< jobResult.elapsedMs << "ms");
+	return true;
+}
+
+juce::AudioBuffer<float> StableAudioEngine::loadAndResampleWavFile(const juce::File& wavFile, double targetSampleRate)
 {
-	std::vector<float> audioData;
+	juce::AudioBuffer<float> buffer;
 
 	try
 	{
 		juce::AudioFormatManager formatManager;
 		formatManager.registerBasicFormats();
 
-		auto* reader = formatManager.createReaderFor(wavFile);
+		std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(wavFile));
 		if (reader == nullptr)
 		{
 			DBG("Failed to create audio reader for: " << wavFile.getFullPathName());
-			return audioData;
+			return buffer;
 		}
 
-		std::unique_ptr<juce::AudioFormatReader> readerPtr(reader);
-
 		auto numSamples = static_cast<int>(reader->lengthInSamples);
-		auto numChannels = static_cast<int>(reader->numChannels);
-		double originalSampleRate = reader->sampleRate;
+		auto numChannels = juce::jmin(2, static_cast<int>(reader->numChannels));
 
-		juce::AudioBuffer<float> buffer(numChannels, numSamples);
+		buffer.setSize(numChannels, numSamples);
 		reader->read(&buffer, 0, numSamples, 0, true, true);
 
-		juce::AudioBuffer<float> monoBuffer(1, numSamples);
-		if (numChannels == 1)
-		{
-			monoBuffer.copyFrom(0, 0, buffer, 0, 0, numSamples);
-		}
-		else
-		{
-			for (int sample = 0; sample < numSamples; ++sample)
-			{
-				float left = buffer.getSample(0, sample);
-				float right = buffer.getSample(1, sample);
-				monoBuffer.setSample(0, sample, (left + right) * 0.5f);
-			}
-		}
-
-		DBG("Original: " << numSamples << " samples at " << originalSampleRate << "Hz");
-		if (std::abs(originalSampleRate - targetSampleRate) > 1.0)
-		{
-			DBG("Resampling from " << originalSampleRate << "Hz to " << targetSampleRate << "Hz");
-
-			juce::AudioBuffer<float> resampledBuffer = resampleBuffer(monoBuffer, originalSampleRate, targetSampleRate);
-
-			audioData.reserve(resampledBuffer.getNumSamples());
-			for (int sample = 0; sample < resampledBuffer.getNumSamples(); ++sample)
-			{
-				audioData.push_back(resampledBuffer.getSample(0, sample));
-			}
-
-			DBG("Resampled to: " << audioData.size() << " samples at " << targetSampleRate << "Hz");
-		}
-		else
-		{
-			audioData.reserve(numSamples);
-			for (int sample = 0; sample < numSamples; ++sample)
-			{
-				audioData.push_back(monoBuffer.getSample(0, sample));
-			}
-			DBG("No resampling needed: " << audioData.size() << " samples");
-		}
+		resampleIfNeeded(buffer, reader->sampleRate, targetSampleRate);
 	}
 	catch (const std::exception& /*e*/)
 	{
 		DBG("Exception loading/resampling WAV file in Stable Audio Engine");
-		audioData.clear();
+		buffer.setSize(0, 0);
 	}
 
-	return audioData;
+	return buffer;
 }
 
-juce::AudioBuffer<float> StableAudioEngine::resampleBuffer(const juce::AudioBuffer<float>& inputBuffer,
+void StableAudioEngine::resampleIfNeeded(juce::AudioBuffer<float>& buffer,
 	double inputSampleRate,
 	double outputSampleRate)
 {
-	double ratio = outputSampleRate / inputSampleRate;
-	int outputNumSamples = static_cast<int>(inputBuffer.getNumSamples() * ratio);
+	if (std::abs(inputSampleRate - outputSampleRate) <= 1.0 || buffer.getNumSamples() == 0)
+		return;
 
-	juce::AudioBuffer<float> outputBuffer(1, outputNumSamples);
-	juce::LagrangeInterpolator interpolator;
-	interpolator.reset();
+	DBG("Resampling from " << inputSampleRate << "Hz to " << outputSampleRate << "Hz");
 
-	const float* inputData = inputBuffer.getReadPointer(0);
-	float* outputData = outputBuffer.getWritePointer(0);
+	double speedRatio = inputSampleRate / outputSampleRate;
+	int outputNumSamples = static_cast<int>(buffer.getNumSamples() / speedRatio);
+	juce::AudioBuffer<float> resampled(buffer.getNumChannels(), outputNumSamples);
 
-	interpolator.process(1.0 / ratio, inputData, outputData, outputNumSamples, inputBuffer.getNumSamples(), 0);
+	for (int ch = 0; ch < buffer.getNumChannels(); ++ch)
+	{
+		juce::WindowedSincInterpolator interpolator;
+		interpolator.process(speedRatio, buffer.getReadPointer(ch), resampled.getWritePointer(ch),
+			outputNumSamples, buffer.getNumSamples(), 0);
+	}
 
-	return outputBuffer;
+	buffer = std::move(resampled);
 }
 
-std::vector<float> StableAudioEngine::generateAudio(const juce::String& prompt, float duration)
+void StableAudioEngine::setResult(GenerationResult& result, juce::AudioBuffer<float>&& audio, double sampleRate)
+{
+	result.audio = std::move(audio);
+	result.sampleRate = sampleRate;
+	result.actualDuration = static_cast<float>(result.audio.getNumSamples() / sampleRate);
+	result.success = result.audio.getNumSamples() > 0;
+	if (!result.success)
+		result.errorMessage = "Generated audio is empty";
+}
+
+juce::AudioBuffer<float> StableAudioEngine::generateAudio(const juce::String& prompt, float duration)
 {
 	GenerationParams params(prompt, duration);
 	auto result = generateSample(params);
-	return result.isValid() ? result.audioData : std::vector<float>();
+	return result.isValid() ? std::move(result.audio) : juce::AudioBuffer<float>();
 }
 
 juce::String StableAudioEngine::sanitizePrompt(const juce::String& prompt)
 {
-	auto sanitized = prompt.replace("\"", "\\\"")
-		.replace("'", "\\'")
-		.replace("|", "")
+	// Arguments are quoted by quoteArgument(); escaping quotes here as well
+	// put literal backslashes into the prompt.
+	auto sanitized = prompt.replace("|", "")
 		.replace("&", "and")
 		.replace(";", "");
 	if (sanitized.length() > 200)
@@ -304,14 +546,17 @@ juce::String StableAudioEngine::sanitizePrompt(const juce::String& prompt)
 
 int StableAudioEngine::generateRandomSeed()
 {
+	juce::Random random(juce::Time::getHighResolutionTicks());
 	return random.nextInt(1000000);
 }
 
-void StableAudioEngine::cleanupTempFiles()
+juce::File StableAudioEngine::createJobWorkspace()
 {
-	auto outputFile = juce::File(modelsDirectory).getChildFile("output.wav");
-	if (outputFile.exists())
-	{
-		outputFile.deleteFile();
-	}
+	auto workspace = juce::File::getSpecialLocation(juce::File::tempDirectory)
+		.getChildFile("OBSIDIAN-Neural-jobs")
+		.getChildFile(juce::Uuid().toString());
+
+	if (!workspace.createDirectory())
+		return juce::File();
+	return workspace;
 }
\ No newline at end of file
@@ -1,7 +1,49 @@
 ﻿#pragma once
 #include <JuceHeader.h>
+#include "LocalInferenceWorker.h"
+#include "GenerationControl.h"
 #include <vector>
 #include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+class LocalJobScheduler
+{
+public:
+	class Slot
+	{
+	public:
+		~Slot() { owner.release(); }
+		int getNumThreads() const { return numThreads; }
+
+	private:
+		friend class LocalJobScheduler;
+		Slot(LocalJobScheduler& ownerToUse, int threads) : owner(ownerToUse), numThreads(threads) {}
+
+		LocalJobScheduler& owner;
+		int numThreads;
+
+		JUCE_DECLARE_NON_COPYABLE(Slot)
+	};
+
+	static LocalJobScheduler& getInstance();
+
+	std::unique_ptr<Slot> acquire(int requestedThreads, const GenerationControl::Ptr &control = nullptr);
+	int getMaxConcurrentJobs() const { return maxConcurrentJobs; }
+	int getActiveJobs() const;
+
+private:
+	LocalJobScheduler();
+	void release();
+
+	mutable std::mutex mutex;
+	std::condition_variable slotFreed;
+	int activeJobs = 0;
+	int maxConcurrentJobs = 1;
+	int availableCores = 1;
+	int threadsPerJob = 1;
+};
 
 class StableAudioEngine
 {
@@ -10,7 +52,7 @@ public:
 	{
 		juce::String prompt;
 		float duration = 10.0f;
-		int numThreads = 4;
+		int numThreads = 0;
 		int seed = -1;
 		int sampleRate = 44100;
 
@@ -23,39 +65,49 @@ public:
 
 	struct GenerationResult
 	{
-		std::vector<float> audioData;
-		std::vector<float> leftChannel;
-		std::vector<float> rightChannel;
+		juce::AudioBuffer<float> audio;
+		double sampleRate = 44100.0;
 		float actualDuration = 0.0f;
+		int seed = -1;
 		bool success = false;
+		bool cancelled = false;
 		juce::String errorMessage = "";
 		juce::String performanceInfo = "";
 
 		bool isValid() const
 		{
-			return success && !audioData.empty() && actualDuration > 0.0f;
+			return success && audio.getNumSamples() > 0 && actualDuration > 0.0f;
 		}
 	};
 	StableAudioEngine() {}
+	~StableAudioEngine();
 
 	bool initialize(const juce::String &modelsDir);
 	bool isReady() const { return isInitialized; }
+	bool hasPersistentWorker() const;
+	void shutdownWorker();
 
-	GenerationResult generateSample(const GenerationParams &params);
-	std::vector<float> generateAudio(const juce::String &prompt, float duration = 10.0f);
+	GenerationResult generateSample(const GenerationParams &params, const GenerationControl::Ptr &control = nullptr);
+	juce::AudioBuffer<float> generateAudio(const juce::String &prompt, float duration = 10.0f);
 
 private:
 	bool isInitialized = false;
 	juce::String modelsDirectory;
 	juce::File audiogenExecutable;
-	juce::Random random;
+	juce::File workerExecutable;
+	// Started on demand, at most one per concurrent scheduler slot.
+	mutable std::mutex workersMutex;
+	std::vector<std::unique_ptr<LocalInferenceWorker>> workers;
+	std::atomic<double> lastSubprocessMs{ 0.0 };
 
 	bool checkRequiredFiles();
-	std::vector<float> loadAndResampleWavFile(const juce::File &wavFile, double targetSampleRate);
-	juce::AudioBuffer<float> resampleBuffer(const juce::AudioBuffer<float> &inputBuffer,
-											double inputSampleRate,
-											double outputSampleRate);
-	void cleanupTempFiles();
+	LocalInferenceWorker* claimWorker();
+	bool generateWithWorker(const GenerationParams &params, const juce::String &prompt, int seed,
+							GenerationResult &result, const GenerationControl::Ptr &control);
+	juce::AudioBuffer<float> loadAndResampleWavFile(const juce::File &wavFile, double targetSampleRate);
+	void resampleIfNeeded(juce::AudioBuffer<float> &buffer, double inputSampleRate, double outputSampleRate);
+	void setResult(GenerationResult &result, juce::AudioBuffer<float> &&audio, double sampleRate);
+	juce::File createJobWorkspace();
 	juce::String sanitizePrompt(const juce::String &prompt);
 	int generateRandomSeed();
 
@@ -216,7 +216,7 @@ void TrackComponent::toggleWaveformDisplay()
 
 		if (track && track->numSamples > 0)
 		{
-			waveformDisplay->setAudioData(track->audioBuffer, track->sampleRate);
+			waveformDisplay->setAudioData(track->getPeakPyramid(), track->sampleRate);
 			waveformDisplay->setLoopPoints(track->loopStart, track->loopEnd);
 			calculateHostBasedDisplay();
 		}
@@ -309,6 +309,7 @@ void TrackComponent::updateFromTrackData()
 	showWaveformButton.setToggleState(track->showWaveform, juce::dontSendNotification);
 	sequencerToggleButton.setToggleState(track->showSequencer, juce::dontSendNotification);
 	randomDurationToggle.setToggleState(track->randomRetriggerDurationEnabled.load(), juce::dontSendNotification);
+	updateSeedLockButton();
 	drawButton.setEnabled(!audioProcessor.getUseLocalModel());
 
 	if (track->usePages.load())
@@ -506,6 +507,15 @@ void TrackComponent::paint(juce::Graphics& g)
 		g.setColour(borderColour.withAlpha(0.3f));
 		g.drawRoundedRectangle(bounds.toFloat().expanded(1), 8.0f, 1.0f);
 	}
+
+	if (isGenerating && generationProgress >= 0.0f)
+	{
+		auto progressArea = bounds.reduced(6, 0).removeFromBottom(3).toFloat();
+		g.setColour(ColourPalette::backgroundLight);
+		g.fillRect(progressArea);
+		g.setColour(ColourPalette::buttonSuccess);
+		g.fillRect(progressArea.withWidth(progressArea.getWidth() * juce::jlimit(0.0f, 100.0f, generationProgress) / 100.0f));
+	}
 }
 
 void TrackComponent::setSamplePending(bool pending)
@@ -558,6 +568,8 @@ void TrackComponent::resized()
 	headerArea.removeFromRight(5);
 	randomDurationToggle.setBounds(headerArea.removeFromRight(35));
 	headerArea.removeFromRight(5);
+	seedLockButton.setBounds(headerArea.removeFromRight(35));
+	headerArea.removeFromRight(5);
 
 	auto knobArea = headerArea.removeFromRight(50);
 	auto knobBounds = knobArea.withHeight(55).withY(knobArea.getY() - 8);
@@ -633,7 +645,7 @@ void TrackComponent::openDrawingCanvas()
 
 	canvas->setGenerating(canvasIsGenerating);
 
-	canvas->onGenerate = [this, canvas](const juce::String& base64Image)
+	canvas->onGenerate = [this, canvas](const CanvasImage::Ptr& image)
 		{
 			if (track)
 			{
@@ -643,21 +655,21 @@ void TrackComponent::openDrawingCanvas()
 				{
 					auto& currentPage = track->getCurrentPage();
 					currentPage.canvasState = stateXml;
-					currentPage.canvasData = base64Image;
+					currentPage.canvasData = image->base64;
 					currentPage.selectedKeywords = canvasState.selectedKeywords;
 					track->syncLegacyProperties();
 				}
 				else
 				{
 					track->canvasState = stateXml;
-					track->canvasData = base64Image;
+					track->canvasData = image->base64;
 					track->selectedKeywords = canvasState.selectedKeywords;
 				}
 			}
 			if (onGenerateWithImage)
 			{
 				auto keywords = canvas->getState().selectedKeywords;
-				onGenerateWithImage(trackId, base64Image, keywords);
+				onGenerateWithImage(trackId, image, keywords);
 			}
 		};
 
@@ -894,15 +906,13 @@ void TrackComponent::performPageChange(int pageIndex)
 	{
 		if (newPage.numSamples > 0 && newPage.isLoaded.load())
 		{
-			waveformDisplay->setAudioData(newPage.audioBuffer, newPage.sampleRate);
+			waveformDisplay->setAudioData(newPage.getPeakPyramid(), newPage.sampleRate);
 			waveformDisplay->setLoopPoints(newPage.loopStart, newPage.loopEnd);
 			calculateHostBasedDisplay();
 		}
 		else
 		{
-			juce::AudioBuffer<float> emptyBuffer;
-			emptyBuffer.setSize(2, 0);
-			waveformDisplay->setAudioData(emptyBuffer, 48000.0);
+			waveformDisplay->setAudioData(nullptr, 48000.0);
 			waveformDisplay->setLoopPoints(0.0, 0.0);
 		}
 	}
@@ -993,29 +1003,17 @@ void TrackComponent::loadPageAudioFile(int pageIndex, const juce::File& audioFil
 
 	try
 	{
-		juce::AudioFormatManager formatManager;
-		formatManager.registerBasicFormats();
-
-		std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(audioFile));
-		if (!reader)
+		double sampleRate = 0.0;
+		auto audio = SharedAudioCache::getInstance().load(audioFile, sampleRate);
+		if (!audio)
 		{
 			page.isLoading = false;
 			return;
 		}
 
-		int numChannels = reader->numChannels;
-		int numSamples = static_cast<int>(reader->lengthInSamples);
-
-		page.audioBuffer.setSize(2, numSamples);
-		reader->read(&page.audioBuffer, 0, numSamples, 0, true, true);
-
-		if (numChannels == 1)
-		{
-			page.audioBuffer.copyFrom(1, 0, page.audioBuffer, 0, 0, numSamples);
-		}
-
-		page.numSamples = numSamples;
-		page.sampleRate = reader->sampleRate;
+		page.numSamples = audio->getNumSamples();
+		page.sampleRate = sampleRate;
+		page.publishAudio(std::move(audio));
 		page.isLoaded = true;
 		page.isLoading = false;
 
@@ -1044,6 +1042,12 @@ void TrackComponent::loadPageAudioFile(int pageIndex, const juce::File& audioFil
 void TrackComponent::startGeneratingAnimation()
 {
 	isGenerating = true;
+	generationProgress = -1.0f;
+
+	generateButton.setButtonText(juce::String::fromUTF8("\xE2\x9C\x95"));
+	generateButton.setColour(juce::TextButton::buttonColourId, ColourPalette::buttonDanger);
+	generateButton.setTooltip("Cancel generation");
+	generateButton.setEnabled(true);
 
 	if (pagesMode)
 	{
@@ -1063,6 +1067,11 @@ void TrackComponent::startGeneratingAnimation()
 void TrackComponent::stopGeneratingAnimation()
 {
 	isGenerating = false;
+	generationProgress = -1.0f;
+
+	generateButton.setButtonText(juce::String::fromUTF8("\xE2\x9C\x93"));
+	generateButton.setColour(juce::TextButton::buttonColourId, ColourPalette::buttonSuccess);
+	generateButton.setTooltip("Generate new sample for this track");
 
 	if (pagesMode)
 	{
@@ -1085,7 +1094,7 @@ void TrackComponent::stopGeneratingAnimation()
 			const auto& currentPage = track->getCurrentPage();
 			if (currentPage.numSamples > 0)
 			{
-				waveformDisplay->setAudioData(currentPage.audioBuffer, currentPage.sampleRate);
+				waveformDisplay->setAudioData(currentPage.getPeakPyramid(), currentPage.sampleRate);
 				waveformDisplay->setLoopPoints(currentPage.loopStart, currentPage.loopEnd);
 			}
 		}
@@ -1093,7 +1102,7 @@ void TrackComponent::stopGeneratingAnimation()
 		{
 			if (track->numSamples > 0)
 			{
-				waveformDisplay->setAudioData(track->audioBuffer, track->sampleRate);
+				waveformDisplay->setAudioData(track->getPeakPyramid(), track->sampleRate);
 				waveformDisplay->setLoopPoints(track->loopStart, track->loopEnd);
 			}
 		}
@@ -1102,6 +1111,19 @@ void TrackComponent::stopGeneratingAnimation()
 	repaint();
 }
 
+void TrackComponent::setGenerationProgress(const juce::String& stage, float percent)
+{
+	if (!isGenerating)
+		return;
+
+	generationProgress = percent;
+	juce::String tooltip = "Cancel generation - " + stage;
+	if (percent >= 0.0f)
+		tooltip += " " + juce::String(juce::roundToInt(percent)) + "%";
+	generateButton.setTooltip(tooltip);
+	repaint();
+}
+
 void TrackComponent::timerCallback()
 {
 	if (isGenerating)
@@ -1141,7 +1163,7 @@ void TrackComponent::refreshWaveformDisplay()
 
 		if (currentPage.numSamples > 0 && currentPage.isLoaded.load())
 		{
-			waveformDisplay->setAudioData(currentPage.audioBuffer, currentPage.sampleRate);
+			waveformDisplay->setAudioData(currentPage.getPeakPyramid(), currentPage.sampleRate);
 			waveformDisplay->setLoopPoints(currentPage.loopStart, currentPage.loopEnd);
 
 			if (!currentPage.audioFilePath.isEmpty())
@@ -1153,9 +1175,7 @@ void TrackComponent::refreshWaveformDisplay()
 		}
 		else
 		{
-			juce::AudioBuffer<float> emptyBuffer;
-			emptyBuffer.setSize(2, 0);
-			waveformDisplay->setAudioData(emptyBuffer, 48000.0);
+			waveformDisplay->setAudioData(nullptr, 48000.0);
 			waveformDisplay->setLoopPoints(0.0, 0.0);
 		}
 	}
@@ -1163,7 +1183,7 @@ void TrackComponent::refreshWaveformDisplay()
 	{
 		if (track->numSamples > 0)
 		{
-			waveformDisplay->setAudioData(track->audioBuffer, track->sampleRate);
+			waveformDisplay->setAudioData(track->getPeakPyramid(), track->sampleRate);
 			waveformDisplay->setLoopPoints(track->loopStart, track->loopEnd);
 
 			if (!track->audioFilePath.isEmpty())
@@ -1241,6 +1261,13 @@ void TrackComponent::setupUI()
 	generateButton.setTooltip("Generate new sample for this track");
 	generateButton.onClick = [this]()
 		{
+			if (isGenerating)
+			{
+				if (onCancelGeneration)
+					onCancelGeneration(trackId);
+				return;
+			}
+
 			if (onGenerateForTrack)
 			{
 				if (track)
@@ -1416,6 +1443,26 @@ void TrackComponent::setupUI()
 			}
 		};
 
+	addAndMakeVisible(seedLockButton);
+	seedLockButton.setButtonText("S");
+	seedLockButton.setClickingTogglesState(true);
+	seedLockButton.setColour(juce::TextButton::buttonColourId, ColourPalette::backgroundLight);
+	seedLockButton.setColour(juce::TextButton::buttonOnColourId, ColourPalette::buttonPrimary);
+	seedLockButton.setColour(juce::TextButton::textColourOffId, ColourPalette::textSecondary);
+	seedLockButton.setColour(juce::TextButton::textColourOnId, ColourPalette::textPrimary);
+	seedLockButton.onClick = [this]()
+		{
+			if (track)
+			{
+				track->seedLocked = seedLockButton.getToggleState();
+				updateSeedLockButton();
+				int seed = track->getRequestSeed();
+				statusCallback(track->seedLocked.load()
+					? (seed >= 0 ? "Seed locked: " + juce::String(seed) : juce::String("Seed will lock after the next generation"))
+					: juce::String("Seed unlocked: each generation uses a new seed"));
+			}
+		};
+
 	togglePagesButton.setVisible(false);
 	for (int i = 0; i < 4; ++i)
 	{
@@ -1424,6 +1471,20 @@ void TrackComponent::setupUI()
 	setupPagesUI();
 }
 
+void TrackComponent::updateSeedLockButton()
+{
+	if (!track) return;
+
+	bool locked = track->seedLocked.load();
+	int seed = track->usePages.load() ? track->getCurrentPage().generationSeed : track->generationSeed;
+	seedLockButton.setToggleState(locked, juce::dontSendNotification);
+
+	juce::String seedText = seed >= 0 ? "Seed " + juce::String(seed) : juce::String("No seed yet");
+	seedLockButton.setTooltip(seedText + (locked
+		? " - locked: regenerating repeats this sample (served from the result cache when enabled)"
+		: " - unlocked: click to regenerate with this seed"));
+}
+
 void TrackComponent::updateRandomRetriggerButtonColor()
 {
 	if (!track) return;
@@ -1492,13 +1553,8 @@ void TrackComponent::onIntervalChanged()
 			double startPosition = track->beatRepeatStartPosition.load();
 			double repeatDuration = audioProcessor.calculateRetriggerInterval(value, hostBpm);
 			double repeatDurationSamples = repeatDuration * track->sampleRate;
-			track->beatRepeatEndPosition.store(startPosition + repeatDurationSamples);
-
-			double maxSamples = track->numSamples;
-			if (track->beatRepeatEndPosition.load() > maxSamples)
-			{
-				track->beatRepeatEndPosition.store(maxSamples);
-			}
+			auto transientIndex = track->getTransientIndex();
+			track->setBeatRepeatWindow(transientIndex.get(), startPosition, repeatDurationSamples, false);
 		}
 	}
 
@@ -1788,6 +1844,9 @@ void TrackComponent::updateTrackInfo()
 		infoLabel.setText(track->prompt.substring(0, 30) + "..." + bpmInfo,
 			juce::dontSendNotification);
 	}
+
+	if (infoLabel.getTooltip() != track->lastGenerationTimings)
+		infoLabel.setTooltip(track->lastGenerationTimings);
 	repaint();
 }
 
@@ -2010,7 +2069,7 @@ void TrackComponent::itemDropped(const SourceDetails& dragSourceDetails)
 
 		if (auto* sampleBank = audioProcessor.getSampleBank())
 		{
-			auto* sampleEntry = sampleBank->getSample(sampleId);
+			auto sampleEntry = sampleBank->getSample(sampleId);
 			if (sampleEntry && !sampleEntry->originalPrompt.isEmpty())
 			{
 				for (int i = 0; i < promptPresetSelector.getNumItems(); ++i)
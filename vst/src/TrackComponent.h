@@ -39,10 +39,11 @@ public:
 	std::function<void(const juce::String&)> onDeleteTrack;
 	std::function<void(const juce::String&)> onSelectTrack;
 	std::function<void(const juce::String&)> onGenerateForTrack;
+	std::function<void(const juce::String&)> onCancelGeneration;
 	std::function<void(const juce::String&, const juce::String&)> onTrackRenamed;
 	std::function<void(const juce::String&, const juce::String&)> onTrackPromptChanged;
 	std::function<void(const juce::String&)> onStatusMessage;
-	std::function<void(const juce::String&, const juce::String&, const juce::StringArray&)> onGenerateWithImage;
+	std::function<void(const juce::String&, const CanvasImage::Ptr&, const juce::StringArray&)> onGenerateWithImage;
 	std::function<void(const juce::String&)> onStopPreview;
 
 	bool isInterestedInDragSource(const SourceDetails& dragSourceDetails) override;
@@ -70,6 +71,7 @@ public:
 	bool isWaveformVisible() const;
 	void startGeneratingAnimation();
 	void stopGeneratingAnimation();
+	void setGenerationProgress(const juce::String& stage, float percent);
 	void updateFromTrackData();
 	void setGenerateButtonEnabled(bool enabled);
 	void updateWaveformWithTimeStretch();
@@ -162,6 +164,7 @@ private:
 	juce::TextButton originalSyncButton;
 	juce::TextButton deleteButton;
 	juce::TextButton drawButton;
+	juce::TextButton seedLockButton;
 
 	juce::Slider bpmOffsetSlider;
 
@@ -178,6 +181,7 @@ private:
 	std::atomic<bool> isDestroyed{ false };
 
 	bool isGenerating = false;
+	float generationProgress = -1.0f;
 	bool blinkState = false;
 	bool isSelected = false;
 	bool isDragOver = false;
@@ -221,6 +225,7 @@ private:
 	void addEventListeners();
 	void updateRandomRetriggerButtonColor();
 	void updateRandomDurationButtonColor();
+	void updateSeedLockButton();
 	void openDrawingCanvas();
 	void updatePreviewButton();
 
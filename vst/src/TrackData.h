@@ -1,6 +1,12 @@
 #pragma once
 #include <JuceHeader.h>
 #include "DjIaClient.h"
+#include "GenerationTrace.h"
+#include "SampleAnalysis.h"
+#include "TransientIndex.h"
+#include "PeakPyramid.h"
+#include "LoopDetector.h"
+#include "SharedAudioCache.h"
 
 struct SequencerData
 {
@@ -21,9 +27,65 @@ struct SequencerData
 	}
 };
 
+// A published buffer together with what is known about it. Everything is
+// swapped in as one, so beat repeat never snaps against an index and the
+// waveform never draws peaks that belong to other audio. Never changed once
+// published; a late analysis is attached by publishing a copy.
+struct PlaybackAudio
+{
+	using Ptr = std::shared_ptr<const PlaybackAudio>;
+	using Slot = SharedAudioCache::Slot<PlaybackAudio>;
+
+	SharedAudioCache::Ptr buffer;
+	TransientIndex::Ptr transientIndex;
+	PeakPyramid::Ptr peakPyramid;
+	SampleAnalysis::Ptr analysis;
+	LoopSuggestion loopSuggestion;
+
+	static std::shared_ptr<PlaybackAudio> create(SharedAudioCache::Ptr buffer, int numSamples, double sampleRate,
+		SampleAnalysis::Ptr analysis = nullptr)
+	{
+		if (!buffer)
+			return nullptr;
+
+		auto playback = std::make_shared<PlaybackAudio>();
+		playback->transientIndex = TransientIndex::build(*buffer, numSamples, sampleRate);
+		playback->peakPyramid = PeakPyramid::build(*buffer, numSamples);
+		playback->buffer = std::move(buffer);
+		playback->analysis = std::move(analysis);
+		return playback;
+	}
+
+	// Republishes the slot's bundle, or an empty one if nothing is loaded
+	// yet, with one field replaced. Not for the audio thread.
+	static void attachAnalysis(Slot& slot, const SampleAnalysis::Ptr& analysis)
+	{
+		republish(slot, [&analysis](PlaybackAudio& next) { next.analysis = analysis; });
+	}
+
+	static void attachLoopSuggestion(Slot& slot, const LoopSuggestion& suggestion)
+	{
+		republish(slot, [&suggestion](PlaybackAudio& next) { next.loopSuggestion = suggestion; });
+	}
+
+private:
+	template <typename Change>
+	static void republish(Slot& slot, Change&& change)
+	{
+		slot.update([&change](const Ptr& current)
+			{
+				auto next = current ? std::make_shared<PlaybackAudio>(*current) : std::make_shared<PlaybackAudio>();
+				change(*next);
+				return Ptr(std::move(next));
+			});
+	}
+};
+
 struct TrackPage
 {
-	juce::AudioSampleBuffer audioBuffer;
+	// The buffer is immutable and possibly shared with other pages, tracks
+	// and instances.
+	PlaybackAudio::Slot playback;
 
 	juce::AudioBuffer<float> originalStagingBuffer;
 
@@ -34,11 +96,13 @@ struct TrackPage
 	juce::String generationKey;
 	juce::String canvasData;
 	juce::String canvasState;
+	juce::String sampleId;
 
 	juce::StringArray selectedKeywords;
 
 	int numSamples = 0;
 	int generationDuration = 6;
+	int generationSeed = -1;
 
 	double sampleRate = 48000.0;
 	double loopStart = 0.0;
@@ -59,7 +123,7 @@ struct TrackPage
 
 	TrackPage(const TrackPage& other)
 	{
-		audioBuffer = other.audioBuffer;
+		playback = other.playback;
 		audioFilePath = other.audioFilePath;
 		numSamples = other.numSamples;
 		sampleRate = other.sampleRate;
@@ -70,8 +134,10 @@ struct TrackPage
 		generationBpm = other.generationBpm;
 		generationKey = other.generationKey;
 		generationDuration = other.generationDuration;
+		generationSeed = other.generationSeed;
 		loopStart = other.loopStart;
 		loopEnd = other.loopEnd;
+		sampleId = other.sampleId;
 		useOriginalFile = other.useOriginalFile.load();
 		hasOriginalVersion = other.hasOriginalVersion.load();
 		originalStagingBuffer = other.originalStagingBuffer;
@@ -81,7 +147,7 @@ struct TrackPage
 
 	void reset()
 	{
-		audioBuffer.setSize(0, 0);
+		playback.reset();
 		audioFilePath.clear();
 		numSamples = 0;
 		sampleRate = 48000.0;
@@ -92,8 +158,10 @@ struct TrackPage
 		generationBpm = 126.0f;
 		generationKey.clear();
 		generationDuration = 6;
+		generationSeed = -1;
 		loopStart = 0.0;
 		loopEnd = 4.0;
+		sampleId.clear();
 		useOriginalFile = false;
 		hasOriginalVersion = false;
 		originalStagingBuffer.setSize(0, 0);
@@ -101,6 +169,47 @@ struct TrackPage
 		isLoading = false;
 	}
 
+	SharedAudioCache::Ptr getAudio() const
+	{
+		auto current = playback.load();
+		return current ? current->buffer : nullptr;
+	}
+
+	PeakPyramid::Ptr getPeakPyramid() const
+	{
+		auto current = playback.load();
+		return current ? current->peakPyramid : nullptr;
+	}
+
+	SampleAnalysis::Ptr getAnalysis() const
+	{
+		auto current = playback.load();
+		return current ? current->analysis : nullptr;
+	}
+
+	LoopSuggestion getLoopSuggestion() const
+	{
+		auto current = playback.load();
+		return current ? current->loopSuggestion : LoopSuggestion{};
+	}
+
+	// Builds the transient index and peaks for buffer and publishes them
+	// with it, so set numSamples and sampleRate first. The page's sample is
+	// unchanged, so its analysis carries over.
+	void publishAudio(SharedAudioCache::Ptr buffer)
+	{
+		auto built = PlaybackAudio::create(std::move(buffer), numSamples, sampleRate);
+		playback.update([&built](const PlaybackAudio::Ptr& current)
+			{
+				if (!built)
+					return PlaybackAudio::Ptr();
+				auto next = std::make_shared<PlaybackAudio>(*built);
+				next->analysis = current ? current->analysis : nullptr;
+				next->loopSuggestion = current ? current->loopSuggestion : LoopSuggestion{};
+				return PlaybackAudio::Ptr(std::move(next));
+			});
+	}
+
 	SequencerData sequences[8];
 	int currentSequenceIndex = 0;
 
@@ -119,8 +228,12 @@ struct TrackData
 {
 	TrackPage pages[4];
 
+	// Loads decode and stretch into stagingBuffer, then publish it as
+	// stagingPlayback, which the audio thread swaps in. playback is only used
+	// without pages; with pages the current page's slot is the live one.
 	juce::AudioSampleBuffer stagingBuffer;
-	juce::AudioSampleBuffer audioBuffer;
+	PlaybackAudio::Slot stagingPlayback;
+	PlaybackAudio::Slot playback;
 
 	juce::AudioBuffer<float> originalStagingBuffer;
 
@@ -135,9 +248,19 @@ struct TrackData
 	juce::String currentSampleId;
 	juce::String canvasData;
 	juce::String canvasState;
+	juce::String lastGenerationTimings;
 
 	juce::StringArray selectedKeywords;
 
+	GenerationTrace::Ptr stagingTrace;
+	// Loader threads only; published with the staged audio.
+	SampleAnalysis::Ptr stagingAnalysis;
+
+	// Audio-thread only: tail of the previous read position being faded out
+	// after a beat-repeat jump.
+	double repeatFadeTailPosition = 0.0;
+	int repeatFadeRemaining = 0;
+
 	bool showWaveform = true;
 	bool showSequencer = true;
 	bool isVersionSwitch = false;
@@ -149,6 +272,7 @@ struct TrackData
 	int midiNote = 60;
 	int numSamples = 0;
 	int generationDuration;
+	int generationSeed = -1;
 	int customStepCounter = 0;
 
 	float fineOffset = 0.0f;
@@ -173,10 +297,15 @@ struct TrackData
 	std::atomic<bool> isCurrentlyPlaying{ false };
 	std::atomic<bool> hasStagingData{ false };
 	std::atomic<bool> swapRequested{ false };
+	// getMillisecondCounterHiRes() at the last buffer swap, for the trace.
+	std::atomic<double> lastSwapMs{ 0.0 };
 	std::atomic<bool> isEnabled{ true };
 	std::atomic<bool> isSolo{ false };
 	std::atomic<bool> isMuted{ false };
 	std::atomic<bool> loopPointsLocked{ false };
+	// Regenerate with the seed of the current sample instead of a new one,
+	// which also lets repeats come from the generation cache.
+	std::atomic<bool> seedLocked{ false };
 	std::atomic<bool> useOriginalFile{ false };
 	std::atomic<bool> hasOriginalVersion{ false };
 	std::atomic<bool> nextHasOriginalVersion{ false };
@@ -272,6 +401,116 @@ struct TrackData
 		return pages[currentPageIndex];
 	}
 
+	// Hands the finished staging buffer to the shared cache and stages it
+	// with stagingAnalysis. The stage*() calls below work on the staged
+	// bundle, so call this first.
+	void publishStagingBuffer()
+	{
+		stageAudio(SharedAudioCache::getInstance().intern(std::move(stagingBuffer), stagingSampleRate.load()),
+			stagingAnalysis);
+	}
+
+	// Stages an already published buffer with its transient index, peaks
+	// and analysis. Set stagingNumSamples and stagingSampleRate first.
+	void stageAudio(SharedAudioCache::Ptr buffer, SampleAnalysis::Ptr analysis)
+	{
+		stagingPlayback.store(PlaybackAudio::create(std::move(buffer), stagingNumSamples.load(), stagingSampleRate.load(),
+			std::move(analysis)));
+	}
+
+	SharedAudioCache::Ptr getStagedAudio() const
+	{
+		auto staged = stagingPlayback.load();
+		return staged ? staged->buffer : nullptr;
+	}
+
+	// Adds the detected loop to the staged bundle. Call before requesting
+	// the swap.
+	void stageLoopSuggestion()
+	{
+		auto staged = stagingPlayback.load();
+		if (!staged || !staged->buffer)
+			return;
+		PlaybackAudio::attachLoopSuggestion(stagingPlayback,
+			LoopDetector::detect(*staged->buffer, stagingNumSamples.load(), stagingSampleRate.load(),
+				stagingOriginalBpm, staged->transientIndex.get()));
+	}
+
+	// A snapshot of whatever the audio thread is playing from, buffer and
+	// transient index together.
+	PlaybackAudio::Ptr getCurrentPlayback() const
+	{
+		return usePages ? getCurrentPage().playback.load() : playback.load();
+	}
+
+	SharedAudioCache::Ptr getCurrentAudio() const
+	{
+		auto current = getCurrentPlayback();
+		return current ? current->buffer : nullptr;
+	}
+
+	PeakPyramid::Ptr getPeakPyramid() const
+	{
+		auto current = getCurrentPlayback();
+		return current ? current->peakPyramid : nullptr;
+	}
+
+	SampleAnalysis::Ptr getAnalysis() const
+	{
+		auto current = getCurrentPlayback();
+		return current ? current->analysis : nullptr;
+	}
+
+	LoopSuggestion getLoopSuggestion() const
+	{
+		auto current = getCurrentPlayback();
+		return current ? current->loopSuggestion : LoopSuggestion{};
+	}
+
+	// Holds the index for as long as the caller keeps the pointer, even if
+	// the audio thread swaps in another page meanwhile. Not for the audio
+	// thread, which uses getRenderPlayback().
+	TransientIndex::Ptr getTransientIndex() const
+	{
+		auto current = getCurrentPlayback();
+		return current ? current->transientIndex : nullptr;
+	}
+
+	// The audio thread's lock-free view of what it is playing; only valid
+	// inside the processor's render block.
+	const PlaybackAudio* getRenderPlayback() const noexcept
+	{
+		return usePages ? getCurrentPage().playback.get() : playback.get();
+	}
+
+	// Snaps a repeat window starting near startPosition (absolute buffer
+	// samples) to a clean attack and ends it on a zero crossing. index comes
+	// from getRenderPlayback() on the audio thread and from a
+	// getTransientIndex() snapshot anywhere else.
+	void setBeatRepeatWindow(const TransientIndex* index, double startPosition, double lengthSamples, bool snapStart)
+	{
+		if (index && snapStart)
+			startPosition = index->snapStart(startPosition, juce::jmin(lengthSamples * 0.25, sampleRate * 0.03));
+
+		double endPosition = startPosition + lengthSamples;
+		if (index)
+			endPosition = index->snapToZeroCrossing(endPosition);
+		endPosition = juce::jmin(endPosition, (double)numSamples);
+		if (endPosition <= startPosition)
+			endPosition = juce::jmin(startPosition + lengthSamples, (double)numSamples);
+
+		beatRepeatStartPosition.store(startPosition);
+		beatRepeatEndPosition.store(endPosition);
+	}
+
+	void startRepeatCrossfade(double fromPosition)
+	{
+		if (!isPlaying.load())
+			return;
+		repeatFadeTailPosition = fromPosition;
+		repeatFadeRemaining = TransientIndex::crossfadeLength;
+	}
+
 	const TrackPage& getCurrentPage() const
 	{
 		return pages[currentPageIndex];
@@ -284,7 +523,6 @@ struct TrackData
 
 		auto& currentPage = getCurrentPage();
 
-		audioBuffer = currentPage.audioBuffer;
 		audioFilePath = currentPage.audioFilePath;
 		numSamples = currentPage.numSamples;
 		sampleRate = currentPage.sampleRate;
@@ -299,6 +537,7 @@ struct TrackData
 		generationBpm = currentPage.generationBpm;
 		generationKey = currentPage.generationKey;
 		generationDuration = currentPage.generationDuration;
+		generationSeed = currentPage.generationSeed;
 
 		useOriginalFile = currentPage.useOriginalFile.load();
 		hasOriginalVersion = currentPage.hasOriginalVersion.load();
@@ -312,7 +551,7 @@ struct TrackData
 		if (usePages)
 			return;
 
-		pages[0].audioBuffer = audioBuffer;
+		pages[0].playback = playback;
 		pages[0].audioFilePath = audioFilePath;
 		pages[0].numSamples = numSamples;
 		pages[0].sampleRate = sampleRate;
@@ -325,6 +564,7 @@ struct TrackData
 		pages[0].generationBpm = generationBpm;
 		pages[0].generationKey = generationKey;
 		pages[0].generationDuration = generationDuration;
+		pages[0].generationSeed = generationSeed;
 		pages[0].useOriginalFile = useOriginalFile.load();
 		pages[0].hasOriginalVersion = hasOriginalVersion.load();
 		pages[0].originalStagingBuffer = originalStagingBuffer;
@@ -367,9 +607,29 @@ struct TrackData
 			request.key = generationKey;
 			request.generationDuration = static_cast<float>(generationDuration);
 		}
+		request.seed = getRequestSeed();
 		return request;
 	}
 
+	// The seed a new generation should use: the current one when locked,
+	// otherwise -1 so the backend picks one.
+	int getRequestSeed() const
+	{
+		if (!seedLocked.load())
+			return -1;
+		return usePages ? getCurrentPage().generationSeed : generationSeed;
+	}
+
+	// Records the seed the backend actually used for the current sample.
+	void setGeneratedSeed(int seed)
+	{
+		if (seed < 0)
+			return;
+		if (usePages)
+			getCurrentPage().generationSeed = seed;
+		generationSeed = seed;
+	}
+
 	void updateFromRequest(const DjIaClient::LoopRequest& request)
 	{
 		if (usePages)
@@ -379,6 +639,8 @@ struct TrackData
 			currentPage.generationBpm = request.bpm;
 			currentPage.generationKey = request.key;
 			currentPage.generationDuration = static_cast<int>(request.generationDuration);
+			if (request.seed >= 0)
+				currentPage.generationSeed = request.seed;
 			syncLegacyProperties();
 		}
 		else
@@ -387,6 +649,8 @@ struct TrackData
 			generationBpm = request.bpm;
 			generationKey = request.key;
 			generationDuration = static_cast<int>(request.generationDuration);
+			if (request.seed >= 0)
+				generationSeed = request.seed;
 		}
 	}
 
@@ -403,13 +667,14 @@ struct TrackData
 		}
 		else
 		{
-			audioBuffer.setSize(0, 0);
+			playback.reset();
 			numSamples = 0;
 			readPosition = 0.0;
 			isEnabled = true;
 			isMuted = false;
 			isSolo = false;
 			loopPointsLocked = false;
+			seedLocked = false;
 			volume = 0.8f;
 			pan = 0.0f;
 			bpmOffset = 0.0;
@@ -427,7 +692,7 @@ struct TrackData
 	{
 		bool wasPlaying = isPlaying.load();
 		isPlaying = playing;
-		if (wasPlaying != playing && onPlayStateChanged && getCurrentAudioBuffer().getNumChannels() > 0 && isPlaying.load())
+		if (wasPlaying != playing && onPlayStateChanged && hasCurrentAudio() && isPlaying.load())
 		{
 			juce::MessageManager::callAsync([this, playing]()
 				{
@@ -441,7 +706,7 @@ struct TrackData
 	{
 		bool wasArmed = isArmed.load();
 		isArmed = armed;
-		if (wasArmed != armed && onArmedStateChanged && getCurrentAudioBuffer().getNumChannels() > 0 && isPlaying.load())
+		if (wasArmed != armed && onArmedStateChanged && hasCurrentAudio() && isPlaying.load())
 		{
 			juce::MessageManager::callAsync([this, armed]()
 				{
@@ -454,7 +719,7 @@ struct TrackData
 	void setArmedToStop(bool armedToStop)
 	{
 		isArmedToStop = armedToStop;
-		if (onArmedToStopStateChanged && getCurrentAudioBuffer().getNumChannels() > 0 && isCurrentlyPlaying.load())
+		if (onArmedToStopStateChanged && hasCurrentAudio() && isCurrentlyPlaying.load())
 		{
 			juce::MessageManager::callAsync([this, armedToStop]()
 				{
@@ -474,8 +739,8 @@ struct TrackData
 	}
 
 private:
-	juce::AudioSampleBuffer& getCurrentAudioBuffer()
+	bool hasCurrentAudio() const
 	{
-		return usePages ? pages[currentPageIndex].audioBuffer : audioBuffer;
+		return getCurrentAudio() != nullptr;
 	}
 };
\ No newline at end of file
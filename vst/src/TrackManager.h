@@ -1,6 +1,7 @@
 #pragma once
 #include "JuceHeader.h"
 #include "TrackData.h"
+#include "PageCacheFile.h"
 
 class TrackManager
 {
@@ -204,7 +205,9 @@ public:
 			trackState.setProperty("generationBpm", track->generationBpm, nullptr);
 			trackState.setProperty("generationKey", track->generationKey, nullptr);
 			trackState.setProperty("generationDuration", track->generationDuration, nullptr);
+			trackState.setProperty("generationSeed", track->generationSeed, nullptr);
 			trackState.setProperty("loopPointsLocked", track->loopPointsLocked.load(), nullptr);
+			trackState.setProperty("seedLocked", track->seedLocked.load(), nullptr);
 			trackState.setProperty("selectedPrompt", track->selectedPrompt, nullptr);
 			trackState.setProperty("useOriginalFile", track->useOriginalFile.load(), nullptr);
 			trackState.setProperty("hasOriginalVersion", track->hasOriginalVersion.load(), nullptr);
@@ -222,6 +225,8 @@ public:
 			trackState.setProperty("currentPageIndex", track->currentPageIndex, nullptr);
 			trackState.setProperty("canvasData", track->canvasData, nullptr);
 			trackState.setProperty("canvasState", track->canvasState, nullptr);
+			if (auto analysis = track->getAnalysis())
+				trackState.setProperty("analysis", analysis->toJsonString(), nullptr);
 			trackState.setProperty("selectedKeywords", track->selectedKeywords.joinIntoString("|"), nullptr);
 
 			for (int pageIndex = 0; pageIndex < 4; ++pageIndex)
@@ -240,6 +245,7 @@ public:
 				pageState.setProperty("generationBpm", page.generationBpm, nullptr);
 				pageState.setProperty("generationKey", page.generationKey, nullptr);
 				pageState.setProperty("generationDuration", page.generationDuration, nullptr);
+				pageState.setProperty("generationSeed", page.generationSeed, nullptr);
 				pageState.setProperty("loopStart", page.loopStart, nullptr);
 				pageState.setProperty("loopEnd", page.loopEnd, nullptr);
 				pageState.setProperty("useOriginalFile", page.useOriginalFile.load(), nullptr);
@@ -247,6 +253,16 @@ public:
 				pageState.setProperty("isLoaded", page.isLoaded.load(), nullptr);
 				pageState.setProperty("canvasData", page.canvasData, nullptr);
 				pageState.setProperty("canvasState", page.canvasState, nullptr);
+				pageState.setProperty("sampleId", page.sampleId, nullptr);
+				auto loopSuggestion = page.getLoopSuggestion();
+				if (loopSuggestion.isValid())
+				{
+					pageState.setProperty("suggestedLoopStart", loopSuggestion.startSeconds, nullptr);
+					pageState.setProperty("suggestedLoopEnd", loopSuggestion.endSeconds, nullptr);
+					pageState.setProperty("suggestedLoopBars", loopSuggestion.bars, nullptr);
+				}
+				if (auto analysis = page.getAnalysis())
+					pageState.setProperty("analysis", analysis->toJsonString(), nullptr);
 				pageState.setProperty("selectedKeywords", page.selectedKeywords.joinIntoString("|"), nullptr);
 				pageState.setProperty("currentSequenceIndex", page.currentSequenceIndex, nullptr);
 
@@ -285,7 +301,8 @@ public:
 				trackState.setProperty("audioFilePath", track->audioFilePath, nullptr);
 				trackState.setProperty("sampleRate", track->sampleRate, nullptr);
 				trackState.setProperty("numSamples", track->numSamples, nullptr);
-				trackState.setProperty("numChannels", track->audioBuffer.getNumChannels(), nullptr);
+				auto currentAudio = track->getCurrentAudio();
+				trackState.setProperty("numChannels", currentAudio ? currentAudio->getNumChannels() : 0, nullptr);
 			}
 
 			juce::ValueTree legacySequencerState("Sequencer");
@@ -361,7 +378,9 @@ public:
 			track->generationBpm = trackState.getProperty("generationBpm", 127.0f);
 			track->generationKey = trackState.getProperty("generationKey", "C Minor");
 			track->generationDuration = trackState.getProperty("generationDuration", 6);
+			track->generationSeed = trackState.getProperty("generationSeed", -1);
 			track->loopPointsLocked = trackState.getProperty("loopPointsLocked", false);
+			track->seedLocked = trackState.getProperty("seedLocked", false);
 			track->selectedPrompt = trackState.getProperty("selectedPrompt", "");
 			track->useOriginalFile = trackState.getProperty("useOriginalFile", false);
 			track->hasOriginalVersion = trackState.getProperty("hasOriginalVersion", false);
@@ -377,6 +396,8 @@ public:
 			track->randomRetriggerDurationEnabled = trackState.getProperty("randomRetriggerDurationEnabled", false);
 			track->canvasData = trackState.getProperty("canvasData", "");
 			track->canvasState = trackState.getProperty("canvasState", "");
+			if (auto analysis = SampleAnalysis::fromJsonString(trackState.getProperty("analysis", "").toString()))
+				PlaybackAudio::attachAnalysis(track->playback, analysis);
 			track->usePages = trackState.getProperty("usePages", false);
 			track->currentPageIndex = trackState.getProperty("currentPageIndex", 0);
 
@@ -421,12 +442,22 @@ public:
 						page.generationBpm = pageState.getProperty("generationBpm", 126.0f);
 						page.generationKey = pageState.getProperty("generationKey", "").toString();
 						page.generationDuration = pageState.getProperty("generationDuration", 6);
+						page.generationSeed = pageState.getProperty("generationSeed", -1);
 						page.loopStart = pageState.getProperty("loopStart", 0.0);
 						page.loopEnd = pageState.getProperty("loopEnd", 4.0);
 						page.useOriginalFile = pageState.getProperty("useOriginalFile", false);
 						page.hasOriginalVersion = pageState.getProperty("hasOriginalVersion", false);
 						page.canvasData = pageState.getProperty("canvasData", "").toString();
 						page.canvasState = pageState.getProperty("canvasState", "").toString();
+						page.sampleId = pageState.getProperty("sampleId", "").toString();
+						LoopSuggestion loopSuggestion;
+						loopSuggestion.startSeconds = pageState.getProperty("suggestedLoopStart", 0.0);
+						loopSuggestion.endSeconds = pageState.getProperty("suggestedLoopEnd", 0.0);
+						loopSuggestion.bars = pageState.getProperty("suggestedLoopBars", 0);
+						if (loopSuggestion.isValid())
+							PlaybackAudio::attachLoopSuggestion(page.playback, loopSuggestion);
+						if (auto analysis = SampleAnalysis::fromJsonString(pageState.getProperty("analysis", "").toString()))
+							PlaybackAudio::attachAnalysis(page.playback, analysis);
 
 						juce::String pageKeywordsStr = pageState.getProperty("selectedKeywords", "");
 						if (pageKeywordsStr.isNotEmpty())
@@ -665,110 +696,49 @@ public:
 
 		DBG("loadAudioFileForPage: Attempting to load page " << (char)('A' + pageIndex) << " from: " << audioFile.getFullPathName());
 
-		static juce::AudioFormatManager formatManager;
-		static bool initialized = false;
-		if (!initialized)
-		{
-			formatManager.registerBasicFormats();
-			initialized = true;
-		}
-
-		std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(audioFile));
-		if (!reader)
-		{
-			DBG("loadAudioFileForPage: Failed to create reader for page " << pageIndex << ": " << audioFile.getFullPathName());
-			page.numSamples = 0;
-			page.isLoaded = false;
-			page.audioBuffer.setSize(0, 0);
-			return;
-		}
-
-		int numChannels = reader->numChannels;
-		int numSamples = static_cast<int>(reader->lengthInSamples);
-
-		DBG("loadAudioFileForPage: File info - channels=" << numChannels << ", samples=" << numSamples << ", sampleRate=" << reader->sampleRate);
-
-		if (numSamples <= 0)
-		{
-			DBG("loadAudioFileForPage: No samples in file for page " << pageIndex);
-			page.numSamples = 0;
-			page.isLoaded = false;
-			page.audioBuffer.setSize(0, 0);
-			return;
-		}
-
-		page.audioBuffer.setSize(2, numSamples, false, true, true);
-		page.audioBuffer.clear();
-
-		DBG("loadAudioFileForPage: Buffer allocated - channels=" << page.audioBuffer.getNumChannels() << ", samples=" << page.audioBuffer.getNumSamples());
-
-		if (!reader->read(&page.audioBuffer, 0, numSamples, 0, true, true))
+		double sampleRate = 0.0;
+		auto audio = SharedAudioCache::getInstance().load(audioFile, sampleRate);
+		if (!audio)
 		{
-			DBG("loadAudioFileForPage: Failed to read samples for page " << pageIndex);
+			DBG("loadAudioFileForPage: Failed to read page " << pageIndex << ": " << audioFile.getFullPathName());
 			page.numSamples = 0;
 			page.isLoaded = false;
-			page.audioBuffer.setSize(0, 0);
+			page.playback.reset();
 			return;
 		}
 
-		if (numChannels == 1)
+		page.numSamples = audio->getNumSamples();
+		page.sampleRate = sampleRate;
+		page.publishAudio(audio);
+		if (!page.getAnalysis())
 		{
-			page.audioBuffer.copyFrom(1, 0, page.audioBuffer, 0, 0, numSamples);
-			DBG("loadAudioFileForPage: Converted mono to stereo");
+			if (auto analysis = PageCacheFile::readAnalysis(audioFile))
+				PlaybackAudio::attachAnalysis(page.playback, analysis);
 		}
-
-		page.numSamples = numSamples;
-		page.sampleRate = reader->sampleRate;
 		page.isLoaded = true;
 		page.isLoading = false;
 
-		DBG("loadAudioFileForPage: SUCCESS - Page " << (char)('A' + pageIndex) << " loaded with " << page.numSamples << " samples, buffer has " << page.audioBuffer.getNumSamples() << " samples");
-
-		float maxSample = 0.0f;
-		for (int ch = 0; ch < page.audioBuffer.getNumChannels(); ++ch)
-		{
-			auto* channelData = page.audioBuffer.getReadPointer(ch);
-			for (int i = 0; i < page.audioBuffer.getNumSamples(); ++i)
-			{
-				maxSample = std::max(maxSample, std::abs(channelData[i]));
-			}
-		}
-		DBG("loadAudioFileForPage: Max sample amplitude: " << maxSample);
+		DBG("loadAudioFileForPage: SUCCESS - Page " << (char)('A' + pageIndex) << " loaded with " << page.numSamples << " samples");
 	}
 
 	void loadAudioFileForTrack(TrackData* track, const juce::File& audioFile)
 	{
-		static juce::AudioFormatManager formatManager;
-		static bool initialized = false;
-		if (!initialized)
-		{
-			formatManager.registerBasicFormats();
-			initialized = true;
-		}
-
-		std::unique_ptr<juce::AudioFormatReader> reader(formatManager.createReaderFor(audioFile));
+		double sampleRate = 0.0;
+		auto audio = SharedAudioCache::getInstance().load(audioFile, sampleRate);
 
-		if (reader != nullptr)
+		if (audio != nullptr)
 		{
-			int numChannels = reader->numChannels;
-			int numSamples = static_cast<int>(reader->lengthInSamples);
-
-			track->audioBuffer.setSize(2, numSamples);
-			reader->read(&track->audioBuffer, 0, numSamples, 0, true, true);
-
-			if (numChannels == 1)
-			{
-				track->audioBuffer.copyFrom(1, 0, track->audioBuffer, 0, 0, numSamples);
-			}
-
-			track->numSamples = track->audioBuffer.getNumSamples();
-			track->sampleRate = reader->sampleRate;
+			track->numSamples = audio->getNumSamples();
+			track->sampleRate = sampleRate;
+			auto current = track->playback.load();
+			auto analysis = current ? current->analysis : nullptr;
+			if (!analysis)
+				analysis = PageCacheFile::readAnalysis(audioFile);
+			track->playback.store(PlaybackAudio::create(std::move(audio), track->numSamples, track->sampleRate, std::move(analysis)));
 
 			DBG("Loaded audio file: " + audioFile.getFullPathName() +
-				" (" + juce::String(numSamples) + " samples, " +
+				" (" + juce::String(track->numSamples) + " samples, " +
 				juce::String(track->sampleRate) + " Hz)");
-
-			reader.reset();
 		}
 		else
 		{
@@ -836,6 +806,9 @@ private:
 			}
 		}
 
+		// Valid to the end of the block; a loader replacing the slot meanwhile
+		// retires the old buffer and index rather than freeing them under us.
+		const PlaybackAudio* playbackSnapshot = nullptr;
 		const juce::AudioSampleBuffer* bufferToUse = nullptr;
 		int numSamplesToUse = 0;
 		double sampleRateToUse = 0;
@@ -846,7 +819,7 @@ private:
 		if (track.usePages.load())
 		{
 			const auto& currentPage = track.getCurrentPage();
-			bufferToUse = &currentPage.audioBuffer;
+			playbackSnapshot = currentPage.playback.get();
 			numSamplesToUse = currentPage.numSamples;
 			sampleRateToUse = currentPage.sampleRate;
 			loopStartToUse = currentPage.loopStart;
@@ -855,13 +828,14 @@ private:
 		}
 		else
 		{
-			bufferToUse = &track.audioBuffer;
+			playbackSnapshot = track.playback.get();
 			numSamplesToUse = track.numSamples;
 			sampleRateToUse = track.sampleRate;
 			loopStartToUse = track.loopStart;
 			loopEndToUse = track.loopEnd;
 			originalBpmToUse = track.originalBpm;
 		}
+		bufferToUse = playbackSnapshot ? playbackSnapshot->buffer.get() : nullptr;
 
 		if (numSamplesToUse == 0 || !track.isPlaying.load() || !bufferToUse)
 			return;
@@ -944,6 +918,8 @@ private:
 		const double beatRepeatStart = beatRepeatActive ? track.beatRepeatStartPosition.load() : 0.0;
 		const double beatRepeatEnd = beatRepeatActive ? track.beatRepeatEndPosition.load() : 0.0;
 
+		const auto* transientIndex = playbackSnapshot->transientIndex.get();
+
 		for (int i = 0; i < numSamples; ++i)
 		{
 			if (beatRepeatActive)
@@ -951,8 +927,9 @@ private:
 				double absolutePos = startSample + currentPosition;
 				if (absolutePos >= beatRepeatEnd)
 				{
+					track.startRepeatCrossfade(absolutePos);
 					currentPosition = beatRepeatStart - startSample;
-					track.readPosition.store(beatRepeatStart);
+					track.readPosition.store(currentPosition);
 				}
 			}
 
@@ -988,6 +965,21 @@ private:
 			float leftSample = interpolateLinear(leftChannel, absolutePosition, bufferSize);
 			float rightSample = interpolateLinear(rightChannel, absolutePosition, bufferSize);
 
+			if (track.repeatFadeRemaining > 0)
+			{
+				int fadeIndex = TransientIndex::crossfadeLength - track.repeatFadeRemaining;
+				float fadeIn = transientIndex ? transientIndex->getFadeIn(fadeIndex)
+					: (float)fadeIndex / TransientIndex::crossfadeLength;
+				float fadeOut = transientIndex ? transientIndex->getFadeOut(fadeIndex) : 1.0f - fadeIn;
+				double tailPosition = juce::jmin(track.repeatFadeTailPosition, (double)bufferSize - 1);
+
+				leftSample = leftSample * fadeIn + interpolateLinear(leftChannel, tailPosition, bufferSize) * fadeOut;
+				rightSample = rightSample * fadeIn + interpolateLinear(rightChannel, tailPosition, bufferSize) * fadeOut;
+
+				track.repeatFadeTailPosition += playbackRatio;
+				--track.repeatFadeRemaining;
+			}
+
 			leftSample *= volume * leftGain * fadeGain;
 			rightSample *= volume * rightGain * fadeGain;
 
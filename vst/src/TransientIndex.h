@@ -0,0 +1,150 @@
+#pragma once
+#include "JuceHeader.h"
+#include "AudioAnalyzer.h"
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <vector>
+
+// Sample positions where a beat-repeat window can start or end without a
+// click: attack starts of detected onsets and upward zero crossings. Built off
+// the audio thread whenever a page buffer is loaded; lookups are binary
+// searches, so the audio thread can snap repeat windows inside a block.
+class TransientIndex
+{
+public:
+	using Ptr = std::shared_ptr<const TransientIndex>;
+
+	static constexpr int crossfadeLength = 128;
+
+	static Ptr build(const juce::AudioBuffer<float>& buffer, int numSamples, double sampleRate)
+	{
+		numSamples = juce::jmin(numSamples, buffer.getNumSamples());
+		if (numSamples <= 0 || buffer.getNumChannels() == 0 || sampleRate <= 0.0)
+			return nullptr;
+
+		auto index = std::make_shared<TransientIndex>();
+		index->sampleRate = sampleRate;
+
+		const float* left = buffer.getReadPointer(0);
+		const float* right = buffer.getNumChannels() > 1 ? buffer.getReadPointer(1) : left;
+		auto mono = [left, right](int i) { return (left[i] + right[i]) * 0.5f; };
+
+		int lastCrossing = -minCrossingSpacing;
+		float previous = mono(0);
+		for (int i = 1; i < numSamples; ++i)
+		{
+			float current = mono(i);
+			if (previous < 0.0f && current >= 0.0f && i - lastCrossing >= minCrossingSpacing)
+			{
+				index->zeroCrossings.push_back(i);
+				lastCrossing = i;
+			}
+			previous = current;
+		}
+
+		juce::AudioBuffer<float> view(const_cast<float* const*>(buffer.getArrayOfReadPointers()),
+			juce::jmin(2, buffer.getNumChannels()), numSamples);
+		int searchRadius = (int)(sampleRate * 0.01);
+		for (float onsetSeconds : AudioAnalyzer::detectOnsets(view, sampleRate))
+		{
+			int attack = findAttackStart(mono, (int)(onsetSeconds * sampleRate), searchRadius, numSamples);
+			int crossing = index->findNearest(index->zeroCrossings, attack, sampleRate * 0.002);
+			index->transients.push_back(crossing >= 0 && crossing <= attack ? crossing : attack);
+		}
+		std::sort(index->transients.begin(), index->transients.end());
+		index->transients.erase(std::unique(index->transients.begin(), index->transients.end()), index->transients.end());
+
+		for (int i = 0; i < crossfadeLength; ++i)
+		{
+			double phase = (i + 0.5) / crossfadeLength * juce::MathConstants<double>::halfPi;
+			index->fadeIn[(size_t)i] = (float)std::sin(phase);
+			index->fadeOut[(size_t)i] = (float)std::cos(phase);
+		}
+		return index;
+	}
+
+	// Where a repeat starting near position should begin: the closest attack
+	// within maxDistance, otherwise the closest zero crossing.
+	double snapStart(double position, double maxDistance) const
+	{
+		int transient = findNearest(transients, position, maxDistance);
+		if (transient >= 0)
+			return transient;
+		return snapToZeroCrossing(position);
+	}
+
+	double snapToZeroCrossing(double position) const
+	{
+		int crossing = findNearest(zeroCrossings, position, sampleRate * maxCrossingSnapSeconds);
+		return crossing >= 0 ? (double)crossing : position;
+	}
+
+	float getFadeIn(int i) const { return fadeIn[(size_t)i]; }
+	float getFadeOut(int i) const { return fadeOut[(size_t)i]; }
+	size_t getNumTransients() const { return transients.size(); }
+
+private:
+	static constexpr int minCrossingSpacing = 16;
+	static constexpr double maxCrossingSnapSeconds = 0.005;
+
+	double sampleRate = 48000.0;
+	std::vector<int> transients;
+	std::vector<int> zeroCrossings;
+	std::array<float, crossfadeLength> fadeIn{};
+	std::array<float, crossfadeLength> fadeOut{};
+
+	static int findNearest(const std::vector<int>& positions, double position, double maxDistance)
+	{
+		if (positions.empty())
+			return -1;
+
+		auto it = std::lower_bound(positions.begin(), positions.end(), position,
+			[](int value, double target) { return value < target; });
+
+		int best = -1;
+		double bestDistance = maxDistance;
+		if (it != positions.end() && *it - position <= bestDistance)
+		{
+			best = *it;
+			bestDistance = *it - position;
+		}
+		if (it != positions.begin() && position - *(it - 1) <= bestDistance)
+			best = *(it - 1);
+		return best;
+	}
+
+	// Onset frames are ~10 ms wide. Walk back from the loudest point in 32
+	// sample blocks to the last quiet block so the repeat starts on the attack
+	// itself rather than wherever the analysis frame happened to be centred.
+	template <typename MonoFn>
+	static int findAttackStart(MonoFn mono, int centre, int radius, int numSamples)
+	{
+		const int blockSize = 32;
+		int start = juce::jlimit(0, numSamples - 1, centre - radius);
+		int end = juce::jlimit(start + 1, numSamples, centre + radius);
+
+		float peak = 0.0f;
+		int peakIndex = start;
+		for (int i = start; i < end; ++i)
+		{
+			float value = std::abs(mono(i));
+			if (value > peak)
+			{
+				peak = value;
+				peakIndex = i;
+			}
+		}
+
+		float threshold = peak * 0.2f;
+		for (int blockEnd = peakIndex; blockEnd - blockSize >= start; blockEnd -= blockSize)
+		{
+			float blockPeak = 0.0f;
+			for (int i = blockEnd - blockSize; i < blockEnd; ++i)
+				blockPeak = juce::jmax(blockPeak, std::abs(mono(i)));
+			if (blockPeak < threshold)
+				return blockEnd;
+		}
+		return start;
+	}
+};
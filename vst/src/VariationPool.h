@@ -0,0 +1,464 @@
+#pragma once
+#include "JuceHeader.h"
+#include "DjIaClient.h"
+#include "GenerationControl.h"
+#include <map>
+#include <set>
+#include <deque>
+#include <atomic>
+#include <memory>
+
+class VariationPool
+{
+public:
+	// Server results arrive as a file; local ones stay in memory in audio.
+	struct Variation
+	{
+		juce::File audioFile;
+		std::shared_ptr<juce::AudioBuffer<float>> audio;
+		double sampleRate = 0.0;
+		juce::String signature;
+		float detectedBpm = -1.0f;
+		juce::int64 sizeBytes = 0;
+
+		bool hasAudio() const { return audio != nullptr || audioFile.existsAsFile(); }
+	};
+
+	static juce::String buildSignature(const DjIaClient::LoopRequest& request, const juce::String& backend)
+	{
+		juce::StringArray parts;
+		parts.add(backend);
+		parts.add(request.prompt.trim().toLowerCase());
+		parts.add(request.key);
+		parts.add(juce::String(juce::roundToInt(request.bpm)));
+		parts.add(juce::String(juce::roundToInt(request.generationDuration)));
+		parts.add(request.keywords.joinIntoString(","));
+		return parts.joinIntoString("|");
+	}
+
+	bool take(const juce::String& trackId, const juce::String& signature, Variation& result)
+	{
+		juce::ScopedLock lock(poolLock);
+		auto it = pools.find(trackId);
+		if (it == pools.end())
+			return false;
+
+		auto& variations = it->second;
+		for (auto v = variations.begin(); v != variations.end(); ++v)
+		{
+			if (v->signature == signature && v->hasAudio())
+			{
+				result = *v;
+				totalBytes -= v->sizeBytes;
+				variations.erase(v);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void add(const juce::String& trackId, Variation variation)
+	{
+		juce::ScopedLock lock(poolLock);
+		variation.sizeBytes = variation.audio != nullptr
+			? static_cast<juce::int64>(variation.audio->getNumChannels()) * variation.audio->getNumSamples() * (juce::int64)sizeof(float)
+			: variation.audioFile.getSize();
+		totalBytes += variation.sizeBytes;
+		pools[trackId].push_back(variation);
+	}
+
+	int countMatching(const juce::String& trackId, const juce::String& signature) const
+	{
+		juce::ScopedLock lock(poolLock);
+		auto it = pools.find(trackId);
+		if (it == pools.end())
+			return 0;
+
+		int count = 0;
+		for (const auto& variation : it->second)
+		{
+			if (variation.signature == signature)
+				++count;
+		}
+		return count;
+	}
+
+	void discardStale(const juce::String& trackId, const juce::String& currentSignature)
+	{
+		juce::ScopedLock lock(poolLock);
+		auto it = pools.find(trackId);
+		if (it == pools.end())
+			return;
+
+		auto& variations = it->second;
+		for (auto v = variations.begin(); v != variations.end();)
+		{
+			if (v->signature != currentSignature)
+			{
+				totalBytes -= v->sizeBytes;
+				v->audioFile.deleteFile();
+				v = variations.erase(v);
+			}
+			else
+			{
+				++v;
+			}
+		}
+	}
+
+	void removeTrack(const juce::String& trackId)
+	{
+		juce::ScopedLock lock(poolLock);
+		auto it = pools.find(trackId);
+		if (it == pools.end())
+			return;
+
+		for (auto& variation : it->second)
+		{
+			totalBytes -= variation.sizeBytes;
+			variation.audioFile.deleteFile();
+		}
+		pools.erase(it);
+	}
+
+	void clear()
+	{
+		juce::ScopedLock lock(poolLock);
+		for (auto& pair : pools)
+		{
+			for (auto& variation : pair.second)
+				variation.audioFile.deleteFile();
+		}
+		pools.clear();
+		totalBytes = 0;
+	}
+
+	juce::int64 getTotalBytes() const
+	{
+		juce::ScopedLock lock(poolLock);
+		return totalBytes;
+	}
+
+private:
+	mutable juce::CriticalSection poolLock;
+	std::map<juce::String, std::deque<Variation>> pools;
+	juce::int64 totalBytes = 0;
+};
+
+class SpeculativeGenerator
+{
+public:
+	struct Target
+	{
+		juce::String trackId;
+		DjIaClient::LoopRequest request;
+		juce::String signature;
+	};
+
+	struct Budget
+	{
+		int variationsPerTrack = 0;
+		int maxConcurrentJobs = 1;
+		// Rolling limit: user activity doesn't refill it.
+		int maxSpeculativeCreditsPerHour = 20;
+		int minCreditsReserve = 10;
+		juce::int64 maxDiskBytes = (juce::int64)512 * 1024 * 1024;
+	};
+
+	// What generate() hands back: the server response, plus the audio itself
+	// when it was made locally and never written to disk.
+	struct Result
+	{
+		DjIaClient::LoopResponse response;
+		std::shared_ptr<juce::AudioBuffer<float>> audio;
+		double sampleRate = 0.0;
+	};
+
+	struct Stats
+	{
+		int generated = 0;
+		int served = 0;
+		int cancelled = 0;
+		int creditsSpent = 0;
+	};
+
+	std::function<bool()> isIdle;
+	// Called from a worker thread; the owner should build the targets on the
+	// message thread, where track state lives, and hand them to setTargets().
+	std::function<void()> requestTargets;
+	std::function<Result(const DjIaClient::LoopRequest&, const GenerationControl::Ptr&)> generate;
+
+	explicit SpeculativeGenerator(VariationPool& poolToFill) : pool(poolToFill) {}
+
+	~SpeculativeGenerator()
+	{
+		stop();
+	}
+
+	void setBudget(const Budget& newBudget)
+	{
+		{
+			juce::ScopedLock lock(jobsLock);
+			budget = newBudget;
+		}
+
+		if (budget.variationsPerTrack <= 0)
+		{
+			stop();
+			pool.clear();
+		}
+		else
+		{
+			start();
+		}
+	}
+
+	Budget getBudget() const
+	{
+		juce::ScopedLock lock(jobsLock);
+		return budget;
+	}
+
+	Stats getStats() const
+	{
+		juce::ScopedLock lock(jobsLock);
+		return stats;
+	}
+
+	bool isEnabled() const
+	{
+		juce::ScopedLock lock(jobsLock);
+		return budget.variationsPerTrack > 0;
+	}
+
+	void start()
+	{
+		juce::ScopedLock lifecycle(lifecycleLock);
+		int numWorkers = juce::jlimit(1, 4, getBudget().maxConcurrentJobs);
+		{
+			juce::ScopedLock lock(workersLock);
+			if (workers.size() == numWorkers)
+				return;
+		}
+
+		stop();
+		juce::OwnedArray<Worker> started;
+		for (int i = 0; i < numWorkers; ++i)
+		{
+			auto* worker = started.add(new Worker(*this, i));
+			worker->startThread(juce::Thread::Priority::low);
+		}
+
+		juce::ScopedLock lock(workersLock);
+		workers.swapWith(started);
+	}
+
+	void stop()
+	{
+		juce::ScopedLock lifecycle(lifecycleLock);
+		cancelSpeculativeWork();
+
+		// Joined outside workersLock, so a generation thread calling
+		// notifyStateChanged() meanwhile doesn't wait on the join.
+		juce::OwnedArray<Worker> stopping;
+		{
+			juce::ScopedLock lock(workersLock);
+			stopping.swapWith(workers);
+		}
+		for (auto* worker : stopping)
+		{
+			worker->signalThreadShouldExit();
+			worker->notify();
+		}
+		for (auto* worker : stopping)
+			worker->stopThread(5000);
+	}
+
+	void cancelSpeculativeWork()
+	{
+		juce::ScopedLock lock(jobsLock);
+		++epoch;
+		for (auto& token : activeTokens)
+		{
+			if (!token->isCancelled())
+			{
+				token->cancel();
+				++stats.cancelled;
+			}
+		}
+	}
+
+	void notifyStateChanged()
+	{
+		juce::ScopedLock lock(workersLock);
+		for (auto* worker : workers)
+			worker->notify();
+	}
+
+	void setTargets(std::vector<Target> newTargets)
+	{
+		{
+			juce::ScopedLock lock(jobsLock);
+			targets = std::move(newTargets);
+		}
+		targetsRequested = false;
+	}
+
+	void recordServed()
+	{
+		juce::ScopedLock lock(jobsLock);
+		++stats.served;
+	}
+
+	void updateKnownCredits(int creditsRemaining, bool isUnlimitedKey)
+	{
+		if (creditsRemaining < 0 && !isUnlimitedKey)
+			return;
+		juce::ScopedLock lock(jobsLock);
+		knownCredits = isUnlimitedKey ? -1 : creditsRemaining;
+	}
+
+private:
+	class Worker : public juce::Thread
+	{
+	public:
+		Worker(SpeculativeGenerator& ownerToUse, int index)
+			: juce::Thread("SpeculativeGeneration " + juce::String(index)), owner(ownerToUse)
+		{
+		}
+
+		void run() override
+		{
+			while (!threadShouldExit())
+			{
+				wait(2000);
+				if (threadShouldExit())
+					break;
+				owner.runNextJob();
+			}
+		}
+
+	private:
+		SpeculativeGenerator& owner;
+	};
+
+	VariationPool& pool;
+	// lifecycleLock serializes start() and stop(); workersLock only guards
+	// the array, which notifyStateChanged() walks from other threads.
+	juce::CriticalSection lifecycleLock;
+	juce::CriticalSection workersLock;
+	juce::OwnedArray<Worker> workers;
+	mutable juce::CriticalSection jobsLock;
+	Budget budget;
+	Stats stats;
+	std::set<juce::String> inFlightTracks;
+	std::vector<GenerationControl::Ptr> activeTokens;
+	std::vector<Target> targets;
+	std::atomic<bool> targetsRequested{ false };
+	juce::int64 epoch = 0;
+	int knownCredits = -1;
+	// Start times of the speculative jobs in the last creditWindowMs.
+	std::deque<juce::int64> recentSpends;
+	static constexpr juce::int64 creditWindowMs = 60 * 60 * 1000;
+
+	bool hasBudgetFor(const Budget& currentBudget)
+	{
+		auto windowStart = juce::Time::currentTimeMillis() - creditWindowMs;
+		while (!recentSpends.empty() && recentSpends.front() <= windowStart)
+			recentSpends.pop_front();
+
+		if (static_cast<int>(recentSpends.size()) >= currentBudget.maxSpeculativeCreditsPerHour)
+			return false;
+		if (knownCredits >= 0 && knownCredits <= currentBudget.minCreditsReserve)
+			return false;
+		if (pool.getTotalBytes() >= currentBudget.maxDiskBytes)
+			return false;
+		return static_cast<int>(activeTokens.size()) < currentBudget.maxConcurrentJobs;
+	}
+
+	void runNextJob()
+	{
+		if (!isIdle || !requestTargets || !generate || !isIdle())
+			return;
+
+		// Used on the next pass; until then the last snapshot is good enough,
+		// stale signatures are discarded below anyway.
+		if (!targetsRequested.exchange(true))
+			requestTargets();
+
+		Target selected;
+		bool found = false;
+		auto token = GenerationControl::create();
+		juce::int64 jobEpoch = 0;
+
+		{
+			juce::ScopedLock lock(jobsLock);
+			if (budget.variationsPerTrack <= 0 || !hasBudgetFor(budget))
+				return;
+
+			for (const auto& target : targets)
+			{
+				pool.discardStale(target.trackId, target.signature);
+
+				if (inFlightTracks.count(target.trackId) > 0)
+					continue;
+				if (pool.countMatching(target.trackId, target.signature) >= budget.variationsPerTrack)
+					continue;
+
+				selected = target;
+				found = true;
+				break;
+			}
+
+			if (!found)
+				return;
+
+			inFlightTracks.insert(selected.trackId);
+			activeTokens.push_back(token);
+			jobEpoch = epoch;
+			++stats.creditsSpent;
+			recentSpends.push_back(juce::Time::currentTimeMillis());
+		}
+
+		DBG("Speculative generation for track " + selected.trackId + ": " + selected.request.prompt);
+		auto result = generate(selected.request, token);
+		auto& response = result.response;
+		bool hasAudio = result.audio != nullptr
+			? result.audio->getNumSamples() > 0
+			: response.audioData.existsAsFile() && response.audioData.getSize() > 0;
+
+		bool keepResult = false;
+		{
+			juce::ScopedLock lock(jobsLock);
+			inFlightTracks.erase(selected.trackId);
+			activeTokens.erase(std::remove(activeTokens.begin(), activeTokens.end(), token), activeTokens.end());
+
+			if (response.creditsRemaining >= 0 || response.isUnlimitedKey)
+				knownCredits = response.isUnlimitedKey ? -1 : response.creditsRemaining;
+
+			keepResult = !token->isCancelled() && jobEpoch == epoch
+				&& response.errorMessage.isEmpty() && hasAudio;
+
+			if (keepResult)
+				++stats.generated;
+		}
+
+		if (!keepResult)
+		{
+			response.audioData.deleteFile();
+			return;
+		}
+
+		VariationPool::Variation variation;
+		variation.audioFile = response.audioData;
+		variation.audio = result.audio;
+		variation.sampleRate = result.sampleRate;
+		variation.signature = selected.signature;
+		variation.detectedBpm = response.detectedBpm;
+		pool.add(selected.trackId, variation);
+
+		DBG("Speculative variation pooled for track " + selected.trackId);
+	}
+
+	JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(SpeculativeGenerator)
+};
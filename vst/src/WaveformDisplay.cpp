@@ -34,44 +34,32 @@ void WaveformDisplay::setOriginalBpm(float bpm)
 	originalBpm = bpm;
 }
 
-void WaveformDisplay::setAudioData(const juce::AudioBuffer<float>& newAudioBuffer, double newSampleRate)
+void WaveformDisplay::setAudioData(PeakPyramid::Ptr newPeaks, double newSampleRate)
 {
 	jassert(juce::MessageManager::getInstance()->isThisTheMessageThread());
 
-	if (newAudioBuffer.getNumChannels() == 0 || newAudioBuffer.getNumSamples() == 0)
+	sampleRate = newSampleRate;
+
+	if (newPeaks == nullptr || newPeaks->getNumSamples() == 0)
 	{
-		audioBuffer.setSize(0, 0);
-		sampleRate = newSampleRate;
+		peaks.reset();
 		thumbnailLeft.clear();
 		thumbnailRight.clear();
 		repaint();
 		return;
 	}
 
-	try
+	// Refreshes for the same buffer keep the current zoom and scroll.
+	if (newPeaks != peaks)
 	{
-		audioBuffer.setSize(newAudioBuffer.getNumChannels(), newAudioBuffer.getNumSamples(), false, true, true);
-
-		for (int channel = 0; channel < newAudioBuffer.getNumChannels(); ++channel)
-		{
-			audioBuffer.copyFrom(channel, 0, newAudioBuffer, channel, 0, newAudioBuffer.getNumSamples());
-		}
-
-		sampleRate = newSampleRate;
+		peaks = std::move(newPeaks);
 		zoomFactor = 1.0;
 		viewStartTime = 0.0;
-
-		generateThumbnail();
-		repaint();
-	}
-	catch (const std::exception& /*e*/)
-	{
-		audioBuffer.setSize(0, 0);
-		sampleRate = newSampleRate;
-		thumbnailLeft.clear();
-		thumbnailRight.clear();
-		repaint();
+		updateScrollBarVisibility();
 	}
+
+	generateThumbnail();
+	repaint();
 }
 
 void WaveformDisplay::setLoopPoints(double startTime, double endTime)
@@ -103,22 +91,44 @@ void WaveformDisplay::calculateStretchRatio() const
 
 void WaveformDisplay::setPlaybackPosition(double timeInSeconds, bool isPlaying)
 {
+	jassert(juce::MessageManager::getInstance()->isThisTheMessageThread());
+
 	playbackPosition = timeInSeconds;
 	isCurrentlyPlaying = isPlaying;
+	repaintPlaybackHead();
+}
 
-	juce::MessageManager::callAsync([this]()
-		{ repaint(); });
+// Only the strips under the old and new head need redrawing; everything
+// under them comes from the cached layers.
+void WaveformDisplay::repaintPlaybackHead()
+{
+	auto area = getPlaybackHeadArea();
+	if (area == lastPlaybackHeadArea)
+		return;
+
+	repaint(lastPlaybackHeadArea);
+	repaint(area);
+	lastPlaybackHeadArea = area;
+}
+
+juce::Rectangle<int> WaveformDisplay::getPlaybackHeadArea()
+{
+	if (!isCurrentlyPlaying || playbackPosition < getViewStartTime() || playbackPosition > getViewEndTime())
+		return {};
+
+	int headX = juce::roundToInt(timeToX(playbackPosition));
+	return juce::Rectangle<int>(headX - 42, 0, 84, getHeight()).getIntersection(getLocalBounds());
 }
 
 void WaveformDisplay::paint(juce::Graphics& g)
 {
 	auto bounds = getLocalBounds();
 
-	g.setColour(ColourPalette::backgroundMid);
-	g.fillRect(bounds);
-
 	if (thumbnailLeft.empty() && thumbnailRight.empty())
 	{
+		g.setColour(ColourPalette::backgroundMid);
+		g.fillRect(bounds);
+
 		g.setColour(ColourPalette::textSecondary);
 		g.setFont(12.0f);
 		g.drawText("No audio data", bounds.reduced(5).removeFromTop(20), juce::Justification::centred);
@@ -130,11 +140,15 @@ void WaveformDisplay::paint(juce::Graphics& g)
 		return;
 	}
 
-	drawWaveform(g);
+	float scale = g.getInternalContext().getPhysicalPixelScaleFactor();
+	updateWaveformLayer(scale);
+	updateGridLayer(scale);
+
+	g.drawImage(waveformLayer, bounds.toFloat());
 	drawLoopMarkers(g);
-	drawBeatMarkers(g);
+	drawLoopSuggestion(g);
+	g.drawImage(gridLayer, bounds.toFloat());
 	drawPlaybackHead(g);
-	drawVisibleBarLabels(g);
 
 	if (zoomFactor > 1.0)
 	{
@@ -151,6 +165,65 @@ void WaveformDisplay::paint(juce::Graphics& g)
 	}
 }
 
+juce::Image WaveformDisplay::createLayerImage(juce::Image::PixelFormat format, float scale) const
+{
+	return juce::Image(format,
+		juce::jmax(1, juce::roundToInt(getWidth() * scale)),
+		juce::jmax(1, juce::roundToInt(getHeight() * scale)),
+		true);
+}
+
+// The waveform only changes with the thumbnail, the size or the stretch
+// colour, so it is rendered once and blitted on every other repaint.
+void WaveformDisplay::updateWaveformLayer(float scale)
+{
+	if (!waveformLayerDirty && waveformLayer.isValid()
+		&& waveformLayerScale == scale && waveformLayerStretchRatio == stretchRatio
+		&& waveformLayer.getWidth() == juce::jmax(1, juce::roundToInt(getWidth() * scale))
+		&& waveformLayer.getHeight() == juce::jmax(1, juce::roundToInt(getHeight() * scale)))
+		return;
+
+	waveformLayer = createLayerImage(juce::Image::RGB, scale);
+	juce::Graphics layer(waveformLayer);
+	layer.addTransform(juce::AffineTransform::scale(scale));
+	layer.setColour(ColourPalette::backgroundMid);
+	layer.fillRect(getLocalBounds());
+	drawWaveform(layer);
+
+	waveformLayerDirty = false;
+	waveformLayerScale = scale;
+	waveformLayerStretchRatio = stretchRatio;
+}
+
+// The grid follows the host tempo and time signature, so rather than
+// hooking every place those can change, the inputs are compared on paint.
+void WaveformDisplay::updateGridLayer(float scale)
+{
+	GridLayerKey key;
+	key.hostBpm = getHostBpm();
+	key.trackBpm = trackBpm;
+	key.stretchRatio = stretchRatio;
+	key.numerator = audioProcessor.getTimeSignatureNumerator();
+	key.denominator = audioProcessor.getTimeSignatureDenominator();
+	key.loopStart = loopStart;
+	key.viewStartTime = viewStartTime;
+	key.zoomFactor = zoomFactor;
+	key.totalDuration = getTotalDuration();
+	key.width = getWidth();
+	key.height = getHeight();
+	key.scale = scale;
+
+	if (gridLayer.isValid() && key.matches(gridLayerKey))
+		return;
+
+	gridLayer = createLayerImage(juce::Image::ARGB, scale);
+	juce::Graphics layer(gridLayer);
+	layer.addTransform(juce::AffineTransform::scale(scale));
+	drawBeatMarkers(layer);
+	drawVisibleBarLabels(layer);
+	gridLayerKey = key;
+}
+
 void WaveformDisplay::mouseDown(const juce::MouseEvent& e)
 {
 	if (e.mods.isRightButtonDown())
@@ -394,8 +467,9 @@ void WaveformDisplay::generateThumbnail()
 {
 	thumbnailLeft.clear();
 	thumbnailRight.clear();
+	waveformLayerDirty = true;
 
-	if (audioBuffer.getNumSamples() == 0)
+	if (peaks == nullptr)
 		return;
 
 	double totalDuration = getTotalDuration();
@@ -404,8 +478,8 @@ void WaveformDisplay::generateThumbnail()
 
 	int startSample = (int)(viewStartTime * sampleRate);
 	int endSample = (int)(viewEndTime * sampleRate);
-	startSample = juce::jlimit(0, audioBuffer.getNumSamples() - 1, startSample);
-	endSample = juce::jlimit(startSample + 1, audioBuffer.getNumSamples(), endSample);
+	startSample = juce::jlimit(0, peaks->getNumSamples() - 1, startSample);
+	endSample = juce::jlimit(startSample + 1, peaks->getNumSamples(), endSample);
 
 	int viewSamples = endSample - startSample;
 
@@ -417,57 +491,26 @@ void WaveformDisplay::generateThumbnail()
 
 	int samplesPerPoint = juce::jmax(1, viewSamples / targetPoints);
 
+	thumbnailLeft.reserve((size_t)targetPoints);
+	thumbnailRight.reserve((size_t)targetPoints);
+
 	for (int point = 0; point < targetPoints; ++point)
 	{
-		int retFlag;
-		feedThumbnailStereo(startSample, point, samplesPerPoint, retFlag);
-		if (retFlag == 2)
+		int sampleStart = startSample + (point * samplesPerPoint);
+		if (sampleStart >= peaks->getNumSamples())
 			break;
+
+		feedThumbnailStereo(sampleStart, sampleStart + samplesPerPoint);
 	}
 }
 
-void WaveformDisplay::feedThumbnailStereo(int startSample, int point, int samplesPerPoint, int& retFlag)
+void WaveformDisplay::feedThumbnailStereo(int sampleStart, int sampleEnd)
 {
-	retFlag = 1;
-	int sampleStart = startSample + (point * samplesPerPoint);
-	int sampleEnd = std::min(sampleStart + samplesPerPoint, audioBuffer.getNumSamples());
-
-	if (sampleStart >= audioBuffer.getNumSamples())
-	{
-		retFlag = 2;
-		return;
-	}
-
-	float rmsSumLeft = 0.0f;
-	float rmsSumRight = 0.0f;
-	float peakLeft = 0.0f;
-	float peakRight = 0.0f;
-	int count = 0;
-
-	int numChannels = audioBuffer.getNumChannels();
-	bool isMono = (numChannels == 1);
-
-	for (int sample = sampleStart; sample < sampleEnd; ++sample)
-	{
-		if (sample >= audioBuffer.getNumSamples())
-			break;
-
-		float valLeft = audioBuffer.getSample(0, sample);
-		rmsSumLeft += valLeft * valLeft;
-		peakLeft = std::max(peakLeft, std::abs(valLeft));
+	auto left = peaks->getRange(0, sampleStart, sampleEnd);
+	auto right = peaks->getRange(1, sampleStart, sampleEnd);
 
-		float valRight = isMono ? valLeft : audioBuffer.getSample(1, sample);
-		rmsSumRight += valRight * valRight;
-		peakRight = std::max(peakRight, std::abs(valRight));
-
-		count++;
-	}
-
-	float rmsLeft = count > 0 ? std::sqrt(rmsSumLeft / count) : 0.0f;
-	float rmsRight = count > 0 ? std::sqrt(rmsSumRight / count) : 0.0f;
-
-	float finalLeft = (rmsLeft * 0.7f) + (peakLeft * 0.3f);
-	float finalRight = (rmsRight * 0.7f) + (peakRight * 0.3f);
+	float finalLeft = (left.rms * 0.7f) + (left.getPeak() * 0.3f);
+	float finalRight = (right.rms * 0.7f) + (right.getPeak() * 0.3f);
 
 	thumbnailLeft.push_back(finalLeft);
 	thumbnailRight.push_back(finalRight);
@@ -643,6 +686,43 @@ void WaveformDisplay::setColorDependingTimeStretchRatio(juce::Colour& waveformCo
 	}
 }
 
+void WaveformDisplay::drawLoopSuggestion(juce::Graphics& g)
+{
+	const auto& suggestion = track.getLoopSuggestion();
+	if (!suggestion.isValid() || suggestion.matches(loopStart, loopEnd))
+		return;
+
+	float startX = timeToX(suggestion.startSeconds);
+	float endX = timeToX(suggestion.endSeconds);
+	float height = static_cast<float>(getHeight());
+
+	juce::Path outline;
+	outline.addRectangle(startX, 1.0f, endX - startX, height - 2.0f);
+	juce::Path dashed;
+	const float dashes[] = { 4.0f, 4.0f };
+	juce::PathStrokeType(1.0f).createDashedStroke(dashed, outline, dashes, 2);
+
+	g.setColour(ColourPalette::textSecondary.withAlpha(0.8f));
+	g.fillPath(dashed);
+
+	g.setFont(juce::FontOptions(10.0f));
+	g.drawText("Suggested " + juce::String(suggestion.bars) + (suggestion.bars == 1 ? " bar" : " bars")
+		+ " - double-click to use",
+		juce::Rectangle<float>(startX + 4.0f, height - 16.0f, juce::jmax(0.0f, endX - startX - 8.0f), 14.0f),
+		juce::Justification::centredLeft, true);
+}
+
+void WaveformDisplay::mouseDoubleClick(const juce::MouseEvent& /*e*/)
+{
+	const auto suggestion = track.getLoopSuggestion();
+	if (!suggestion.isValid() || suggestion.matches(loopStart, loopEnd))
+		return;
+
+	if (onLoopPointsChanged)
+		onLoopPointsChanged(suggestion.startSeconds, suggestion.endSeconds);
+	repaint();
+}
+
 void WaveformDisplay::drawLoopMarkers(juce::Graphics& g)
 {
 	float startX = timeToX(loopStart);
@@ -978,10 +1058,10 @@ double WaveformDisplay::xToTime(float x)
 
 double WaveformDisplay::getTotalDuration() const
 {
-	if (audioBuffer.getNumSamples() == 0 || sampleRate <= 0)
+	if (peaks == nullptr || sampleRate <= 0)
 		return 0.0;
 
-	return audioBuffer.getNumSamples() / sampleRate;
+	return peaks->getNumSamples() / sampleRate;
 }
 
 double WaveformDisplay::getViewStartTime() const
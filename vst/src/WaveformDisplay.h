@@ -1,5 +1,6 @@
 #pragma once
 #include "JuceHeader.h"
+#include "PeakPyramid.h"
 
 class DjIaVstProcessor;
 struct TrackData;
@@ -16,12 +17,12 @@ public:
 	void setSampleBpm(float bpm);
 	void lockLoopPoints(bool locked);
 	void setPlaybackPosition(double timeInSeconds, bool isPlaying);
-	void setAudioData(const juce::AudioBuffer<float>& newAudioBuffer, double newSampleRate);
+	void setAudioData(PeakPyramid::Ptr newPeaks, double newSampleRate);
 	void setLoopPoints(double startTime, double endTime);
 	void setAudioFile(const juce::File& file);
 
 private:
-	juce::AudioBuffer<float> audioBuffer;
+	PeakPyramid::Ptr peaks;
 	juce::File currentAudioFile;
 	juce::Point<int> dragStartPosition;
 	std::unique_ptr<juce::ScrollBar> horizontalScrollBar;
@@ -31,6 +32,39 @@ private:
 	std::vector<float> thumbnailLeft;
 	std::vector<float> thumbnailRight;
 
+	struct GridLayerKey
+	{
+		float hostBpm = 0.0f;
+		float trackBpm = 0.0f;
+		float stretchRatio = 0.0f;
+		int numerator = 0;
+		int denominator = 0;
+		double loopStart = 0.0;
+		double viewStartTime = 0.0;
+		double zoomFactor = 0.0;
+		double totalDuration = 0.0;
+		int width = 0;
+		int height = 0;
+		float scale = 0.0f;
+
+		bool matches(const GridLayerKey& other) const
+		{
+			return hostBpm == other.hostBpm && trackBpm == other.trackBpm && stretchRatio == other.stretchRatio
+				&& numerator == other.numerator && denominator == other.denominator
+				&& loopStart == other.loopStart && viewStartTime == other.viewStartTime
+				&& zoomFactor == other.zoomFactor && totalDuration == other.totalDuration
+				&& width == other.width && height == other.height && scale == other.scale;
+		}
+	};
+
+	juce::Image waveformLayer;
+	juce::Image gridLayer;
+	GridLayerKey gridLayerKey;
+	juce::Rectangle<int> lastPlaybackHeadArea;
+	bool waveformLayerDirty = true;
+	float waveformLayerScale = 0.0f;
+	float waveformLayerStretchRatio = 0.0f;
+
 	double loopStart = 0.0;
 	double loopEnd = 4.0;
 	double sampleRate = 48000.0;
@@ -54,11 +88,17 @@ private:
 	float getHostBpm() const;
 	float timeToX(double time);
 
+	juce::Image createLayerImage(juce::Image::PixelFormat format, float scale) const;
+	void updateWaveformLayer(float scale);
+	void updateGridLayer(float scale);
+	void repaintPlaybackHead();
+	juce::Rectangle<int> getPlaybackHeadArea();
 	void generateThumbnail();
-	void feedThumbnailStereo(int startSample, int point, int samplesPerPoint, int& retFlag);
+	void feedThumbnailStereo(int sampleStart, int sampleEnd);
 	void drawWaveform(juce::Graphics& g);
 	void setColorDependingTimeStretchRatio(juce::Colour& waveformColor) const;
 	void drawLoopMarkers(juce::Graphics& g);
+	void drawLoopSuggestion(juce::Graphics& g);
 	void drawLoopTimeLabels(juce::Graphics& g, float startX, float endX);
 	void drawLoopBarLabels(juce::Graphics& g, float startX, float endX) const;
 	void drawPlaybackHead(juce::Graphics& g);
@@ -76,6 +116,7 @@ private:
 	void mouseDown(const juce::MouseEvent& e) override;
 	void mouseDrag(const juce::MouseEvent& e) override;
 	void mouseUp(const juce::MouseEvent& e) override;
+	void mouseDoubleClick(const juce::MouseEvent& e) override;
 	void mouseWheelMove(const juce::MouseEvent& e, const juce::MouseWheelDetails& wheel) override;
 	void scrollBarMoved(juce::ScrollBar* scrollBarThatHasMoved, double newRangeStart) override;
 
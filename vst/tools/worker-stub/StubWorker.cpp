@@ -0,0 +1,221 @@
+#include <juce_core/juce_core.h>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// Stand-in for audiogen-worker that speaks the same "OBSW" framing as
+// LocalInferenceWorker but renders a sine instead of running the models.
+// --load-ms simulates the model load paid once per process, --ms-per-second
+// the inference time per second of audio, so the bench can show what a
+// persistent worker saves without shipping the real models.
+
+namespace
+{
+	const char frameMagic[4] = { 'O', 'B', 'S', 'W' };
+	constexpr juce::uint32 maxHeaderBytes = 64 * 1024;
+	constexpr int stubSampleRate = 44100;
+
+	struct Options
+	{
+		int port = 0;
+		juce::String token;
+		int loadMs = 2000;
+		int msPerSecond = 50;
+	};
+
+	Options parseOptions(int argc, char* argv[])
+	{
+		Options options;
+		for (int i = 1; i + 1 < argc; ++i)
+		{
+			juce::String name(argv[i]);
+			juce::String value(argv[i + 1]);
+			if (name == "--port")
+				options.port = value.getIntValue();
+			else if (name == "--token")
+				options.token = value;
+			else if (name == "--load-ms")
+				options.loadMs = value.getIntValue();
+			else if (name == "--ms-per-second")
+				options.msPerSecond = value.getIntValue();
+		}
+		return options;
+	}
+
+	bool readExactly(juce::StreamingSocket& socket, void* dest, size_t numBytes)
+	{
+		auto* bytes = static_cast<char*>(dest);
+		size_t received = 0;
+		while (received < numBytes)
+		{
+			int count = socket.read(bytes + received, (int)(numBytes - received), true);
+			if (count <= 0)
+				return false;
+			received += (size_t)count;
+		}
+		return true;
+	}
+
+	bool writeExactly(juce::StreamingSocket& socket, const void* data, size_t numBytes)
+	{
+		auto* bytes = static_cast<const char*>(data);
+		size_t sent = 0;
+		while (sent < numBytes)
+		{
+			int count = socket.write(bytes + sent, (int)(numBytes - sent));
+			if (count <= 0)
+				return false;
+			sent += (size_t)count;
+		}
+		return true;
+	}
+
+	bool writeFrame(juce::StreamingSocket& socket, const juce::var& header, const void* payload = nullptr, size_t payloadSize = 0)
+	{
+		auto headerText = juce::JSON::toString(header, true).toStdString();
+		auto headerSize = juce::ByteOrder::swapIfBigEndian((juce::uint32)headerText.size());
+		auto payloadSizeLE = juce::ByteOrder::swapIfBigEndian((juce::uint32)payloadSize);
+
+		return writeExactly(socket, frameMagic, sizeof(frameMagic))
+			&& writeExactly(socket, &headerSize, sizeof(headerSize))
+			&& writeExactly(socket, headerText.data(), headerText.size())
+			&& writeExactly(socket, &payloadSizeLE, sizeof(payloadSizeLE))
+			&& (payloadSize == 0 || writeExactly(socket, payload, payloadSize));
+	}
+
+	bool readFrame(juce::StreamingSocket& socket, juce::var& header)
+	{
+		char magic[4];
+		juce::uint32 headerSize = 0;
+		juce::uint32 payloadSize = 0;
+
+		if (!readExactly(socket, magic, sizeof(magic)) || memcmp(magic, frameMagic, sizeof(magic)) != 0)
+			return false;
+
+		if (!readExactly(socket, &headerSize, sizeof(headerSize)))
+			return false;
+		headerSize = juce::ByteOrder::swapIfBigEndian(headerSize);
+		if (headerSize == 0 || headerSize > maxHeaderBytes)
+			return false;
+
+		juce::MemoryBlock headerData(headerSize);
+		if (!readExactly(socket, headerData.getData(), headerSize))
+			return false;
+
+		// Requests never carry a payload, skip it if one shows up anyway.
+		if (!readExactly(socket, &payloadSize, sizeof(payloadSize)))
+			return false;
+		payloadSize = juce::ByteOrder::swapIfBigEndian(payloadSize);
+		juce::MemoryBlock payload(payloadSize);
+		if (payloadSize > 0 && !readExactly(socket, payload.getData(), payloadSize))
+			return false;
+
+		header = juce::JSON::parse(headerData.toString());
+		return header.isObject();
+	}
+
+	juce::var makeHeader(const juce::String& type, juce::int64 id)
+	{
+		juce::DynamicObject::Ptr header = new juce::DynamicObject();
+		header->setProperty("type", type);
+		header->setProperty("id", id);
+		return juce::var(header.get());
+	}
+
+	bool sendFailure(juce::StreamingSocket& socket, juce::int64 id, const juce::String& error)
+	{
+		auto header = makeHeader("result", id);
+		header.getDynamicObject()->setProperty("ok", false);
+		header.getDynamicObject()->setProperty("error", error);
+		return writeFrame(socket, header);
+	}
+
+	// Returns false once the connection is gone.
+	bool runGenerate(juce::StreamingSocket& socket, const juce::var& request, const Options& options)
+	{
+		auto id = static_cast<juce::int64>(request.getProperty("id", -1));
+		float duration = juce::jlimit(0.1f, 60.0f, static_cast<float>(request.getProperty("duration", 10.0)));
+		int seed = static_cast<int>(request.getProperty("seed", -1));
+
+		constexpr int numSteps = 10;
+		int stepMs = juce::roundToInt(duration * (float)options.msPerSecond / numSteps);
+		for (int step = 0; step < numSteps; ++step)
+		{
+			if (socket.waitUntilReady(true, stepMs) == 1)
+			{
+				juce::var incoming;
+				if (!readFrame(socket, incoming))
+					return false;
+
+				auto type = incoming.getProperty("type", "").toString();
+				if (type == "cancel")
+					return sendFailure(socket, id, "Generation cancelled");
+				if (type == "shutdown")
+					return false;
+			}
+
+			auto progress = makeHeader("progress", id);
+			progress.getDynamicObject()->setProperty("percent", 100.0 * (step + 1) / numSteps);
+			if (!writeFrame(socket, progress))
+				return false;
+		}
+
+		int numFrames = juce::roundToInt(duration * stubSampleRate);
+		double frequency = 110.0 * std::pow(2.0, (seed < 0 ? 0 : seed % 24) / 12.0);
+		std::vector<float> interleaved((size_t)numFrames * 2);
+		for (int i = 0; i < numFrames; ++i)
+		{
+			auto sample = (float)(0.25 * std::sin(juce::MathConstants<double>::twoPi * frequency * i / stubSampleRate));
+			interleaved[(size_t)i * 2] = sample;
+			interleaved[(size_t)i * 2 + 1] = sample;
+		}
+
+		auto result = makeHeader("result", id);
+		result.getDynamicObject()->setProperty("ok", true);
+		result.getDynamicObject()->setProperty("channels", 2);
+		result.getDynamicObject()->setProperty("sampleRate", stubSampleRate);
+		return writeFrame(socket, result, interleaved.data(), interleaved.size() * sizeof(float));
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	auto options = parseOptions(argc, argv);
+	if (options.port <= 0)
+	{
+		std::cerr << "usage: audiogen-worker --models <dir> --port <port> --token <token> [--load-ms N] [--ms-per-second N]" << std::endl;
+		return 1;
+	}
+
+	juce::Thread::sleep(options.loadMs);
+
+	juce::StreamingSocket socket;
+	if (!socket.connect("127.0.0.1", options.port, 5000))
+		return 1;
+
+	auto hello = makeHeader("hello", 0);
+	hello.getDynamicObject()->setProperty("token", options.token);
+	if (!writeFrame(socket, hello))
+		return 1;
+
+	juce::var request;
+	while (readFrame(socket, request))
+	{
+		auto type = request.getProperty("type", "").toString();
+		if (type == "shutdown")
+			break;
+
+		if (type == "ping")
+		{
+			if (!writeFrame(socket, makeHeader("pong", 0)))
+				break;
+		}
+		else if (type == "generate")
+		{
+			if (!runGenerate(socket, request, options))
+				break;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,78 @@
+#include "LocalInferenceWorker.h"
+#include <iostream>
+
+// Times generations through LocalInferenceWorker against the stub worker:
+// once with a fresh process per job, which is what spawning audiogen costs,
+// and once with the worker kept alive between jobs.
+//
+//   audiogen-worker-bench --worker <stub> [--jobs N] [--duration S]
+
+namespace
+{
+	juce::String getOption(const juce::StringArray& args, const juce::String& name, const juce::String& fallback)
+	{
+		int index = args.indexOf(name);
+		return index >= 0 && index + 1 < args.size() ? args[index + 1] : fallback;
+	}
+
+	// Wall-clock milliseconds per job, or a negative value if a job failed.
+	double timeJobs(LocalInferenceWorker& worker, int numJobs, float duration, bool restartEachJob)
+	{
+		LocalInferenceWorker::Job job;
+		job.prompt = "bench";
+		job.duration = duration;
+
+		double totalMs = 0.0;
+		for (int i = 0; i < numJobs; ++i)
+		{
+			if (restartEachJob)
+				worker.shutdown();
+
+			job.seed = i;
+			auto start = juce::Time::getMillisecondCounterHiRes();
+			auto result = worker.runJob(job);
+			totalMs += juce::Time::getMillisecondCounterHiRes() - start;
+
+			if (!result.success)
+			{
+				std::cerr << "Job " << i << " failed: " << result.errorMessage << std::endl;
+				return -1.0;
+			}
+		}
+		return totalMs / numJobs;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	juce::StringArray args;
+	for (int i = 1; i < argc; ++i)
+		args.add(argv[i]);
+
+	juce::File executable(getOption(args, "--worker", ""));
+	int numJobs = juce::jmax(1, getOption(args, "--jobs", "5").getIntValue());
+	float duration = getOption(args, "--duration", "6").getFloatValue();
+
+	if (!executable.existsAsFile())
+	{
+		std::cerr << "usage: audiogen-worker-bench --worker <stub> [--jobs N] [--duration S]" << std::endl;
+		return 1;
+	}
+
+	auto modelsDir = juce::File::getSpecialLocation(juce::File::tempDirectory).getFullPathName();
+	LocalInferenceWorker worker(executable, modelsDir);
+
+	double coldMs = timeJobs(worker, numJobs, duration, true);
+	int coldLaunches = worker.getLaunchCount();
+	double warmMs = timeJobs(worker, numJobs, duration, false);
+	worker.shutdown();
+
+	if (coldMs < 0.0 || warmMs < 0.0)
+		return 1;
+
+	std::cout << "Worker startup:        " << worker.getLastStartupMs() << " ms" << std::endl;
+	std::cout << "Fresh worker per job:  " << coldMs << " ms/job (" << coldLaunches << " launches)" << std::endl;
+	std::cout << "Persistent worker:     " << warmMs << " ms/job ("
+		<< (worker.getLaunchCount() - coldLaunches) << " launches)" << std::endl;
+	return 0;
+}